@@ -2,10 +2,20 @@
 
 #include <DirectXMath.h>
 
-struct VertexShaderExternalData
+// the constant buffers' structs are generated from the shaders
+#include "ShaderStructs.h"
+
+// Per instance vertex data for instanced draws, read from input slot 1
+// - Must match the *_PER_INSTANCE inputs of VertexShader.hlsl and
+//   ShadowMapVS.hlsl, in the same order
+struct InstanceData
 {
+    DirectX::XMFLOAT4X4 world;
+    DirectX::XMFLOAT4 normalMatrix[3];  // rows of the inverse transpose world
     DirectX::XMFLOAT4 colorTint;
-    DirectX::XMFLOAT4X4 worldMatrix;
-    DirectX::XMFLOAT4X4 viewMatrix;
-    DirectX::XMFLOAT4X4 projectionMatrix;
+    DirectX::XMFLOAT4 material;         // texture array slice, specular intensity, light list offset, count
 };
+
+// A material's constants - MaterialData in PixelShader.hlsl
+// (the tint goes in InstanceData, so instances of different tints batch)
+typedef PixelShaderMaterialData MaterialConstants;
@@ -11,6 +11,7 @@ Camera::Camera(float x, float y, float z, float aspectRatio, float fov, float nP
     this->farPlane = fPlane;
     this->movementSpeed = moveSpeed;
     this->mLookSpeed = mouseLookSpeed;
+    XMStoreFloat4x4(&viewMatrix, XMMatrixIdentity());
 
     // update projection/view
     UpdateProjectionMatrix(aspectRatio);
@@ -21,6 +22,7 @@ Camera::Camera(float x, float y, float z, float aspectRatio, float fov, float nP
 DirectX::XMFLOAT4X4 Camera::GetViewMatrix() { return this->viewMatrix; }
 DirectX::XMFLOAT4X4 Camera::GetProjectionMatrix() { return this->projMatrix; }
 Transform* Camera::GetTransform() { return &transform; }
+const DirectX::XMFLOAT4* Camera::GetFrustumPlanes() { return this->frustumPlanes; }
 
 
 // methods
@@ -42,41 +44,67 @@ void Camera::UpdateViewMatrix()
     );
 
     XMStoreFloat4x4(&viewMatrix, view);
+    UpdateFrustumPlanes();
 }
 
 void Camera::UpdateProjectionMatrix(float aspectRatio)
 {
     XMMATRIX proj = XMMatrixPerspectiveFovLH(fieldOfView, aspectRatio, nearPlane, farPlane);
     XMStoreFloat4x4(&projMatrix, proj);
+    UpdateFrustumPlanes();
 }
 
-void Camera::Update(float dt, HWND windowHandle, int controlMode)
+// extracts the world space frustum planes straight from the combined
+// view-projection matrix (Gribb/Hartmann). DirectXMath uses row vectors,
+// so each plane is a sum/difference of the matrix columns, and the near
+// plane is just the third column since D3D clip space z runs from 0 to w
+void Camera::UpdateFrustumPlanes()
+{
+    XMFLOAT4X4 vp;
+    XMStoreFloat4x4(&vp, XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projMatrix)));
+
+    XMVECTOR col0 = XMVectorSet(vp._11, vp._21, vp._31, vp._41);
+    XMVECTOR col1 = XMVectorSet(vp._12, vp._22, vp._32, vp._42);
+    XMVECTOR col2 = XMVectorSet(vp._13, vp._23, vp._33, vp._43);
+    XMVECTOR col3 = XMVectorSet(vp._14, vp._24, vp._34, vp._44);
+
+    XMVECTOR planes[6] =
+    {
+        XMVectorAdd(col3, col0),        // left
+        XMVectorSubtract(col3, col0),   // right
+        XMVectorAdd(col3, col1),        // bottom
+        XMVectorSubtract(col3, col1),   // top
+        col2,                           // near
+        XMVectorSubtract(col3, col2)    // far
+    };
+
+    // normalize so the plane distance is in world units
+    for (int i = 0; i < 6; i++)
+    {
+        XMStoreFloat4(&frustumPlanes[i], XMPlaneNormalize(planes[i]));
+    }
+}
+
+void Camera::Update(float dt, Input& input, int controlMode)
 {
     // keyboard input
     if (0 == controlMode)
     {
-        if (GetAsyncKeyState('W') & 0x8000) { transform.MoveRelative(0.0f, 0.0f, movementSpeed * dt); }
-        if (GetAsyncKeyState('A') & 0x8000) { transform.MoveRelative(-movementSpeed * dt, 0.0f, 0.0f); }
-        if (GetAsyncKeyState('S') & 0x8000) { transform.MoveRelative(0.0f, 0.0f, -movementSpeed * dt); }
-        if (GetAsyncKeyState('D') & 0x8000) { transform.MoveRelative(movementSpeed * dt, 0.0f, 0.0f); }
-        if (GetAsyncKeyState(VK_SPACE) & 0x8000) { transform.MoveRelative(0.0f, movementSpeed * dt, 0.0f); }
-        if (GetAsyncKeyState('X') & 0x8000) { transform.MoveRelative(0.0f, -movementSpeed * dt, 0.0f); }
+        if (input.KeyDown('W')) { transform.MoveRelative(0.0f, 0.0f, movementSpeed * dt); }
+        if (input.KeyDown('A')) { transform.MoveRelative(-movementSpeed * dt, 0.0f, 0.0f); }
+        if (input.KeyDown('S')) { transform.MoveRelative(0.0f, 0.0f, -movementSpeed * dt); }
+        if (input.KeyDown('D')) { transform.MoveRelative(movementSpeed * dt, 0.0f, 0.0f); }
+        if (input.KeyDown(VK_SPACE)) { transform.MoveRelative(0.0f, movementSpeed * dt, 0.0f); }
+        if (input.KeyDown('X')) { transform.MoveRelative(0.0f, -movementSpeed * dt, 0.0f); }
     }
 
     // mouse input
-    POINT mousePos = {};
-    GetCursorPos(&mousePos);
-    ScreenToClient(windowHandle, &mousePos);
-    if (GetAsyncKeyState(VK_LBUTTON) & 0x8000) 
+    if (input.KeyDown(VK_LBUTTON)) 
     { 
-        
-        float dx = dt * mLookSpeed * (mousePos.x - mInput.x);
-        float dy = dt * mLookSpeed * (mousePos.y - mInput.y);
+        float dx = dt * mLookSpeed * input.GetMouseDeltaX();
+        float dy = dt * mLookSpeed * input.GetMouseDeltaY();
         transform.Rotate(dy, dx, 0.0f);
     }
 
     UpdateViewMatrix();
-
-    // store the previous mouse input for next frame
-    mInput = mousePos;
 }
@@ -1,7 +1,7 @@
 #pragma once
 #include <DirectXMath.h>
 
-#include "DXCore.h"
+#include "Input.h"
 #include "Transform.h"
 
 class Camera
@@ -13,21 +13,26 @@ public:
     DirectX::XMFLOAT4X4 GetViewMatrix();
     DirectX::XMFLOAT4X4 GetProjectionMatrix();
     Transform* GetTransform();
+    const DirectX::XMFLOAT4* GetFrustumPlanes();
 
     // methods
     void UpdateViewMatrix();
     void UpdateProjectionMatrix(float aspectRatio);
-    void Update(float dt, HWND windowHandle, int controlMode);
+    void Update(float dt, Input& input, int controlMode);
 
 private:
+    void UpdateFrustumPlanes();
+
     DirectX::XMFLOAT4X4 viewMatrix;
     DirectX::XMFLOAT4X4 projMatrix;
     Transform transform;
-    POINT mInput;
     float fieldOfView;
     float nearPlane;
     float farPlane;
     float movementSpeed;
     float mLookSpeed;
+
+    // world space planes (left, right, bottom, top, near, far), normals point inward
+    DirectX::XMFLOAT4 frustumPlanes[6];
 };
 
@@ -0,0 +1,93 @@
+#include "CameraPath.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace DirectX;
+
+CameraPath::CameraPath()
+{
+}
+
+void CameraPath::Clear()
+{
+    keys.clear();
+}
+
+void CameraPath::AddKey(float time, XMFLOAT3 position, XMFLOAT3 pitchYawRoll)
+{
+    Key key = { time, position, pitchYawRoll };
+
+    // keep the keys sorted so Evaluate() can binary search
+    auto it = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& k) { return t < k.time; });
+    keys.insert(it, key);
+}
+
+bool CameraPath::LoadFromFile(std::string fileName)
+{
+    std::ifstream file(fileName);
+    if (!file.is_open())
+        return false;
+
+    Clear();
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream stream(line);
+        float t;
+        XMFLOAT3 p, r;
+        if (stream >> t >> p.x >> p.y >> p.z >> r.x >> r.y >> r.z)
+            AddKey(t, p, r);
+    }
+
+    return !keys.empty();
+}
+
+void CameraPath::Evaluate(float time, XMFLOAT3& position, XMFLOAT3& pitchYawRoll)
+{
+    if (keys.empty())
+        return;
+
+    if (keys.size() == 1 || time <= keys.front().time)
+    {
+        position = keys.front().position;
+        pitchYawRoll = keys.front().pitchYawRoll;
+        return;
+    }
+
+    if (time >= keys.back().time)
+    {
+        position = keys.back().position;
+        pitchYawRoll = keys.back().pitchYawRoll;
+        return;
+    }
+
+    // segment [i, i + 1] containing time, with its outer neighbours clamped
+    size_t i = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& k) { return t < k.time; }) - keys.begin() - 1;
+    const Key& k0 = keys[i > 0 ? i - 1 : i];
+    const Key& k1 = keys[i];
+    const Key& k2 = keys[i + 1];
+    const Key& k3 = keys[std::min(i + 2, keys.size() - 1)];
+
+    float span = k2.time - k1.time;
+    float s = span > 0.0f ? (time - k1.time) / span : 0.0f;
+
+    XMStoreFloat3(&position, XMVectorCatmullRom(
+        XMLoadFloat3(&k0.position), XMLoadFloat3(&k1.position),
+        XMLoadFloat3(&k2.position), XMLoadFloat3(&k3.position), s));
+
+    // angles are splined directly, so paths should avoid wrapping around +-pi
+    XMStoreFloat3(&pitchYawRoll, XMVectorCatmullRom(
+        XMLoadFloat3(&k0.pitchYawRoll), XMLoadFloat3(&k1.pitchYawRoll),
+        XMLoadFloat3(&k2.pitchYawRoll), XMLoadFloat3(&k3.pitchYawRoll), s));
+}
+
+float CameraPath::GetDuration()
+{
+    return keys.empty() ? 0.0f : keys.back().time;
+}
+
+size_t CameraPath::GetKeyCount() { return keys.size(); }
@@ -0,0 +1,36 @@
+#pragma once
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+// Scripted camera fly-through
+// - A list of timed keys (position + pitch/yaw/roll), smoothly
+//   interpolated with a Catmull-Rom spline
+// - Can be built in code or loaded from a text file with one key
+//   per line: "time x y z pitch yaw roll" ('#' starts a comment)
+class CameraPath
+{
+public:
+    CameraPath();
+
+    void Clear();
+    void AddKey(float time, DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 pitchYawRoll);
+    bool LoadFromFile(std::string fileName);
+
+    // samples the path, clamping time to the first/last key
+    void Evaluate(float time, DirectX::XMFLOAT3& position, DirectX::XMFLOAT3& pitchYawRoll);
+
+    // time of the last key
+    float GetDuration();
+    size_t GetKeyCount();
+
+private:
+    struct Key
+    {
+        float time;
+        DirectX::XMFLOAT3 position;
+        DirectX::XMFLOAT3 pitchYawRoll;
+    };
+
+    std::vector<Key> keys;
+};
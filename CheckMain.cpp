@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <cstring>
+#include "Checks.h"
+
+// --------------------------------------------------------
+// Console driver for the checks and benchmarks that need
+// no window or device, so they run on the Linux build farm
+// and in CI as well as on Windows:
+//   DX11Checks -<check> [options]
+// Exits with 0 only if the check passed
+// --------------------------------------------------------
+struct CheckEntry
+{
+    const char* flag;
+    int (*run)(int argc, char** argv);
+    const char* options;
+};
+
+static const CheckEntry checks[] =
+{
+    { "-statecache", RunStateCacheCheck, "" },
+    { "-submitbench", RunSubmitBenchmark, "[-items N] [-frames N]" },
+    { "-tracereplay", RunTraceReplay, "<frame.trace> [-loops N]" },
+    { "-cullbench", RunCullBenchmark, "[-entities N] [-iterations N]" },
+    { "-lightbench", RunLightBenchmark, "[-lights N] [-iterations N]" },
+    { "-occlusioncheck", RunOcclusionCheck, "[-threads N] [-update] [-models dir] [-goldens dir]" },
+    { "-pvscheck", RunPvsCheck, "" },
+    { "-gpucull", RunGpuCullCheck, "" },
+};
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        for (const CheckEntry& check : checks)
+        {
+            if (strcmp(argv[i], check.flag) == 0)
+                return check.run(argc, argv);
+        }
+    }
+
+    printf("usage: DX11Checks <check> [options]\n");
+    for (const CheckEntry& check : checks)
+        printf("  %s %s\n", check.flag, check.options);
+    return 1;
+}
@@ -0,0 +1,77 @@
+#include "CheckReport.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+CheckReport::CheckReport(const char* name)
+{
+    this->name = name;
+    failed = 0;
+}
+
+void CheckReport::Print(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+bool CheckReport::Expect(bool condition, const char* format, ...)
+{
+    if (condition)
+        return true;
+
+    printf("FAILED: ");
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+
+    failed++;
+    return false;
+}
+
+unsigned int CheckReport::GetFailedCount() { return failed; }
+
+int CheckReport::Finish()
+{
+    if (failed == 0)
+        printf("%s: passed\n", name.c_str());
+    else
+        printf("%s: FAILED (%u)\n", name.c_str(), failed);
+    fflush(stdout);
+    return failed == 0 ? 0 : 1;
+}
+
+// --------------------------------------------------------
+// Command line options
+// --------------------------------------------------------
+bool CheckReport::HasOption(int argc, char** argv, const char* option)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], option) == 0)
+            return true;
+    }
+    return false;
+}
+
+int CheckReport::GetIntOption(int argc, char** argv, const char* option, int defaultValue)
+{
+    const char* value = GetStringOption(argc, argv, option, 0);
+    return value ? atoi(value) : defaultValue;
+}
+
+const char* CheckReport::GetStringOption(int argc, char** argv, const char* option, const char* defaultValue)
+{
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], option) == 0)
+            return argv[i + 1];
+    }
+    return defaultValue;
+}
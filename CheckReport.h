@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+
+// What one console check (DX11Checks) found, and the exit code for it
+// - Print() is for what was measured, Expect() for the conditions the
+//   check depends on - every one that doesn't hold is printed and counted
+// - Finish() prints the check's verdict and returns 0 if nothing failed
+// - The option getters read "-name value" pairs off the command line
+class CheckReport
+{
+public:
+    CheckReport(const char* name);
+
+    void Print(const char* format, ...);
+    bool Expect(bool condition, const char* format, ...);
+    unsigned int GetFailedCount();
+    int Finish();
+
+    static bool HasOption(int argc, char** argv, const char* option);
+    static int GetIntOption(int argc, char** argv, const char* option, int defaultValue);
+    static const char* GetStringOption(int argc, char** argv, const char* option, const char* defaultValue);
+
+private:
+    std::string name;
+    unsigned int failed;
+};
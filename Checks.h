@@ -0,0 +1,25 @@
+#pragma once
+
+// The checks and benchmarks DX11Checks runs - each takes the whole
+// command line, reads its own options with CheckReport's getters
+// and returns the process exit code, 0 when everything held
+
+// RenderDeviceCheck.cpp
+int RunStateCacheCheck(int argc, char** argv);
+int RunSubmitBenchmark(int argc, char** argv);
+int RunTraceReplay(int argc, char** argv);
+
+// OcclusionCullerCheck.cpp
+int RunOcclusionCheck(int argc, char** argv);
+
+// LightGridCheck.cpp
+int RunLightBenchmark(int argc, char** argv);
+
+// FrustumCullerCheck.cpp
+int RunCullBenchmark(int argc, char** argv);
+
+// PotentiallyVisibleSetCheck.cpp
+int RunPvsCheck(int argc, char** argv);
+
+// GpuCullerCheck.cpp
+int RunGpuCullCheck(int argc, char** argv);
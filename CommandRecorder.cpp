@@ -0,0 +1,141 @@
+#include "CommandRecorder.h"
+#include "SimpleShader.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+CommandRecorder::CommandRecorder(ID3D11Device* device, unsigned int threadCount)
+{
+    nextThread = 0;
+    lastRecordTime = 0.0f;
+    lastExecuteTime = 0.0f;
+
+    // every worker needs its own SimpleShader slot
+    if (threadCount == 0)
+        threadCount = std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+    threadCount = std::min(threadCount, (unsigned int)SIMPLE_SHADER_CONTEXT_SLOTS - 1);
+
+    D3D11_FEATURE_DATA_THREADING threading = {};
+    device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading));
+    driverCommandLists = threading.DriverCommandLists != 0;
+
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        Worker worker;
+        if (FAILED(device->CreateDeferredContext(0, worker.context.GetAddressOf())))
+            break;
+        worker.device = new D3D11RenderDevice(worker.context.Get());
+        worker.device->EnableConstantRing(device);
+        worker.stateCache = new StateCache(worker.device);
+        workers.push_back(worker);
+    }
+}
+
+CommandRecorder::~CommandRecorder()
+{
+    for (Worker& worker : workers)
+    {
+        delete worker.stateCache;
+        delete worker.device;
+    }
+}
+
+bool CommandRecorder::IsValid() { return !workers.empty(); }
+
+void CommandRecorder::Clear()
+{
+    jobs.clear();
+    jobThreads.clear();
+    nextThread = 0;
+}
+
+void CommandRecorder::Add(RecordJob job, int thread)
+{
+    unsigned int threadCount = std::max(1u, (unsigned int)workers.size());
+    if (thread < 0)
+    {
+        thread = (int)nextThread;
+        nextThread = (nextThread + 1) % threadCount;
+    }
+
+    jobs.push_back(job);
+    jobThreads.push_back((unsigned int)thread % threadCount);
+}
+
+void CommandRecorder::Submit(ID3D11DeviceContext* immediate, StateCache* immediateCache, bool parallel)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (!parallel || workers.empty())
+    {
+        for (RecordJob& job : jobs)
+            job(immediate, immediateCache);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        lastRecordTime = std::chrono::duration<float, std::milli>(end - start).count();
+        lastExecuteTime = 0.0f;
+        return;
+    }
+
+    commandLists.clear();
+    commandLists.resize(jobs.size());
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < workers.size(); t++)
+        threads.push_back(std::thread(&CommandRecorder::RecordThread, this, t));
+
+    RecordThread(0);
+
+    for (auto& t : threads)
+        t.join();
+
+    auto recorded = std::chrono::high_resolution_clock::now();
+    lastRecordTime = std::chrono::duration<float, std::milli>(recorded - start).count();
+
+    // playback in submission order, each list starting from a clean state
+    for (auto& list : commandLists)
+    {
+        if (list)
+            immediate->ExecuteCommandList(list.Get(), FALSE);
+    }
+    commandLists.clear();
+    immediateCache->Invalidate();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    lastExecuteTime = std::chrono::duration<float, std::milli>(end - recorded).count();
+}
+
+void CommandRecorder::RecordThread(unsigned int thread)
+{
+    Worker& worker = workers[thread];
+
+    // route every SimpleShader call on this thread to the worker
+    StateCache* previousCache = ISimpleShader::GetStateCache();
+    ISimpleShader::SetThreadContext(worker.context.Get(), thread + 1);
+    ISimpleShader::SetStateCache(worker.stateCache);
+
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        if (jobThreads[j] != thread)
+            continue;
+
+        worker.device->BeginCommandList();
+        jobs[j](worker.context.Get(), worker.stateCache);
+
+        // finishing resets the deferred context, so the cache starts over too
+        worker.context->FinishCommandList(FALSE, commandLists[j].GetAddressOf());
+        worker.stateCache->Invalidate();
+    }
+
+    ISimpleShader::SetThreadContext(0, 0);
+    ISimpleShader::SetStateCache(previousCache);
+}
+
+unsigned int CommandRecorder::GetThreadCount() { return (unsigned int)workers.size(); }
+unsigned int CommandRecorder::GetJobCount() { return (unsigned int)jobs.size(); }
+ID3D11DeviceContext* CommandRecorder::GetContext(unsigned int thread) { return workers[thread].context.Get(); }
+StateCache* CommandRecorder::GetStateCache(unsigned int thread) { return workers[thread].stateCache; }
+D3D11RenderDevice* CommandRecorder::GetDevice(unsigned int thread) { return workers[thread].device; }
+bool CommandRecorder::HasDriverCommandLists() { return driverCommandLists; }
+float CommandRecorder::GetLastRecordTime() { return lastRecordTime; }
+float CommandRecorder::GetLastExecuteTime() { return lastExecuteTime; }
@@ -0,0 +1,76 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <functional>
+#include <vector>
+#include "StateCache.h"
+#include "D3D11RenderDevice.h"
+
+// One pass (or part of one) to record - gets the context to record
+// into and the state cache in front of it. A deferred context starts
+// with nothing bound, so a job sets up its own targets and states.
+// Draws and clears go through stateCache->GetDevice()
+typedef std::function<void(ID3D11DeviceContext* context, StateCache* stateCache)> RecordJob;
+
+// Records render passes in parallel on deferred contexts, then plays
+// the command lists back in submission order on the immediate context
+// - Each worker thread owns a deferred context, a RenderDevice and
+//   StateCache on top of it, a constant ring and a SimpleShader
+//   local data slot (thread i uses slot i + 1)
+// - Jobs go to the threads round robin unless pinned to one, which is
+//   needed for anything tied to a context at creation (SpriteBatch)
+// - The calling thread records thread 0's jobs itself
+// - Executing a command list resets the immediate context's state, so
+//   its StateCache is invalidated afterwards
+class CommandRecorder
+{
+public:
+    // threadCount 0 picks one based on the hardware
+    CommandRecorder(ID3D11Device* device, unsigned int threadCount = 0);
+    ~CommandRecorder();
+
+    // false if the deferred contexts couldn't be created
+    bool IsValid();
+
+    // jobs are executed in the order they're added
+    void Clear();
+    void Add(RecordJob job, int thread = -1);
+
+    // parallel - record on the workers and execute the command lists
+    // otherwise - just run the jobs in order on the immediate context
+    void Submit(ID3D11DeviceContext* immediate, StateCache* immediateCache, bool parallel);
+
+    unsigned int GetThreadCount();
+    unsigned int GetJobCount();
+    ID3D11DeviceContext* GetContext(unsigned int thread);
+    StateCache* GetStateCache(unsigned int thread);
+    D3D11RenderDevice* GetDevice(unsigned int thread);
+
+    // true if the driver builds command lists itself, rather than
+    // the runtime emulating them
+    bool HasDriverCommandLists();
+
+    // ms spent recording, and playing back, in the last Submit()
+    float GetLastRecordTime();
+    float GetLastExecuteTime();
+
+private:
+    void RecordThread(unsigned int thread);
+
+    struct Worker
+    {
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+        D3D11RenderDevice* device;
+        StateCache* stateCache;
+    };
+    std::vector<Worker> workers;
+
+    std::vector<RecordJob> jobs;
+    std::vector<unsigned int> jobThreads;
+    std::vector<Microsoft::WRL::ComPtr<ID3D11CommandList>> commandLists;
+    unsigned int nextThread;
+
+    bool driverCommandLists;
+    float lastRecordTime;
+    float lastExecuteTime;
+};
@@ -0,0 +1,85 @@
+#include "ConstantBufferRing.h"
+#include <cstring>
+
+ConstantBufferRing::ConstantBufferRing(ID3D11Device* device, unsigned int size)
+{
+    this->size = size / CONSTANT_RING_ALIGNMENT * CONSTANT_RING_ALIGNMENT;
+    offset = 0;
+    discardNext = true;
+    generation = 0;
+    ResetStats();
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = this->size;
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+}
+
+bool ConstantBufferRing::IsSupported(ID3D11Device* device)
+{
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+        return false;
+    return options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+}
+
+bool ConstantBufferRing::IsValid() { return buffer != 0; }
+
+bool ConstantBufferRing::Allocate(ID3D11DeviceContext* context, const void* data, unsigned int dataSize, ConstantAllocation& allocation)
+{
+    unsigned int allocationSize = (dataSize + CONSTANT_RING_ALIGNMENT - 1) / CONSTANT_RING_ALIGNMENT * CONSTANT_RING_ALIGNMENT;
+    if (allocationSize > size || allocationSize / 16 > D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT)
+        return false;
+
+    // wrap around - the GPU may still be reading the old contents,
+    // so the driver hands out fresh memory for the discard
+    if (offset + allocationSize > size)
+    {
+        discardNext = true;
+        generation++;
+    }
+    if (discardNext)
+        offset = 0;
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    D3D11_MAP mapType = discardNext ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    if (FAILED(context->Map(buffer.Get(), 0, mapType, 0, &mapped)))
+        return false;
+    memcpy((unsigned char*)mapped.pData + offset, data, dataSize);
+    context->Unmap(buffer.Get(), 0);
+
+    if (discardNext)
+        discardCount++;
+    discardNext = false;
+
+    allocation.buffer = buffer.Get();
+    allocation.firstConstant = offset / 16;
+    allocation.numConstants = allocationSize / 16;
+    allocation.generation = generation;
+
+    offset += allocationSize;
+    bytesWritten += dataSize;
+    allocationCount++;
+    return true;
+}
+
+void ConstantBufferRing::BeginList()
+{
+    discardNext = true;
+    generation++;
+}
+
+unsigned int ConstantBufferRing::GetGeneration() { return generation; }
+
+unsigned int ConstantBufferRing::GetBytesWritten() { return bytesWritten; }
+unsigned int ConstantBufferRing::GetAllocationCount() { return allocationCount; }
+unsigned int ConstantBufferRing::GetDiscardCount() { return discardCount; }
+
+void ConstantBufferRing::ResetStats()
+{
+    bytesWritten = 0;
+    allocationCount = 0;
+    discardCount = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include "RenderDevice.h"
+
+// default ring size - a frame's worth of per draw constants many times over
+#define CONSTANT_RING_DEFAULT_SIZE      (4 * 1024 * 1024)
+
+// constant offsets are in 16 byte constants and must be a multiple
+// of 16 of them, so every allocation starts on a 256 byte boundary
+#define CONSTANT_RING_ALIGNMENT         256
+
+// Linear allocator over one big dynamic constant buffer
+// - Constants are written with NO_OVERWRITE behind the last allocation;
+//   when the ring is full it's mapped with DISCARD and starts over
+// - Allocations are bound as a range of the buffer (*SetConstantBuffers1),
+//   which needs a D3D11.1 runtime and driver support - see IsSupported()
+// - A deferred context can only NO_OVERWRITE a buffer it has already
+//   DISCARDed in the same command list, so BeginList() must be called
+//   at the start of every one
+class ConstantBufferRing
+{
+public:
+    ConstantBufferRing(ID3D11Device* device, unsigned int size = CONSTANT_RING_DEFAULT_SIZE);
+
+    // true if the device can bind constant buffer ranges and map
+    // dynamic constant buffers with NO_OVERWRITE
+    static bool IsSupported(ID3D11Device* device);
+
+    bool IsValid();
+
+    // copies the constants into the ring - false if the map failed
+    bool Allocate(ID3D11DeviceContext* context, const void* data, unsigned int size, ConstantAllocation& allocation);
+
+    // the next allocation discards the whole ring
+    void BeginList();
+
+    // changes whenever earlier allocations stop being valid - on a
+    // wrap around and at the start of every command list
+    unsigned int GetGeneration();
+
+    // since the last ResetStats()
+    unsigned int GetBytesWritten();
+    unsigned int GetAllocationCount();
+    unsigned int GetDiscardCount();
+    void ResetStats();
+
+private:
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+    unsigned int size;
+    unsigned int offset;
+    bool discardNext;
+    unsigned int generation;
+
+    unsigned int bytesWritten;
+    unsigned int allocationCount;
+    unsigned int discardCount;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+// Small helpers for picking SIMD code paths at runtime
+// - The project is built for plain SSE2 so it runs everywhere,
+//   wider paths are compiled alongside and chosen once at startup
+// - MSVC lets any function use AVX intrinsics, gcc/clang need the
+//   function tagged with the target it was written for
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define SIMD_TARGET_AVX
+#define SIMD_TARGET_AVX2
+#else
+#include <immintrin.h>
+#define SIMD_TARGET_AVX __attribute__((target("avx")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace CpuFeatures
+{
+    // checks the cpuid feature bits plus the OS support (XSAVE'd ymm state)
+    inline bool DetectAVX(bool requireAVX2)
+    {
+#if defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx)
+            return false;
+
+        // ymm registers must be saved by the OS
+        if ((_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        if (!requireAVX2)
+            return true;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return requireAVX2 ? __builtin_cpu_supports("avx2") != 0 : __builtin_cpu_supports("avx") != 0;
+#endif
+    }
+
+    inline bool HasAVX()
+    {
+        static const bool supported = DetectAVX(false);
+        return supported;
+    }
+
+    inline bool HasAVX2()
+    {
+        static const bool supported = DetectAVX(true);
+        return supported;
+    }
+}
@@ -0,0 +1,232 @@
+#include "D3D11RenderDevice.h"
+#include <cstring>
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11DeviceContext* context)
+{
+    this->context = context;
+    constantRing = 0;
+}
+
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+    delete constantRing;
+}
+
+ID3D11DeviceContext* D3D11RenderDevice::GetContext() { return context; }
+void* D3D11RenderDevice::GetNativeContext() { return context; }
+
+bool D3D11RenderDevice::EnableConstantRing(ID3D11Device* device, unsigned int size)
+{
+    if (constantRing)
+        return true;
+
+    // ranges are bound through the 11.1 context
+    if (!ConstantBufferRing::IsSupported(device) || FAILED(context->QueryInterface(context1.GetAddressOf())))
+        return false;
+
+    constantRing = new ConstantBufferRing(device, size);
+    if (!constantRing->IsValid())
+    {
+        delete constantRing;
+        constantRing = 0;
+        return false;
+    }
+    return true;
+}
+
+ConstantBufferRing* D3D11RenderDevice::GetConstantRing() { return constantRing; }
+
+void D3D11RenderDevice::BeginCommandList()
+{
+    if (constantRing)
+        constantRing->BeginList();
+}
+
+void D3D11RenderDevice::SetShader(int stage, ID3D11DeviceChild* shader)
+{
+    switch (stage)
+    {
+    case SHADER_STAGE_VERTEX: context->VSSetShader((ID3D11VertexShader*)shader, 0, 0); break;
+    case SHADER_STAGE_PIXEL: context->PSSetShader((ID3D11PixelShader*)shader, 0, 0); break;
+    case SHADER_STAGE_GEOMETRY: context->GSSetShader((ID3D11GeometryShader*)shader, 0, 0); break;
+    case SHADER_STAGE_HULL: context->HSSetShader((ID3D11HullShader*)shader, 0, 0); break;
+    case SHADER_STAGE_DOMAIN: context->DSSetShader((ID3D11DomainShader*)shader, 0, 0); break;
+    case SHADER_STAGE_COMPUTE: context->CSSetShader((ID3D11ComputeShader*)shader, 0, 0); break;
+    }
+}
+
+void D3D11RenderDevice::SetConstantBuffer(int stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+    switch (stage)
+    {
+    case SHADER_STAGE_VERTEX: context->VSSetConstantBuffers(slot, 1, &buffer); break;
+    case SHADER_STAGE_PIXEL: context->PSSetConstantBuffers(slot, 1, &buffer); break;
+    case SHADER_STAGE_GEOMETRY: context->GSSetConstantBuffers(slot, 1, &buffer); break;
+    case SHADER_STAGE_HULL: context->HSSetConstantBuffers(slot, 1, &buffer); break;
+    case SHADER_STAGE_DOMAIN: context->DSSetConstantBuffers(slot, 1, &buffer); break;
+    case SHADER_STAGE_COMPUTE: context->CSSetConstantBuffers(slot, 1, &buffer); break;
+    }
+}
+
+void D3D11RenderDevice::SetShaderResources(int stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs)
+{
+    switch (stage)
+    {
+    case SHADER_STAGE_VERTEX: context->VSSetShaderResources(startSlot, count, srvs); break;
+    case SHADER_STAGE_PIXEL: context->PSSetShaderResources(startSlot, count, srvs); break;
+    case SHADER_STAGE_GEOMETRY: context->GSSetShaderResources(startSlot, count, srvs); break;
+    case SHADER_STAGE_HULL: context->HSSetShaderResources(startSlot, count, srvs); break;
+    case SHADER_STAGE_DOMAIN: context->DSSetShaderResources(startSlot, count, srvs); break;
+    case SHADER_STAGE_COMPUTE: context->CSSetShaderResources(startSlot, count, srvs); break;
+    }
+}
+
+void D3D11RenderDevice::SetSampler(int stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+    switch (stage)
+    {
+    case SHADER_STAGE_VERTEX: context->VSSetSamplers(slot, 1, &sampler); break;
+    case SHADER_STAGE_PIXEL: context->PSSetSamplers(slot, 1, &sampler); break;
+    case SHADER_STAGE_GEOMETRY: context->GSSetSamplers(slot, 1, &sampler); break;
+    case SHADER_STAGE_HULL: context->HSSetSamplers(slot, 1, &sampler); break;
+    case SHADER_STAGE_DOMAIN: context->DSSetSamplers(slot, 1, &sampler); break;
+    case SHADER_STAGE_COMPUTE: context->CSSetSamplers(slot, 1, &sampler); break;
+    }
+}
+
+// the whole buffer is replaced, so the size is only for recording
+void D3D11RenderDevice::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int)
+{
+    context->UpdateSubresource(buffer, 0, 0, data, 0, 0);
+}
+
+void D3D11RenderDevice::UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int offset, unsigned int size)
+{
+    D3D11_BOX box = { offset, 0, 0, offset + size, 1, 1 };
+    context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+}
+
+bool D3D11RenderDevice::WriteDynamicBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    if (FAILED(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+        return false;
+    memcpy(mapped.pData, data, size);
+    context->Unmap(buffer, 0);
+    return true;
+}
+
+bool D3D11RenderDevice::AllocateConstants(const void* data, unsigned int size, ConstantAllocation& allocation)
+{
+    return constantRing && constantRing->Allocate(context, data, size, allocation);
+}
+
+void D3D11RenderDevice::SetConstantBufferRange(int stage, unsigned int slot, const ConstantAllocation& allocation)
+{
+    ID3D11DeviceContext1* context1 = this->context1.Get();
+    ID3D11Buffer* buffer = allocation.buffer;
+    if (!context1)
+    {
+        SetConstantBuffer(stage, slot, buffer);
+        return;
+    }
+
+    const UINT* first = &allocation.firstConstant;
+    const UINT* count = &allocation.numConstants;
+    switch (stage)
+    {
+    case SHADER_STAGE_VERTEX: context1->VSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+    case SHADER_STAGE_PIXEL: context1->PSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+    case SHADER_STAGE_GEOMETRY: context1->GSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+    case SHADER_STAGE_HULL: context1->HSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+    case SHADER_STAGE_DOMAIN: context1->DSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+    case SHADER_STAGE_COMPUTE: context1->CSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+    }
+}
+
+unsigned int D3D11RenderDevice::GetConstantGeneration()
+{
+    return constantRing ? constantRing->GetGeneration() : 0;
+}
+
+void D3D11RenderDevice::SetInputLayout(ID3D11InputLayout* layout)
+{
+    context->IASetInputLayout(layout);
+}
+
+void D3D11RenderDevice::SetPrimitiveTopology(unsigned int topology)
+{
+    context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11RenderDevice::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+    context->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+}
+
+void D3D11RenderDevice::SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset)
+{
+    context->IASetIndexBuffer(buffer, (DXGI_FORMAT)format, offset);
+}
+
+void D3D11RenderDevice::SetRasterizerState(ID3D11RasterizerState* state)
+{
+    context->RSSetState(state);
+}
+
+void D3D11RenderDevice::SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+    context->OMSetDepthStencilState(state, stencilRef);
+}
+
+void D3D11RenderDevice::SetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask)
+{
+    context->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void D3D11RenderDevice::SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+    context->OMSetRenderTargets(count, rtvs, dsv);
+}
+
+void D3D11RenderDevice::SetViewport(float x, float y, float width, float height, float minDepth, float maxDepth)
+{
+    D3D11_VIEWPORT vp = {};
+    vp.TopLeftX = x;
+    vp.TopLeftY = y;
+    vp.Width = width;
+    vp.Height = height;
+    vp.MinDepth = minDepth;
+    vp.MaxDepth = maxDepth;
+    context->RSSetViewports(1, &vp);
+}
+
+void D3D11RenderDevice::ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4])
+{
+    context->ClearRenderTargetView(rtv, color);
+}
+
+void D3D11RenderDevice::ClearDepthStencil(ID3D11DepthStencilView* dsv, unsigned int flags, float depth, unsigned char stencil)
+{
+    context->ClearDepthStencilView(dsv, flags, depth, stencil);
+}
+
+void D3D11RenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+    context->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderDevice::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+    context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderDevice::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+    context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D11RenderDevice::DrawIndexedInstancedIndirect(ID3D11Buffer* args, unsigned int byteOffset)
+{
+    context->DrawIndexedInstancedIndirect(args, byteOffset);
+}
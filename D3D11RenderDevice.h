@@ -0,0 +1,64 @@
+#pragma once
+#include <d3d11.h>
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include "RenderDevice.h"
+#include "ConstantBufferRing.h"
+
+// RenderDevice on top of a D3D11 context, immediate or deferred -
+// every call goes straight through
+// - The constant ring is optional, and only enabled when the device
+//   supports binding constant buffer ranges (D3D11.1)
+class D3D11RenderDevice : public RenderDevice
+{
+public:
+    D3D11RenderDevice(ID3D11DeviceContext* context);
+    ~D3D11RenderDevice();
+
+    ID3D11DeviceContext* GetContext();
+    void* GetNativeContext();
+
+    // returns false (and keeps using UpdateBuffer) if it isn't supported
+    bool EnableConstantRing(ID3D11Device* device, unsigned int size = CONSTANT_RING_DEFAULT_SIZE);
+    ConstantBufferRing* GetConstantRing();
+
+    // call at the start of every deferred command list
+    void BeginCommandList();
+
+    void SetShader(int stage, ID3D11DeviceChild* shader);
+    void SetConstantBuffer(int stage, unsigned int slot, ID3D11Buffer* buffer);
+    void SetShaderResources(int stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs);
+    void SetSampler(int stage, unsigned int slot, ID3D11SamplerState* sampler);
+
+    void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+    void UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int offset, unsigned int size);
+    bool WriteDynamicBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+
+    bool AllocateConstants(const void* data, unsigned int size, ConstantAllocation& allocation);
+    void SetConstantBufferRange(int stage, unsigned int slot, const ConstantAllocation& allocation);
+    unsigned int GetConstantGeneration();
+
+    void SetInputLayout(ID3D11InputLayout* layout);
+    void SetPrimitiveTopology(unsigned int topology);
+    void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+    void SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset);
+
+    void SetRasterizerState(ID3D11RasterizerState* state);
+    void SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+    void SetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask);
+
+    void SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv);
+    void SetViewport(float x, float y, float width, float height, float minDepth, float maxDepth);
+    void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]);
+    void ClearDepthStencil(ID3D11DepthStencilView* dsv, unsigned int flags, float depth, unsigned char stencil);
+
+    void Draw(unsigned int vertexCount, unsigned int startVertex);
+    void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+    void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+    void DrawIndexedInstancedIndirect(ID3D11Buffer* args, unsigned int byteOffset);
+
+private:
+    ID3D11DeviceContext* context;
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+    ConstantBufferRing* constantRing;
+};
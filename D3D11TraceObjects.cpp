@@ -0,0 +1,144 @@
+#include "D3D11TraceObjects.h"
+
+D3D11TraceObjects::D3D11TraceObjects()
+{
+    device = 0;
+    context = 0;
+    trace = 0;
+}
+
+D3D11TraceObjects::~D3D11TraceObjects()
+{
+    for (SimpleVertexShader* shader : vertexShaders)
+        delete shader;
+}
+
+const std::vector<void*>& D3D11TraceObjects::GetHandles() { return handles; }
+
+unsigned int D3D11TraceObjects::Create(ID3D11Device* device, ID3D11DeviceContext* context, FrameTrace* trace)
+{
+    this->device = device;
+    this->context = context;
+    this->trace = trace;
+
+    unsigned int count = trace->GetObjectCount();
+    objects.assign(count + 1, 0);
+    handles.assign(count + 1, 0);
+    vertexShaders.assign(count + 1, 0);
+
+    // an object's parent always comes before it, so one pass in order does it
+    unsigned int failed = 0;
+    for (unsigned int id = 1; id <= count; id++)
+    {
+        handles[id] = CreateObject(id);
+        if (!handles[id])
+            failed++;
+    }
+    return failed;
+}
+
+void* D3D11TraceObjects::CreateObject(unsigned int id)
+{
+    const TraceObject& object = trace->GetTraceObject(id);
+    const void* desc = object.desc.empty() ? 0 : object.desc.data();
+    const std::vector<unsigned char>* payload = object.payload ? trace->GetBlob(object.payload) : 0;
+    ID3D11Resource* parent = object.parent ? (ID3D11Resource*)handles[object.parent] : 0;
+
+    Microsoft::WRL::ComPtr<ID3D11DeviceChild>& created = objects[id];
+    switch (object.kind)
+    {
+    case TRACE_OBJECT_VERTEX_SHADER:
+    {
+        // SimpleVertexShader builds the input layout alongside the shader
+        if (!payload)
+            return 0;
+        vertexShaders[id] = new SimpleVertexShader(device, context, payload->data(), payload->size());
+        return vertexShaders[id]->GetDirectXShader();
+    }
+
+    case TRACE_OBJECT_PIXEL_SHADER:
+    {
+        if (!payload)
+            return 0;
+        device->CreatePixelShader(payload->data(), payload->size(), 0, (ID3D11PixelShader**)created.GetAddressOf());
+        return created.Get();
+    }
+
+    case TRACE_OBJECT_INPUT_LAYOUT:
+        return object.parent && vertexShaders[object.parent] ? vertexShaders[object.parent]->GetInputLayout() : 0;
+
+    case TRACE_OBJECT_BUFFER:
+    {
+        if (object.desc.size() != sizeof(D3D11_BUFFER_DESC))
+            return 0;
+        D3D11_BUFFER_DESC bufferDesc = *(const D3D11_BUFFER_DESC*)desc;
+
+        D3D11_SUBRESOURCE_DATA initial = {};
+        bool hasContents = payload && payload->size() == bufferDesc.ByteWidth;
+        initial.pSysMem = hasContents ? payload->data() : 0;
+        if (!hasContents && bufferDesc.Usage == D3D11_USAGE_IMMUTABLE)
+            bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+
+        device->CreateBuffer(&bufferDesc, hasContents ? &initial : 0, (ID3D11Buffer**)created.GetAddressOf());
+        return created.Get();
+    }
+
+    case TRACE_OBJECT_TEXTURE2D:
+    {
+        if (object.desc.size() != sizeof(D3D11_TEXTURE2D_DESC))
+            return 0;
+
+        // contents weren't captured, so it can't stay immutable
+        D3D11_TEXTURE2D_DESC textureDesc = *(const D3D11_TEXTURE2D_DESC*)desc;
+        if (textureDesc.Usage == D3D11_USAGE_IMMUTABLE)
+            textureDesc.Usage = D3D11_USAGE_DEFAULT;
+
+        device->CreateTexture2D(&textureDesc, 0, (ID3D11Texture2D**)created.GetAddressOf());
+        return created.Get();
+    }
+
+    case TRACE_OBJECT_SRV:
+        if (!parent || object.desc.size() != sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC))
+            return 0;
+        device->CreateShaderResourceView(parent, (const D3D11_SHADER_RESOURCE_VIEW_DESC*)desc, (ID3D11ShaderResourceView**)created.GetAddressOf());
+        return created.Get();
+
+    case TRACE_OBJECT_RTV:
+        if (!parent || object.desc.size() != sizeof(D3D11_RENDER_TARGET_VIEW_DESC))
+            return 0;
+        device->CreateRenderTargetView(parent, (const D3D11_RENDER_TARGET_VIEW_DESC*)desc, (ID3D11RenderTargetView**)created.GetAddressOf());
+        return created.Get();
+
+    case TRACE_OBJECT_DSV:
+        if (!parent || object.desc.size() != sizeof(D3D11_DEPTH_STENCIL_VIEW_DESC))
+            return 0;
+        device->CreateDepthStencilView(parent, (const D3D11_DEPTH_STENCIL_VIEW_DESC*)desc, (ID3D11DepthStencilView**)created.GetAddressOf());
+        return created.Get();
+
+    case TRACE_OBJECT_SAMPLER:
+        if (object.desc.size() != sizeof(D3D11_SAMPLER_DESC))
+            return 0;
+        device->CreateSamplerState((const D3D11_SAMPLER_DESC*)desc, (ID3D11SamplerState**)created.GetAddressOf());
+        return created.Get();
+
+    case TRACE_OBJECT_RASTERIZER_STATE:
+        if (object.desc.size() != sizeof(D3D11_RASTERIZER_DESC))
+            return 0;
+        device->CreateRasterizerState((const D3D11_RASTERIZER_DESC*)desc, (ID3D11RasterizerState**)created.GetAddressOf());
+        return created.Get();
+
+    case TRACE_OBJECT_DEPTH_STENCIL_STATE:
+        if (object.desc.size() != sizeof(D3D11_DEPTH_STENCIL_DESC))
+            return 0;
+        device->CreateDepthStencilState((const D3D11_DEPTH_STENCIL_DESC*)desc, (ID3D11DepthStencilState**)created.GetAddressOf());
+        return created.Get();
+
+    case TRACE_OBJECT_BLEND_STATE:
+        if (object.desc.size() != sizeof(D3D11_BLEND_DESC))
+            return 0;
+        device->CreateBlendState((const D3D11_BLEND_DESC*)desc, (ID3D11BlendState**)created.GetAddressOf());
+        return created.Get();
+    }
+
+    return 0;
+}
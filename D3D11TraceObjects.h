@@ -0,0 +1,35 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include "FrameTrace.h"
+#include "SimpleShader.h"
+
+// Recreates a trace's objects on a D3D11 device, for TraceReplay
+// - Buffers get their captured contents when there are any
+// - Textures are created blank, from their captured desc
+// - Input layouts are rebuilt from their vertex shader's bytecode,
+//   the same way SimpleVertexShader builds them
+// - Objects that can't be recreated (unregistered shaders) stay null
+class D3D11TraceObjects
+{
+public:
+    D3D11TraceObjects();
+    ~D3D11TraceObjects();
+
+    // returns the number of objects that couldn't be created
+    unsigned int Create(ID3D11Device* device, ID3D11DeviceContext* context, FrameTrace* trace);
+
+    // handles[id], handles[0] being null
+    const std::vector<void*>& GetHandles();
+
+private:
+    void* CreateObject(unsigned int id);
+
+    ID3D11Device* device;
+    ID3D11DeviceContext* context;
+    FrameTrace* trace;
+    std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceChild>> objects;
+    std::vector<void*> handles;
+    std::vector<SimpleVertexShader*> vertexShaders;
+};
@@ -0,0 +1,48 @@
+#include "DynamicBuffer.h"
+
+DynamicBuffer::DynamicBuffer(UINT bindFlags, unsigned int elementSize)
+{
+    this->bindFlags = bindFlags;
+    this->elementSize = elementSize;
+    capacity = 0;
+}
+
+bool DynamicBuffer::Reserve(ID3D11Device* device, unsigned int count, bool* recreated)
+{
+    if (recreated)
+        *recreated = false;
+    if (count <= capacity && buffer)
+        return true;
+
+    unsigned int newCapacity = 64;
+    while (newCapacity < count)
+        newCapacity *= 2;
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = newCapacity * elementSize;
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = bindFlags;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    buffer.Reset();
+    capacity = 0;
+    if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())))
+        return false;
+
+    capacity = newCapacity;
+    if (recreated)
+        *recreated = true;
+    return true;
+}
+
+bool DynamicBuffer::Write(RenderDevice* renderDevice, const void* elements, unsigned int count)
+{
+    if (count == 0)
+        return true;
+
+    // the whole buffer is rewritten every frame, so the old contents can go
+    return renderDevice->WriteDynamicBuffer(buffer.Get(), elements, count * elementSize);
+}
+
+ID3D11Buffer* DynamicBuffer::GetBuffer() { return buffer.Get(); }
+unsigned int DynamicBuffer::GetCapacity() { return capacity; }
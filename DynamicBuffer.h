@@ -0,0 +1,32 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include "RenderDevice.h"
+
+// Dynamic buffer that holds one frame's worth of elements and is
+// rewritten whole every frame with a single Map/DISCARD
+// - Grows (to the next power of two, from 64 elements) when a frame
+//   needs more room, so it settles at the scene's high water mark
+// - InstanceBuffer and TypedBuffer keep their data in one of these
+class DynamicBuffer
+{
+public:
+    DynamicBuffer(UINT bindFlags, unsigned int elementSize);
+
+    // makes sure the buffer exists and has room for count elements -
+    // recreated is set when it had to be (re)made, so views onto it can
+    // be too. returns false if it couldn't be created
+    bool Reserve(ID3D11Device* device, unsigned int count, bool* recreated = 0);
+
+    // replaces the contents with count elements - Reserve() them first
+    bool Write(RenderDevice* renderDevice, const void* elements, unsigned int count);
+
+    ID3D11Buffer* GetBuffer();
+    unsigned int GetCapacity();
+
+private:
+    UINT bindFlags;
+    unsigned int elementSize;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+    unsigned int capacity;
+};
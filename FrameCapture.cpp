@@ -0,0 +1,276 @@
+#include "FrameCapture.h"
+#include <wrl/client.h>
+
+using namespace Microsoft::WRL;
+
+FrameCapture::FrameCapture(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+    this->device = device;
+    this->context = context;
+}
+
+void FrameCapture::RegisterShader(SimpleVertexShader* shader)
+{
+    shaders[shader->GetDirectXShader()] = { TRACE_OBJECT_VERTEX_SHADER, shader->GetShaderBlob() };
+    if (shader->GetInputLayout())
+        layoutShaders[shader->GetInputLayout()] = shader->GetDirectXShader();
+}
+
+void FrameCapture::RegisterShader(SimplePixelShader* shader)
+{
+    shaders[shader->GetDirectXShader()] = { TRACE_OBJECT_PIXEL_SHADER, shader->GetShaderBlob() };
+}
+
+void FrameCapture::Begin()
+{
+    trace.Clear();
+    objectIds.clear();
+}
+
+bool FrameCapture::Save(std::string path) { return trace.Save(path); }
+FrameTrace& FrameCapture::GetTrace() { return trace; }
+
+void FrameCapture::AddFrame(RecordingRenderDevice* recorder)
+{
+    const std::vector<RenderCommand>& commands = recorder->GetCommands();
+    const std::vector<unsigned char>& data = recorder->GetData();
+
+    TraceFrame& frame = trace.AddFrame();
+    frame.commands.reserve(commands.size());
+
+    std::vector<unsigned int> ids;
+    for (const RenderCommand& command : commands)
+    {
+        TraceCommand traced = {};
+        traced.type = (unsigned short)command.type;
+        for (int i = 0; i < 5; i++)
+            traced.args[i] = command.args[i];
+
+        int kind = GetCommandObjectKind(command);
+        if (kind >= 0)
+            traced.object = GetObjectId((unsigned int)kind, command.object);
+
+        const unsigned char* bytes = command.dataSize > 0 ? &data[command.dataOffset] : 0;
+
+        // handle lists are stored as ids
+        if (bytes && (command.type == RENDER_CMD_SET_SHADER_RESOURCES || command.type == RENDER_CMD_SET_RENDER_TARGETS))
+        {
+            unsigned int listKind = command.type == RENDER_CMD_SET_SHADER_RESOURCES ? TRACE_OBJECT_SRV : TRACE_OBJECT_RTV;
+            const void* const* handles = (const void* const*)bytes;
+            unsigned int count = command.dataSize / sizeof(void*);
+
+            ids.resize(count);
+            for (unsigned int i = 0; i < count; i++)
+                ids[i] = GetObjectId(listKind, handles[i]);
+            trace.AddCommandData(frame, traced, ids.data(), count * sizeof(unsigned int));
+        }
+        else
+        {
+            trace.AddCommandData(frame, traced, bytes, command.dataSize);
+        }
+
+        frame.commands.push_back(traced);
+    }
+}
+
+int FrameCapture::GetCommandObjectKind(const RenderCommand& command)
+{
+    switch (command.type)
+    {
+    case RENDER_CMD_SET_SHADER:
+        if (command.args[0] == SHADER_STAGE_VERTEX) return TRACE_OBJECT_VERTEX_SHADER;
+        if (command.args[0] == SHADER_STAGE_PIXEL) return TRACE_OBJECT_PIXEL_SHADER;
+        return TRACE_OBJECT_OTHER_SHADER;
+    case RENDER_CMD_SET_CONSTANT_BUFFER:
+    case RENDER_CMD_UPDATE_BUFFER:
+    case RENDER_CMD_UPDATE_BUFFER_RANGE:
+    case RENDER_CMD_WRITE_DYNAMIC_BUFFER:
+    case RENDER_CMD_SET_VERTEX_BUFFER:
+    case RENDER_CMD_SET_INDEX_BUFFER:
+    case RENDER_CMD_ALLOCATE_CONSTANTS:
+    case RENDER_CMD_SET_CONSTANT_BUFFER_RANGE:
+    case RENDER_CMD_DRAW_INDEXED_INSTANCED_INDIRECT:
+        return TRACE_OBJECT_BUFFER;
+    case RENDER_CMD_SET_SAMPLER: return TRACE_OBJECT_SAMPLER;
+    case RENDER_CMD_SET_INPUT_LAYOUT: return TRACE_OBJECT_INPUT_LAYOUT;
+    case RENDER_CMD_SET_RASTERIZER_STATE: return TRACE_OBJECT_RASTERIZER_STATE;
+    case RENDER_CMD_SET_DEPTH_STENCIL_STATE: return TRACE_OBJECT_DEPTH_STENCIL_STATE;
+    case RENDER_CMD_SET_BLEND_STATE: return TRACE_OBJECT_BLEND_STATE;
+    case RENDER_CMD_SET_RENDER_TARGETS: return TRACE_OBJECT_DSV;
+    case RENDER_CMD_CLEAR_RENDER_TARGET: return TRACE_OBJECT_RTV;
+    case RENDER_CMD_CLEAR_DEPTH_STENCIL: return TRACE_OBJECT_DSV;
+    }
+    return -1;
+}
+
+unsigned int FrameCapture::GetObjectId(unsigned int kind, const void* handle)
+{
+    if (!handle)
+        return 0;
+
+    auto found = objectIds.find(handle);
+    if (found != objectIds.end())
+        return found->second;
+
+    unsigned int id = DescribeObject(kind, handle);
+    objectIds[handle] = id;
+    return id;
+}
+
+// --------------------------------------------------------
+// Adds an object to the trace along with whatever it
+// takes to recreate it
+// --------------------------------------------------------
+unsigned int FrameCapture::DescribeObject(unsigned int kind, const void* handle)
+{
+    switch (kind)
+    {
+    case TRACE_OBJECT_VERTEX_SHADER:
+    case TRACE_OBJECT_PIXEL_SHADER:
+    case TRACE_OBJECT_OTHER_SHADER:
+    {
+        auto shader = shaders.find(handle);
+        uint64_t bytecode = 0;
+        if (shader != shaders.end() && shader->second.bytecode)
+            bytecode = trace.AddBlob(shader->second.bytecode->GetBufferPointer(), (unsigned int)shader->second.bytecode->GetBufferSize());
+        return trace.AddObject(kind, 0, 0, 0, bytecode);
+    }
+
+    case TRACE_OBJECT_BUFFER:
+        return DescribeBuffer((ID3D11Buffer*)handle);
+
+    case TRACE_OBJECT_SRV:
+    {
+        ID3D11ShaderResourceView* srv = (ID3D11ShaderResourceView*)handle;
+        ComPtr<ID3D11Resource> resource;
+        D3D11_SHADER_RESOURCE_VIEW_DESC desc = {};
+        srv->GetDesc(&desc);
+        srv->GetResource(resource.GetAddressOf());
+        return trace.AddObject(kind, DescribeResource(resource.Get()), &desc, sizeof(desc), 0);
+    }
+
+    case TRACE_OBJECT_RTV:
+    {
+        ID3D11RenderTargetView* rtv = (ID3D11RenderTargetView*)handle;
+        ComPtr<ID3D11Resource> resource;
+        D3D11_RENDER_TARGET_VIEW_DESC desc = {};
+        rtv->GetDesc(&desc);
+        rtv->GetResource(resource.GetAddressOf());
+        return trace.AddObject(kind, DescribeResource(resource.Get()), &desc, sizeof(desc), 0);
+    }
+
+    case TRACE_OBJECT_DSV:
+    {
+        ID3D11DepthStencilView* dsv = (ID3D11DepthStencilView*)handle;
+        ComPtr<ID3D11Resource> resource;
+        D3D11_DEPTH_STENCIL_VIEW_DESC desc = {};
+        dsv->GetDesc(&desc);
+        dsv->GetResource(resource.GetAddressOf());
+        return trace.AddObject(kind, DescribeResource(resource.Get()), &desc, sizeof(desc), 0);
+    }
+
+    case TRACE_OBJECT_SAMPLER:
+    {
+        D3D11_SAMPLER_DESC desc = {};
+        ((ID3D11SamplerState*)handle)->GetDesc(&desc);
+        return trace.AddObject(kind, 0, &desc, sizeof(desc), 0);
+    }
+
+    case TRACE_OBJECT_RASTERIZER_STATE:
+    {
+        D3D11_RASTERIZER_DESC desc = {};
+        ((ID3D11RasterizerState*)handle)->GetDesc(&desc);
+        return trace.AddObject(kind, 0, &desc, sizeof(desc), 0);
+    }
+
+    case TRACE_OBJECT_DEPTH_STENCIL_STATE:
+    {
+        D3D11_DEPTH_STENCIL_DESC desc = {};
+        ((ID3D11DepthStencilState*)handle)->GetDesc(&desc);
+        return trace.AddObject(kind, 0, &desc, sizeof(desc), 0);
+    }
+
+    case TRACE_OBJECT_BLEND_STATE:
+    {
+        D3D11_BLEND_DESC desc = {};
+        ((ID3D11BlendState*)handle)->GetDesc(&desc);
+        return trace.AddObject(kind, 0, &desc, sizeof(desc), 0);
+    }
+
+    case TRACE_OBJECT_INPUT_LAYOUT:
+    {
+        // layouts are rebuilt from their vertex shader's input signature
+        auto shader = layoutShaders.find(handle);
+        unsigned int parent = shader != layoutShaders.end() ? GetObjectId(TRACE_OBJECT_VERTEX_SHADER, shader->second) : 0;
+        return trace.AddObject(kind, parent, 0, 0, 0);
+    }
+    }
+
+    return trace.AddObject(kind, 0, 0, 0, 0);
+}
+
+unsigned int FrameCapture::DescribeBuffer(ID3D11Buffer* buffer)
+{
+    D3D11_BUFFER_DESC desc = {};
+    buffer->GetDesc(&desc);
+
+    // geometry doesn't change once it's made, so it's read back
+    // once and shared by every frame (and every copy) that uses it
+    uint64_t contents = 0;
+    if ((desc.Usage == D3D11_USAGE_IMMUTABLE || desc.Usage == D3D11_USAGE_DEFAULT) &&
+        (desc.BindFlags & (D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_INDEX_BUFFER)))
+        contents = ReadBufferContents(buffer, desc);
+
+    return trace.AddObject(TRACE_OBJECT_BUFFER, 0, &desc, sizeof(desc), contents);
+}
+
+unsigned int FrameCapture::DescribeResource(ID3D11Resource* resource)
+{
+    if (!resource)
+        return 0;
+
+    auto found = objectIds.find(resource);
+    if (found != objectIds.end())
+        return found->second;
+
+    unsigned int id = 0;
+    D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    resource->GetType(&dimension);
+    if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+    {
+        D3D11_TEXTURE2D_DESC desc = {};
+        ((ID3D11Texture2D*)resource)->GetDesc(&desc);
+        id = trace.AddObject(TRACE_OBJECT_TEXTURE2D, 0, &desc, sizeof(desc), 0);
+    }
+    else if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+    {
+        id = DescribeBuffer((ID3D11Buffer*)resource);
+    }
+    else
+    {
+        id = trace.AddObject(TRACE_OBJECT_TEXTURE2D, 0, 0, 0, 0);
+    }
+
+    objectIds[resource] = id;
+    return id;
+}
+
+uint64_t FrameCapture::ReadBufferContents(ID3D11Buffer* buffer, const D3D11_BUFFER_DESC& desc)
+{
+    D3D11_BUFFER_DESC stagingDesc = {};
+    stagingDesc.ByteWidth = desc.ByteWidth;
+    stagingDesc.Usage = D3D11_USAGE_STAGING;
+    stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    ComPtr<ID3D11Buffer> staging;
+    if (FAILED(device->CreateBuffer(&stagingDesc, 0, staging.GetAddressOf())))
+        return 0;
+    context->CopyResource(staging.Get(), buffer);
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    if (FAILED(context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+        return 0;
+    uint64_t hash = trace.AddBlob(mapped.pData, desc.ByteWidth);
+    context->Unmap(staging.Get(), 0);
+    return hash;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <d3d11.h>
+#include <string>
+#include <unordered_map>
+#include "FrameTrace.h"
+#include "RecordingRenderDevice.h"
+#include "SimpleShader.h"
+
+// Turns frames recorded by a RecordingRenderDevice into a FrameTrace
+// - Every object a frame uses is described the first time it shows up:
+//   its D3D11 desc, the texture behind a view, and the contents of
+//   immutable and default usage vertex/index buffers (read back once)
+// - Shader objects don't keep their bytecode, so shaders have to be
+//   registered to be replayable on a real device
+// - Texture contents aren't captured; replay recreates them blank
+class FrameCapture
+{
+public:
+    FrameCapture(ID3D11Device* device, ID3D11DeviceContext* context);
+
+    // bytecode (and input layout) for the shaders the frames will use
+    void RegisterShader(SimpleVertexShader* shader);
+    void RegisterShader(SimplePixelShader* shader);
+
+    // starts a new trace - objects from earlier captures are forgotten
+    void Begin();
+
+    // adds everything the device recorded since its last Reset() as a frame
+    void AddFrame(RecordingRenderDevice* recorder);
+
+    bool Save(std::string path);
+    FrameTrace& GetTrace();
+
+private:
+    unsigned int GetObjectId(unsigned int kind, const void* handle);
+    unsigned int DescribeObject(unsigned int kind, const void* handle);
+    unsigned int DescribeBuffer(ID3D11Buffer* buffer);
+    unsigned int DescribeResource(ID3D11Resource* resource);
+    uint64_t ReadBufferContents(ID3D11Buffer* buffer, const D3D11_BUFFER_DESC& desc);
+
+    // the kind of object a command's main handle is, or -1 for none
+    static int GetCommandObjectKind(const RenderCommand& command);
+
+    struct ShaderInfo
+    {
+        unsigned int kind;
+        ID3DBlob* bytecode;
+    };
+
+    ID3D11Device* device;
+    ID3D11DeviceContext* context;
+    FrameTrace trace;
+    std::unordered_map<const void*, unsigned int> objectIds;
+    std::unordered_map<const void*, ShaderInfo> shaders;
+    std::unordered_map<const void*, const void*> layoutShaders;
+};
@@ -0,0 +1,376 @@
+#include "FrameGraph.h"
+#include <algorithm>
+
+FrameGraph::FrameGraph(ID3D11Device* device)
+{
+    this->device = device;
+    culledPassCount = 0;
+    unaliasedBytes = 0;
+    aliasedBytes = 0;
+}
+
+void FrameGraph::Reset()
+{
+    resources.clear();
+    passes.clear();
+    culledPassCount = 0;
+    unaliasedBytes = 0;
+    aliasedBytes = 0;
+}
+
+unsigned int FrameGraph::CreateTexture(const char* name, const FrameGraphTextureDesc& desc)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.desc = desc;
+    resources.push_back(resource);
+    return (unsigned int)resources.size() - 1;
+}
+
+unsigned int FrameGraph::ImportTexture(const char* name, ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv, ID3D11ShaderResourceView* srv)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.imported = true;
+    resource.rtv = rtv;
+    resource.dsv = dsv;
+    resource.srv = srv;
+    resources.push_back(resource);
+    return (unsigned int)resources.size() - 1;
+}
+
+unsigned int FrameGraph::AddPass(const char* name)
+{
+    Pass pass = {};
+    pass.name = name;
+    passes.push_back(pass);
+    return (unsigned int)passes.size() - 1;
+}
+
+void FrameGraph::Read(unsigned int pass, unsigned int resource) { passes[pass].reads.push_back(resource); }
+void FrameGraph::Write(unsigned int pass, unsigned int resource) { passes[pass].writes.push_back(resource); }
+
+void FrameGraph::AddJob(unsigned int pass, RecordJob job, int thread)
+{
+    passes[pass].jobs.push_back(job);
+    passes[pass].jobThreads.push_back(thread);
+}
+
+bool FrameGraph::Compile()
+{
+    CullPasses();
+
+    // lifetimes, in pass indices
+    for (Resource& resource : resources)
+    {
+        resource.firstPass = -1;
+        resource.lastPass = -1;
+        resource.lastRead = -1;
+        resource.texture = -1;
+    }
+    for (int p = 0; p < (int)passes.size(); p++)
+    {
+        if (passes[p].culled)
+            continue;
+        for (int access = 0; access < 2; access++)
+        {
+            for (unsigned int r : access == 0 ? passes[p].reads : passes[p].writes)
+            {
+                Resource& resource = resources[r];
+                if (resource.firstPass < 0)
+                    resource.firstPass = p;
+                resource.lastPass = std::max(resource.lastPass, p);
+                if (access == 0)
+                    resource.lastRead = std::max(resource.lastRead, p);
+            }
+        }
+    }
+
+    bool changed = AllocateTextures();
+
+    // SRVs come off after their last read, so whichever pass writes the
+    // texture next (this frame or the next) finds it unbound
+    for (Resource& resource : resources)
+    {
+        ID3D11ShaderResourceView* srv = GetSRV((unsigned int)(&resource - resources.data()));
+        if (resource.lastRead >= 0 && srv)
+            passes[resource.lastRead].unbindAfter.push_back(srv);
+    }
+    return changed;
+}
+
+// --------------------------------------------------------
+// Works back from the passes with side effects (writing an
+// imported resource) - a pass whose writes are never read
+// is culled, which can leave what it read unread in turn
+// --------------------------------------------------------
+void FrameGraph::CullPasses()
+{
+    for (Resource& resource : resources)
+        resource.readers = 0;
+    for (Pass& pass : passes)
+    {
+        pass.culled = false;
+        pass.refCount = (unsigned int)pass.writes.size();
+        pass.unbindAfter.clear();
+        for (unsigned int r : pass.reads)
+            resources[r].readers++;
+        for (unsigned int r : pass.writes)
+        {
+            if (resources[r].imported)
+                pass.refCount += (unsigned int)passes.size(); // never reaches zero
+        }
+    }
+
+    std::vector<unsigned int> unread;
+    for (unsigned int r = 0; r < resources.size(); r++)
+    {
+        if (resources[r].readers == 0 && !resources[r].imported)
+            unread.push_back(r);
+    }
+
+    culledPassCount = 0;
+    while (!unread.empty())
+    {
+        unsigned int r = unread.back();
+        unread.pop_back();
+
+        for (Pass& pass : passes)
+        {
+            if (pass.culled || std::find(pass.writes.begin(), pass.writes.end(), r) == pass.writes.end())
+                continue;
+            if (--pass.refCount > 0)
+                continue;
+
+            pass.culled = true;
+            culledPassCount++;
+            for (unsigned int read : pass.reads)
+            {
+                if (--resources[read].readers == 0 && !resources[read].imported)
+                    unread.push_back(read);
+            }
+        }
+    }
+}
+
+// --------------------------------------------------------
+// Hands every live transient resource a pooled texture,
+// in order of first use - one is shared when its last
+// user is done before the next resource's first pass
+// --------------------------------------------------------
+bool FrameGraph::AllocateTextures()
+{
+    bool changed = false;
+
+    // textures nothing has asked for in a while (an old size) go first
+    for (size_t t = 0; t < pool.size(); )
+    {
+        if (pool[t].idleFrames >= FRAME_GRAPH_POOL_FRAMES)
+        {
+            pool.erase(pool.begin() + t);
+            changed = true;
+        }
+        else
+        {
+            pool[t].busyUntil = -1;
+            t++;
+        }
+    }
+
+    std::vector<unsigned int> order;
+    for (unsigned int r = 0; r < resources.size(); r++)
+    {
+        if (!resources[r].imported && resources[r].firstPass >= 0)
+            order.push_back(r);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+    {
+        return resources[a].firstPass < resources[b].firstPass;
+    });
+
+    std::vector<bool> used(pool.size(), false);
+    for (unsigned int r : order)
+    {
+        Resource& resource = resources[r];
+        unaliasedBytes += GetTextureBytes(resource.desc);
+
+        int found = -1;
+        for (size_t t = 0; t < pool.size() && found < 0; t++)
+        {
+            if (pool[t].busyUntil < resource.firstPass && SameDesc(pool[t].desc, resource.desc))
+                found = (int)t;
+        }
+
+        if (found < 0)
+        {
+            PooledTexture pooled = {};
+            if (!CreatePooledTexture(resource.desc, pooled))
+                continue;
+            pool.push_back(pooled);
+            used.push_back(false);
+            found = (int)pool.size() - 1;
+            changed = true;
+        }
+
+        pool[found].busyUntil = resource.lastPass;
+        resource.texture = found;
+        if (!used[found])
+            aliasedBytes += GetTextureBytes(pool[found].desc);
+        used[found] = true;
+    }
+
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].idleFrames = used[t] ? 0 : pool[t].idleFrames + 1;
+    return changed;
+}
+
+bool FrameGraph::CreatePooledTexture(const FrameGraphTextureDesc& desc, PooledTexture& pooled)
+{
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width = desc.width;
+    textureDesc.Height = desc.height;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = desc.format;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = desc.bindFlags;
+    if (FAILED(device->CreateTexture2D(&textureDesc, 0, pooled.texture.GetAddressOf())))
+        return false;
+
+    bool typed = desc.viewFormat != DXGI_FORMAT_UNKNOWN;
+    if (desc.bindFlags & D3D11_BIND_RENDER_TARGET)
+    {
+        D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+        rtvDesc.Format = desc.viewFormat;
+        rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+        device->CreateRenderTargetView(pooled.texture.Get(), typed ? &rtvDesc : 0, pooled.rtv.GetAddressOf());
+    }
+    if (desc.bindFlags & D3D11_BIND_DEPTH_STENCIL)
+    {
+        D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+        dsvDesc.Format = desc.depthFormat;
+        dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+        device->CreateDepthStencilView(pooled.texture.Get(), &dsvDesc, pooled.dsv.GetAddressOf());
+    }
+    if (desc.bindFlags & D3D11_BIND_SHADER_RESOURCE)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = desc.viewFormat;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MipLevels = 1;
+        device->CreateShaderResourceView(pooled.texture.Get(), typed ? &srvDesc : 0, pooled.srv.GetAddressOf());
+    }
+
+    pooled.desc = desc;
+    pooled.idleFrames = 0;
+    pooled.busyUntil = -1;
+    return true;
+}
+
+bool FrameGraph::SameDesc(const FrameGraphTextureDesc& a, const FrameGraphTextureDesc& b)
+{
+    return a.width == b.width && a.height == b.height && a.format == b.format &&
+        a.viewFormat == b.viewFormat && a.depthFormat == b.depthFormat && a.bindFlags == b.bindFlags;
+}
+
+void FrameGraph::Execute(CommandRecorder* recorder)
+{
+    for (Pass& pass : passes)
+    {
+        if (pass.culled)
+            continue;
+
+        for (size_t j = 0; j < pass.jobs.size(); j++)
+        {
+            if (pass.unbindAfter.empty())
+            {
+                recorder->Add(pass.jobs[j], pass.jobThreads[j]);
+                continue;
+            }
+
+            // every job, since each one may be on its own context
+            RecordJob job = pass.jobs[j];
+            const std::vector<ID3D11ShaderResourceView*>* unbind = &pass.unbindAfter;
+            recorder->Add([job, unbind](ID3D11DeviceContext* context, StateCache* stateCache)
+            {
+                job(context, stateCache);
+                for (ID3D11ShaderResourceView* srv : *unbind)
+                    stateCache->UnbindShaderResource(srv);
+            }, pass.jobThreads[j]);
+        }
+    }
+}
+
+ID3D11RenderTargetView* FrameGraph::GetRTV(unsigned int resource)
+{
+    const Resource& r = resources[resource];
+    if (r.imported)
+        return r.rtv;
+    return r.texture >= 0 ? pool[r.texture].rtv.Get() : 0;
+}
+
+ID3D11DepthStencilView* FrameGraph::GetDSV(unsigned int resource)
+{
+    const Resource& r = resources[resource];
+    if (r.imported)
+        return r.dsv;
+    return r.texture >= 0 ? pool[r.texture].dsv.Get() : 0;
+}
+
+ID3D11ShaderResourceView* FrameGraph::GetSRV(unsigned int resource)
+{
+    const Resource& r = resources[resource];
+    if (r.imported)
+        return r.srv;
+    return r.texture >= 0 ? pool[r.texture].srv.Get() : 0;
+}
+
+unsigned int FrameGraph::GetPassCount() { return (unsigned int)passes.size(); }
+unsigned int FrameGraph::GetCulledPassCount() { return culledPassCount; }
+bool FrameGraph::IsPassCulled(unsigned int pass) { return passes[pass].culled; }
+
+uint64_t FrameGraph::GetUnaliasedBytes() { return unaliasedBytes; }
+uint64_t FrameGraph::GetAliasedBytes() { return aliasedBytes; }
+unsigned int FrameGraph::GetPooledTextureCount() { return (unsigned int)pool.size(); }
+
+std::string FrameGraph::GetReport()
+{
+    std::string report = "Frame graph: " + std::to_string(passes.size()) + " passes, " + std::to_string(culledPassCount) + " culled\n";
+    for (Pass& pass : passes)
+        report += "  pass " + pass.name + (pass.culled ? " (culled)" : "") + "\n";
+
+    for (Resource& resource : resources)
+    {
+        if (resource.imported)
+            continue;
+        report += "  " + resource.name + " " + std::to_string(resource.desc.width) + "x" + std::to_string(resource.desc.height);
+        if (resource.texture < 0)
+        {
+            report += " unused\n";
+            continue;
+        }
+        report += " passes " + passes[resource.firstPass].name + ".." + passes[resource.lastPass].name
+            + ", texture " + std::to_string(resource.texture) + ", " + std::to_string(GetTextureBytes(resource.desc) / 1024) + " KB\n";
+    }
+
+    report += "  peak memory " + std::to_string(unaliasedBytes / 1024) + " KB unaliased, "
+        + std::to_string(aliasedBytes / 1024) + " KB aliased, " + std::to_string(pool.size()) + " pooled textures";
+    return report;
+}
+
+uint64_t FrameGraph::GetTextureBytes(const FrameGraphTextureDesc& desc)
+{
+    unsigned int bytesPerPixel = 4;
+    switch (desc.format)
+    {
+    case DXGI_FORMAT_R8_UNORM: bytesPerPixel = 1; break;
+    case DXGI_FORMAT_R8G8_UNORM:
+    case DXGI_FORMAT_R16_UINT: bytesPerPixel = 2; break;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R32G32_FLOAT: bytesPerPixel = 8; break;
+    case DXGI_FORMAT_R32G32B32A32_FLOAT: bytesPerPixel = 16; break;
+    default: break;
+    }
+    return (uint64_t)desc.width * desc.height * bytesPerPixel;
+}
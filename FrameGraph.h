@@ -0,0 +1,140 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CommandRecorder.h"
+
+// compiles a pooled texture can sit unused before it's released
+#define FRAME_GRAPH_POOL_FRAMES     3
+
+// A transient texture - the graph creates (or reuses) one matching it
+// - viewFormat is the SRV/RTV format, DXGI_FORMAT_UNKNOWN for the texture's
+// - depthFormat is the DSV format, for textures bound as depth
+struct FrameGraphTextureDesc
+{
+    unsigned int width;
+    unsigned int height;
+    DXGI_FORMAT format;
+    DXGI_FORMAT viewFormat;
+    DXGI_FORMAT depthFormat;
+    unsigned int bindFlags;
+};
+
+// Declarative description of a frame - passes say which textures they
+// read and write, and the graph works out the rest
+// - Everything is declared again every frame, then Compile()d:
+//   passes whose writes nobody reads are culled (a pass that writes an
+//   imported resource, like the back buffer, always runs), the
+//   transient textures get lifetimes from the passes that use them,
+//   and are handed textures from a pool - two textures with the same
+//   desc whose lifetimes don't overlap share one
+// - A texture's SRV is unbound after the last pass that reads it, so
+//   it can become a render target again without a hazard
+// - Pooled textures follow the declared sizes, so a resize needs
+//   nothing more than declaring the new size - the old ones are
+//   released once they've gone unused for a few frames
+// - A pass records through RecordJobs, the same as CommandRecorder,
+//   and Execute() hands the surviving ones to the recorder in order
+class FrameGraph
+{
+public:
+    FrameGraph(ID3D11Device* device);
+
+    // starts declaring a new frame
+    void Reset();
+
+    // resources - the returned handles are only valid for this frame
+    unsigned int CreateTexture(const char* name, const FrameGraphTextureDesc& desc);
+    unsigned int ImportTexture(const char* name, ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv, ID3D11ShaderResourceView* srv);
+
+    // passes run in the order they're added
+    unsigned int AddPass(const char* name);
+    void Read(unsigned int pass, unsigned int resource);
+    void Write(unsigned int pass, unsigned int resource);
+    void AddJob(unsigned int pass, RecordJob job, int thread = -1);
+
+    // culls, works out lifetimes and hands out textures - returns true
+    // if textures had to be created or released for it
+    bool Compile();
+
+    // adds the surviving passes' jobs to the recorder
+    void Execute(CommandRecorder* recorder);
+
+    // a resource's views once compiled - null if it wasn't needed
+    ID3D11RenderTargetView* GetRTV(unsigned int resource);
+    ID3D11DepthStencilView* GetDSV(unsigned int resource);
+    ID3D11ShaderResourceView* GetSRV(unsigned int resource);
+
+    unsigned int GetPassCount();
+    unsigned int GetCulledPassCount();
+    bool IsPassCulled(unsigned int pass);
+
+    // peak transient texture memory - with every texture on its own,
+    // and with the pool's sharing
+    uint64_t GetUnaliasedBytes();
+    uint64_t GetAliasedBytes();
+    unsigned int GetPooledTextureCount();
+
+    // passes, lifetimes and the texture each resource landed in
+    std::string GetReport();
+
+    static uint64_t GetTextureBytes(const FrameGraphTextureDesc& desc);
+
+private:
+    struct Resource
+    {
+        std::string name;
+        FrameGraphTextureDesc desc;
+        bool imported;
+        ID3D11RenderTargetView* rtv;
+        ID3D11DepthStencilView* dsv;
+        ID3D11ShaderResourceView* srv;
+
+        // filled in by Compile() - pass indices, -1 if unused
+        int firstPass;
+        int lastPass;
+        int lastRead;
+        int texture;
+        unsigned int readers;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<unsigned int> reads;
+        std::vector<unsigned int> writes;
+        std::vector<RecordJob> jobs;
+        std::vector<int> jobThreads;
+
+        unsigned int refCount;
+        bool culled;
+        std::vector<ID3D11ShaderResourceView*> unbindAfter;
+    };
+
+    struct PooledTexture
+    {
+        FrameGraphTextureDesc desc;
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+        Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
+        Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+        unsigned int idleFrames;
+        int busyUntil;
+    };
+
+    void CullPasses();
+    bool AllocateTextures();
+    bool CreatePooledTexture(const FrameGraphTextureDesc& desc, PooledTexture& pooled);
+    static bool SameDesc(const FrameGraphTextureDesc& a, const FrameGraphTextureDesc& b);
+
+    ID3D11Device* device;
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<PooledTexture> pool;
+
+    unsigned int culledPassCount;
+    uint64_t unaliasedBytes;
+    uint64_t aliasedBytes;
+};
@@ -0,0 +1,239 @@
+#include "FrameTrace.h"
+#include <cstring>
+#include <fstream>
+
+#define FRAME_TRACE_MAGIC     0x31435254 // "TRC1"
+#define FRAME_TRACE_VERSION   1
+
+FrameTrace::FrameTrace()
+{
+    Clear();
+}
+
+void FrameTrace::Clear()
+{
+    objects.clear();
+    blobs.clear();
+    frames.clear();
+    blobBytes = 0;
+    sharedBytes = 0;
+}
+
+unsigned int FrameTrace::AddObject(unsigned int kind, unsigned int parent, const void* desc, unsigned int descSize, uint64_t payload)
+{
+    TraceObject object;
+    object.kind = kind;
+    object.parent = parent;
+    object.payload = payload;
+    if (desc && descSize > 0)
+        object.desc.assign((const unsigned char*)desc, (const unsigned char*)desc + descSize);
+
+    objects.push_back(object);
+    return (unsigned int)objects.size();
+}
+
+unsigned int FrameTrace::GetObjectCount() { return (unsigned int)objects.size(); }
+const TraceObject& FrameTrace::GetTraceObject(unsigned int id) { return objects[id - 1]; }
+
+uint64_t FrameTrace::AddBlob(const void* data, unsigned int size)
+{
+    uint64_t hash = Hash(data, size);
+
+    auto found = blobs.find(hash);
+    if (found != blobs.end())
+    {
+        sharedBytes += size;
+        return hash;
+    }
+
+    blobs[hash].assign((const unsigned char*)data, (const unsigned char*)data + size);
+    blobBytes += size;
+    return hash;
+}
+
+const std::vector<unsigned char>* FrameTrace::GetBlob(uint64_t hash)
+{
+    auto found = blobs.find(hash);
+    return found != blobs.end() ? &found->second : 0;
+}
+
+unsigned int FrameTrace::GetBlobCount() { return (unsigned int)blobs.size(); }
+
+TraceFrame& FrameTrace::AddFrame()
+{
+    frames.push_back(TraceFrame());
+    return frames.back();
+}
+
+unsigned int FrameTrace::GetFrameCount() { return (unsigned int)frames.size(); }
+TraceFrame& FrameTrace::GetFrame(unsigned int index) { return frames[index]; }
+
+void FrameTrace::AddCommandData(TraceFrame& frame, TraceCommand& command, const void* data, unsigned int size)
+{
+    command.dataOffset = (unsigned int)frame.data.size();
+    command.dataSize = size;
+    if (!data || size == 0)
+    {
+        command.dataSize = 0;
+        return;
+    }
+
+    // big payloads are stored once, and the frame just keeps their hash
+    uint64_t hash = 0;
+    if (size >= TRACE_BLOB_THRESHOLD)
+    {
+        hash = AddBlob(data, size);
+        command.flags |= TRACE_DATA_BLOB;
+        data = &hash;
+        size = sizeof(hash);
+    }
+
+    frame.data.insert(frame.data.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+}
+
+const unsigned char* FrameTrace::GetCommandData(const TraceFrame& frame, const TraceCommand& command, unsigned int& size)
+{
+    size = command.dataSize;
+    if (size == 0)
+        return 0;
+
+    if (command.flags & TRACE_DATA_BLOB)
+    {
+        uint64_t hash = 0;
+        memcpy(&hash, &frame.data[command.dataOffset], sizeof(hash));
+        const std::vector<unsigned char>* blob = GetBlob(hash);
+        if (!blob || blob->size() != size)
+        {
+            size = 0;
+            return 0;
+        }
+        return blob->data();
+    }
+
+    return &frame.data[command.dataOffset];
+}
+
+uint64_t FrameTrace::GetBlobBytes() { return blobBytes; }
+uint64_t FrameTrace::GetSharedBytes() { return sharedBytes; }
+
+uint64_t FrameTrace::Hash(const void* data, unsigned int size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned int i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// --------------------------------------------------------
+// File layout, all little endian:
+//   header   - magic, version, object/blob/frame counts
+//   blobs    - hash, size, bytes
+//   objects  - kind, parent, payload hash, desc size, desc
+//   frames   - command count, data size, commands, data
+// --------------------------------------------------------
+bool FrameTrace::Save(std::string path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    uint32_t header[5] = { FRAME_TRACE_MAGIC, FRAME_TRACE_VERSION, (uint32_t)objects.size(), (uint32_t)blobs.size(), (uint32_t)frames.size() };
+    file.write((const char*)header, sizeof(header));
+
+    for (auto& blob : blobs)
+    {
+        uint32_t size = (uint32_t)blob.second.size();
+        file.write((const char*)&blob.first, sizeof(blob.first));
+        file.write((const char*)&size, sizeof(size));
+        file.write((const char*)blob.second.data(), size);
+    }
+
+    for (TraceObject& object : objects)
+    {
+        uint32_t fields[2] = { object.kind, object.parent };
+        uint32_t descSize = (uint32_t)object.desc.size();
+        file.write((const char*)fields, sizeof(fields));
+        file.write((const char*)&object.payload, sizeof(object.payload));
+        file.write((const char*)&descSize, sizeof(descSize));
+        file.write((const char*)object.desc.data(), descSize);
+    }
+
+    for (TraceFrame& frame : frames)
+    {
+        uint32_t sizes[2] = { (uint32_t)frame.commands.size(), (uint32_t)frame.data.size() };
+        file.write((const char*)sizes, sizeof(sizes));
+        file.write((const char*)frame.commands.data(), frame.commands.size() * sizeof(TraceCommand));
+        file.write((const char*)frame.data.data(), frame.data.size());
+    }
+
+    return file.good();
+}
+
+bool FrameTrace::Load(std::string path)
+{
+    Clear();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    uint32_t header[5] = {};
+    file.read((char*)header, sizeof(header));
+    if (!file.good() || header[0] != FRAME_TRACE_MAGIC || header[1] != FRAME_TRACE_VERSION)
+        return false;
+
+    for (uint32_t i = 0; i < header[3] && file.good(); i++)
+    {
+        uint64_t hash = 0;
+        uint32_t size = 0;
+        file.read((char*)&hash, sizeof(hash));
+        file.read((char*)&size, sizeof(size));
+
+        std::vector<unsigned char>& blob = blobs[hash];
+        blob.resize(size);
+        file.read((char*)blob.data(), size);
+        blobBytes += size;
+    }
+
+    objects.resize(header[2]);
+    for (TraceObject& object : objects)
+    {
+        uint32_t fields[2] = {};
+        uint32_t descSize = 0;
+        file.read((char*)fields, sizeof(fields));
+        file.read((char*)&object.payload, sizeof(object.payload));
+        file.read((char*)&descSize, sizeof(descSize));
+        if (!file.good())
+            break;
+
+        object.kind = fields[0];
+        object.parent = fields[1];
+        object.desc.resize(descSize);
+        file.read((char*)object.desc.data(), descSize);
+    }
+
+    frames.resize(header[4]);
+    for (TraceFrame& frame : frames)
+    {
+        uint32_t sizes[2] = {};
+        file.read((char*)sizes, sizeof(sizes));
+        if (!file.good())
+            break;
+
+        frame.commands.resize(sizes[0]);
+        frame.data.resize(sizes[1]);
+        file.read((char*)frame.commands.data(), frame.commands.size() * sizeof(TraceCommand));
+        file.read((char*)frame.data.data(), frame.data.size());
+    }
+
+    if (!file.good())
+    {
+        Clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// kinds of object a trace can refer to
+#define TRACE_OBJECT_VERTEX_SHADER      0
+#define TRACE_OBJECT_PIXEL_SHADER       1
+#define TRACE_OBJECT_OTHER_SHADER       2
+#define TRACE_OBJECT_BUFFER             3
+#define TRACE_OBJECT_TEXTURE2D          4
+#define TRACE_OBJECT_SRV                5
+#define TRACE_OBJECT_RTV                6
+#define TRACE_OBJECT_DSV                7
+#define TRACE_OBJECT_SAMPLER            8
+#define TRACE_OBJECT_INPUT_LAYOUT       9
+#define TRACE_OBJECT_RASTERIZER_STATE   10
+#define TRACE_OBJECT_DEPTH_STENCIL_STATE 11
+#define TRACE_OBJECT_BLEND_STATE        12
+#define TRACE_OBJECT_KIND_COUNT         13
+
+// the command's data is an 8 byte blob hash, not the bytes themselves
+#define TRACE_DATA_BLOB                 0x1
+
+// payloads this big or bigger are stored once, by hash
+#define TRACE_BLOB_THRESHOLD            256
+
+// An object used by the traced frames
+// - desc is the D3D11 description struct the object was created with
+//   (D3D11_BUFFER_DESC, D3D11_SAMPLER_DESC, ...), nothing for shaders
+// - payload is the blob holding its contents, if they were captured
+//   (shader bytecode, immutable buffer data), 0 otherwise
+// - parent is the object it was made from - the resource of a view,
+//   the vertex shader of an input layout - or 0
+struct TraceObject
+{
+    unsigned int kind;
+    unsigned int parent;
+    uint64_t payload;
+    std::vector<unsigned char> desc;
+};
+
+// A recorded RenderDevice call, like RenderCommand but with object ids
+// (0 is null) instead of handles - that includes any handle lists in the data
+struct TraceCommand
+{
+    unsigned short type;
+    unsigned short flags;
+    unsigned int object;
+    unsigned int args[5];
+    unsigned int dataOffset;
+    unsigned int dataSize;
+};
+
+struct TraceFrame
+{
+    std::vector<TraceCommand> commands;
+    std::vector<unsigned char> data;
+};
+
+// A compact binary trace of one or more frames of RenderDevice calls
+// - Objects are listed once, up front, and referred to by id
+// - Large payloads (mesh data, bytecode, big uploads) are content
+//   hashed and stored once no matter how often they show up
+// - Nothing here touches D3D - FrameCapture fills a trace in,
+//   TraceReplay plays it back
+class FrameTrace
+{
+public:
+    FrameTrace();
+
+    void Clear();
+
+    // returns the new object's id
+    unsigned int AddObject(unsigned int kind, unsigned int parent, const void* desc, unsigned int descSize, uint64_t payload);
+    unsigned int GetObjectCount();
+    const TraceObject& GetTraceObject(unsigned int id);
+
+    // stores the bytes unless they're already there, returns their hash
+    uint64_t AddBlob(const void* data, unsigned int size);
+    const std::vector<unsigned char>* GetBlob(uint64_t hash);
+    unsigned int GetBlobCount();
+
+    TraceFrame& AddFrame();
+    unsigned int GetFrameCount();
+    TraceFrame& GetFrame(unsigned int index);
+
+    // appends a command's data to the frame, through the blob
+    // store when it's big enough to be worth sharing
+    void AddCommandData(TraceFrame& frame, TraceCommand& command, const void* data, unsigned int size);
+
+    // a command's data, wherever it's stored
+    const unsigned char* GetCommandData(const TraceFrame& frame, const TraceCommand& command, unsigned int& size);
+
+    bool Save(std::string path);
+    bool Load(std::string path);
+
+    // bytes of blob data stored, and how many more it would
+    // have taken without sharing
+    uint64_t GetBlobBytes();
+    uint64_t GetSharedBytes();
+
+    // 64 bit FNV-1a
+    static uint64_t Hash(const void* data, unsigned int size);
+
+private:
+    std::vector<TraceObject> objects;
+    std::unordered_map<uint64_t, std::vector<unsigned char>> blobs;
+    std::vector<TraceFrame> frames;
+    uint64_t blobBytes;
+    uint64_t sharedBytes;
+};
@@ -0,0 +1,256 @@
+#include "FrustumCuller.h"
+#include "CpuFeatures.h"
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    // plane data laid out for broadcasting: nx, ny, nz, d, |nx|, |ny|, |nz|
+    struct CullPlane
+    {
+        float nx, ny, nz, d;
+        float ax, ay, az;
+    };
+
+    // a box is outside a plane when its center lies further behind the
+    // plane than the box's projected radius onto the plane normal:
+    //     dot(n, c) + d + dot(|n|, e) < 0
+    // the outside results are OR'd across planes and the rest are compacted
+    size_t CullSSE(const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, size_t count, const CullPlane* planes, const uint64_t* preVisible, unsigned int* out)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        size_t visible = 0;
+
+        for (size_t base = 0; base < count; base += 4)
+        {
+            // blocks never straddle a 64 bit word, so the bits come from one read
+            unsigned int allowed = 0xF;
+            if (preVisible)
+            {
+                allowed = (unsigned int)(preVisible[base >> 6] >> (base & 63)) & 0xF;
+                if (allowed == 0)
+                    continue;
+            }
+
+            __m128 centerX = _mm_loadu_ps(cx + base);
+            __m128 centerY = _mm_loadu_ps(cy + base);
+            __m128 centerZ = _mm_loadu_ps(cz + base);
+            __m128 extentX = _mm_loadu_ps(ex + base);
+            __m128 extentY = _mm_loadu_ps(ey + base);
+            __m128 extentZ = _mm_loadu_ps(ez + base);
+
+            __m128 outside = _mm_setzero_ps();
+            for (int p = 0; p < 6; p++)
+            {
+                const CullPlane& pl = planes[p];
+                __m128 dist = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(pl.nx)), _mm_mul_ps(centerY, _mm_set1_ps(pl.ny))),
+                    _mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(pl.nz)), _mm_set1_ps(pl.d)));
+                __m128 radius = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(pl.ax)), _mm_mul_ps(extentY, _mm_set1_ps(pl.ay))),
+                    _mm_mul_ps(extentZ, _mm_set1_ps(pl.az)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+            }
+
+            // mask off the padding past the end of the list
+            unsigned int mask = ~(unsigned int)_mm_movemask_ps(outside) & allowed;
+            size_t remaining = count - base;
+            if (remaining < 4)
+                mask &= (1u << remaining) - 1;
+
+            // nothing survived, which is the common case for big scenes
+            if (mask == 0)
+                continue;
+
+            // branchless compaction - always write, only advance on visible
+            for (unsigned int lane = 0; lane < 4; lane++)
+            {
+                out[visible] = (unsigned int)(base + lane);
+                visible += (mask >> lane) & 1;
+            }
+        }
+
+        return visible;
+    }
+
+    SIMD_TARGET_AVX
+    size_t CullAVX(const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, size_t count, const CullPlane* planes, const uint64_t* preVisible, unsigned int* out)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        size_t visible = 0;
+
+        for (size_t base = 0; base < count; base += 8)
+        {
+            unsigned int allowed = 0xFF;
+            if (preVisible)
+            {
+                allowed = (unsigned int)(preVisible[base >> 6] >> (base & 63)) & 0xFF;
+                if (allowed == 0)
+                    continue;
+            }
+
+            __m256 centerX = _mm256_loadu_ps(cx + base);
+            __m256 centerY = _mm256_loadu_ps(cy + base);
+            __m256 centerZ = _mm256_loadu_ps(cz + base);
+            __m256 extentX = _mm256_loadu_ps(ex + base);
+            __m256 extentY = _mm256_loadu_ps(ey + base);
+            __m256 extentZ = _mm256_loadu_ps(ez + base);
+
+            __m256 outside = _mm256_setzero_ps();
+            for (int p = 0; p < 6; p++)
+            {
+                const CullPlane& pl = planes[p];
+                __m256 dist = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(centerX, _mm256_set1_ps(pl.nx)), _mm256_mul_ps(centerY, _mm256_set1_ps(pl.ny))),
+                    _mm256_add_ps(_mm256_mul_ps(centerZ, _mm256_set1_ps(pl.nz)), _mm256_set1_ps(pl.d)));
+                __m256 radius = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(extentX, _mm256_set1_ps(pl.ax)), _mm256_mul_ps(extentY, _mm256_set1_ps(pl.ay))),
+                    _mm256_mul_ps(extentZ, _mm256_set1_ps(pl.az)));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), zero, _CMP_LT_OQ));
+            }
+
+            unsigned int mask = ~(unsigned int)_mm256_movemask_ps(outside) & allowed;
+            size_t remaining = count - base;
+            if (remaining < 8)
+                mask &= (1u << remaining) - 1;
+
+            if (mask == 0)
+                continue;
+
+            for (unsigned int lane = 0; lane < 8; lane++)
+            {
+                out[visible] = (unsigned int)(base + lane);
+                visible += (mask >> lane) & 1;
+            }
+        }
+
+        return visible;
+    }
+}
+
+FrustumCuller::FrustumCuller()
+{
+    count = 0;
+    useAVX = CpuFeatures::HasAVX();
+    testedCount = 0;
+    culledCount = 0;
+    visibleCount = 0;
+    refreshedCount = 0;
+    lastCullTime = 0.0f;
+    updating = false;
+}
+
+void FrustumCuller::Resize(size_t newCount)
+{
+    count = newCount;
+
+    // pad so the SIMD loops can always load a full 8 wide block
+    size_t padded = (newCount + 7) & ~(size_t)7;
+    centerX.resize(padded, 0.0f);
+    centerY.resize(padded, 0.0f);
+    centerZ.resize(padded, 0.0f);
+    extentX.resize(padded, 0.0f);
+    extentY.resize(padded, 0.0f);
+    extentZ.resize(padded, 0.0f);
+
+    // compaction writes a full block before trimming, so leave room
+    compacted.resize(padded + 8);
+}
+
+size_t FrustumCuller::GetCount() { return count; }
+
+// transforms a local space box into a world space box that encloses it
+// - the center is transformed as a point, and the new extents are the
+//   old extents projected through the absolute value of the 3x3 part
+void FrustumCuller::SetBounds(size_t index, XMFLOAT3 localMin, XMFLOAT3 localMax, const XMFLOAT4X4& world)
+{
+    if (index >= count)
+        return;
+
+    float cx = (localMin.x + localMax.x) * 0.5f;
+    float cy = (localMin.y + localMax.y) * 0.5f;
+    float cz = (localMin.z + localMax.z) * 0.5f;
+    float ex = (localMax.x - localMin.x) * 0.5f;
+    float ey = (localMax.y - localMin.y) * 0.5f;
+    float ez = (localMax.z - localMin.z) * 0.5f;
+
+    // row vector convention: p' = p * M
+    centerX[index] = cx * world._11 + cy * world._21 + cz * world._31 + world._41;
+    centerY[index] = cx * world._12 + cy * world._22 + cz * world._32 + world._42;
+    centerZ[index] = cx * world._13 + cy * world._23 + cz * world._33 + world._43;
+
+    extentX[index] = ex * fabsf(world._11) + ey * fabsf(world._21) + ez * fabsf(world._31);
+    extentY[index] = ex * fabsf(world._12) + ey * fabsf(world._22) + ez * fabsf(world._32);
+    extentZ[index] = ex * fabsf(world._13) + ey * fabsf(world._23) + ez * fabsf(world._33);
+    refreshedCount++;
+}
+
+void FrustumCuller::GetBounds(size_t index, XMFLOAT3& center, XMFLOAT3& extents)
+{
+    if (index >= count)
+    {
+        center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        extents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        return;
+    }
+
+    center = XMFLOAT3(centerX[index], centerY[index], centerZ[index]);
+    extents = XMFLOAT3(extentX[index], extentY[index], extentZ[index]);
+}
+
+void FrustumCuller::BeginUpdate()
+{
+    updateStart = std::chrono::high_resolution_clock::now();
+    updating = true;
+    refreshedCount = 0;
+}
+
+void FrustumCuller::Cull(const XMFLOAT4* planes, std::vector<unsigned int>& visibleOut, const uint64_t* preVisible)
+{
+    // a frame started with BeginUpdate() is timed from there
+    auto start = updating ? updateStart : std::chrono::high_resolution_clock::now();
+    if (!updating)
+        refreshedCount = 0;
+    updating = false;
+
+    CullPlane cullPlanes[6];
+    for (int i = 0; i < 6; i++)
+    {
+        cullPlanes[i].nx = planes[i].x;
+        cullPlanes[i].ny = planes[i].y;
+        cullPlanes[i].nz = planes[i].z;
+        cullPlanes[i].d = planes[i].w;
+        cullPlanes[i].ax = fabsf(planes[i].x);
+        cullPlanes[i].ay = fabsf(planes[i].y);
+        cullPlanes[i].az = fabsf(planes[i].z);
+    }
+
+    size_t visible = 0;
+    if (count > 0)
+    {
+        if (useAVX)
+            visible = CullAVX(centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), count, cullPlanes, preVisible, compacted.data());
+        else
+            visible = CullSSE(centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), count, cullPlanes, preVisible, compacted.data());
+    }
+
+    // only the survivors are copied - visibleOut keeps its capacity
+    visibleOut.assign(compacted.begin(), compacted.begin() + visible);
+
+    testedCount = (unsigned int)count;
+    visibleCount = (unsigned int)visible;
+    culledCount = testedCount - visibleCount;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    lastCullTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void FrustumCuller::SetUseAVX(bool enabled) { useAVX = enabled && CpuFeatures::HasAVX(); }
+
+unsigned int FrustumCuller::GetTestedCount() { return testedCount; }
+unsigned int FrustumCuller::GetCulledCount() { return culledCount; }
+unsigned int FrustumCuller::GetVisibleCount() { return visibleCount; }
+unsigned int FrustumCuller::GetRefreshedCount() { return refreshedCount; }
+float FrustumCuller::GetLastCullTime() { return lastCullTime; }
@@ -0,0 +1,73 @@
+#pragma once
+#include <DirectXMath.h>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Culls world space bounding boxes against the camera frustum
+// - Boxes are stored as center/extents in structure-of-arrays form
+//   so 4 (SSE) or 8 (AVX) of them can be tested per iteration
+// - The result is a compacted list of the indices that survived,
+//   which the draw loop walks instead of the whole entity list
+// - Bounds are only refreshed for entities whose transform changed;
+//   BeginUpdate() starts the frame's clock, so the reported time covers
+//   those refreshes as well as the test itself
+class FrustumCuller
+{
+public:
+    FrustumCuller();
+
+    // bounds management
+    void Resize(size_t count);
+    size_t GetCount();
+    void SetBounds(size_t index, DirectX::XMFLOAT3 localMin, DirectX::XMFLOAT3 localMax, const DirectX::XMFLOAT4X4& world);
+    void GetBounds(size_t index, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents); // zeros past the end
+
+    // starts timing a frame - the SetBounds() calls from here until
+    // Cull() are counted and timed with it
+    void BeginUpdate();
+
+    // tests every box against the 6 planes (normals pointing inward)
+    // and writes the indices of the visible ones to visibleOut
+    // - preVisible is an optional bitset (one bit per box, e.g. from the PVS),
+    //   boxes with a clear bit are rejected without being tested
+    void Cull(const DirectX::XMFLOAT4* planes, std::vector<unsigned int>& visibleOut, const uint64_t* preVisible = nullptr);
+
+    // the SIMD width the boxes are tested at - on by default when the
+    // CPU has AVX
+    void SetUseAVX(bool enabled);
+
+    // stats from the last call to Cull()
+    unsigned int GetTestedCount();
+    unsigned int GetCulledCount();
+    unsigned int GetVisibleCount();
+    unsigned int GetRefreshedCount();   // bounds set since BeginUpdate()
+    float GetLastCullTime();            // refreshes and test together
+
+private:
+    size_t count;
+    bool useAVX;
+
+    // world space bounds, padded to a multiple of 8
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+
+    // what Cull() compacts into, sized by Resize() so a frame never
+    // has to allocate or clear it
+    std::vector<unsigned int> compacted;
+
+    unsigned int testedCount;
+    unsigned int culledCount;
+    unsigned int visibleCount;
+    unsigned int refreshedCount;
+    float lastCullTime;
+
+    // set by BeginUpdate(), until the Cull() that ends the frame
+    bool updating;
+    std::chrono::high_resolution_clock::time_point updateStart;
+};
+
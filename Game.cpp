@@ -5,6 +5,16 @@
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
 // For the DirectX Math library
 using namespace DirectX;
 
@@ -23,6 +33,8 @@ Game::Game(HINSTANCE hInstance)
 		1280,			   // Width of the window's client area
 		720,			   // Height of the window's client area
 		true)			   // Show extra stats (fps) in title bar?
+	, lightGridCells(DXGI_FORMAT_R32G32_UINT, sizeof(LightGridCell))
+	, lightIndexBuffer(DXGI_FORMAT_R32_UINT, sizeof(unsigned int))
 {
 
 #if defined(DEBUG) || defined(_DEBUG)
@@ -38,10 +50,33 @@ Game::Game(HINSTANCE hInstance)
 
 	ppVS = 0;
 	ppPS = 0;
+	textureArrayPS = 0;
+	pixelShaderVariants = 0;
+	textureArrayVariants = 0;
+	frameVariantBits = 0;
+	texturePacker = 0;
+	enableTextureArrays = true;
+	gpuCullCS = 0;
+	gpuCuller = 0;
+	enableGpuCulling = false;
+	gpuCullingActive = false;
+	frameGraph = 0;
+	sceneColorTarget = 0;
+	sceneNormalsTarget = 0;
+	sceneDepthTarget = 0;
+	shadowMapTarget = 0;
+	enableDepthPrepass = true;
+	lightCulling = LIGHT_CULLING_CLUSTERED;
+	depthPrepassActive = false;
+	depthPrepassOverdraw = 0.0f;
+	depthPrepassTriangles = 0;
 
 	controlMode = 0;
-	prevTab = false;
-	prevV = false;
+	playingCameraPath = false;
+	cameraPathTime = 0.0f;
+	quitAfterRun = false;
+	enableOcclusionCulling = true;
+	cameraCell = -1;
 	dirLightDirection = XMFLOAT3(0.0f, -1.0f, 0.0f);
 	pointLightPosition = XMFLOAT3(0.0f, 5.0f, 0.0f);
 	pointLightRange = 20.0f;
@@ -53,11 +88,28 @@ Game::Game(HINSTANCE hInstance)
 	shadowMapSize = 0;
 	shadowViewMatrix = {};
 	shadowProjectionMatrix = {};
+	pixelFrameData = {};
+	vertexFrameData = {};
 	shadowVS = 0;
 	enableShadows = true;
 
 	mainCamera = 0;
 	skyBox = 0;
+	renderDevice = 0;
+	stateCache = 0;
+	stateObjects = 0;
+	commandRecorder = 0;
+	frameCapture = 0;
+	captureDevice = 0;
+	captureCache = 0;
+	captureFramesLeft = 0;
+	enableParallelRecording = true;
+	shadowStats = {};
+	frameQueueStats = {};
+	memset(frameStateCallsIssued, 0, sizeof(frameStateCallsIssued));
+	memset(frameStateCallsFiltered, 0, sizeof(frameStateCallsFiltered));
+	frameConstantBytes = 0;
+	frameConstantAllocations = 0;
 }
 
 // --------------------------------------------------------
@@ -97,6 +149,23 @@ Game::~Game()
 	if (ppVS) { delete ppVS; }
 	if (ppPS) { delete ppPS; }
 	if (shadowVS) { delete shadowVS; }
+	if (pixelShaderVariants) { delete pixelShaderVariants; }
+	if (textureArrayVariants) { delete textureArrayVariants; }
+	if (textureArrayPS) { delete textureArrayPS; }
+	if (texturePacker) { delete texturePacker; }
+	if (gpuCullCS) { delete gpuCullCS; }
+	if (gpuCuller) { delete gpuCuller; }
+	if (frameGraph) { delete frameGraph; }
+
+	ISimpleShader::SetStateCache(0);
+	if (commandRecorder) { delete commandRecorder; }
+	if (frameCapture) { delete frameCapture; }
+	if (captureCache) { delete captureCache; }
+	if (captureDevice) { delete captureDevice; }
+	if (stateCache) { delete stateCache; }
+	if (renderDevice) { delete renderDevice; }
+	ISimpleShader::SetStateObjectCache(0);
+	if (stateObjects) { delete stateObjects; }
 }
 
 // --------------------------------------------------------
@@ -108,47 +177,85 @@ void Game::Init()
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
+	renderDevice = new D3D11RenderDevice(context.Get());
+	renderDevice->EnableConstantRing(device.Get());
+	stateCache = new StateCache(renderDevice);
+	ISimpleShader::SetStateCache(stateCache);
+	stateObjects = new StateObjectCache(device.Get());
+	ISimpleShader::SetStateObjectCache(stateObjects);
+	commandRecorder = new CommandRecorder(device.Get());
+	enableParallelRecording = commandRecorder->IsValid();
 	LoadShaders();
+	ResolveShaderHandles();
+
+	// frame capture needs the shaders' bytecode to make a trace replayable
+	captureDevice = new RecordingRenderDevice(renderDevice);
+	captureCache = new StateCache(captureDevice);
+	frameCapture = new FrameCapture(device.Get(), context.Get());
+	frameCapture->RegisterShader(vertexShader);
+	frameCapture->RegisterShader(pixelShader);
+	frameCapture->RegisterShader(skyVertexShader);
+	frameCapture->RegisterShader(skyPixelShader);
+	frameCapture->RegisterShader(ppVS);
+	frameCapture->RegisterShader(ppPS);
+	frameCapture->RegisterShader(shadowVS);
+	frameCapture->RegisterShader(textureArrayPS);
 	LoadTextures();
 	CreateBasicGeometry();
+	PlaceEntities();
+
+	// pack what can share texture arrays before the draw ids are made
+	texturePacker = new TexturePacker(device.Get(), context.Get(), textureArrayPS);
+	texturePacker->Pack(materials);
+	LoadShaderVariants();
+	BuildEntityDrawIds();
+	gpuCuller = new GpuCuller(device.Get(), gpuCullCS);
+	CreateOccluders();
+	CreatePVS();
 
 	// create skyBox - can use either .dds or 6 texture method
-	skyBox = new SkyBox(meshes[1], sampler, device, GetFullPathTo_Wide(L"../../Assets/Textures/SkyBox/SunnyCubeMap.dds"), skyVertexShader, skyPixelShader);
+	skyBox = new SkyBox(meshes[1], sampler, device, stateObjects, GetFullPathTo_Wide(L"../../Assets/Textures/SkyBox/SunnyCubeMap.dds"), skyVertexShader, skyPixelShader);
 
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
 	// Essentially: "What kind of shape should the GPU draw with our data?"
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-	// create cbuffer for vertex shader
-	// Get size as the next multiple of 16 (don't hardcode the number here!)
-	unsigned int size = sizeof(VertexShaderExternalData);
-	size = (size + 15) / 16 * 16; // This will work even if your struct size changes
-
-	// Describe the constant buffer
-	D3D11_BUFFER_DESC cbDesc = {};	// Sets struct to all zeroes
-	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	cbDesc.ByteWidth = size; // Must be a multiple of 16
-	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// initialize the lights
 	GenerateLights();
 
 	// initialize the shadowmap
 	InitializeShadowMap();
-
-	// create the post processing resources
-	ResizePostProcessResources();
+	frameGraph = new FrameGraph(device.Get());
+	InitializeDepthPrepass();
 
 	// Set up sprite batch and sprite font
 	spriteBatch = std::make_unique<SpriteBatch>(context.Get());
+	if (commandRecorder->IsValid())
+		recorderSpriteBatch = std::make_unique<SpriteBatch>(commandRecorder->GetContext(0));
 	spriteFont = std::make_unique<SpriteFont>(device.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/arial.spritefont").c_str());
 	spriteFontLarge = std::make_unique<SpriteFont>(device.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/arial72.spritefont").c_str());
+	CreateUIStates();
+
+	// everything drawn from here on uses states made above
+	stateObjects->Freeze();
+	printf("State objects: %u created while loading, %u requests shared one\n", stateObjects->GetObjectCount(), stateObjects->GetSharedCount());
 
 	// create the camera
 	mainCamera = new Camera(0.0f, -2.0f, 4.5f, (float)this->width / this->height, 0.25 * XM_PI, 0.01f, 100.0f, 6.0f, 10.0f);
 	mainCamera->GetTransform()->SetPitchYawRoll(0.05f, XM_PI, 0.0f);
+
+	// perf runs can be started from the command line:
+	//  -replay <file>  plays back an input log (frame traces are -tracereplay)
+	//  -path <file>    flies the camera along a path file
+	//  -quit           exits once the run is over
+	for (int i = 1; i < __argc; i++)
+	{
+		std::string arg = __argv[i];
+		if (arg == "-replay" && i + 1 < __argc) { runReplayFile = __argv[++i]; }
+		else if (arg == "-path" && i + 1 < __argc) { runPathFile = __argv[++i]; }
+		else if (arg == "-quit") { quitAfterRun = true; }
+	}
 }
 
 // --------------------------------------------------------
@@ -161,6 +268,18 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// the post-build step packs every shader with its reflection, so
+	// they can all be created at once without reading .cso files
+	ShaderPack pack;
+	if (pack.Open(GetFullPathTo_Wide(L"Shaders.pack")) && LoadPackedShaders(pack))
+	{
+		auto end = std::chrono::high_resolution_clock::now();
+		printf("Shaders: created from Shaders.pack in %.2f ms\n", std::chrono::duration<float, std::milli>(end - start).count());
+		return;
+	}
+
 	vertexShader = new SimpleVertexShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"VertexShader.cso").c_str());
 	pixelShader = new SimplePixelShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"PixelShader.cso").c_str());
 
@@ -171,6 +290,149 @@ void Game::LoadShaders()
 	ppPS = new SimplePixelShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"PostProcessPS.cso").c_str());
 
     shadowVS = new SimpleVertexShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"ShadowMapVS.cso").c_str());
+	textureArrayPS = new SimplePixelShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"TextureArrayPS.cso").c_str());
+	gpuCullCS = new SimpleComputeShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"GpuCullCS.cso").c_str());
+
+	auto end = std::chrono::high_resolution_clock::now();
+	printf("Shaders: loaded from .cso files in %.2f ms\n", std::chrono::duration<float, std::milli>(end - start).count());
+}
+
+// --------------------------------------------------------
+// Creates every shader from a shader pack, spread over a few
+// threads - the device is free threaded and each shader only
+// reads the mapped pack. Returns false without creating any
+// if the pack is missing one, so the .cso files are used
+// --------------------------------------------------------
+bool Game::LoadPackedShaders(const ShaderPack& pack)
+{
+	const char* names[] = { "VertexShader", "PixelShader", "SkyVS", "SkyPS", "PostProcessVS",
+		"PostProcessPS", "ShadowMapVS", "TextureArrayPS", "GpuCullCS" };
+	for (const char* name : names)
+	{
+		if (pack.FindShader(name) < 0)
+			return false;
+	}
+
+	ID3D11Device* device = this->device.Get();
+	ID3D11DeviceContext* context = this->context.Get();
+	std::function<void()> loads[] = {
+		[&]() { vertexShader = new SimpleVertexShader(device, context, &pack, "VertexShader"); },
+		[&]() { pixelShader = new SimplePixelShader(device, context, &pack, "PixelShader"); },
+		[&]() { skyVertexShader = new SimpleVertexShader(device, context, &pack, "SkyVS"); },
+		[&]() { skyPixelShader = new SimplePixelShader(device, context, &pack, "SkyPS"); },
+		[&]() { ppVS = new SimpleVertexShader(device, context, &pack, "PostProcessVS"); },
+		[&]() { ppPS = new SimplePixelShader(device, context, &pack, "PostProcessPS"); },
+		[&]() { shadowVS = new SimpleVertexShader(device, context, &pack, "ShadowMapVS"); },
+		[&]() { textureArrayPS = new SimplePixelShader(device, context, &pack, "TextureArrayPS"); },
+		[&]() { gpuCullCS = new SimpleComputeShader(device, context, &pack, "GpuCullCS"); } };
+	const unsigned int loadCount = sizeof(loads) / sizeof(loads[0]);
+
+	// each thread takes the next shader until they're all done
+	std::atomic<unsigned int> next(0);
+	auto worker = [&]()
+	{
+		for (unsigned int i = next++; i < loadCount; i = next++)
+			loads[i]();
+	};
+	unsigned int threadCount = std::min(loadCount, std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::thread> threads;
+	for (unsigned int t = 1; t < threadCount; t++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+	return true;
+}
+
+// --------------------------------------------------------
+// Resolves the names Game binds every frame into handles
+// --------------------------------------------------------
+void Game::ResolveShaderHandles()
+{
+	ppPixelsHandle = ppPS->GetShaderResourceViewHandle("pixels");
+	ppNormalsHandle = ppPS->GetShaderResourceViewHandle("normals");
+	ppDepthHandle = ppPS->GetShaderResourceViewHandle("depth");
+	ppSamplerHandle = ppPS->GetSamplerHandle("samplerOptions");
+
+	toonShaderHandles.clear();
+	toonShaderHandles.push_back(GetToonShaderHandles(pixelShader));
+	toonShaderHandles.push_back(GetToonShaderHandles(textureArrayPS));
+}
+
+// --------------------------------------------------------
+// Creates the opaque pixel shaders' variants for the
+// materials there are, from the cache -buildvariants wrote
+// after the build - without one, every draw falls back to
+// the shaders LoadShaders() made
+// --------------------------------------------------------
+void Game::LoadShaderVariants()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::wstring cache = GetFullPathTo_Wide(L"ShaderCache");
+	pixelShaderVariants = new ShaderVariants(device.Get(), context.Get(), pixelShader);
+	textureArrayVariants = new ShaderVariants(device.Get(), context.Get(), textureArrayPS);
+	if (!pixelShaderVariants->Open(cache, L"PixelShader") || !textureArrayVariants->Open(cache, L"TextureArrayPS"))
+	{
+		printf("Shader variants: no cache, branching in the base shaders\n");
+		return;
+	}
+
+	unsigned int count = 0;
+	for (Material* mat : materials)
+	{
+		unsigned int bits = mat->GetShaderVariantBits();
+		count += pixelShaderVariants->Prewarm(bits);
+		count += textureArrayVariants->Prewarm(bits);
+	}
+
+	// they're drawn like the base shaders, so they're set up like them
+	ShaderVariants* sets[] = { pixelShaderVariants, textureArrayVariants };
+	for (ShaderVariants* set : sets)
+	{
+		for (SimplePixelShader* variant : set->GetCreated())
+		{
+			toonShaderHandles.push_back(GetToonShaderHandles(variant));
+			frameCapture->RegisterShader(variant);
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	printf("Shader variants: %u created in %.2f ms\n", count, std::chrono::duration<float, std::milli>(end - start).count());
+}
+
+// --------------------------------------------------------
+// The opaque pixel shader a material is drawn with - the
+// variant for its keywords and the frame's
+// --------------------------------------------------------
+SimplePixelShader* Game::GetOpaquePixelShader(Material* mat, int arrayGroup, unsigned int frameBits)
+{
+	unsigned int mask = mat->GetShaderVariantBits() | frameBits;
+	return arrayGroup >= 0 ? textureArrayVariants->Get(mask) : pixelShaderVariants->Get(mask);
+}
+
+// --------------------------------------------------------
+// Gets a toon pixel shader's handles - a shader that wasn't
+// resolved up front is resolved on the spot, without being
+// kept, since the chunks call this from several threads
+// --------------------------------------------------------
+ToonShaderHandles Game::GetToonShaderHandles(SimplePixelShader* shader)
+{
+	for (size_t i = 0; i < toonShaderHandles.size(); i++)
+	{
+		if (toonShaderHandles[i].shader == shader)
+			return toonShaderHandles[i];
+	}
+
+	ToonShaderHandles handles;
+	handles.shader = shader;
+	handles.clampSampler = shader->GetSamplerHandle("ClampSampler");
+	handles.shadowSampler = shader->GetSamplerHandle("shadowSampler");
+	handles.rampMap = shader->GetShaderResourceViewHandle("RampMap");
+	handles.specularRampMap = shader->GetShaderResourceViewHandle("specularRampMap");
+	handles.shadowMap = shader->GetShaderResourceViewHandle("shadowMap");
+	handles.lightGrid = shader->GetShaderResourceViewHandle("LightGrid");
+	handles.lightIndices = shader->GetShaderResourceViewHandle("LightIndices");
+	return handles;
 }
 
 void Game::LoadBasicTexture(const wchar_t* file, ID3D11ShaderResourceView** textureSRV)
@@ -267,13 +529,13 @@ void Game::LoadTextures()
 	sDesc.Filter = D3D11_FILTER_ANISOTROPIC;
 	sDesc.MaxAnisotropy = 1;
 	sDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	device->CreateSamplerState(&sDesc, sampler.GetAddressOf());
+	sampler = stateObjects->GetSamplerState(sDesc);
 
 	// Make a second sampler that's uses clamp addressing
 	sDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
 	sDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
 	sDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-	device->CreateSamplerState(&sDesc, clampSampler.GetAddressOf());
+	clampSampler = stateObjects->GetSamplerState(sDesc);
 }
 
 void Game::CreateBasicGeometry()
@@ -309,6 +571,8 @@ void Game::CreateBasicGeometry()
 	materials.push_back(matCoffeeTable);
 	materials.push_back(matCradle);
 	materials.push_back(matSword);
+	for (Material* material : materials)
+		material->CreateBindings(device.Get());
 
 	// make sphere entitites with PBR textures
 	entities.push_back(new Entity(meshes[1], matCarpet));
@@ -324,6 +588,156 @@ void Game::CreateBasicGeometry()
 	entities.push_back(new Entity(meshes[11], matSword));
 }
 
+// --------------------------------------------------------
+// Positions the (static) room - done once so the culling
+// structures built from it stay valid
+// --------------------------------------------------------
+void Game::PlaceEntities()
+{
+	// floor
+	entities[0]->GetTransform()->SetPosition(0.0f, -5.0f, 0.0f);
+	entities[0]->GetTransform()->SetScale(15.0f, 1.0f, 15.f);
+
+	// front wall
+	entities[1]->GetTransform()->SetPosition(0.0f, -0.5f, -8.0f);
+	entities[1]->GetTransform()->SetScale(15.0f, 10.0f, 1.0f);
+
+	// back wall
+	entities[2]->GetTransform()->SetPosition(0.0f, -0.5f, 8.0f);
+	entities[2]->GetTransform()->SetScale(15.0f, 10.0f, 1.0f);
+
+	// left wall
+	entities[3]->GetTransform()->SetPosition(-8.0f, -0.5f, 0.0f);
+	entities[3]->GetTransform()->SetScale(1.0f, 10.0f, 17.0f);
+
+	// right wall
+	entities[4]->GetTransform()->SetPosition(8.0f, -0.5f, 0.0f);
+	entities[4]->GetTransform()->SetScale(1.0f, 10.0f, 17.0f);
+
+	// tv table
+	entities[5]->GetTransform()->SetScale(0.02f, 0.02f, 0.02f);
+	entities[5]->GetTransform()->SetPosition(0.0f, -4.5f, -4.5f);
+
+	// sofa
+	entities[6]->GetTransform()->SetScale(0.03f, 0.03f, 0.03f);
+	entities[6]->GetTransform()->SetPosition(0.0f, -4.5f, 4.5f);
+
+	// tv
+	entities[7]->GetTransform()->SetScale(5.0f, 5.0f, 5.0f);
+	entities[7]->GetTransform()->SetPitchYawRoll(0.0f, XM_PI, 0.0f);
+	entities[7]->GetTransform()->SetPosition(0.0f, -2.85f, -4.5f);
+
+	// coffee table
+	entities[8]->GetTransform()->SetScale(1.5f, 1.5f, 1.5f);
+	entities[8]->GetTransform()->SetPosition(0.0f, -4.6f, 0.0f);
+
+	// newton's cradle
+	entities[9]->GetTransform()->SetScale(0.05f, 0.05f, 0.05f);
+	entities[9]->GetTransform()->SetPosition(0.0f, -2.95f, 0.0f);
+
+	// claymore sword
+	entities[10]->GetTransform()->SetScale(0.05f, 0.05f, 0.05f);
+	entities[10]->GetTransform()->SetPosition(1.0f, -3.76f, 0.0f);
+	entities[10]->GetTransform()->SetPitchYawRoll(-0.01f, XM_PI/4, 0.0f);
+}
+
+// --------------------------------------------------------
+// Gives every entity the small shader/material/mesh ids
+// its render queue sort keys are built from
+// - with texture arrays on, a packed material's id is its
+//   array group's, so its entities batch with the group's
+// --------------------------------------------------------
+void Game::BuildEntityDrawIds()
+{
+	std::vector<std::pair<SimpleVertexShader*, SimplePixelShader*>> shaderPairs;
+
+	entityDrawIds.resize(entities.size());
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		Material* mat = entities[i]->GetMaterial();
+		EntityDrawIds& ids = entityDrawIds[i];
+
+		int arrayGroup = enableTextureArrays ? mat->GetTextureArrayGroup() : -1;
+		// the frame's keywords change every material's variant the
+		// same way, so they don't change which entities share one
+		SimplePixelShader* ps = GetOpaquePixelShader(mat, arrayGroup, 0);
+		std::pair<SimpleVertexShader*, SimplePixelShader*> shaders(mat->GetVertexShader(), ps);
+		ids.shader = (unsigned int)(std::find(shaderPairs.begin(), shaderPairs.end(), shaders) - shaderPairs.begin());
+		if (ids.shader == shaderPairs.size())
+			shaderPairs.push_back(shaders);
+
+		ids.material = arrayGroup >= 0 ?
+			(unsigned int)(materials.size() + arrayGroup) :
+			(unsigned int)(std::find(materials.begin(), materials.end(), mat) - materials.begin());
+		ids.mesh = (unsigned int)(std::find(meshes.begin(), meshes.end(), entities[i]->GetMesh()) - meshes.begin());
+	}
+}
+
+void Game::CreateOccluders()
+{
+	// the walls are already just boxes, so they can be used as is
+	const std::vector<XMFLOAT3>& cubePositions = meshes[1]->GetPositions();
+	const std::vector<unsigned int>& cubeIndices = meshes[1]->GetIndices();
+	int wallOccluder = occlusionCuller.AddOccluder(cubePositions.data(), cubePositions.size(), cubeIndices.data(), cubeIndices.size());
+	for (unsigned int i = 1; i <= 4; i++)
+	{
+		occluderEntities.push_back(i);
+		occluderIds.push_back(wallOccluder);
+	}
+
+	// the sofa and tv are too dense to rasterize every frame,
+	// so they get a few boxes that fit inside them instead
+	unsigned int proxyEntities[] = { 6, 7 };
+	for (unsigned int e : proxyEntities)
+	{
+		std::vector<XMFLOAT3> proxyPositions;
+		std::vector<unsigned int> proxyIndices;
+		Mesh* mesh = entities[e]->GetMesh();
+		OcclusionCuller::BuildProxy(
+			mesh->GetPositions().data(), mesh->GetPositions().size(),
+			mesh->GetIndices().data(), mesh->GetIndices().size(),
+			24, proxyPositions, proxyIndices);
+		if (proxyIndices.empty())
+			continue;
+
+		occluderEntities.push_back(e);
+		occluderIds.push_back(occlusionCuller.AddOccluder(proxyPositions.data(), proxyPositions.size(), proxyIndices.data(), proxyIndices.size()));
+	}
+}
+
+void Game::CreatePVS()
+{
+	// world space bounds of everything, the same ones culling uses
+	TrackEntityBounds();
+
+	// a coarse grid over the room and a band of space around it
+	pvs.GenerateGridCells(XMFLOAT3(-12.0f, -6.0f, -12.0f), XMFLOAT3(12.0f, 6.0f, 12.0f), 6, 2, 6);
+
+	// the floor and walls are the only things solid enough to block a view
+	for (unsigned int i = 0; i <= 4; i++)
+	{
+		XMFLOAT3 center, extents;
+		frustumCuller.GetBounds(i, center, extents);
+		pvs.AddOccluder(center, extents);
+	}
+
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		XMFLOAT3 center, extents;
+		frustumCuller.GetBounds(i, center, extents);
+		pvs.AddEntity(center, extents);
+	}
+	pvs.DerivePortals();
+
+	// only rebuild when the saved set doesn't match the scene anymore
+	std::string pvsPath = GetFullPathTo("room.pvs");
+	if (!pvs.Load(pvsPath.c_str()))
+	{
+		pvs.Build();
+		pvs.Save(pvsPath.c_str());
+	}
+}
+
 void Game::GenerateLights()
 {
 	// create directional lights
@@ -371,47 +785,8 @@ void Game::InitializeShadowMap()
 	// In general, this should be a power of 2
 	shadowMapSize = 1024;
 
-	// Create an underlying texture resource for the shadow map
-	// First, describe what we want
-	D3D11_TEXTURE2D_DESC shadowDesc = {};
-	shadowDesc.Width = shadowMapSize;
-	shadowDesc.Height = shadowMapSize;
-	shadowDesc.ArraySize = 1; // Not an array
-	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE; // We'll bind as one or the other
-	shadowDesc.CPUAccessFlags = 0; // Not reading back in C++
-	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS; // All 32 bits in a single channel (number)
-	shadowDesc.MipLevels = 1;
-	shadowDesc.MiscFlags = 0;
-	shadowDesc.SampleDesc.Count = 1;
-	shadowDesc.SampleDesc.Quality = 0;
-	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	// Create the texture itself
-	ID3D11Texture2D* shadowTexture;
-	device->CreateTexture2D(&shadowDesc, 0, &shadowTexture);
-	if (!shadowTexture)
-		return;
-
-	// Create the depth/stencil view for the shadow map
-	D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-	dsvDesc.Flags = 0;
-	dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	dsvDesc.Texture2D.MipSlice = 0; // Render into the first mip
-	device->CreateDepthStencilView(shadowTexture, &dsvDesc, shadowDSV.GetAddressOf());
-
-	// Create the shader resource view for the shadow map
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	device->CreateShaderResourceView(shadowTexture, &srvDesc, shadowSRV.GetAddressOf());
-
-	// Now that we have both views, we can release the
-	// reference to the texture itself!
-	shadowTexture->Release();
-
+	// the shadow map texture itself comes from the frame graph,
+	// declared every frame in BuildFrameGraph()
 
 	// Create the rasterizer state to add bias to depth values
 	// when creating the shadow map each frame
@@ -422,7 +797,7 @@ void Game::InitializeShadowMap()
 	shRast.DepthBias = 1000; // 1000 units of precision
 	shRast.DepthBiasClamp = 0.0f;
 	shRast.SlopeScaledDepthBias = 1.0f;
-	device->CreateRasterizerState(&shRast, shadowRasterizer.GetAddressOf());
+	shadowRasterizer = stateObjects->GetRasterizerState(shRast);
 
 
 	// Create a sampler state for sampling the shadow map with
@@ -437,7 +812,7 @@ void Game::InitializeShadowMap()
 	shSamp.BorderColor[3] = 1.0f;
 	shSamp.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR; // COMPARISON filter!  For use with comparison samplers!
 	shSamp.ComparisonFunc = D3D11_COMPARISON_LESS;
-	device->CreateSamplerState(&shSamp, shadowSampler.GetAddressOf());
+	shadowSampler = stateObjects->GetSamplerState(shSamp);
 
 
 	// Update the Shadow Map View matrix
@@ -451,55 +826,17 @@ void Game::InitializeShadowMap()
 	XMStoreFloat4x4(&shadowProjectionMatrix, shProj);
 }
 
-void Game::ResizePostProcessResources()
-{
-	D3D11_TEXTURE2D_DESC textureDesc = {};
-	textureDesc.Width = width;
-	textureDesc.Height = height;
-	textureDesc.ArraySize = 1;
-	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // Will render to it and sample from it!
-	textureDesc.CPUAccessFlags = 0;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	textureDesc.MipLevels = 1;
-	textureDesc.MiscFlags = 0;
-	textureDesc.SampleDesc.Count = 1;
-	textureDesc.SampleDesc.Quality = 0;
-	textureDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	// Create the color and normals textures
-	ID3D11Texture2D* ppTexture;
-	device->CreateTexture2D(&textureDesc, 0, &ppTexture);
-	if (!ppTexture)
-		return;
-
-	// Adjust the description for scene normals
-	textureDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-	ID3D11Texture2D* sceneNormalsTexture;
-	device->CreateTexture2D(&textureDesc, 0, &sceneNormalsTexture);
-	if (!sceneNormalsTexture)
-		return;
-
-	// Adjust the description for the scene depths
-	textureDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	ID3D11Texture2D* sceneDepthsTexture;
-	device->CreateTexture2D(&textureDesc, 0, &sceneDepthsTexture);
-	if (!sceneDepthsTexture)
-		return;
-
-	// Create the Render Target Views
-	device->CreateRenderTargetView(ppTexture, 0, ppRTV.ReleaseAndGetAddressOf());
-	device->CreateRenderTargetView(sceneNormalsTexture, 0, sceneNormalsRTV.ReleaseAndGetAddressOf());
-	device->CreateRenderTargetView(sceneDepthsTexture, 0, sceneDepthRTV.ReleaseAndGetAddressOf());
-
-	// Create the Shader Resource Views
-	device->CreateShaderResourceView(ppTexture, 0, ppSRV.ReleaseAndGetAddressOf());
-	device->CreateShaderResourceView(sceneNormalsTexture, 0, sceneNormalsSRV.ReleaseAndGetAddressOf());
-	device->CreateShaderResourceView(sceneDepthsTexture, 0, sceneDepthSRV.ReleaseAndGetAddressOf());
-
-	// Release the extra texture references
-	ppTexture->Release();
-	sceneNormalsTexture->Release();
-	sceneDepthsTexture->Release();
+// --------------------------------------------------------
+// The main pass's depth state when the pre-pass already
+// laid down the depth - only the front most surface passes
+// --------------------------------------------------------
+void Game::InitializeDepthPrepass()
+{
+	D3D11_DEPTH_STENCIL_DESC dsd = {};
+	dsd.DepthEnable = true;
+	dsd.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	dsd.DepthFunc = D3D11_COMPARISON_EQUAL;
+	depthEqualState = stateObjects->GetDepthStencilState(dsd);
 }
 
 void Game::LightControl(float dt)
@@ -508,12 +845,12 @@ void Game::LightControl(float dt)
 	{
 	case CONTROL_MODE_MOVE_DIRLIGHT:
 		// direction
-		if ((GetAsyncKeyState('W') & 0x8000) && (dirLightDirection.z <= 1)) { dirLightDirection.z += dt * 0.1f; }
-		if ((GetAsyncKeyState('S') & 0x8000) && (dirLightDirection.z >= -1)) { dirLightDirection.z -= dt * 0.1f; }
-		if ((GetAsyncKeyState('A') & 0x8000) && (dirLightDirection.x >= -1)) { dirLightDirection.x -= dt * 0.1f; }
-		if ((GetAsyncKeyState('D') & 0x8000) && (dirLightDirection.x <= 1)) { dirLightDirection.x += dt * 0.1f; }
-		if ((GetAsyncKeyState('Q') & 0x8000) && (dirLightDirection.y <= 1)) { dirLightDirection.y += dt * 0.1f; }
-		if ((GetAsyncKeyState('E') & 0x8000) && (dirLightDirection.y >= -1)) { dirLightDirection.y -= dt * 0.1f; }
+		if (input.KeyDown('W') && (dirLightDirection.z <= 1)) { dirLightDirection.z += dt * 0.1f; }
+		if (input.KeyDown('S') && (dirLightDirection.z >= -1)) { dirLightDirection.z -= dt * 0.1f; }
+		if (input.KeyDown('A') && (dirLightDirection.x >= -1)) { dirLightDirection.x -= dt * 0.1f; }
+		if (input.KeyDown('D') && (dirLightDirection.x <= 1)) { dirLightDirection.x += dt * 0.1f; }
+		if (input.KeyDown('Q') && (dirLightDirection.y <= 1)) { dirLightDirection.y += dt * 0.1f; }
+		if (input.KeyDown('E') && (dirLightDirection.y >= -1)) { dirLightDirection.y -= dt * 0.1f; }
 
 		// since directional light, update shadow map
 		UpdateShadowMapView();
@@ -521,42 +858,42 @@ void Game::LightControl(float dt)
         break;
     case CONTROL_MODE_MOVE_POINTLIGHT:
 		// position
-        if ((GetAsyncKeyState('W') & 0x8000) && (pointLightPosition.z <= 20)) { pointLightPosition.z += dt * 1.0f; }
-        if ((GetAsyncKeyState('S') & 0x8000) && (pointLightPosition.z >= -20)) { pointLightPosition.z -= dt * 1.0f; }
-        if ((GetAsyncKeyState('A') & 0x8000) && (pointLightPosition.x >= -20)) { pointLightPosition.x -= dt * 1.0f; }
-        if ((GetAsyncKeyState('D') & 0x8000) && (pointLightPosition.x <= 20)) { pointLightPosition.x += dt * 1.0f; }
-        if ((GetAsyncKeyState('Q') & 0x8000) && (pointLightPosition.y <= 20)) { pointLightPosition.y += dt * 1.0f; }
-		if ((GetAsyncKeyState('E') & 0x8000) && (pointLightPosition.y >= -20)) { pointLightPosition.y -= dt * 1.0f; }
+        if (input.KeyDown('W') && (pointLightPosition.z <= 20)) { pointLightPosition.z += dt * 1.0f; }
+        if (input.KeyDown('S') && (pointLightPosition.z >= -20)) { pointLightPosition.z -= dt * 1.0f; }
+        if (input.KeyDown('A') && (pointLightPosition.x >= -20)) { pointLightPosition.x -= dt * 1.0f; }
+        if (input.KeyDown('D') && (pointLightPosition.x <= 20)) { pointLightPosition.x += dt * 1.0f; }
+        if (input.KeyDown('Q') && (pointLightPosition.y <= 20)) { pointLightPosition.y += dt * 1.0f; }
+		if (input.KeyDown('E') && (pointLightPosition.y >= -20)) { pointLightPosition.y -= dt * 1.0f; }
 
 		// range
-		if ((GetAsyncKeyState(VK_UP) & 0x8000) && (pointLightRange < 100)) { pointLightRange += dt * 5.0f; }
-		if ((GetAsyncKeyState(VK_DOWN) & 0x8000) && (pointLightRange > 0)) { pointLightRange -= dt * 5.0f; }
+		if (input.KeyDown(VK_UP) && (pointLightRange < 100)) { pointLightRange += dt * 5.0f; }
+		if (input.KeyDown(VK_DOWN) && (pointLightRange > 0)) { pointLightRange -= dt * 5.0f; }
 
         break;
     case CONTROL_MODE_MOVE_SPOTLIGHT:
 		// position
-        if ((GetAsyncKeyState('W') & 0x8000) && (spotLightPosition.z <= 20)) { spotLightPosition.z += dt * 1.0f; }
-        if ((GetAsyncKeyState('S') & 0x8000) && (spotLightPosition.z >= -20)) { spotLightPosition.z -= dt * 1.0f; }
-        if ((GetAsyncKeyState('A') & 0x8000) && (spotLightPosition.x >= -20)) { spotLightPosition.x -= dt * 1.0f; }
-        if ((GetAsyncKeyState('D') & 0x8000) && (spotLightPosition.x <= 20)) { spotLightPosition.x += dt * 1.0f; }
-        if ((GetAsyncKeyState('Q') & 0x8000) && (spotLightPosition.y <= 20)) { spotLightPosition.y += dt * 1.0f; }
-        if ((GetAsyncKeyState('E') & 0x8000) && (spotLightPosition.y >= -20)) { spotLightPosition.y -= dt * 1.0f; }
+        if (input.KeyDown('W') && (spotLightPosition.z <= 20)) { spotLightPosition.z += dt * 1.0f; }
+        if (input.KeyDown('S') && (spotLightPosition.z >= -20)) { spotLightPosition.z -= dt * 1.0f; }
+        if (input.KeyDown('A') && (spotLightPosition.x >= -20)) { spotLightPosition.x -= dt * 1.0f; }
+        if (input.KeyDown('D') && (spotLightPosition.x <= 20)) { spotLightPosition.x += dt * 1.0f; }
+        if (input.KeyDown('Q') && (spotLightPosition.y <= 20)) { spotLightPosition.y += dt * 1.0f; }
+        if (input.KeyDown('E') && (spotLightPosition.y >= -20)) { spotLightPosition.y -= dt * 1.0f; }
 
 		// direction
-		if ((GetAsyncKeyState('I') & 0x8000) && (spotLightDirection.z <= 1)) {	spotLightDirection.z += dt * 0.1f; }
-		if ((GetAsyncKeyState('K') & 0x8000) && (spotLightDirection.z >= -1)) { spotLightDirection.z -= dt * 0.1f; }
-		if ((GetAsyncKeyState('J') & 0x8000) && (spotLightDirection.x >= -1)) { spotLightDirection.x -= dt * 0.1f; }
-		if ((GetAsyncKeyState('L') & 0x8000) && (spotLightDirection.x <= 1)) {	spotLightDirection.x += dt * 0.1f; }
-		if ((GetAsyncKeyState('U') & 0x8000) && (spotLightDirection.y <= 1)) {	spotLightDirection.y += dt * 0.1f; }
-		if ((GetAsyncKeyState('O') & 0x8000) && (spotLightDirection.y >= -1)) { spotLightDirection.y -= dt * 0.1f; }
+		if (input.KeyDown('I') && (spotLightDirection.z <= 1)) {	spotLightDirection.z += dt * 0.1f; }
+		if (input.KeyDown('K') && (spotLightDirection.z >= -1)) { spotLightDirection.z -= dt * 0.1f; }
+		if (input.KeyDown('J') && (spotLightDirection.x >= -1)) { spotLightDirection.x -= dt * 0.1f; }
+		if (input.KeyDown('L') && (spotLightDirection.x <= 1)) {	spotLightDirection.x += dt * 0.1f; }
+		if (input.KeyDown('U') && (spotLightDirection.y <= 1)) {	spotLightDirection.y += dt * 0.1f; }
+		if (input.KeyDown('O') && (spotLightDirection.y >= -1)) { spotLightDirection.y -= dt * 0.1f; }
 
 		// range
-		if ((GetAsyncKeyState(VK_UP) & 0x8000) && (spotLightRange < 100)) { spotLightRange += dt * 5.0f; }
-		if ((GetAsyncKeyState(VK_DOWN) & 0x8000) && (spotLightRange > 0)) { spotLightRange -= dt * 5.0f; }
+		if (input.KeyDown(VK_UP) && (spotLightRange < 100)) { spotLightRange += dt * 5.0f; }
+		if (input.KeyDown(VK_DOWN) && (spotLightRange > 0)) { spotLightRange -= dt * 5.0f; }
 
 		// falloff
-		if ((GetAsyncKeyState(VK_RIGHT) & 0x8000) && (spotLightFalloff < 100)) { spotLightFalloff += dt * 5.0f; }
-		if ((GetAsyncKeyState(VK_LEFT) & 0x8000) && (spotLightFalloff > 1)) { spotLightFalloff -= dt * 5.0f; }
+		if (input.KeyDown(VK_RIGHT) && (spotLightFalloff < 100)) { spotLightFalloff += dt * 5.0f; }
+		if (input.KeyDown(VK_LEFT) && (spotLightFalloff > 1)) { spotLightFalloff -= dt * 5.0f; }
 
 		break;
 	default:
@@ -610,7 +947,10 @@ void Game::UpdateLights()
 	lights[(size_t)controlMode - 1] = lightToUpdate;
 }
 
-void Game::PreRender()
+// --------------------------------------------------------
+// Clears the frame's targets and binds the scene targets
+// --------------------------------------------------------
+void Game::PreRender(StateCache* stateCache)
 {
 	// Background color (Cornflower Blue in this case) for clearing
 	const float color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
@@ -618,223 +958,959 @@ void Game::PreRender()
 	// Clear the render target and depth buffer (erases what's on the screen)
 	//  - Do this ONCE PER FRAME
 	//  - At the beginning of Draw (before drawing *anything*)
-	context->ClearRenderTargetView(backBufferRTV.Get(), color);
-	context->ClearDepthStencilView(
+	RenderDevice* renderDevice = stateCache->GetDevice();
+	renderDevice->ClearRenderTarget(backBufferRTV.Get(), color);
+	renderDevice->ClearDepthStencil(
 		depthStencilView.Get(),
 		D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
 		1.0f,
 		0);
 
 	// Ensure we are clearing all render targets
-	context->ClearRenderTargetView(ppRTV.Get(), color);
-	context->ClearRenderTargetView(sceneNormalsRTV.Get(), color);
-	context->ClearRenderTargetView(sceneDepthRTV.Get(), color);
+	renderDevice->ClearRenderTarget(frameGraph->GetRTV(sceneColorTarget), color);
+	renderDevice->ClearRenderTarget(frameGraph->GetRTV(sceneNormalsTarget), color);
+	renderDevice->ClearRenderTarget(frameGraph->GetRTV(sceneDepthTarget), color);
 
 	// Set all 3 render targets, making all three active at once
 	// - Properly utilizing these all at once requires a special setup
 	//   in your pixel shader, so that the shader returns multiple colors
+	BindSceneTargets(stateCache);
+}
+
+// --------------------------------------------------------
+// Binds the three scene targets and the depth buffer, plus
+// the rest of the state a scene pass expects - needed at the
+// start of every job, since deferred contexts start empty
+// --------------------------------------------------------
+void Game::BindSceneTargets(StateCache* stateCache)
+{
 	ID3D11RenderTargetView* rtvs[3] =
 	{
-		ppRTV.Get(),
-		sceneNormalsRTV.Get(),
-		sceneDepthRTV.Get()
+		frameGraph->GetRTV(sceneColorTarget),
+		frameGraph->GetRTV(sceneNormalsTarget),
+		frameGraph->GetRTV(sceneDepthTarget)
 	};
-	context->OMSetRenderTargets(3, rtvs, depthStencilView.Get());
-	context->ClearRenderTargetView(ppRTV.Get(), color);
+	stateCache->SetRenderTargets(3, rtvs, depthStencilView.Get());
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	SetScreenViewport(stateCache->GetDevice());
 }
 
-void Game::PostRender()
+void Game::SetScreenViewport(RenderDevice* renderDevice)
 {
-	// Necessary for potentially turning off buffers
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	ID3D11Buffer* nothing = 0;
+	renderDevice->SetViewport(0.0f, 0.0f, (float)this->width, (float)this->height, 0.0f, 1.0f);
+}
 
+void Game::PostRender(StateCache* stateCache)
+{
 	// do depth normal outlines
-	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), 0);
+	stateCache->SetRenderTargets(1, backBufferRTV.GetAddressOf(), 0);
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	SetScreenViewport(stateCache->GetDevice());
 	// Set up post process shaders
 	ppVS->SetShader();
 
-	ppPS->SetShaderResourceView("pixels", ppSRV.Get());
-	ppPS->SetShaderResourceView("normals", sceneNormalsSRV.Get());
-	ppPS->SetShaderResourceView("depth", sceneDepthSRV.Get());
-	ppPS->SetSamplerState("samplerOptions", clampSampler.Get());
+	ppPS->SetShaderResourceView(ppPixelsHandle, frameGraph->GetSRV(sceneColorTarget));
+	ppPS->SetShaderResourceView(ppNormalsHandle, frameGraph->GetSRV(sceneNormalsTarget));
+	ppPS->SetShaderResourceView(ppDepthHandle, frameGraph->GetSRV(sceneDepthTarget));
+	ppPS->SetSamplerState(ppSamplerHandle, clampSampler.Get());
 	ppPS->SetShader();
 	
-	ppPS->SetFloat("pixelWidth", 1.0f / width);
-	ppPS->SetFloat("pixelHeight", 1.0f / height);
-	ppPS->SetFloat("depthAdjust", 5.0f);
-	ppPS->SetFloat("normalAdjust", 5.0f);
-	ppPS->CopyAllBufferData();
+	PostProcessPSExternalData ppData = {};
+	ppData.pixelWidth = 1.0f / width;
+	ppData.pixelHeight = 1.0f / height;
+	ppData.depthAdjust = 5.0f;
+	ppData.normalAdjust = 5.0f;
+	ppPS->WriteBufferData(ppData);
 
 	// Turn OFF my vertex and index buffers
-	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
-	context->IASetVertexBuffers(0, 1, &nothing, &stride, &offset);
+	stateCache->SetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
+	stateCache->SetVertexBuffer(0, 0, sizeof(Vertex), 0);
 
 	// Draw exactly 3 vertices, which the special post-process vertex shader will
 	// "figure out" on the fly (resulting in our "full screen triangle")
-	context->Draw(3, 0);
+	stateCache->GetDevice()->Draw(3, 0);
 
-	// Unbind shader resource views at the end of the frame,
-	// since we'll be rendering into one of those textures
-	// at the start of the next
-	ID3D11ShaderResourceView* nullSRVs[16] = {};
-	context->PSSetShaderResources(0, 16, nullSRVs);
+	// the frame graph unbinds the scene textures after this pass,
+	// since they're rendered into again at the start of the next frame
 }
 
-void Game::DrawUI()
+// --------------------------------------------------------
+// The states SpriteBatch defaults to (premultiplied alpha
+// blending, linear clamp sampling, no depth, counter
+// clockwise culling), made through the state cache
+// --------------------------------------------------------
+void Game::CreateUIStates()
 {
-	spriteBatch->Begin();
+	D3D11_BLEND_DESC blend = {};
+	blend.RenderTarget[0].BlendEnable = TRUE;
+	blend.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+	blend.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blend.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blend.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blend.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	blend.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blend.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	uiBlendState = stateObjects->GetBlendState(blend);
+
+	D3D11_SAMPLER_DESC samp = {};
+	samp.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samp.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samp.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samp.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samp.MaxAnisotropy = D3D11_MAX_MAXANISOTROPY;
+	samp.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	samp.MaxLOD = D3D11_FLOAT32_MAX;
+	uiSamplerState = stateObjects->GetSamplerState(samp);
+
+	D3D11_DEPTH_STENCIL_DESC depth = {};
+	depth.DepthEnable = FALSE;
+	depth.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depth.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+	uiDepthState = stateObjects->GetDepthStencilState(depth);
+
+	D3D11_RASTERIZER_DESC rast = {};
+	rast.FillMode = D3D11_FILL_SOLID;
+	rast.CullMode = D3D11_CULL_BACK;
+	rast.DepthClipEnable = TRUE;
+	rast.MultisampleEnable = TRUE;
+	uiRasterizerState = stateObjects->GetRasterizerState(rast);
+}
+
+void Game::DrawUI(ID3D11DeviceContext* context, StateCache* stateCache)
+{
+	// use the sprite batch made for the context being recorded
+	SpriteBatch* batch = recorderSpriteBatch && context == commandRecorder->GetContext(0) ?
+		recorderSpriteBatch.get() : spriteBatch.get();
+
+	stateCache->SetRenderTargets(1, backBufferRTV.GetAddressOf(), 0);
+	SetScreenViewport(stateCache->GetDevice());
+	batch->Begin(SpriteSortMode_Deferred, uiBlendState.Get(), uiSamplerState.Get(), uiDepthState.Get(), uiRasterizerState.Get());
 
 	// Title
-	spriteFont->DrawString(spriteBatch.get(), "Toon Shader Sandbox", XMFLOAT2(10, 10), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "Toon Shader Sandbox", XMFLOAT2(10, 10), Colors::LawnGreen);
 
 	// Description
-	spriteFont->DrawString(spriteBatch.get(), "This project presents Toon/Cel Shading through\nvarious lighting manipulation alongside\nthe use of real-time shadows.", XMFLOAT2(10, 30), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "This project presents Toon/Cel Shading through\nvarious lighting manipulation alongside\nthe use of real-time shadows.", XMFLOAT2(10, 30), Colors::LawnGreen);
 
 	// Controls
-	spriteFont->DrawString(spriteBatch.get(), "== Controls ==", XMFLOAT2(10, 100), Colors::LawnGreen);
-	spriteFont->DrawString(spriteBatch.get(), "TAB: Change control mode\n", XMFLOAT2(10, 120), Colors::LawnGreen);
-	spriteFont->DrawString(spriteBatch.get(), "V: Toggle Real-Time Shadows\n", XMFLOAT2(10, 140), Colors::LawnGreen);
-	spriteFont->DrawString(spriteBatch.get(), "1: Directional Light", XMFLOAT2(10, 160), Colors::LawnGreen);
-	spriteFont->DrawString(spriteBatch.get(), "2: Point Light", XMFLOAT2(10, 180), Colors::LawnGreen);
-	spriteFont->DrawString(spriteBatch.get(), "3: Spot Light", XMFLOAT2(10, 200), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "== Controls ==", XMFLOAT2(10, 100), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "TAB: Change control mode\n", XMFLOAT2(10, 120), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "V: Toggle Real-Time Shadows\n", XMFLOAT2(10, 140), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "1: Directional Light", XMFLOAT2(10, 160), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "2: Point Light", XMFLOAT2(10, 180), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "3: Spot Light", XMFLOAT2(10, 200), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "O: Occlusion Culling  M: Parallel Recording  T: Texture Arrays  G: GPU Culling  Z: Depth Pre-pass  C: Light Culling", XMFLOAT2(10, 220), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "F5: Record  F6: Replay  F7: Camera Path  F8: Capture Frame", XMFLOAT2(10, 240), Colors::LawnGreen);
 
 	// Info on current outline mode
-	spriteFont->DrawString(spriteBatch.get(), "== Control Mode ==", XMFLOAT2(10, 260), Colors::LawnGreen);
-	spriteFont->DrawString(spriteBatch.get(), "Current Mode:", XMFLOAT2(10, 280), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "== Control Mode ==", XMFLOAT2(10, 260), Colors::LawnGreen);
+	spriteFont->DrawString(batch, "Current Mode:", XMFLOAT2(10, 280), Colors::LawnGreen);
 
 	switch (controlMode) 
 	{
 	case CONTROL_MODE_MOVE_CAMERA:
-		spriteFont->DrawString(spriteBatch.get(), "Camera Mode", XMFLOAT2(120, 280), Colors::LightSeaGreen);
-		spriteFont->DrawString(spriteBatch.get(), "Use WASD to move around\nClick and Drag to look", XMFLOAT2(10, 300), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "Camera Mode", XMFLOAT2(120, 280), Colors::LightSeaGreen);
+		spriteFont->DrawString(batch, "Use WASD to move around\nClick and Drag to look", XMFLOAT2(10, 300), Colors::LawnGreen);
 		break;
 	case CONTROL_MODE_MOVE_DIRLIGHT:
-		spriteFont->DrawString(spriteBatch.get(), "Direction Light Mode", XMFLOAT2(120, 280), Colors::LightSeaGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Use WASDQE to change the lighting direction", XMFLOAT2(10, 300), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Click and Drag to look", XMFLOAT2(10, 320), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "Direction:", XMFLOAT2(10, 360), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "X:", XMFLOAT2(10, 380), Colors::HotPink);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(dirLightDirection.x).c_str(), XMFLOAT2(30, 380), Colors::Red);
-		spriteFont->DrawString(spriteBatch.get(), "Y:", XMFLOAT2(10, 400), Colors::LightGreen);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(dirLightDirection.y).c_str(), XMFLOAT2(30, 400), Colors::Green);
-		spriteFont->DrawString(spriteBatch.get(), "Z:", XMFLOAT2(10, 420), Colors::LightBlue);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(dirLightDirection.z).c_str(), XMFLOAT2(30, 420), Colors::Blue);
+		spriteFont->DrawString(batch, "Direction Light Mode", XMFLOAT2(120, 280), Colors::LightSeaGreen);
+		spriteFont->DrawString(batch, "- Use WASDQE to change the lighting direction", XMFLOAT2(10, 300), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "- Click and Drag to look", XMFLOAT2(10, 320), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "Direction:", XMFLOAT2(10, 360), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "X:", XMFLOAT2(10, 380), Colors::HotPink);
+		spriteFont->DrawString(batch, std::to_string(dirLightDirection.x).c_str(), XMFLOAT2(30, 380), Colors::Red);
+		spriteFont->DrawString(batch, "Y:", XMFLOAT2(10, 400), Colors::LightGreen);
+		spriteFont->DrawString(batch, std::to_string(dirLightDirection.y).c_str(), XMFLOAT2(30, 400), Colors::Green);
+		spriteFont->DrawString(batch, "Z:", XMFLOAT2(10, 420), Colors::LightBlue);
+		spriteFont->DrawString(batch, std::to_string(dirLightDirection.z).c_str(), XMFLOAT2(30, 420), Colors::Blue);
 		break;
 	case CONTROL_MODE_MOVE_POINTLIGHT:
-		spriteFont->DrawString(spriteBatch.get(), "Point Light Mode", XMFLOAT2(120, 280), Colors::LightSeaGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Use WASDQE to change the point light position", XMFLOAT2(10, 300), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Use Up/Down Arrow to adjust range", XMFLOAT2(10, 320), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Click and Drag to look", XMFLOAT2(10, 340), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "Position:", XMFLOAT2(10, 380), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "X:", XMFLOAT2(10, 400), Colors::HotPink);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(pointLightPosition.x).c_str(), XMFLOAT2(30, 400), Colors::Red);
-		spriteFont->DrawString(spriteBatch.get(), "Y:", XMFLOAT2(10, 420), Colors::LightGreen);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(pointLightPosition.y).c_str(), XMFLOAT2(30, 420), Colors::Green);
-		spriteFont->DrawString(spriteBatch.get(), "Z:", XMFLOAT2(10, 440), Colors::LightBlue);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(pointLightPosition.z).c_str(), XMFLOAT2(30, 440), Colors::Blue);
-		spriteFont->DrawString(spriteBatch.get(), "Range:", XMFLOAT2(10, 480), Colors::Cyan);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(pointLightRange).c_str(), XMFLOAT2(65, 480), Colors::LightCyan);
+		spriteFont->DrawString(batch, "Point Light Mode", XMFLOAT2(120, 280), Colors::LightSeaGreen);
+		spriteFont->DrawString(batch, "- Use WASDQE to change the point light position", XMFLOAT2(10, 300), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "- Use Up/Down Arrow to adjust range", XMFLOAT2(10, 320), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "- Click and Drag to look", XMFLOAT2(10, 340), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "Position:", XMFLOAT2(10, 380), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "X:", XMFLOAT2(10, 400), Colors::HotPink);
+		spriteFont->DrawString(batch, std::to_string(pointLightPosition.x).c_str(), XMFLOAT2(30, 400), Colors::Red);
+		spriteFont->DrawString(batch, "Y:", XMFLOAT2(10, 420), Colors::LightGreen);
+		spriteFont->DrawString(batch, std::to_string(pointLightPosition.y).c_str(), XMFLOAT2(30, 420), Colors::Green);
+		spriteFont->DrawString(batch, "Z:", XMFLOAT2(10, 440), Colors::LightBlue);
+		spriteFont->DrawString(batch, std::to_string(pointLightPosition.z).c_str(), XMFLOAT2(30, 440), Colors::Blue);
+		spriteFont->DrawString(batch, "Range:", XMFLOAT2(10, 480), Colors::Cyan);
+		spriteFont->DrawString(batch, std::to_string(pointLightRange).c_str(), XMFLOAT2(65, 480), Colors::LightCyan);
 		break;
 	case CONTROL_MODE_MOVE_SPOTLIGHT:
-		spriteFont->DrawString(spriteBatch.get(), "Spot Light Mode", XMFLOAT2(120, 280), Colors::LightSeaGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Use WASDQE to change the spot light position", XMFLOAT2(10, 300), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Use IJKLUO to change the spot light direction", XMFLOAT2(10, 320), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Use Up/Down Arrow to adjust range", XMFLOAT2(10, 340), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Use Left/Right Arrow to adjust falloff", XMFLOAT2(10, 360), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "- Click and Drag to look", XMFLOAT2(10, 380), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "Position:", XMFLOAT2(10, 420), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "X:", XMFLOAT2(10, 440), Colors::HotPink);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(spotLightPosition.x).c_str(), XMFLOAT2(30, 440), Colors::Red);
-		spriteFont->DrawString(spriteBatch.get(), "Y:", XMFLOAT2(10, 460), Colors::LightGreen);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(spotLightPosition.y).c_str(), XMFLOAT2(30, 460), Colors::Green);
-		spriteFont->DrawString(spriteBatch.get(), "Z:", XMFLOAT2(10, 480), Colors::LightBlue);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(spotLightPosition.z).c_str(), XMFLOAT2(30, 480), Colors::Blue);
-		spriteFont->DrawString(spriteBatch.get(), "Direction:", XMFLOAT2(10, 500), Colors::LawnGreen);
-		spriteFont->DrawString(spriteBatch.get(), "X:", XMFLOAT2(10, 520), Colors::HotPink);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(spotLightDirection.x).c_str(), XMFLOAT2(30, 520), Colors::Red);
-		spriteFont->DrawString(spriteBatch.get(), "Y:", XMFLOAT2(10, 540), Colors::LightGreen);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(spotLightDirection.y).c_str(), XMFLOAT2(30, 540), Colors::Green);
-		spriteFont->DrawString(spriteBatch.get(), "Z:", XMFLOAT2(10, 560), Colors::LightBlue);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(spotLightDirection.z).c_str(), XMFLOAT2(30, 560), Colors::Blue);
-		spriteFont->DrawString(spriteBatch.get(), "Range:", XMFLOAT2(10, 600), Colors::Cyan);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(spotLightRange).c_str(), XMFLOAT2(65, 600), Colors::LightCyan);
-		spriteFont->DrawString(spriteBatch.get(), "Falloff:", XMFLOAT2(10, 620), Colors::Cyan);
-		spriteFont->DrawString(spriteBatch.get(), std::to_string(spotLightFalloff).c_str(), XMFLOAT2(65, 620), Colors::LightCyan);
+		spriteFont->DrawString(batch, "Spot Light Mode", XMFLOAT2(120, 280), Colors::LightSeaGreen);
+		spriteFont->DrawString(batch, "- Use WASDQE to change the spot light position", XMFLOAT2(10, 300), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "- Use IJKLUO to change the spot light direction", XMFLOAT2(10, 320), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "- Use Up/Down Arrow to adjust range", XMFLOAT2(10, 340), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "- Use Left/Right Arrow to adjust falloff", XMFLOAT2(10, 360), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "- Click and Drag to look", XMFLOAT2(10, 380), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "Position:", XMFLOAT2(10, 420), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "X:", XMFLOAT2(10, 440), Colors::HotPink);
+		spriteFont->DrawString(batch, std::to_string(spotLightPosition.x).c_str(), XMFLOAT2(30, 440), Colors::Red);
+		spriteFont->DrawString(batch, "Y:", XMFLOAT2(10, 460), Colors::LightGreen);
+		spriteFont->DrawString(batch, std::to_string(spotLightPosition.y).c_str(), XMFLOAT2(30, 460), Colors::Green);
+		spriteFont->DrawString(batch, "Z:", XMFLOAT2(10, 480), Colors::LightBlue);
+		spriteFont->DrawString(batch, std::to_string(spotLightPosition.z).c_str(), XMFLOAT2(30, 480), Colors::Blue);
+		spriteFont->DrawString(batch, "Direction:", XMFLOAT2(10, 500), Colors::LawnGreen);
+		spriteFont->DrawString(batch, "X:", XMFLOAT2(10, 520), Colors::HotPink);
+		spriteFont->DrawString(batch, std::to_string(spotLightDirection.x).c_str(), XMFLOAT2(30, 520), Colors::Red);
+		spriteFont->DrawString(batch, "Y:", XMFLOAT2(10, 540), Colors::LightGreen);
+		spriteFont->DrawString(batch, std::to_string(spotLightDirection.y).c_str(), XMFLOAT2(30, 540), Colors::Green);
+		spriteFont->DrawString(batch, "Z:", XMFLOAT2(10, 560), Colors::LightBlue);
+		spriteFont->DrawString(batch, std::to_string(spotLightDirection.z).c_str(), XMFLOAT2(30, 560), Colors::Blue);
+		spriteFont->DrawString(batch, "Range:", XMFLOAT2(10, 600), Colors::Cyan);
+		spriteFont->DrawString(batch, std::to_string(spotLightRange).c_str(), XMFLOAT2(65, 600), Colors::LightCyan);
+		spriteFont->DrawString(batch, "Falloff:", XMFLOAT2(10, 620), Colors::Cyan);
+		spriteFont->DrawString(batch, std::to_string(spotLightFalloff).c_str(), XMFLOAT2(65, 620), Colors::LightCyan);
 		break;
 	default:
 		break;
 	}
 
-	spriteBatch->End();
-
-	// Reset render states altered by sprite batch!
-	context->RSSetState(0);
-	context->OMSetDepthStencilState(0, 0);
-	context->OMSetBlendState(0, 0, 0xFFFFFFFF);
+	// Record/replay status
+	std::string runStatus;
+	if (input.GetMode() == INPUT_MODE_RECORD)
+		runStatus = "Recording: frame " + std::to_string(input.GetFrameIndex());
+	else if (input.GetMode() == INPUT_MODE_REPLAY)
+		runStatus = "Replaying: frame " + std::to_string(input.GetFrameIndex()) + " of " + std::to_string(input.GetFrameCount());
+	else if (playingCameraPath)
+		runStatus = "Camera path: " + std::to_string(cameraPathTime) + " of " + std::to_string(cameraPath.GetDuration()) + " s";
+	if (!runStatus.empty())
+		spriteFont->DrawString(batch, runStatus.c_str(), XMFLOAT2((float)width - 300, 10), Colors::OrangeRed);
+
+	// Render queue stats
+	const RenderQueueStats& queueStats = frameQueueStats;
+	std::string queueInfo = "Queue: " + std::to_string(queueStats.draws) + " draws (" + std::to_string(queueStats.instances) + " instances), binds "
+		+ std::to_string(queueStats.shaderBinds) + "/" + std::to_string(queueStats.materialBinds) + "/" + std::to_string(queueStats.meshBinds)
+		+ ", skipped " + std::to_string(queueStats.shaderSkips) + "/" + std::to_string(queueStats.materialSkips) + "/" + std::to_string(queueStats.meshSkips)
+		+ " (shader/material/mesh, sort " + std::to_string(queueStats.sortTime) + " ms)"
+		+ (enableTextureArrays ? ", " + std::to_string(texturePacker->GetGroupCount()) + " texture arrays ("
+			+ std::to_string(texturePacker->GetArrayBytes() / (1024 * 1024)) + " MB)" : "");
+	spriteFont->DrawString(batch, queueInfo.c_str(), XMFLOAT2(10, 640), Colors::LawnGreen);
+
+	// State cache stats, summed over every context
+	unsigned int totalIssued = 0;
+	unsigned int totalFiltered = 0;
+	for (int i = 0; i < STATE_CALL_COUNT; i++)
+	{
+		totalIssued += frameStateCallsIssued[i];
+		totalFiltered += frameStateCallsFiltered[i];
+	}
+	std::string cacheInfo = "State cache: " + std::to_string(totalFiltered) + " of "
+		+ std::to_string(totalFiltered + totalIssued) + " calls filtered (";
+	const char* callNames[STATE_CALL_COUNT] = { "shader", "cb", "srv", "sampler", "ia", "state" };
+	for (int i = 0; i < STATE_CALL_COUNT; i++)
+	{
+		cacheInfo += std::string(i > 0 ? ", " : "") + callNames[i] + " " + std::to_string(frameStateCallsFiltered[i])
+			+ "/" + std::to_string(frameStateCallsFiltered[i] + frameStateCallsIssued[i]);
+	}
+	cacheInfo += ")";
+	spriteFont->DrawString(batch, cacheInfo.c_str(), XMFLOAT2(10, 620), Colors::LawnGreen);
+
+	// Recording stats, from the previous frame
+	std::string recordInfo = enableParallelRecording && commandRecorder->IsValid() ?
+		"Recording: " + std::to_string(commandRecorder->GetJobCount()) + " jobs on " + std::to_string(commandRecorder->GetThreadCount()) + " threads, record "
+		+ std::to_string(commandRecorder->GetLastRecordTime()) + " ms, execute " + std::to_string(commandRecorder->GetLastExecuteTime()) + " ms"
+		+ (commandRecorder->HasDriverCommandLists() ? "" : " (emulated command lists)") :
+		"Recording: immediate, " + std::to_string(commandRecorder->GetLastRecordTime()) + " ms";
+	spriteFont->DrawString(batch, recordInfo.c_str(), XMFLOAT2(10, 600), Colors::LawnGreen);
+
+	// Constant upload stats
+	std::string constantInfo = renderDevice->GetConstantRing() ?
+		"Constants: " + std::to_string(frameConstantBytes / 1024) + " KB/frame in " + std::to_string(frameConstantAllocations) + " ring allocations, "
+		+ std::to_string(frameConstantBytes / (frameQueueStats.draws > 0 ? frameQueueStats.draws : 1)) + " B/draw" :
+		"Constants: UpdateSubresource per buffer (no D3D11.1 constant offsets)";
+	spriteFont->DrawString(batch, constantInfo.c_str(), XMFLOAT2(10, 580), Colors::LawnGreen);
+
+	// Culling stats - what the GPU kept never comes back to the CPU
+	std::string cullStats = gpuCullingActive ?
+		"Culling: " + std::to_string(gpuCuller->GetObjectCount()) + " tested "
+		+ (gpuCuller->IsGpu() ? "on the GPU" : "by CPU emulation") + ", "
+		+ std::to_string(gpuCuller->GetBatchCount()) + " indirect draws" :
+		"Culling: " + std::to_string(frustumCuller.GetTestedCount()) + " tested, "
+		+ std::to_string(frustumCuller.GetCulledCount()) + " culled, "
+		+ std::to_string(frustumCuller.GetVisibleCount()) + " visible, "
+		+ std::to_string(frustumCuller.GetRefreshedCount()) + " bounds refreshed ("
+		+ std::to_string(frustumCuller.GetLastCullTime()) + " ms)";
+	spriteFont->DrawString(batch, cullStats.c_str(), XMFLOAT2(10, 680), Colors::LawnGreen);
+
+	std::string pvsStats = cameraCell >= 0 ?
+		"PVS: cell " + std::to_string(cameraCell) + " of " + std::to_string(pvs.GetCellCount()) + ", "
+		+ std::to_string(pvs.GetVisibleEntityCount(cameraCell)) + " potentially visible" :
+		"PVS: outside cells";
+	spriteFont->DrawString(batch, pvsStats.c_str(), XMFLOAT2(10, 660), Colors::LawnGreen);
+
+	std::string occlusionStats = enableOcclusionCulling ?
+		"Occlusion: " + std::to_string(occlusionCuller.GetOccludedCount()) + " occluded, "
+		+ std::to_string(occlusionCuller.GetRasterizedTriangleCount()) + " tris rasterized ("
+		+ std::to_string(occlusionCuller.GetLastRasterTime()) + " ms)" :
+		"Occlusion: off";
+	spriteFont->DrawString(batch, occlusionStats.c_str(), XMFLOAT2(10, 700), Colors::LawnGreen);
+
+	std::string prepassStats = !enableDepthPrepass ? "Depth pre-pass: off" :
+		std::string("Depth pre-pass: ") + (depthPrepassActive ? "on" : "skipped") + " (estimated overdraw "
+		+ std::to_string(depthPrepassOverdraw) + "x, " + std::to_string(depthPrepassTriangles) + " visible tris)";
+	spriteFont->DrawString(batch, prepassStats.c_str(), XMFLOAT2(10, 720), Colors::LawnGreen);
+
+	std::string graphStats = "Frame graph: " + std::to_string(frameGraph->GetPassCount() - frameGraph->GetCulledPassCount()) + " of "
+		+ std::to_string(frameGraph->GetPassCount()) + " passes, targets " + std::to_string(frameGraph->GetAliasedBytes() / 1024) + " KB ("
+		+ std::to_string(frameGraph->GetUnaliasedBytes() / 1024) + " KB unaliased, " + std::to_string(frameGraph->GetPooledTextureCount()) + " pooled)";
+	spriteFont->DrawString(batch, graphStats.c_str(), XMFLOAT2(10, 740), Colors::LawnGreen);
+
+	// Shader constant buffer uploads, and the shader that sent the most
+	SimpleUploadStats uploads = {};
+	const std::pair<const char*, SimpleUploadStats>* busiest = 0;
+	for (const std::pair<const char*, SimpleUploadStats>& shader : frameShaderUploads)
+	{
+		uploads.Uploads += shader.second.Uploads;
+		uploads.CleanSkips += shader.second.CleanSkips;
+		uploads.Bytes += shader.second.Bytes;
+		uploads.RingAllocations += shader.second.RingAllocations;
+		uploads.DiscardMaps += shader.second.DiscardMaps;
+		uploads.PartialUpdates += shader.second.PartialUpdates;
+		uploads.FullUpdates += shader.second.FullUpdates;
+		if (!busiest || shader.second.Bytes > busiest->second.Bytes)
+			busiest = &shader;
+	}
+	std::string uploadStats = "Shader uploads: " + std::to_string(uploads.Uploads) + " buffers, " + std::to_string(uploads.CleanSkips)
+		+ " clean skipped, " + std::to_string(uploads.Bytes / 1024) + " KB (ring " + std::to_string(uploads.RingAllocations)
+		+ ", discard " + std::to_string(uploads.DiscardMaps) + ", partial " + std::to_string(uploads.PartialUpdates)
+		+ ", full " + std::to_string(uploads.FullUpdates) + ")"
+		+ (busiest ? ", most from " + std::string(busiest->first) + " (" + std::to_string(busiest->second.Bytes / 1024) + " KB)" : "");
+	spriteFont->DrawString(batch, uploadStats.c_str(), XMFLOAT2(10, 760), Colors::LawnGreen);
+
+	std::string lightStats;
+	if (lightCulling == LIGHT_CULLING_CLUSTERED)
+	{
+		lightStats = "Lights: clustered " + std::to_string(LIGHT_GRID_X) + "x" + std::to_string(LIGHT_GRID_Y) + "x" + std::to_string(LIGHT_GRID_Z) + ", "
+			+ std::to_string(lightGrid.GetBinnedLightCount()) + " binned into " + std::to_string(lightGrid.GetEntryCount()) + " cell entries, busiest cell "
+			+ std::to_string(lightGrid.GetBusiestCellCount()) + ", " + std::to_string(lightGrid.GetDroppedCount()) + " dropped ("
+			+ std::to_string(lightGrid.GetLastBuildTime()) + " ms)";
+	}
+	else if (lightCulling == LIGHT_CULLING_PER_OBJECT)
+	{
+		lightStats = "Lights: per object, " + std::to_string(objectLights.GetEntryCount()) + " listed for " + std::to_string(objectLights.GetObjectCount())
+			+ " objects, longest list " + std::to_string(objectLights.GetLongestList()) + ", " + std::to_string(objectLights.GetCappedCount())
+			+ " capped at " + std::to_string(OBJECT_LIGHT_LIST_MAX);
+	}
+	else
+	{
+		lightStats = "Lights: unculled, " + std::to_string(lightGrid.GetEntryCount()) + " point/spot lights in every pixel's list";
+	}
+	spriteFont->DrawString(batch, lightStats.c_str(), XMFLOAT2(10, 780), Colors::LawnGreen);
+
+	batch->End();
+
+	// Reset render states altered by sprite batch! It bound its own
+	// shaders, buffers and states, so the cache can't trust anything -
+	// null is the default state, so nothing's created for it
+	stateCache->Invalidate();
+	stateCache->SetRasterizerState(0);
+	stateCache->SetDepthStencilState(0, 0);
+	stateCache->SetBlendState(0, 0, 0xFFFFFFFF);
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
-void Game::RenderShadowMap()
+void Game::RenderShadowMap(StateCache* stateCache, RenderQueueStats& stats)
 {
 	// Set the current render target and depth buffer
 	// for shadow map creations
 	// (Changing where the rendering goes!)
-	context->OMSetRenderTargets(0, 0, shadowDSV.Get()); // Only need the depth buffer (shadow map)
-	context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	ID3D11DepthStencilView* shadowDSV = frameGraph->GetDSV(shadowMapTarget);
+	stateCache->SetRenderTargets(0, 0, shadowDSV); // Only need the depth buffer (shadow map)
+	stateCache->GetDevice()->ClearDepthStencil(shadowDSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
 
 	// Change any shadow-mapping-specific render states
-	context->RSSetState(shadowRasterizer.Get());
+	stateCache->SetRasterizerState(shadowRasterizer.Get());
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// Create a viewport to match the new target size
-	D3D11_VIEWPORT vp = {};
-	vp.TopLeftX = 0.0f;
-	vp.TopLeftY = 0.0f;
-	vp.Width = (float)shadowMapSize;
-	vp.Height = (float)shadowMapSize;
-	vp.MinDepth = 0.0f;
-	vp.MaxDepth = 1.0f;
-	context->RSSetViewports(1, &vp);
+	stateCache->GetDevice()->SetViewport(0.0f, 0.0f, (float)shadowMapSize, (float)shadowMapSize, 0.0f, 1.0f);
 
 	// Set up vertex and pixel shaders
+	ShadowMapVSPassData passData = {};
+	passData.view = shadowViewMatrix;
+	passData.projection = shadowProjectionMatrix;
+	shadowVS->WriteBufferData(passData);
 	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", shadowViewMatrix);
-	shadowVS->SetMatrix4x4("projection", shadowProjectionMatrix);
-	context->PSSetShader(0, 0, 0); // Turns OFF the pixel shader!
+	stateCache->SetShader(SHADER_STAGE_PIXEL, 0); // Turns OFF the pixel shader!
+
+	// the world matrices come from the frame's instance buffer
+	stateCache->SetVertexBuffer(1, instanceBuffer.GetBuffer(), sizeof(InstanceData), 0);
 
-	// Loop and render all entities
-	for (auto& e : entities)
+	// Loop and render the queued shadow casters - they're sorted by
+	// mesh, so every run of the same mesh is one instanced draw
+	const std::vector<RenderItem>& items = renderQueue.GetItems();
+	size_t begin = renderQueue.GetPassBegin(RENDER_PASS_SHADOW);
+	size_t end = renderQueue.GetPassEnd(RENDER_PASS_SHADOW);
+	for (size_t q = begin; q < end; )
 	{
-		// Grab this entity's world matrix and
-		// send to the VS
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
+		size_t batchEnd = renderQueue.GetBatchEnd(q, end);
+		Mesh* mesh = entities[items[q].entity]->GetMesh();
 
-		// Only draw the current entity
 		// Set the Vertex and Index Buffer
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-		context->IASetVertexBuffers(0, 1, e->GetMesh()->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(e->GetMesh()->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
-
-		// tell D3D to render using the currently bound resources
-		// Finally do the actual drawing
-			//  - Do this ONCE PER OBJECT you intend to draw
-			//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
-			//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
-			//     vertices in the currently set VERTEX BUFFER
-		context->DrawIndexed(
-			e->GetMesh()->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-			0,     // Offset to the first index we want to use
-			0);    // Offset to add to each index when looking up vertices
+		stateCache->SetVertexBuffer(0, mesh->GetVertexBuffer().Get(), sizeof(Vertex), 0);
+		stateCache->SetIndexBuffer(mesh->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+		stats.meshBinds++;
+
+		stateCache->GetDevice()->DrawIndexedInstanced(mesh->GetIndexCount(), (UINT)(batchEnd - q), 0, 0, (UINT)q);
+		stats.draws++;
+		stats.instances += (unsigned int)(batchEnd - q);
+		stats.meshSkips += (unsigned int)(batchEnd - q - 1);
+		q = batchEnd;
 	}
 
 	// Reset anything I've changed
-	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
-	vp.Width = (float)this->width;
-	vp.Height = (float)this->height;
-	context->RSSetViewports(1, &vp);
-	context->RSSetState(0);
+	stateCache->SetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
+	SetScreenViewport(stateCache->GetDevice());
+	stateCache->SetRasterizerState(0);
+}
+
+// --------------------------------------------------------
+// Estimates the opaque pass's overdraw from the projected
+// size of the visible bounds, and only turns the pre-pass
+// on when the shading it saves outweighs drawing every
+// visible triangle a second time
+// --------------------------------------------------------
+void Game::DecideDepthPrepass()
+{
+	depthPrepassActive = false;
+	depthPrepassOverdraw = 0.0f;
+	depthPrepassTriangles = 0;
+	if (!enableDepthPrepass || !depthEqualState)
+		return;
+
+	XMFLOAT4X4 view = mainCamera->GetViewMatrix();
+	XMFLOAT4X4 proj = mainCamera->GetProjectionMatrix();
+	float screenPixels = (float)width * (float)height;
+	float pixelsPerUnit = proj._22 * (float)height * 0.5f; // at a view depth of 1
+
+	// each entity's bounding sphere, projected - a sphere the camera is
+	// inside of covers the whole screen
+	float coveredPixels = 0.0f;
+	for (unsigned int i : visibleEntities)
+	{
+		XMFLOAT3 center, extents;
+		frustumCuller.GetBounds(i, center, extents);
+		float radius = sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+		float depth = center.x * view._13 + center.y * view._23 + center.z * view._33 + view._43;
+
+		float area = screenPixels;
+		if (depth > radius)
+		{
+			float projectedRadius = radius / depth * pixelsPerUnit;
+			area = std::min(screenPixels, XM_PI * projectedRadius * projectedRadius);
+		}
+		coveredPixels += area;
+		depthPrepassTriangles += entities[i]->GetMesh()->GetIndexCount() / 3;
+	}
+	depthPrepassOverdraw = coveredPixels / screenPixels;
+
+	// every pixel past the first layer is one the pre-pass saves from shading
+	float savedPixels = coveredPixels - std::min(coveredPixels, screenPixels);
+	depthPrepassActive = depthPrepassOverdraw >= DEPTH_PREPASS_MIN_OVERDRAW &&
+		savedPixels > depthPrepassTriangles * DEPTH_PREPASS_TRIANGLE_COST;
+}
+
+// --------------------------------------------------------
+// Lays down the opaque pass's depth with the shadow map's
+// vertex shader and no pixel shader, so the main pass only
+// shades the front most surface of every pixel
+// --------------------------------------------------------
+void Game::RenderDepthPrepass(StateCache* stateCache, RenderQueueStats& stats)
+{
+	stateCache->SetRenderTargets(0, 0, depthStencilView.Get());
+	stateCache->SetRasterizerState(0);
+	stateCache->SetDepthStencilState(0, 0);
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	SetScreenViewport(stateCache->GetDevice());
+
+	ShadowMapVSPassData passData = {};
+	passData.view = mainCamera->GetViewMatrix();
+	passData.projection = mainCamera->GetProjectionMatrix();
+	shadowVS->WriteBufferData(passData);
+	shadowVS->SetShader();
+	stateCache->SetShader(SHADER_STAGE_PIXEL, 0);
+
+	// the same instances the main pass will draw
+	if (gpuCullingActive)
+		gpuCuller->BindInstances(stateCache);
+	else
+		stateCache->SetVertexBuffer(1, instanceBuffer.GetBuffer(), sizeof(InstanceData), 0);
+
+	// only the mesh matters here, but the queue is sorted by shader and
+	// material first, so the same mesh can come back in a later batch
+	const std::vector<RenderItem>& items = renderQueue.GetItems();
+	size_t begin = renderQueue.GetPassBegin(RENDER_PASS_OPAQUE);
+	size_t end = renderQueue.GetPassEnd(RENDER_PASS_OPAQUE);
+	unsigned int lastMesh = UINT_MAX;
+	unsigned int batchIndex = 0;
+	for (size_t q = begin; q < end; )
+	{
+		size_t batchEnd = renderQueue.GetBatchEnd(q, end);
+		unsigned int instanceCount = (unsigned int)(batchEnd - q);
+		Mesh* mesh = entities[items[q].entity]->GetMesh();
+
+		unsigned int meshId = RenderQueue::GetMesh(items[q].key);
+		if (meshId != lastMesh)
+		{
+			stateCache->SetVertexBuffer(0, mesh->GetVertexBuffer().Get(), sizeof(Vertex), 0);
+			stateCache->SetIndexBuffer(mesh->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+			lastMesh = meshId;
+			stats.meshBinds++;
+		}
+		else
+		{
+			stats.meshSkips++;
+		}
+		stats.meshSkips += instanceCount - 1;
+
+		if (gpuCullingActive)
+			gpuCuller->Draw(stateCache->GetDevice(), batchIndex++);
+		else
+			stateCache->GetDevice()->DrawIndexedInstanced(mesh->GetIndexCount(), instanceCount, 0, 0, (UINT)q);
+		stats.draws++;
+		stats.instances += instanceCount;
+		q = batchEnd;
+	}
+}
+
+// --------------------------------------------------------
+// Sizes the culler for the entity list and gives every transform
+// its index, so from then on only the ones that move list
+// themselves in movedEntities
+// --------------------------------------------------------
+void Game::TrackEntityBounds()
+{
+	frustumCuller.Resize(entities.size());
+	movedEntities.clear();
+	for (unsigned int i = 0; i < entities.size(); i++)
+	{
+		entities[i]->GetTransform()->SetChangeList(&movedEntities, i);
+		movedEntities.push_back(i);
+	}
+	RefreshMovedBounds();
+}
+
+// --------------------------------------------------------
+// Updates the culler's bounds of the entities in movedEntities
+// and empties the list
+// --------------------------------------------------------
+void Game::RefreshMovedBounds()
+{
+	for (unsigned int i : movedEntities)
+	{
+		Transform* transform = entities[i]->GetTransform();
+		Mesh* mesh = entities[i]->GetMesh();
+		frustumCuller.SetBounds(i, mesh->GetAABBMin(), mesh->GetAABBMax(), transform->GetWorldMatrix());
+		transform->ClearChanged();
+	}
+	movedEntities.clear();
+}
+
+void Game::CullEntities()
+{
+	// refresh the world space bounds of the entities that moved (all of
+	// them when the list changed size)
+	frustumCuller.BeginUpdate();
+	if (frustumCuller.GetCount() != entities.size())
+		TrackEntityBounds();
+	else
+		RefreshMovedBounds();
+
+	// the GPU tests the planes itself, so everything is queued
+	// (and the PVS and occluders aren't used)
+	if (gpuCullingActive)
+	{
+		visibleEntities.resize(entities.size());
+		for (unsigned int i = 0; i < entities.size(); i++)
+			visibleEntities[i] = i;
+		return;
+	}
+
+	// the PVS for the camera's cell rules out whole groups of entities
+	// before the planes are even tested
+	const uint64_t* preVisible = nullptr;
+	cameraCell = pvs.GetCell(mainCamera->GetTransform()->GetPosition());
+	if (cameraCell >= 0 && pvs.GetEntityCount() == entities.size())
+		preVisible = pvs.GetVisibleEntities(cameraCell);
+
+	// the shadow pass still draws everything, since objects
+	// outside of the view can cast shadows into it
+	frustumCuller.Cull(mainCamera->GetFrustumPlanes(), visibleEntities, preVisible);
+
+	// then drop whatever is hidden behind the big occluders
+	if (!enableOcclusionCulling)
+		return;
+
+	XMFLOAT4X4 view = mainCamera->GetViewMatrix();
+	XMFLOAT4X4 proj = mainCamera->GetProjectionMatrix();
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&proj)));
+
+	occlusionCuller.BeginFrame(viewProj);
+	for (size_t i = 0; i < occluderEntities.size(); i++)
+	{
+		occlusionCuller.AddOccluderInstance(occluderIds[i], entities[occluderEntities[i]]->GetTransform()->GetWorldMatrix());
+	}
+	occlusionCuller.Rasterize();
+
+	size_t kept = 0;
+	for (size_t v = 0; v < visibleEntities.size(); v++)
+	{
+		XMFLOAT3 center, extents;
+		frustumCuller.GetBounds(visibleEntities[v], center, extents);
+		if (occlusionCuller.IsVisible(center, extents))
+			visibleEntities[kept++] = visibleEntities[v];
+	}
+	visibleEntities.resize(kept);
+}
+
+// --------------------------------------------------------
+// Fills the render queue with this frame's shadow casters
+// and visible entities, and sorts it
+// --------------------------------------------------------
+void Game::BuildRenderQueue(RenderDevice* renderDevice)
+{
+	renderQueue.Clear();
+
+	// depth is the post projection z, which keeps the view depth order
+	auto projectedDepth = [](const XMFLOAT4X4& m, XMFLOAT3 p)
+	{
+		float z = p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43;
+		float w = p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44;
+		return w > 0.0f ? z / w : 0.0f;
+	};
+
+	// shadow casters - everything, since objects outside
+	// the view can still cast shadows into it
+	if (enableShadows)
+	{
+		XMFLOAT4X4 shadowViewProj;
+		XMStoreFloat4x4(&shadowViewProj, XMMatrixMultiply(XMLoadFloat4x4(&shadowViewMatrix), XMLoadFloat4x4(&shadowProjectionMatrix)));
+		for (unsigned int i = 0; i < entities.size(); i++)
+		{
+			XMFLOAT3 center, extents;
+			frustumCuller.GetBounds(i, center, extents);
+			renderQueue.Add(RenderQueue::MakeKey(RENDER_PASS_SHADOW, 0, 0, entityDrawIds[i].mesh, projectedDepth(shadowViewProj, center)), i);
+		}
+	}
+
+	XMFLOAT4X4 view = mainCamera->GetViewMatrix();
+	XMFLOAT4X4 proj = mainCamera->GetProjectionMatrix();
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&proj)));
+	for (unsigned int i : visibleEntities)
+	{
+		XMFLOAT3 center, extents;
+		frustumCuller.GetBounds(i, center, extents);
+		const EntityDrawIds& ids = entityDrawIds[i];
+		renderQueue.Add(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, ids.shader, ids.material, ids.mesh, projectedDepth(viewProj, center)), i);
+	}
+
+	renderQueue.Sort();
+
+	// one instance per queued item, in queue order, so a batch's
+	// first item index is also its first instance
+	const std::vector<RenderItem>& items = renderQueue.GetItems();
+	size_t opaqueBegin = renderQueue.GetPassBegin(RENDER_PASS_OPAQUE);
+	instanceBuffer.Clear();
+
+	// per object light lists are made with the instances that carry them
+	bool objectLightLists = lightCulling == LIGHT_CULLING_PER_OBJECT;
+	if (objectLightLists)
+		objectLights.Begin(lights.data(), (unsigned int)std::min(lights.size(), (size_t)MAX_LIGHTS));
+
+	for (size_t q = 0; q < items.size(); q++)
+	{
+		Entity* entity = entities[items[q].entity];
+		InstanceData instance = {};
+		instance.world = entity->GetTransform()->GetWorldMatrix();
+
+		// the shadow pass only reads the world matrix
+		if (q >= opaqueBegin)
+		{
+			XMFLOAT4X4 invTransposeWorld = entity->GetTransform()->GetInverseTransposeWorldMatrix();
+			for (int r = 0; r < 3; r++)
+				instance.normalMatrix[r] = XMFLOAT4(invTransposeWorld.m[r][0], invTransposeWorld.m[r][1], invTransposeWorld.m[r][2], 0.0f);
+			Material* mat = entity->GetMaterial();
+			instance.colorTint = mat->GetColorTint();
+			instance.material = XMFLOAT4((float)mat->GetTextureArraySlice(), mat->GetSpecularIntensity(), 0.0f, 0.0f);
+
+			if (objectLightLists)
+			{
+				XMFLOAT3 center, extents;
+				frustumCuller.GetBounds(items[q].entity, center, extents);
+				unsigned int lightCount = 0;
+				instance.material.z = (float)objectLights.Add(center, extents, lightCount);
+				instance.material.w = (float)lightCount;
+			}
+		}
+		instanceBuffer.Add(instance);
+	}
+	instanceBuffer.Upload(device.Get(), renderDevice);
+
+	// edited materials write their constants before anything binds them
+	for (Material* material : materials)
+		material->UploadConstants(renderDevice);
+
+	if (gpuCullingActive)
+		PrepareGpuCulling(renderDevice);
+}
+
+// --------------------------------------------------------
+// Bins the frame's lights for the main camera and uploads
+// the grid and its index list for the toon shaders - per
+// object lists are already made, and only need uploading
+// --------------------------------------------------------
+void Game::BuildLightGrid(RenderDevice* renderDevice)
+{
+	if (lightCulling == LIGHT_CULLING_PER_OBJECT)
+	{
+		// the grid isn't read, but its view still has to exist
+		const std::vector<unsigned int>& indices = objectLights.GetIndices();
+		lightGridCells.Upload(device.Get(), renderDevice, 0, 0);
+		lightIndexBuffer.Upload(device.Get(), renderDevice, indices.data(), (unsigned int)indices.size());
+		return;
+	}
+
+	// the indices point into FrameData's lights, which holds MAX_LIGHTS
+	unsigned int lightCount = (unsigned int)std::min(lights.size(), (size_t)MAX_LIGHTS);
+	if (lightCulling == LIGHT_CULLING_CLUSTERED)
+	{
+		lightGrid.SetProjection(mainCamera->GetProjectionMatrix());
+		lightGrid.Build(mainCamera->GetViewMatrix(), lights.data(), lightCount);
+	}
+	else
+	{
+		lightGrid.BuildUnculled(lights.data(), lightCount);
+	}
+
+	const std::vector<LightGridCell>& cells = lightGrid.GetCells();
+	const std::vector<unsigned int>& indices = lightGrid.GetIndices();
+	lightGridCells.Upload(device.Get(), renderDevice, cells.data(), (unsigned int)cells.size());
+	lightIndexBuffer.Upload(device.Get(), renderDevice, indices.data(), (unsigned int)indices.size());
+}
+
+// --------------------------------------------------------
+// Hands the opaque pass to the GPU culler - one indirect
+// draw per batch, with the batch's items as its objects
+// --------------------------------------------------------
+void Game::PrepareGpuCulling(RenderDevice* renderDevice)
+{
+	const std::vector<RenderItem>& items = renderQueue.GetItems();
+	size_t begin = renderQueue.GetPassBegin(RENDER_PASS_OPAQUE);
+	size_t end = renderQueue.GetPassEnd(RENDER_PASS_OPAQUE);
+
+	// a batch's visible instances are packed where its own instances
+	// start, so the culled buffer has the same layout as the frame's
+	gpuCuller->Clear();
+	for (size_t q = begin; q < end; )
+	{
+		size_t batchEnd = renderQueue.GetBatchEnd(q, end);
+		unsigned int batch = gpuCuller->AddBatch(entities[items[q].entity]->GetMesh()->GetIndexCount(), (unsigned int)q);
+		for (; q < batchEnd; q++)
+		{
+			XMFLOAT3 center, extents;
+			frustumCuller.GetBounds(items[q].entity, center, extents);
+			gpuCuller->AddObject(center, extents, batch, (unsigned int)q);
+		}
+	}
+
+	// if the buffers can't be made the queue is just drawn unculled
+	gpuCullingActive = gpuCuller->Upload(renderDevice, mainCamera->GetFrustumPlanes(), instanceBuffer.GetData(), instanceBuffer.GetCount());
+}
+
+// --------------------------------------------------------
+// Cuts the opaque pass into roughly equal runs of items,
+// always on batch boundaries, so each run can be recorded
+// on its own thread
+// --------------------------------------------------------
+void Game::SplitOpaqueChunks(unsigned int chunkCount)
+{
+	size_t begin = renderQueue.GetPassBegin(RENDER_PASS_OPAQUE);
+	size_t end = renderQueue.GetPassEnd(RENDER_PASS_OPAQUE);
+	size_t target = std::max((size_t)1, (end - begin + chunkCount - 1) / std::max(1u, chunkCount));
+
+	opaqueChunks.clear();
+	size_t chunkBegin = begin;
+	for (size_t q = begin; q < end; )
+	{
+		q = renderQueue.GetBatchEnd(q, end);
+		if (q - chunkBegin >= target || q == end)
+		{
+			DrawChunk chunk = {};
+			chunk.begin = chunkBegin;
+			chunk.end = q;
+			opaqueChunks.push_back(chunk);
+			chunkBegin = q;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Fills the opaque shaders' FrameData for this frame - the
+// chunks only copy it, so it's built once however many
+// chunks and shader changes there are
+// --------------------------------------------------------
+void Game::UpdateFrameConstants()
+{
+	unsigned int lightCount = (unsigned int)std::min(lights.size(), (size_t)MAX_LIGHTS);
+	memcpy(pixelFrameData.lights, lights.data(), sizeof(Light) * lightCount);
+	pixelFrameData.lightCount = (int)lightCount;
+	pixelFrameData.renderShadows = (int)enableShadows;
+	frameVariantBits = ShaderVariants::GetFrameBits(enableShadows, lights.data(), lightCount);
+
+	// the light grid's lookup - zeroed scales put every pixel in cell 0,
+	// which is where the unculled list is
+	bool clustered = lightCulling == LIGHT_CULLING_CLUSTERED;
+	pixelFrameData.objectLightLists = (int)(lightCulling == LIGHT_CULLING_PER_OBJECT);
+	pixelFrameData.directionalCount = (int)(pixelFrameData.objectLightLists ? objectLights.GetDirectionalCount() : lightGrid.GetDirectionalCount());
+	pixelFrameData.clusterSliceScale = clustered ? lightGrid.GetSliceScale() : 0.0f;
+	pixelFrameData.clusterSliceBias = clustered ? lightGrid.GetSliceBias() : 0.0f;
+	pixelFrameData.clusterTileScale = clustered ?
+		XMFLOAT2((float)LIGHT_GRID_X / width, (float)LIGHT_GRID_Y / height) : XMFLOAT2(0.0f, 0.0f);
+
+	// toon point and spot lights add their ambient to every pixel,
+	// wherever they are, so the grid can't cull it
+	XMFLOAT3 localAmbient(0.0f, 0.0f, 0.0f);
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		if (lights[i].enabled && (lights[i].type == TYPE_POINT || lights[i].type == TYPE_SPOT))
+		{
+			localAmbient.x += lights[i].ambientColor.x;
+			localAmbient.y += lights[i].ambientColor.y;
+			localAmbient.z += lights[i].ambientColor.z;
+		}
+	}
+	pixelFrameData.localAmbient = localAmbient;
+
+	vertexFrameData.shadowView = shadowViewMatrix;
+	vertexFrameData.shadowProjection = shadowProjectionMatrix;
+}
+
+// --------------------------------------------------------
+// Submits [begin, end) of the opaque pass as instanced batches,
+// only rebinding what changed between neighbouring batches
+//  - shader: frame and pass constants, shared samplers and textures
+//  - material: the material's binding set (constants, textures, sampler)
+//  - mesh: vertex/index buffers
+//  - world, normal matrix and tint come from the instance buffer
+//  - gpuCulled draws every batch indirectly from the GPU culler's
+//    instances, which only works on the whole pass in one go
+// --------------------------------------------------------
+void Game::DrawRenderQueue(StateCache* stateCache, size_t begin, size_t end, RenderQueueStats& stats, bool gpuCulled)
+{
+	const std::vector<RenderItem>& items = renderQueue.GetItems();
+
+	PixelShaderPassData pixelPassData = {};
+	pixelPassData.cameraPos = mainCamera->GetTransform()->GetPosition();
+	VertexShaderPassData vertexPassData = {};
+	vertexPassData.view = mainCamera->GetViewMatrix();
+	vertexPassData.projection = mainCamera->GetProjectionMatrix();
+
+	if (gpuCulled)
+		gpuCuller->BindInstances(stateCache);
+	else
+		stateCache->SetVertexBuffer(1, instanceBuffer.GetBuffer(), sizeof(InstanceData), 0);
+	unsigned int batchIndex = 0;
+
+	// nothing is assumed to be bound at the start of the chunk
+	unsigned int lastShader = UINT_MAX;
+	unsigned int lastMaterial = UINT_MAX;
+	unsigned int lastMesh = UINT_MAX;
+	for (size_t q = begin; q < end; )
+	{
+		size_t batchEnd = renderQueue.GetBatchEnd(q, end);
+		unsigned int instanceCount = (unsigned int)(batchEnd - q);
+
+		uint64_t key = items[q].key;
+		Entity* entity = entities[items[q].entity];
+		Material* mat = entity->GetMaterial();
+		Mesh* mesh = entity->GetMesh();
+		int arrayGroup = enableTextureArrays ? mat->GetTextureArrayGroup() : -1;
+		SimpleVertexShader* vs = mat->GetVertexShader();
+		SimplePixelShader* ps = GetOpaquePixelShader(mat, arrayGroup, frameVariantBits);
+
+		// the rest of the batch never needs its own binds
+		stats.shaderSkips += instanceCount - 1;
+		stats.materialSkips += instanceCount - 1;
+		stats.meshSkips += instanceCount - 1;
+
+		unsigned int shaderId = RenderQueue::GetShader(key);
+		if (shaderId != lastShader)
+		{
+			// the frame and pass buckets are uploaded before the shaders
+			// are bound, so binding picks up the fresh copies
+			ps->WriteBufferData(pixelFrameData);
+			ps->WriteBufferData(pixelPassData);
+			vs->WriteBufferData(vertexFrameData);
+			vs->WriteBufferData(vertexPassData);
+
+			ToonShaderHandles handles = GetToonShaderHandles(ps);
+			vs->SetShader();
+			ps->SetShader();
+			ps->SetSamplerState(handles.clampSampler, clampSampler.Get());
+			ps->SetSamplerState(handles.shadowSampler, shadowSampler.Get());
+			ps->SetShaderResourceView(handles.rampMap, toonRamp_SRV.Get());
+			ps->SetShaderResourceView(handles.specularRampMap, specularToonRamp_SRV.Get());
+			ps->SetShaderResourceView(handles.shadowMap, frameGraph->GetSRV(shadowMapTarget));
+			ps->SetShaderResourceView(handles.lightGrid, lightGridCells.GetSRV());
+			ps->SetShaderResourceView(handles.lightIndices, lightIndexBuffer.GetSRV());
+
+			// binding the shader put its own MaterialData buffer in the
+			// material's slot, so the material is bound again below
+			lastShader = shaderId;
+			lastMaterial = UINT_MAX;
+			stats.shaderBinds++;
+		}
+		else
+		{
+			stats.shaderSkips++;
+		}
+
+		unsigned int materialId = RenderQueue::GetMaterial(key);
+		if (materialId != lastMaterial)
+		{
+			// a texture array group binds the same way for all its materials
+			if (arrayGroup >= 0)
+				texturePacker->Bind(stateCache, (unsigned int)arrayGroup);
+			else
+				mat->Bind(stateCache);
+
+			lastMaterial = materialId;
+			stats.materialBinds++;
+		}
+		else
+		{
+			stats.materialSkips++;
+		}
+
+		unsigned int meshId = RenderQueue::GetMesh(key);
+		if (meshId != lastMesh)
+		{
+			stateCache->SetVertexBuffer(0, mesh->GetVertexBuffer().Get(), sizeof(Vertex), 0);
+			stateCache->SetIndexBuffer(mesh->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+
+			lastMesh = meshId;
+			stats.meshBinds++;
+		}
+		else
+		{
+			stats.meshSkips++;
+		}
+
+		// the batch's instances start at its first queue item
+		if (gpuCulled)
+			gpuCuller->Draw(stateCache->GetDevice(), batchIndex++);
+		else
+			stateCache->GetDevice()->DrawIndexedInstanced(mesh->GetIndexCount(), instanceCount, 0, 0, (UINT)q);
+		stats.draws++;
+		stats.instances += instanceCount;
+		q = batchEnd;
+	}
 }
 
 void Game::UpdateShadowMapView()
@@ -862,67 +1938,208 @@ void Game::OnResize()
 		mainCamera->UpdateProjectionMatrix((float)this->width / this->height);
 	}
 
-	// resize post process resources
-	ResizePostProcessResources();
+	// the base class rebound the render targets directly
+	if (stateCache)
+		stateCache->Invalidate();
 }
 
 // --------------------------------------------------------
-// Update your game here - user input, move objects, AI, etc.
+// Record/replay and camera path runs
+//  - F5 starts/stops recording input to input.rec
+//  - F6 replays input.rec, F7 flies along camera.path
+//  - Both runs use a fixed time step, and report their frame
+//    times when they finish so builds can be compared
 // --------------------------------------------------------
-void Game::Update(float deltaTime, float totalTime)
+void Game::UpdatePerfRun(float& deltaTime, float frameTime)
 {
-	// update entities transformation
+	bool idle = input.GetMode() == INPUT_MODE_LIVE && !playingCameraPath;
 
-	// floor
-	entities[0]->GetTransform()->SetPosition(0.0f, -5.0f, 0.0f);
-	entities[0]->GetTransform()->SetScale(15.0f, 1.0f, 15.f);
+	if (input.LiveKeyPressed(VK_F5) && !playingCameraPath)
+	{
+		if (input.GetMode() == INPUT_MODE_RECORD)
+		{
+			std::string file = GetFullPathTo("input.rec");
+			unsigned int frames = input.GetFrameCount();
+			bool saved = input.StopRecording(file);
+			printf("Recorded %u frames to %s%s\n", frames, file.c_str(), saved ? "" : " (FAILED)");
+		}
+		else if (idle)
+		{
+			RunState state;
+			CaptureRunState(state);
+			input.StartRecording(&state, sizeof(state));
+			deltaTime = INPUT_FIXED_DELTA_TIME;
+		}
+	}
 
-	// front wall
-	entities[1]->GetTransform()->SetPosition(0.0f, -0.5f, -8.0f);
-	entities[1]->GetTransform()->SetScale(15.0f, 10.0f, 1.0f);
+	if (idle && input.LiveKeyPressed(VK_F6)) { runReplayFile = GetFullPathTo("input.rec"); }
+	if (idle && input.LiveKeyPressed(VK_F7)) { runPathFile = GetFullPathTo("camera.path"); }
 
-	// back wall
-	entities[2]->GetTransform()->SetPosition(0.0f, -0.5f, 8.0f);
-	entities[2]->GetTransform()->SetScale(15.0f, 10.0f, 1.0f);
+	// start whatever was requested, this frame is the first one of the run
+	if (idle && !runReplayFile.empty())
+	{
+		if (input.StartReplay(runReplayFile) && input.GetReplayState().size() == sizeof(RunState))
+		{
+			RestoreRunState(*(const RunState*)input.GetReplayState().data());
+			deltaTime = INPUT_FIXED_DELTA_TIME;
+			runFrameTimes.clear();
+		}
+		else
+		{
+			input.StopReplay();
+			printf("Couldn't replay %s\n", runReplayFile.c_str());
+		}
+		runReplayFile.clear();
+	}
+	else if (idle && !runPathFile.empty())
+	{
+		if (!cameraPath.LoadFromFile(runPathFile))
+		{
+			// a lap around the room
+			cameraPath.Clear();
+			cameraPath.AddKey(0.0f, XMFLOAT3(0.0f, -2.0f, 4.5f), XMFLOAT3(0.05f, XM_PI, 0.0f));
+			cameraPath.AddKey(3.0f, XMFLOAT3(-5.0f, -2.0f, 3.0f), XMFLOAT3(0.1f, 2.4f, 0.0f));
+			cameraPath.AddKey(6.0f, XMFLOAT3(-5.0f, -1.0f, -4.0f), XMFLOAT3(0.2f, 1.2f, 0.0f));
+			cameraPath.AddKey(9.0f, XMFLOAT3(5.0f, -1.0f, -4.0f), XMFLOAT3(0.2f, -0.6f, 0.0f));
+			cameraPath.AddKey(12.0f, XMFLOAT3(5.0f, -2.0f, 3.0f), XMFLOAT3(0.1f, -2.2f, 0.0f));
+			cameraPath.AddKey(15.0f, XMFLOAT3(0.0f, -2.0f, 4.5f), XMFLOAT3(0.05f, -XM_PI, 0.0f));
+		}
+
+		playingCameraPath = true;
+		cameraPathTime = 0.0f;
+		deltaTime = INPUT_FIXED_DELTA_TIME;
+		runFrameTimes.clear();
+		runPathFile.clear();
+	}
 
-	// left wall
-	entities[3]->GetTransform()->SetPosition(-8.0f, -0.5f, 0.0f);
-	entities[3]->GetTransform()->SetScale(1.0f, 10.0f, 17.0f);
+	// track the run, and wrap it up once it's over
+	if (input.GetMode() == INPUT_MODE_REPLAY)
+	{
+		runFrameTimes.push_back(frameTime * 1000.0f);
+	}
+	else if (input.IsReplayFinished())
+	{
+		FinishPerfRun("replay");
+	}
 
-	// right wall
-	entities[4]->GetTransform()->SetPosition(8.0f, -0.5f, 0.0f);
-	entities[4]->GetTransform()->SetScale(1.0f, 10.0f, 17.0f);
+	if (playingCameraPath)
+	{
+		deltaTime = INPUT_FIXED_DELTA_TIME;
+		if (cameraPathTime > cameraPath.GetDuration())
+		{
+			playingCameraPath = false;
+			FinishPerfRun("camera path");
+		}
+		else
+		{
+			runFrameTimes.push_back(frameTime * 1000.0f);
+		}
+	}
+}
 
-	// tv table
-	entities[5]->GetTransform()->SetScale(0.02f, 0.02f, 0.02f);
-	entities[5]->GetTransform()->SetPosition(0.0f, -4.5f, -4.5f);
+void Game::FinishPerfRun(const char* name)
+{
+	if (!runFrameTimes.empty())
+	{
+		// the first frame's time belongs to whatever ran before the run started
+		std::vector<float> times(runFrameTimes.begin() + 1, runFrameTimes.end());
+		if (times.empty())
+			times = runFrameTimes;
+		std::sort(times.begin(), times.end());
+
+		float total = 0.0f;
+		for (float t : times) { total += t; }
+		float average = total / times.size();
+		float p95 = times[(times.size() - 1) * 95 / 100];
+
+		printf("%s: %u frames, avg %.3f ms, min %.3f ms, p95 %.3f ms, max %.3f ms\n",
+			name, (unsigned int)times.size(), average, times.front(), p95, times.back());
+
+		// one line per run, tagged with the build, for comparing builds later
+		std::ofstream csv(GetFullPathTo("perf_runs.csv"), std::ios::app);
+		csv << __DATE__ << " " << __TIME__ << "," << name << "," << times.size() << ","
+			<< average << "," << times.front() << "," << p95 << "," << times.back() << "\n";
+	}
 
-	// sofa
-	entities[6]->GetTransform()->SetScale(0.03f, 0.03f, 0.03f);
-	entities[6]->GetTransform()->SetPosition(0.0f, -4.5f, 4.5f);
+	runFrameTimes.clear();
 
-	// tv
-	entities[7]->GetTransform()->SetScale(5.0f, 5.0f, 5.0f);
-	entities[7]->GetTransform()->SetPitchYawRoll(0.0f, XM_PI, 0.0f);
-	entities[7]->GetTransform()->SetPosition(0.0f, -2.85f, -4.5f);
+	if (quitAfterRun)
+		Quit();
+}
 
-	// coffee table
-	entities[8]->GetTransform()->SetScale(1.5f, 1.5f, 1.5f);
-	entities[8]->GetTransform()->SetPosition(0.0f, -4.6f, 0.0f);
+void Game::CaptureRunState(RunState& state)
+{
+	state.cameraPosition = mainCamera->GetTransform()->GetPosition();
+	state.cameraRotation = mainCamera->GetTransform()->GetPitchYawRoll();
+	state.controlMode = controlMode;
+	state.dirLightDirection = dirLightDirection;
+	state.pointLightPosition = pointLightPosition;
+	state.pointLightRange = pointLightRange;
+	state.spotLightDirection = spotLightDirection;
+	state.spotLightPosition = spotLightPosition;
+	state.spotLightRange = spotLightRange;
+	state.spotLightFalloff = spotLightFalloff;
+	for (size_t i = 0; i < 3; i++)
+	{
+		state.lightEnabled[i] = i < lights.size() ? lights[i].enabled : 0;
+	}
+	state.enableShadows = enableShadows ? 1 : 0;
+	state.enableOcclusionCulling = enableOcclusionCulling ? 1 : 0;
+}
 
-	// newton's cradle
-	entities[9]->GetTransform()->SetScale(0.05f, 0.05f, 0.05f);
-	entities[9]->GetTransform()->SetPosition(0.0f, -2.95f, 0.0f);
+void Game::RestoreRunState(const RunState& state)
+{
+	mainCamera->GetTransform()->SetPosition(state.cameraPosition.x, state.cameraPosition.y, state.cameraPosition.z);
+	mainCamera->GetTransform()->SetPitchYawRoll(state.cameraRotation.x, state.cameraRotation.y, state.cameraRotation.z);
+	mainCamera->UpdateViewMatrix();
+	controlMode = state.controlMode;
+	dirLightDirection = state.dirLightDirection;
+	pointLightPosition = state.pointLightPosition;
+	pointLightRange = state.pointLightRange;
+	spotLightDirection = state.spotLightDirection;
+	spotLightPosition = state.spotLightPosition;
+	spotLightRange = state.spotLightRange;
+	spotLightFalloff = state.spotLightFalloff;
+	enableShadows = state.enableShadows != 0;
+	enableOcclusionCulling = state.enableOcclusionCulling != 0;
+
+	// rebuild the lights from the restored values
+	lights.clear();
+	GenerateLights();
+	for (size_t i = 0; i < 3 && i < lights.size(); i++)
+	{
+		lights[i].enabled = state.lightEnabled[i];
+	}
+	UpdateShadowMapView();
+}
 
-	// claymore sword
-	entities[10]->GetTransform()->SetScale(0.05f, 0.05f, 0.05f);
-	entities[10]->GetTransform()->SetPosition(1.0f, -3.76f, 0.0f);
-	entities[10]->GetTransform()->SetPitchYawRoll(-0.01f, XM_PI/4, 0.0f);
+// --------------------------------------------------------
+// Update your game here - user input, move objects, AI, etc.
+// --------------------------------------------------------
+void Game::Update(float deltaTime, float totalTime)
+{
+	// the measured frame time is kept for perf runs, since
+	// recording/replaying swaps deltaTime for a fixed step
+	float frameTime = deltaTime;
+	input.BeginFrame(this->hWnd, deltaTime);
+	UpdatePerfRun(deltaTime, frameTime);
 
 	// update the camera
 	if (mainCamera)
 	{
-		mainCamera->Update(deltaTime, this->hWnd, controlMode);
+		if (playingCameraPath)
+		{
+			XMFLOAT3 position, rotation;
+			cameraPath.Evaluate(cameraPathTime, position, rotation);
+			mainCamera->GetTransform()->SetPosition(position.x, position.y, position.z);
+			mainCamera->GetTransform()->SetPitchYawRoll(rotation.x, rotation.y, rotation.z);
+			mainCamera->UpdateViewMatrix();
+			cameraPathTime += deltaTime;
+		}
+		else
+		{
+			mainCamera->Update(deltaTime, input, controlMode);
+		}
 	}
 
 	if (controlMode > 0)
@@ -930,70 +2147,306 @@ void Game::Update(float deltaTime, float totalTime)
 		LightControl(deltaTime);
 	}
 
-	if (GetAsyncKeyState('1') & 0x8000) { ToggleLights(1); }
-	if (GetAsyncKeyState('2') & 0x8000) { ToggleLights(2); }
-	if (GetAsyncKeyState('3') & 0x8000) { ToggleLights(3); }
+	if (input.KeyDown('1')) { ToggleLights(1); }
+	if (input.KeyDown('2')) { ToggleLights(2); }
+	if (input.KeyDown('3')) { ToggleLights(3); }
 
-	bool currentTab = (GetAsyncKeyState(VK_TAB) & 0x8000) != 0;
-	if(currentTab && !prevTab)
+	if (input.KeyPressed(VK_TAB))
 	{
 		controlMode++;
 		controlMode = controlMode % (CONTROL_MODE_MOVE_SPOTLIGHT + 1);
 	}
 
-	bool currentV = (GetAsyncKeyState('V') & 0x8000) != 0;
-	if (currentV && !prevV) { enableShadows = !enableShadows; }
-
-	prevTab = currentTab;
-	prevV = currentV;
+	// the opaque pass picks the shadowed or unshadowed variants from this
+	if (input.KeyPressed('V')) { enableShadows = !enableShadows; }
+	if (input.KeyPressed('O')) { enableOcclusionCulling = !enableOcclusionCulling; }
+	if (input.KeyPressed('M')) { enableParallelRecording = !enableParallelRecording; }
+	if (input.KeyPressed('G')) { enableGpuCulling = !enableGpuCulling; }
+	if (input.KeyPressed('Z')) { enableDepthPrepass = !enableDepthPrepass; }
+	if (input.KeyPressed('C')) { lightCulling = (lightCulling + 1) % LIGHT_CULLING_MODE_COUNT; }
+	if (input.KeyPressed('T'))
+	{
+		enableTextureArrays = !enableTextureArrays;
+		BuildEntityDrawIds();
+	}
+	if (input.KeyPressed(VK_F8) && captureFramesLeft == 0)
+	{
+		captureFramesLeft = input.KeyDown(VK_SHIFT) ? CAPTURE_LONG_FRAME_COUNT : 1;
+		frameCapture->Begin();
+	}
 
 	// Quit if the escape key is pressed
-	if (GetAsyncKeyState(VK_ESCAPE))
+	if (input.LiveKeyDown(VK_ESCAPE))
 		Quit();
 }
 
 // --------------------------------------------------------
-// Clear the screen, redraw everything, present to the user
+// Collects the counters the frame's jobs kept on their own
+// threads, for the queue and for the UI's next frame
 // --------------------------------------------------------
-void Game::Draw(float deltaTime, float totalTime)
+void Game::GatherFrameStats()
 {
+	renderQueue.MergeStats(shadowStats);
+	renderQueue.MergeStats(depthPrepassStats);
+	for (DrawChunk& chunk : opaqueChunks)
+		renderQueue.MergeStats(chunk.stats);
+	frameQueueStats = renderQueue.GetStats();
+
+	for (int i = 0; i < STATE_CALL_COUNT; i++)
+	{
+		frameStateCallsIssued[i] = stateCache->GetIssuedCount(i);
+		frameStateCallsFiltered[i] = stateCache->GetFilteredCount(i);
+		for (unsigned int t = 0; t < commandRecorder->GetThreadCount(); t++)
+		{
+			frameStateCallsIssued[i] += commandRecorder->GetStateCache(t)->GetIssuedCount(i);
+			frameStateCallsFiltered[i] += commandRecorder->GetStateCache(t)->GetFilteredCount(i);
+		}
+	}
+
+	// constants written to the rings - every upload is a new allocation
+	frameConstantBytes = 0;
+	frameConstantAllocations = 0;
+	for (unsigned int t = 0; t <= commandRecorder->GetThreadCount(); t++)
+	{
+		D3D11RenderDevice* ringDevice = t == 0 ? renderDevice : commandRecorder->GetDevice(t - 1);
+		ConstantBufferRing* ring = ringDevice->GetConstantRing();
+		if (!ring)
+			continue;
+		frameConstantBytes += ring->GetBytesWritten();
+		frameConstantAllocations += ring->GetAllocationCount();
+	}
+
+	// each shader's constant buffer uploads, counted again next frame
+	std::pair<const char*, ISimpleShader*> shaders[] = {
+		{ "VertexShader", vertexShader }, { "PixelShader", pixelShader },
+		{ "TextureArrayPS", textureArrayPS }, { "ShadowMapVS", shadowVS },
+		{ "SkyVS", skyVertexShader }, { "SkyPS", skyPixelShader },
+		{ "PostProcessVS", ppVS }, { "PostProcessPS", ppPS }, { "GpuCullCS", gpuCullCS } };
+	frameShaderUploads.clear();
+	for (auto& shader : shaders)
+	{
+		frameShaderUploads.push_back(std::make_pair(shader.first, shader.second->GetUploadStats()));
+		shader.second->ResetUploadStats();
+	}
+
+	// a shader's variants are counted as one
+	std::pair<const char*, ShaderVariants*> variantSets[] = {
+		{ "PixelShader variants", pixelShaderVariants }, { "TextureArrayPS variants", textureArrayVariants } };
+	for (auto& set : variantSets)
+	{
+		SimpleUploadStats total = {};
+		for (SimplePixelShader* variant : set.second->GetCreated())
+		{
+			SimpleUploadStats stats = variant->GetUploadStats();
+			total.Uploads += stats.Uploads;
+			total.CleanSkips += stats.CleanSkips;
+			total.Bytes += stats.Bytes;
+			total.RingAllocations += stats.RingAllocations;
+			total.DiscardMaps += stats.DiscardMaps;
+			total.PartialUpdates += stats.PartialUpdates;
+			total.FullUpdates += stats.FullUpdates;
+			variant->ResetUploadStats();
+		}
+		frameShaderUploads.push_back(std::make_pair(set.first, total));
+	}
+}
+
+// --------------------------------------------------------
+// Runs the frame's jobs through the recording device in
+// front of the real one and adds them to the capture, which
+// is saved to frame.trace once the last frame is in
+// --------------------------------------------------------
+void Game::SubmitCapturedFrame()
+{
+	ISimpleShader::SetStateCache(captureCache);
+	commandRecorder->Submit(context.Get(), captureCache, false);
+	ISimpleShader::SetStateCache(stateCache);
+
+	// the real device was driven behind the main cache's back
+	stateCache->Invalidate();
+
+	frameCapture->AddFrame(captureDevice);
+	for (const std::string& message : captureDevice->GetErrorMessages())
+		printf("  %s\n", message.c_str());
+
+	if (--captureFramesLeft > 0)
+		return;
+
+	FrameTrace& trace = frameCapture->GetTrace();
+	std::string file = GetFullPathTo("frame.trace");
+	bool saved = frameCapture->Save(file);
+	printf("Captured %u frames to %s%s: %u objects, %u blobs (%llu bytes, %llu more shared), last frame %u calls, %u draws, %u errors\n",
+		trace.GetFrameCount(), file.c_str(), saved ? "" : " (FAILED)",
+		trace.GetObjectCount(), trace.GetBlobCount(),
+		(unsigned long long)trace.GetBlobBytes(), (unsigned long long)trace.GetSharedBytes(),
+		(unsigned int)captureDevice->GetCommands().size(), captureDevice->GetDrawCount(), captureDevice->GetErrorCount());
+	if (saved)
+	{
+		printf("Replay it with: DX11Starter.exe -tracereplay %s [-loops N]\n", file.c_str());
+		printf("or on the null device: DX11Checks -tracereplay %s [-loops N]\n", file.c_str());
+	}
+}
+
+// --------------------------------------------------------
+// Declares the frame's passes and the targets between them,
+// and compiles the graph - passes nothing needs are culled
+// (the shadow pass, with shadows off) and the targets are
+// handed out from the graph's pool at the current size
+// --------------------------------------------------------
+void Game::BuildFrameGraph()
+{
+	frameGraph->Reset();
+
+	// the swap chain's targets are what the frame is for
+	unsigned int backBuffer = frameGraph->ImportTexture("BackBuffer", backBufferRTV.Get(), 0, 0);
+	unsigned int depthBuffer = frameGraph->ImportTexture("DepthBuffer", 0, depthStencilView.Get(), 0);
+
+	FrameGraphTextureDesc desc = {};
+	desc.width = shadowMapSize;
+	desc.height = shadowMapSize;
+	desc.format = DXGI_FORMAT_R32_TYPELESS; // bound as depth and sampled as a float
+	desc.viewFormat = DXGI_FORMAT_R32_FLOAT;
+	desc.depthFormat = DXGI_FORMAT_D32_FLOAT;
+	desc.bindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	shadowMapTarget = frameGraph->CreateTexture("ShadowMap", desc);
+
+	desc = {};
+	desc.width = width;
+	desc.height = height;
+	desc.bindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	desc.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	sceneColorTarget = frameGraph->CreateTexture("SceneColor", desc);
+	desc.format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	sceneNormalsTarget = frameGraph->CreateTexture("SceneNormals", desc);
+	desc.format = DXGI_FORMAT_R32_FLOAT;
+	sceneDepthTarget = frameGraph->CreateTexture("SceneDepth", desc);
+
 	// Render shadow map
-	if(enableShadows)
-		RenderShadowMap();
+	shadowStats = {};
+	unsigned int pass = frameGraph->AddPass("Shadow");
+	frameGraph->Write(pass, shadowMapTarget);
+	frameGraph->AddJob(pass, [this](ID3D11DeviceContext*, StateCache* s) { RenderShadowMap(s, shadowStats); });
+
+	// opaque MRT - clears, GPU culling, depth pre-pass and the queue
+	pass = frameGraph->AddPass("Opaque");
+	if (enableShadows)
+		frameGraph->Read(pass, shadowMapTarget);
+	frameGraph->Write(pass, sceneColorTarget);
+	frameGraph->Write(pass, sceneNormalsTarget);
+	frameGraph->Write(pass, sceneDepthTarget);
+	frameGraph->Write(pass, depthBuffer);
+	frameGraph->Write(pass, backBuffer);
 
 	// clear render target and depth buffer
-	PreRender();
-
-	// loop through entity list and draw them
-	for (size_t i = 0; i < entities.size(); i++) 
-	{
-		// Set data for each entity since there are multiple shader files
-		SimpleVertexShader * entityVS = entities[i]->GetMaterial()->GetVertexShader();
-		SimplePixelShader * entityPS = entities[i]->GetMaterial()->GetPixelShader();
-		entityPS->SetData("lights", (void*)(&lights[0]), sizeof(Light) * MAX_LIGHTS);
-		entityPS->SetInt("lightCount", (int)lights.size());
-		entityPS->SetInt("renderShadows", (int)enableShadows);
-		entityPS->SetFloat3("cameraPos", mainCamera->GetTransform()->GetPosition());
-		entityPS->SetFloat("specularIntensity", entities[i]->GetMaterial()->GetSpecularIntensity());
-		entityPS->CopyAllBufferData();
-		entityPS->SetSamplerState("ClampSampler", clampSampler.Get());
-		entityPS->SetSamplerState("shadowSampler", shadowSampler.Get());
-		entityPS->SetShaderResourceView("RampMap", toonRamp_SRV.Get());
-		entityPS->SetShaderResourceView("specularRampMap", specularToonRamp_SRV.Get()); 
-		entityPS->SetShaderResourceView("shadowMap", shadowSRV.Get());
-		entityVS->SetMatrix4x4("shadowView", shadowViewMatrix);
-		entityVS->SetMatrix4x4("shadowProjection", shadowProjectionMatrix);
-		entities[i]->Draw(device, context, mainCamera);
+	frameGraph->AddJob(pass, [this](ID3D11DeviceContext*, StateCache* s) { PreRender(s); });
+
+	// cull on the GPU before anything draws what it keeps
+	if (gpuCullingActive)
+		frameGraph->AddJob(pass, [this](ID3D11DeviceContext*, StateCache* s) { gpuCuller->Dispatch(s); });
+
+	// lay down the depth the opaque pass is then tested EQUAL against
+	depthPrepassStats = {};
+	if (depthPrepassActive)
+		frameGraph->AddJob(pass, [this](ID3D11DeviceContext*, StateCache* s) { RenderDepthPrepass(s, depthPrepassStats); });
+
+	// draw the visible entities in sorted order, a chunk per job
+	for (size_t i = 0; i < opaqueChunks.size(); i++)
+	{
+		frameGraph->AddJob(pass, [this, i](ID3D11DeviceContext*, StateCache* s)
+		{
+			BindSceneTargets(s);
+			if (depthPrepassActive)
+				s->SetDepthStencilState(depthEqualState.Get(), 0);
+			DrawRenderQueue(s, opaqueChunks[i].begin, opaqueChunks[i].end, opaqueChunks[i].stats, gpuCullingActive);
+			if (depthPrepassActive)
+				s->SetDepthStencilState(0, 0);
+		});
 	}
 
 	// draw the SkyBox
-	skyBox->Draw(context, mainCamera);
+	pass = frameGraph->AddPass("Sky");
+	frameGraph->Read(pass, depthBuffer);
+	frameGraph->Write(pass, sceneColorTarget);
+	frameGraph->AddJob(pass, [this](ID3D11DeviceContext*, StateCache* s)
+	{
+		BindSceneTargets(s);
+		skyBox->Draw(s, mainCamera);
+	});
+
+	// post processing - depth/normal outlines
+	pass = frameGraph->AddPass("Outline");
+	frameGraph->Read(pass, sceneColorTarget);
+	frameGraph->Read(pass, sceneNormalsTarget);
+	frameGraph->Read(pass, sceneDepthTarget);
+	frameGraph->Write(pass, backBuffer);
+	frameGraph->AddJob(pass, [this](ID3D11DeviceContext*, StateCache* s) { PostRender(s); });
+
+	// Draw UI - pinned to the thread its sprite batch was made for
+	pass = frameGraph->AddPass("UI");
+	frameGraph->Write(pass, backBuffer);
+	frameGraph->AddJob(pass, [this](ID3D11DeviceContext* c, StateCache* s) { DrawUI(c, s); }, 0);
+
+	// the layout only changes on a resize or a toggle, so it's
+	// only reported then
+	if (frameGraph->Compile())
+		printf("%s\n", frameGraph->GetReport().c_str());
+}
+
+// --------------------------------------------------------
+// Clear the screen, redraw everything, present to the user
+// --------------------------------------------------------
+void Game::Draw(float deltaTime, float totalTime)
+{
+	// figure out what the camera can actually see,
+	// then sort everything that's going to be drawn
+	// a captured frame goes through the recording device from the
+	// start, with nothing assumed to be bound, and runs in order
+	bool capture = captureFramesLeft > 0;
+	if (capture)
+	{
+		captureDevice->Reset();
+		captureCache->Invalidate();
+
+		// earlier ring allocations aren't in the trace, so every
+		// constant buffer is written again inside the frame
+		renderDevice->BeginCommandList();
+	}
+
+	// the culling dispatch isn't something a trace can hold, so
+	// captured frames are culled on the CPU
+	gpuCullingActive = enableGpuCulling && !capture;
+	CullEntities();
+	BuildRenderQueue(capture ? (RenderDevice*)captureDevice : renderDevice);
+	BuildLightGrid(capture ? (RenderDevice*)captureDevice : renderDevice);
+
+	DecideDepthPrepass();
+	UpdateFrameConstants();
+
+	bool parallel = enableParallelRecording && commandRecorder->IsValid() && !capture;
+	SplitOpaqueChunks(parallel && !gpuCullingActive ? commandRecorder->GetThreadCount() : 1);
+
+	stateCache->ResetStats();
+	if (renderDevice->GetConstantRing())
+		renderDevice->GetConstantRing()->ResetStats();
+	for (unsigned int t = 0; t < commandRecorder->GetThreadCount(); t++)
+	{
+		commandRecorder->GetStateCache(t)->ResetStats();
+		if (commandRecorder->GetDevice(t)->GetConstantRing())
+			commandRecorder->GetDevice(t)->GetConstantRing()->ResetStats();
+	}
 
-	// post processing
-	PostRender();
+	// queue up the passes in the order they have to execute - they're
+	// recorded in parallel on deferred contexts, or just run in order
+	// on the immediate context when that's switched off
+	commandRecorder->Clear();
+	BuildFrameGraph();
+	frameGraph->Execute(commandRecorder);
 
-	// Draw UI
-	DrawUI();
+	if (capture)
+		SubmitCapturedFrame();
+	else
+		commandRecorder->Submit(context.Get(), stateCache, parallel);
+	GatherFrameStats();
 
 	// Present the back buffer to the user
 	//  - Puts the final frame we're drawing into the window so the user can see it
@@ -1002,5 +2455,5 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	// Due to the usage of a more sophisticated swap chain,
 	// the render target must be re-bound after every call to Present()
-	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
+	stateCache->SetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
 }
\ No newline at end of file
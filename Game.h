@@ -6,9 +6,28 @@
 #include "Entity.h"
 #include "Camera.h"
 #include "Material.h"
+#include "ShaderVariants.h"
 #include "SimpleShader.h"
 #include "Lights.h"
 #include "SkyBox.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "Input.h"
+#include "CameraPath.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "D3D11RenderDevice.h"
+#include "RecordingRenderDevice.h"
+#include "FrameCapture.h"
+#include "InstanceBuffer.h"
+#include "TypedBuffer.h"
+#include "LightGrid.h"
+#include "ObjectLightLists.h"
+#include "CommandRecorder.h"
+#include "PotentiallyVisibleSet.h"
+#include "TexturePacker.h"
+#include "GpuCuller.h"
+#include "FrameGraph.h"
 #include "WICTextureLoader.h"
 #include "SpriteBatch.h"
 #include "SpriteFont.h"
@@ -21,6 +40,34 @@
 #define CONTROL_MODE_MOVE_POINTLIGHT	2
 #define CONTROL_MODE_MOVE_SPOTLIGHT		3
 
+// frames shift+F8 captures
+#define CAPTURE_LONG_FRAME_COUNT		60
+
+// depth pre-pass heuristic - the estimated overdraw it needs, and what
+// a triangle drawn depth only costs, in toon shaded pixels
+#define DEPTH_PREPASS_MIN_OVERDRAW		1.5f
+#define DEPTH_PREPASS_TRIANGLE_COST		0.25f
+
+// how the toon shaders find the lights that reach a pixel - C cycles them
+#define LIGHT_CULLING_CLUSTERED			0	// the light grid cell it's in
+#define LIGHT_CULLING_PER_OBJECT		1	// its object's own list
+#define LIGHT_CULLING_OFF				2	// every light, everywhere
+#define LIGHT_CULLING_MODE_COUNT		3
+
+// A toon pixel shader's shared bindings, resolved once per shader so
+// binding the shader in a chunk doesn't look names up
+struct ToonShaderHandles
+{
+	SimplePixelShader* shader;
+	SamplerSlotHandle clampSampler;
+	SamplerSlotHandle shadowSampler;
+	SrvSlotHandle rampMap;
+	SrvSlotHandle specularRampMap;
+	SrvSlotHandle shadowMap;
+	SrvSlotHandle lightGrid;
+	SrvSlotHandle lightIndices;
+};
+
 class Game 
 	: public DXCore
 {
@@ -40,26 +87,79 @@ private:
 
 	// Initialization helper methods - feel free to customize, combine, etc.
 	void LoadShaders();
+	bool LoadPackedShaders(const ShaderPack& pack);
+	void ResolveShaderHandles();
+	void LoadShaderVariants();
+	SimplePixelShader* GetOpaquePixelShader(Material* mat, int arrayGroup, unsigned int frameBits);
+	ToonShaderHandles GetToonShaderHandles(SimplePixelShader* shader);
 	void LoadBasicTexture(const wchar_t* file, ID3D11ShaderResourceView** textureSRV);
 	void LoadPBRTexture(const wchar_t* albedoPath, ID3D11ShaderResourceView** albedoSRV, const wchar_t* normalPath, ID3D11ShaderResourceView** normalSRV, const wchar_t* metalPath, ID3D11ShaderResourceView** metalSRV, const wchar_t* roughnessPath, ID3D11ShaderResourceView** roughnessSRV);
 	void LoadTextures();
 	void CreateBasicGeometry();
+	void PlaceEntities();
+	void BuildEntityDrawIds();
+	void CreateOccluders();
+	void CreatePVS();
 	void GenerateLights();
 	void InitializeShadowMap();
 
-	void ResizePostProcessResources();
 
 	void LightControl(float dt);
 	void ToggleLights(int light);
 	void UpdateLights();
 
-	void PreRender();
-	void PostRender();
+	// the passes record through whatever state cache they're given,
+	// whose device may wrap a deferred context on a worker thread
+	void PreRender(StateCache* stateCache);
+	void PostRender(StateCache* stateCache);
 
-	void DrawUI();
+	void CreateUIStates();
+	void DrawUI(ID3D11DeviceContext* context, StateCache* stateCache);
 
-	void RenderShadowMap();
+	void RenderShadowMap(StateCache* stateCache, RenderQueueStats& stats);
+	void InitializeDepthPrepass();
+	void DecideDepthPrepass();
+	void RenderDepthPrepass(StateCache* stateCache, RenderQueueStats& stats);
 	void UpdateShadowMapView();
+
+	void BindSceneTargets(StateCache* stateCache);
+	void SetScreenViewport(RenderDevice* renderDevice);
+
+	void TrackEntityBounds();
+	void RefreshMovedBounds();
+	void CullEntities();
+	void BuildRenderQueue(RenderDevice* renderDevice);
+	void BuildLightGrid(RenderDevice* renderDevice);
+	void SplitOpaqueChunks(unsigned int chunkCount);
+	void UpdateFrameConstants();
+	void PrepareGpuCulling(RenderDevice* renderDevice);
+	void DrawRenderQueue(StateCache* stateCache, size_t begin, size_t end, RenderQueueStats& stats, bool gpuCulled);
+	void GatherFrameStats();
+	void SubmitCapturedFrame();
+	void BuildFrameGraph();
+
+	// everything a recorded run needs to start from the same place
+	struct RunState
+	{
+		DirectX::XMFLOAT3 cameraPosition;
+		DirectX::XMFLOAT3 cameraRotation;
+		int controlMode;
+		DirectX::XMFLOAT3 dirLightDirection;
+		DirectX::XMFLOAT3 pointLightPosition;
+		float pointLightRange;
+		DirectX::XMFLOAT3 spotLightDirection;
+		DirectX::XMFLOAT3 spotLightPosition;
+		float spotLightRange;
+		float spotLightFalloff;
+		int lightEnabled[3];
+		int enableShadows;
+		int enableOcclusionCulling;
+	};
+
+	void UpdatePerfRun(float& deltaTime, float frameTime);
+	void FinishPerfRun(const char* name);
+	void CaptureRunState(RunState& state);
+	void RestoreRunState(const RunState& state);
 	
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -75,9 +175,35 @@ private:
 
 	SimpleVertexShader* ppVS;
 	SimplePixelShader* ppPS;
+	SrvSlotHandle ppPixelsHandle;
+	SrvSlotHandle ppNormalsHandle;
+	SrvSlotHandle ppDepthHandle;
+	SamplerSlotHandle ppSamplerHandle;
+
+	// the toon pixel shaders' shared bindings, resolved up front
+	std::vector<ToonShaderHandles> toonShaderHandles;
 
 	SimpleVertexShader* shadowVS;
 
+	// materials packed into texture arrays share this shader, so their
+	// entities can be drawn in one instanced batch
+	SimplePixelShader* textureArrayPS;
+	TexturePacker* texturePacker;
+	bool enableTextureArrays;
+
+	// specialized builds of the two opaque pixel shaders - each draw
+	// uses the one for its material's keywords plus the frame's
+	ShaderVariants* pixelShaderVariants;
+	ShaderVariants* textureArrayVariants;
+	unsigned int frameVariantBits;
+
+	// frustum culling on the GPU - the opaque pass is drawn indirectly,
+	// from whatever the compute shader kept
+	SimpleComputeShader* gpuCullCS;
+	GpuCuller* gpuCuller;
+	bool enableGpuCulling;
+	bool gpuCullingActive;
+
 	// List of entites
 	std::vector<Entity*> entities;
 	std::vector<Mesh*> meshes;
@@ -85,10 +211,93 @@ private:
 
 	Camera* mainCamera;
 
+	// view frustum culling - indices into entities that survived this frame
+	FrustumCuller frustumCuller;
+	std::vector<unsigned int> visibleEntities;
+	std::vector<unsigned int> movedEntities;	// pushed by the entities' transforms
+
+	// sorted submission - entityDrawIds[i] are the sort key ids for entities[i]
+	struct EntityDrawIds
+	{
+		unsigned int shader;
+		unsigned int material;
+		unsigned int mesh;
+	};
+	RenderQueue renderQueue;
+	std::vector<EntityDrawIds> entityDrawIds;
+
+	// per instance data of every queued item, indexed like the queue's items
+	InstanceBuffer instanceBuffer;
+
+	// light culling - the enabled lights binned into a grid over the view
+	// frustum each frame, or listed per drawn object, so a toon pixel only
+	// visits the lights near it. With it off every light is listed in the
+	// one cell all pixels look in
+	LightGrid lightGrid;
+	ObjectLightLists objectLights;
+	TypedBuffer lightGridCells;
+	TypedBuffer lightIndexBuffer;
+	int lightCulling;
+
+	// drops redundant binds - everything drawn on the immediate context goes through it
+	D3D11RenderDevice* renderDevice;
+	StateCache* stateCache;
+
+	// every state object and input layout, made while loading and
+	// shared by identical descriptions - no frame creates one
+	StateObjectCache* stateObjects;
+
+	// F8 captures the next frame (shift+F8 the next few) to frame.trace,
+	// running them through a RecordingRenderDevice in front of the real one
+	FrameCapture* frameCapture;
+	RecordingRenderDevice* captureDevice;
+	StateCache* captureCache;
+	unsigned int captureFramesLeft;
+
+	// parallel pass recording - each opaque chunk is its own job, and keeps
+	// its own stats until they're merged after the frame is submitted
+	struct DrawChunk
+	{
+		size_t begin;
+		size_t end;
+		RenderQueueStats stats;
+	};
+	CommandRecorder* commandRecorder;
+	std::vector<DrawChunk> opaqueChunks;
+	RenderQueueStats shadowStats;
+	bool enableParallelRecording;
+
+	// the UI is recorded alongside the passes it reports on,
+	// so it shows the previous frame's totals
+	RenderQueueStats frameQueueStats;
+	unsigned int frameStateCallsIssued[STATE_CALL_COUNT];
+	unsigned int frameStateCallsFiltered[STATE_CALL_COUNT];
+	unsigned int frameConstantBytes;
+	unsigned int frameConstantAllocations;
+	std::vector<std::pair<const char*, SimpleUploadStats>> frameShaderUploads;
+
+	// software occlusion culling - occluderIds[i] is the culler's geometry for entities[occluderEntities[i]]
+	OcclusionCuller occlusionCuller;
+	std::vector<unsigned int> occluderEntities;
+	std::vector<int> occluderIds;
+	bool enableOcclusionCulling;
+
+	// precomputed cell visibility for the room
+	PotentiallyVisibleSet pvs;
+	int cameraCell;
+
 	// keep track of modes
 	int controlMode = 0;
-	bool prevTab;
-	bool prevV;
+
+	// input, plus the record/replay and camera path runs built on it
+	Input input;
+	CameraPath cameraPath;
+	bool playingCameraPath;
+	float cameraPathTime;
+	std::string runReplayFile;
+	std::string runPathFile;
+	bool quitAfterRun;
+	std::vector<float> runFrameTimes;
 
 	// controllable vars for lights
 	DirectX::XMFLOAT3 dirLightDirection;
@@ -103,31 +312,54 @@ private:
 
 	bool enableShadows;
 
+	// depth pre-pass - the opaque pass is drawn depth only first, with the
+	// shadow map's vertex shader, then shaded with depth EQUAL and writes
+	// off, so each pixel runs the toon shader once. depthPrepassActive is
+	// this frame's call, which the overdraw heuristic can veto
+	bool enableDepthPrepass;
+	bool depthPrepassActive;
+	float depthPrepassOverdraw;
+	unsigned int depthPrepassTriangles;
+	RenderQueueStats depthPrepassStats;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthEqualState;
+
 	// Sprite batch and sprite font for 2D rendering
 	std::unique_ptr<DirectX::SpriteBatch> spriteBatch;
 	std::unique_ptr<DirectX::SpriteFont> spriteFont;
 	std::unique_ptr<DirectX::SpriteFont> spriteFontLarge;
 
+	// sprite batches are tied to a context, so the UI job (pinned to
+	// the recorder's first thread) gets its own
+	std::unique_ptr<DirectX::SpriteBatch> recorderSpriteBatch;
+
+	// the states the sprite batches draw with, so they don't
+	// create their own on the first frame
+	Microsoft::WRL::ComPtr<ID3D11BlendState> uiBlendState;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> uiSamplerState;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> uiDepthState;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> uiRasterizerState;
+
 	// skybox
 	SkyBox* skyBox;
 
 	// lights
 	std::vector<Light> lights;
 
-	// post processing vars
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> ppRTV;		// Allows us to render to a texture
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ppSRV;		// Allows us to sample from the same texture
+	// the opaque shaders' FrameData, filled once per frame by
+	// UpdateFrameConstants() and written whole by every chunk
+	PixelShaderFrameData pixelFrameData;
+	VertexShaderFrameData vertexFrameData;
 
-	// Depth/normal technique
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> sceneDepthRTV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sceneDepthSRV;
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> sceneNormalsRTV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sceneNormalsSRV;
+	// the frame's passes and the render targets between them - the
+	// handles below are this frame's, made again by BuildFrameGraph()
+	FrameGraph* frameGraph;
+	unsigned int sceneColorTarget;		// lit scene, read by the outline post process
+	unsigned int sceneNormalsTarget;	// depth/normal outline technique
+	unsigned int sceneDepthTarget;
+	unsigned int shadowMapTarget;
 
 	// shadow map resources
 	int shadowMapSize;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
 	DirectX::XMFLOAT4X4 shadowViewMatrix;
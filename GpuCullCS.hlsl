@@ -0,0 +1,74 @@
+// Compute Shader that frustum culls the opaque pass's instances and
+// compacts the visible ones into per batch runs of a vertex buffer
+// - GpuCuller::EmulateCull() is the same kernel on the CPU; keep them in step
+
+// must match sizeof(InstanceData) and GpuCullObject / GPU_CULL_ARGS_STRIDE
+#define INSTANCE_ROWS		9
+#define INSTANCE_STRIDE		144
+#define DRAW_ARGS_STRIDE	20
+
+// camera frustum planes (normals pointing inward) and the object count
+cbuffer CullData : register(b0)
+{
+	float4 planes[6];
+	uint objectCount;
+}
+
+// world space bounds, plus the batch the object draws in and its
+// instance in the source buffer
+struct CullObject
+{
+	float3 center;
+	uint batch;
+	float3 extents;
+	uint instance;
+};
+
+// one InstanceData, as rows of float4s
+struct CullInstance
+{
+	float4 rows[INSTANCE_ROWS];
+};
+
+StructuredBuffer<CullObject> objects		: register(t0);
+StructuredBuffer<CullInstance> instances	: register(t1);
+
+// visible instances, read back as per instance vertex data
+RWByteAddressBuffer visibleInstances		: register(u0);
+
+// DrawIndexedInstancedIndirect arguments, 5 uints per batch:
+// index count, instance count, start index, base vertex, start instance
+RWByteAddressBuffer drawArgs				: register(u1);
+
+// --------------------------------------------------------
+// The entry point (main method) for our compute shader
+// --------------------------------------------------------
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+	if (id.x >= objectCount)
+		return;
+
+	// a box is outside a plane when its center lies further behind the
+	// plane than the box's projected radius onto the plane normal
+	CullObject object = objects[id.x];
+	for (int p = 0; p < 6; p++)
+	{
+		float distance = dot(planes[p].xyz, object.center) + planes[p].w;
+		float radius = dot(abs(planes[p].xyz), object.extents);
+		if (distance + radius < 0.0f)
+			return;
+	}
+
+	// take the next slot in the batch's run - the run starts at the
+	// batch's start instance, which the CPU filled in
+	uint argsOffset = object.batch * DRAW_ARGS_STRIDE;
+	uint slot;
+	drawArgs.InterlockedAdd(argsOffset + 4, 1, slot);
+	uint firstInstance = drawArgs.Load(argsOffset + 16);
+
+	CullInstance instance = instances[object.instance];
+	uint destination = (firstInstance + slot) * INSTANCE_STRIDE;
+	for (int r = 0; r < INSTANCE_ROWS; r++)
+		visibleInstances.Store4(destination + r * 16, asuint(instance.rows[r]));
+}
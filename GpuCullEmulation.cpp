@@ -0,0 +1,43 @@
+#include "GpuCullEmulation.h"
+#include <cmath>
+
+using namespace DirectX;
+
+void GpuCullEmulation::BuildDrawArgs(const std::vector<GpuCullBatch>& batches, std::vector<unsigned int>& argsOut)
+{
+    argsOut.assign(batches.size() * GPU_CULL_ARGS_PER_DRAW, 0);
+    for (size_t b = 0; b < batches.size(); b++)
+    {
+        unsigned int* drawArgs = &argsOut[b * GPU_CULL_ARGS_PER_DRAW];
+        drawArgs[0] = batches[b].indexCount;
+        drawArgs[4] = batches[b].firstInstance;
+    }
+}
+
+// --------------------------------------------------------
+// One object at a time - the GPU fills a batch's run in
+// whatever order its threads finish, this fills it in
+// object order
+// --------------------------------------------------------
+void GpuCullEmulation::Cull(const XMFLOAT4* planes, const GpuCullObject* objects, unsigned int objectCount, const InstanceData* instances, unsigned int* args, InstanceData* visibleOut)
+{
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        const GpuCullObject& object = objects[i];
+
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; p++)
+        {
+            const XMFLOAT4& plane = planes[p];
+            float distance = plane.x * object.center.x + plane.y * object.center.y + plane.z * object.center.z + plane.w;
+            float radius = fabsf(plane.x) * object.extents.x + fabsf(plane.y) * object.extents.y + fabsf(plane.z) * object.extents.z;
+            visible = distance + radius >= 0.0f;
+        }
+        if (!visible)
+            continue;
+
+        unsigned int* drawArgs = &args[object.batch * GPU_CULL_ARGS_PER_DRAW];
+        unsigned int slot = drawArgs[1]++;
+        visibleOut[drawArgs[4] + slot] = instances[object.instance];
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "BufferStructs.h"
+
+// DrawIndexedInstancedIndirect arguments - index count, instance count,
+// start index, base vertex, start instance
+#define GPU_CULL_ARGS_PER_DRAW      5
+#define GPU_CULL_ARGS_STRIDE        (GPU_CULL_ARGS_PER_DRAW * sizeof(unsigned int))
+
+// One object to cull - must match CullObject in GpuCullCS.hlsl
+struct GpuCullObject
+{
+    DirectX::XMFLOAT3 center;
+    unsigned int batch;
+    DirectX::XMFLOAT3 extents;
+    unsigned int instance;
+};
+
+// One indirect draw - its visible instances are packed from firstInstance on
+struct GpuCullBatch
+{
+    unsigned int indexCount;
+    unsigned int firstInstance;
+};
+
+// GpuCullCS.hlsl on the CPU - what GpuCuller falls back to without
+// compute shaders, and the reference for its buffer layouts and
+// argument generation. Nothing here touches D3D
+class GpuCullEmulation
+{
+public:
+    // the initial arguments for a list of batches - nothing visible yet
+    static void BuildDrawArgs(const std::vector<GpuCullBatch>& batches, std::vector<unsigned int>& argsOut);
+
+    // the kernel - args must come from BuildDrawArgs(), and visibleOut
+    // must have room for every batch's instances
+    static void Cull(const DirectX::XMFLOAT4* planes, const GpuCullObject* objects, unsigned int objectCount, const InstanceData* instances, unsigned int* args, InstanceData* visibleOut);
+};
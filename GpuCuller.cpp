@@ -0,0 +1,272 @@
+#include "GpuCuller.h"
+#include <cstring>
+
+using namespace DirectX;
+
+// the kernel copies instances as rows of float4s
+static_assert(sizeof(InstanceData) == 9 * sizeof(XMFLOAT4), "InstanceData no longer matches INSTANCE_ROWS in GpuCullCS.hlsl");
+static_assert(sizeof(GpuCullObject) == 32, "GpuCullObject no longer matches CullObject in GpuCullCS.hlsl");
+
+namespace
+{
+    // copies a GPU buffer into a staging one and reads it back
+    bool ReadBuffer(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Buffer* buffer, std::vector<unsigned char>& dataOut)
+    {
+        D3D11_BUFFER_DESC desc = {};
+        buffer->GetDesc(&desc);
+        desc.Usage = D3D11_USAGE_STAGING;
+        desc.BindFlags = 0;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        desc.MiscFlags = 0;
+        desc.StructureByteStride = 0;
+
+        Microsoft::WRL::ComPtr<ID3D11Buffer> staging;
+        if (FAILED(device->CreateBuffer(&desc, 0, staging.GetAddressOf())))
+            return false;
+        context->CopyResource(staging.Get(), buffer);
+
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        if (FAILED(context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+            return false;
+        dataOut.assign((unsigned char*)mapped.pData, (unsigned char*)mapped.pData + desc.ByteWidth);
+        context->Unmap(staging.Get(), 0);
+        return true;
+    }
+}
+
+GpuCuller::GpuCuller(ID3D11Device* device, SimpleComputeShader* shader)
+{
+    this->device = device;
+    this->shader = shader;
+    instanceCapacity = 0;
+    batchCapacity = 0;
+    memset(planes, 0, sizeof(planes));
+
+    gpu = shader && shader->IsShaderValid() && device->GetFeatureLevel() >= D3D_FEATURE_LEVEL_11_0;
+    if (shader)
+    {
+        objectsHandle = shader->GetShaderResourceViewHandle("objects");
+        instancesHandle = shader->GetShaderResourceViewHandle("instances");
+    }
+}
+
+bool GpuCuller::IsGpu() { return gpu; }
+
+void GpuCuller::Clear()
+{
+    batches.clear();
+    objects.clear();
+}
+
+unsigned int GpuCuller::AddBatch(unsigned int indexCount, unsigned int firstInstance)
+{
+    GpuCullBatch batch = { indexCount, firstInstance };
+    batches.push_back(batch);
+    return (unsigned int)batches.size() - 1;
+}
+
+void GpuCuller::AddObject(XMFLOAT3 center, XMFLOAT3 extents, unsigned int batch, unsigned int instance)
+{
+    GpuCullObject object = { center, batch, extents, instance };
+    objects.push_back(object);
+}
+
+// --------------------------------------------------------
+// (Re)creates the buffers when the frame needs more room
+// than they have
+// --------------------------------------------------------
+bool GpuCuller::Reserve(unsigned int instanceCount, unsigned int batchCount)
+{
+    if (instanceCount <= instanceCapacity && batchCount <= batchCapacity)
+        return true;
+
+    unsigned int newInstances = instanceCapacity > 0 ? instanceCapacity : 64;
+    while (newInstances < instanceCount)
+        newInstances *= 2;
+    unsigned int newBatches = batchCapacity > 0 ? batchCapacity : 16;
+    while (newBatches < batchCount)
+        newBatches *= 2;
+
+    objectBuffer.Reset();
+    objectSRV.Reset();
+    sourceBuffer.Reset();
+    sourceSRV.Reset();
+    visibleBuffer.Reset();
+    visibleUAV.Reset();
+    argsBuffer.Reset();
+    argsUAV.Reset();
+    instanceCapacity = 0;
+    batchCapacity = 0;
+
+    // emulated culling writes the visible instances from the CPU
+    if (!gpu)
+    {
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = newInstances * sizeof(InstanceData);
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        if (FAILED(device->CreateBuffer(&desc, 0, visibleBuffer.GetAddressOf())))
+            return false;
+
+        instanceCapacity = newInstances;
+        batchCapacity = newBatches;
+        return true;
+    }
+
+    // inputs - written every frame
+    D3D11_BUFFER_DESC desc = {};
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    srvDesc.Buffer.FirstElement = 0;
+    srvDesc.Buffer.NumElements = newInstances;
+
+    desc.ByteWidth = newInstances * sizeof(GpuCullObject);
+    desc.StructureByteStride = sizeof(GpuCullObject);
+    if (FAILED(device->CreateBuffer(&desc, 0, objectBuffer.GetAddressOf())) ||
+        FAILED(device->CreateShaderResourceView(objectBuffer.Get(), &srvDesc, objectSRV.GetAddressOf())))
+        return false;
+
+    desc.ByteWidth = newInstances * sizeof(InstanceData);
+    desc.StructureByteStride = sizeof(InstanceData);
+    if (FAILED(device->CreateBuffer(&desc, 0, sourceBuffer.GetAddressOf())) ||
+        FAILED(device->CreateShaderResourceView(sourceBuffer.Get(), &srvDesc, sourceSRV.GetAddressOf())))
+        return false;
+
+    // outputs - raw views, since neither can be a structured buffer
+    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+    uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    uavDesc.Buffer.FirstElement = 0;
+    uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+
+    desc = {};
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.ByteWidth = newInstances * sizeof(InstanceData);
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_UNORDERED_ACCESS;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+    uavDesc.Buffer.NumElements = desc.ByteWidth / 4;
+    if (FAILED(device->CreateBuffer(&desc, 0, visibleBuffer.GetAddressOf())) ||
+        FAILED(device->CreateUnorderedAccessView(visibleBuffer.Get(), &uavDesc, visibleUAV.GetAddressOf())))
+        return false;
+
+    desc.ByteWidth = newBatches * GPU_CULL_ARGS_STRIDE;
+    desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS | D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+    uavDesc.Buffer.NumElements = desc.ByteWidth / 4;
+    if (FAILED(device->CreateBuffer(&desc, 0, argsBuffer.GetAddressOf())) ||
+        FAILED(device->CreateUnorderedAccessView(argsBuffer.Get(), &uavDesc, argsUAV.GetAddressOf())))
+        return false;
+
+    instanceCapacity = newInstances;
+    batchCapacity = newBatches;
+    return true;
+}
+
+// --------------------------------------------------------
+// Writes the frame's objects, source instances and initial
+// draw arguments - emulated culling is done right here
+// --------------------------------------------------------
+bool GpuCuller::Upload(RenderDevice* renderDevice, const XMFLOAT4* planes, const InstanceData* instances, unsigned int instanceCount)
+{
+    memcpy(this->planes, planes, sizeof(this->planes));
+    if (!Reserve(instanceCount, (unsigned int)batches.size()))
+        return false;
+
+    GpuCullEmulation::BuildDrawArgs(batches, args);
+
+    if (!gpu)
+    {
+        emulatedInstances.resize(instanceCount);
+        GpuCullEmulation::Cull(planes, objects.data(), (unsigned int)objects.size(), instances, args.data(), emulatedInstances.data());
+        return instanceCount == 0 ||
+            renderDevice->WriteDynamicBuffer(visibleBuffer.Get(), emulatedInstances.data(), instanceCount * sizeof(InstanceData));
+    }
+
+    if (objects.empty())
+        return true;
+
+    // the whole argument buffer is replaced, so it's padded out to its size
+    args.resize(batchCapacity * GPU_CULL_ARGS_PER_DRAW, 0);
+    renderDevice->UpdateBuffer(argsBuffer.Get(), args.data(), (unsigned int)(args.size() * sizeof(unsigned int)));
+    return renderDevice->WriteDynamicBuffer(objectBuffer.Get(), objects.data(), (unsigned int)(objects.size() * sizeof(GpuCullObject))) &&
+        renderDevice->WriteDynamicBuffer(sourceBuffer.Get(), instances, instanceCount * sizeof(InstanceData));
+}
+
+void GpuCuller::Dispatch(StateCache* stateCache)
+{
+    if (!gpu || objects.empty())
+        return;
+
+    // the visible buffer can't be an input and an output at the same time
+    stateCache->SetVertexBuffer(1, 0, 0, 0);
+
+    GpuCullCSCullData cullData = {};
+    memcpy(cullData.planes, planes, sizeof(planes));
+    cullData.objectCount = (unsigned int)objects.size();
+    shader->WriteBufferData(cullData);
+    shader->SetShader();
+    shader->SetShaderResourceView(objectsHandle, objectSRV.Get());
+    shader->SetShaderResourceView(instancesHandle, sourceSRV.Get());
+    shader->SetUnorderedAccessView("visibleInstances", visibleUAV.Get());
+    shader->SetUnorderedAccessView("drawArgs", argsUAV.Get());
+    shader->DispatchByThreads((unsigned int)objects.size(), 1, 1);
+
+    // unbound again, so the draws can read what was written
+    shader->SetUnorderedAccessView("visibleInstances", 0);
+    shader->SetUnorderedAccessView("drawArgs", 0);
+}
+
+void GpuCuller::BindInstances(StateCache* stateCache)
+{
+    stateCache->SetVertexBuffer(1, visibleBuffer.Get(), sizeof(InstanceData), 0);
+}
+
+void GpuCuller::Draw(RenderDevice* renderDevice, unsigned int batch)
+{
+    if (gpu)
+    {
+        renderDevice->DrawIndexedInstancedIndirect(argsBuffer.Get(), batch * GPU_CULL_ARGS_STRIDE);
+        return;
+    }
+
+    // emulated - the counts are already known, so empty batches are skipped
+    const unsigned int* drawArgs = &args[batch * GPU_CULL_ARGS_PER_DRAW];
+    if (drawArgs[1] > 0)
+        renderDevice->DrawIndexedInstanced(drawArgs[0], drawArgs[1], drawArgs[2], (int)drawArgs[3], drawArgs[4]);
+}
+
+unsigned int GpuCuller::GetBatchCount() { return (unsigned int)batches.size(); }
+unsigned int GpuCuller::GetObjectCount() { return (unsigned int)objects.size(); }
+
+bool GpuCuller::ReadBack(std::vector<unsigned int>& argsOut, std::vector<InstanceData>& visibleOut)
+{
+    if (!gpu)
+    {
+        argsOut = args;
+        visibleOut = emulatedInstances;
+        return true;
+    }
+    if (!argsBuffer || !visibleBuffer)
+        return false;
+
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+    device->GetImmediateContext(context.GetAddressOf());
+    std::vector<unsigned char> argBytes;
+    std::vector<unsigned char> visibleBytes;
+    if (!ReadBuffer(device, context.Get(), argsBuffer.Get(), argBytes) ||
+        !ReadBuffer(device, context.Get(), visibleBuffer.Get(), visibleBytes))
+        return false;
+
+    argsOut.resize(argBytes.size() / sizeof(unsigned int));
+    memcpy(argsOut.data(), argBytes.data(), argsOut.size() * sizeof(unsigned int));
+    visibleOut.resize(visibleBytes.size() / sizeof(InstanceData));
+    memcpy(visibleOut.data(), visibleBytes.data(), visibleOut.size() * sizeof(InstanceData));
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "BufferStructs.h"
+#include "GpuCullEmulation.h"
+#include "RenderDevice.h"
+#include "SimpleShader.h"
+#include "StateCache.h"
+
+// Frustum culls the opaque pass on the GPU (GpuCullCS.hlsl)
+// - The CPU only lists the batches and their objects' bounds; the
+//   kernel tests every object and appends the visible ones to their
+//   batch's run of a vertex buffer, counting them in the batch's
+//   indirect draw arguments
+// - Draws then read their instance counts from the argument buffer,
+//   so the CPU never learns (or waits for) what was visible
+// - Without compute shaders (feature level below 11_0, or a missing
+//   shader) GpuCullEmulation runs the same kernel on the CPU and the
+//   draws are regular instanced ones
+class GpuCuller
+{
+public:
+    GpuCuller(ID3D11Device* device, SimpleComputeShader* shader);
+
+    // true if culling runs on the GPU, false if it's emulated
+    bool IsGpu();
+
+    // CPU side of a frame - batches and objects are listed, then
+    // Upload() writes them along with the source instances
+    void Clear();
+    unsigned int AddBatch(unsigned int indexCount, unsigned int firstInstance);
+    void AddObject(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents, unsigned int batch, unsigned int instance);
+    bool Upload(RenderDevice* renderDevice, const DirectX::XMFLOAT4* planes, const InstanceData* instances, unsigned int instanceCount);
+
+    // runs the kernel - call before any of the frame's Draw()s
+    void Dispatch(StateCache* stateCache);
+
+    // binds the visible instances to input slot 1
+    void BindInstances(StateCache* stateCache);
+
+    // draws one batch's visible instances with the mesh that's bound
+    void Draw(RenderDevice* renderDevice, unsigned int batch);
+
+    unsigned int GetBatchCount();
+    unsigned int GetObjectCount();
+
+    // the frame's draw arguments and visible instances as the draws
+    // will see them - read back from the GPU, so it waits for the
+    // kernel. For checking, not for a frame
+    bool ReadBack(std::vector<unsigned int>& argsOut, std::vector<InstanceData>& visibleOut);
+
+private:
+    bool Reserve(unsigned int instanceCount, unsigned int batchCount);
+
+    ID3D11Device* device;
+    SimpleComputeShader* shader;
+    SrvSlotHandle objectsHandle;
+    SrvSlotHandle instancesHandle;
+    bool gpu;
+
+    std::vector<GpuCullBatch> batches;
+    std::vector<GpuCullObject> objects;
+    std::vector<unsigned int> args;
+    std::vector<InstanceData> emulatedInstances;
+    DirectX::XMFLOAT4 planes[6];
+
+    // capacities grow to the next power of two
+    unsigned int instanceCapacity;
+    unsigned int batchCapacity;
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> objectBuffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> objectSRV;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> sourceBuffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sourceSRV;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> visibleBuffer;
+    Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> visibleUAV;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> argsBuffer;
+    Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> argsUAV;
+};
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "CheckReport.h"
+#include "Checks.h"
+#include "GpuCullerCheck.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // compares each batch's arguments and run of visible instances with
+    // the expected ones - instances carry their index in world._41, and
+    // the kernel fills a run in any order, so runs are compared sorted
+    void CheckBatches(CheckReport& report, const char* label, const std::vector<GpuCullBatch>& batches, const std::vector<std::vector<unsigned int>>& expected,
+        const unsigned int* args, const InstanceData* visible)
+    {
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            const unsigned int* drawArgs = &args[b * GPU_CULL_ARGS_PER_DRAW];
+            std::vector<unsigned int> run;
+            for (unsigned int i = 0; i < drawArgs[1] && i < expected[b].size(); i++)
+                run.push_back((unsigned int)visible[drawArgs[4] + i].world._41);
+            std::sort(run.begin(), run.end());
+
+            bool argsMatch = drawArgs[0] == batches[b].indexCount && drawArgs[2] == 0 && drawArgs[3] == 0 && drawArgs[4] == batches[b].firstInstance;
+            report.Print("%s batch %u: %u visible, expected %u", label, (unsigned int)b, drawArgs[1], (unsigned int)expected[b].size());
+            report.Expect(argsMatch, "%s batch %u: wrong draw arguments", label, (unsigned int)b);
+            report.Expect(drawArgs[1] == expected[b].size() && run == expected[b], "%s batch %u: wrong instances", label, (unsigned int)b);
+        }
+    }
+}
+
+// --------------------------------------------------------
+// Culls a fixed set of objects against a box shaped frustum
+// and checks every batch's count and instances
+// --------------------------------------------------------
+int CheckGpuCulling(const char* cullerName, GpuCullFunction cull)
+{
+    CheckReport report("gpucull");
+
+    // x and y within 10 of the axis, z from 0.1 to 100
+    const XMFLOAT4 planes[6] =
+    {
+        XMFLOAT4(1.0f, 0.0f, 0.0f, 10.0f),
+        XMFLOAT4(-1.0f, 0.0f, 0.0f, 10.0f),
+        XMFLOAT4(0.0f, 1.0f, 0.0f, 10.0f),
+        XMFLOAT4(0.0f, -1.0f, 0.0f, 10.0f),
+        XMFLOAT4(0.0f, 0.0f, 1.0f, -0.1f),
+        XMFLOAT4(0.0f, 0.0f, -1.0f, 100.0f)
+    };
+
+    // each batch's objects fill its run of instances, which start right
+    // after the previous batch's
+    struct CheckObject { unsigned int batch; XMFLOAT3 center; XMFLOAT3 extents; bool visible; };
+    const CheckObject checkObjects[] =
+    {
+        // inside, straddling each kind of plane, and just past them
+        { 0, XMFLOAT3(0.0f, 0.0f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), true },
+        { 0, XMFLOAT3(9.5f, 0.0f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), true },
+        { 0, XMFLOAT3(11.5f, 0.0f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), false },
+        { 0, XMFLOAT3(0.0f, -10.5f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), true },
+        { 0, XMFLOAT3(0.0f, 0.0f, -0.5f), XMFLOAT3(1.0f, 1.0f, 1.0f), true },
+        { 0, XMFLOAT3(0.0f, 0.0f, -2.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), false },
+        { 0, XMFLOAT3(0.0f, 0.0f, 100.5f), XMFLOAT3(1.0f, 1.0f, 1.0f), true },
+        { 0, XMFLOAT3(0.0f, 0.0f, 102.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), false },
+
+        // nothing visible - its draw has no instances
+        { 1, XMFLOAT3(20.0f, 0.0f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), false },
+        { 1, XMFLOAT3(0.0f, -20.0f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), false },
+        { 1, XMFLOAT3(0.0f, 0.0f, -50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), false },
+        { 1, XMFLOAT3(-15.0f, 15.0f, 150.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), false },
+
+        // everything visible, one box bigger than the frustum itself
+        { 2, XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(2.0f, 2.0f, 2.0f), true },
+        { 2, XMFLOAT3(-5.0f, 5.0f, 20.0f), XMFLOAT3(1.0f, 2.0f, 3.0f), true },
+        { 2, XMFLOAT3(5.0f, -5.0f, 90.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), true },
+        { 2, XMFLOAT3(0.0f, 0.0f, 50.0f), XMFLOAT3(30.0f, 30.0f, 30.0f), true },
+
+        // exactly touching a plane counts, and a box past a corner but
+        // inside each plane on its own is kept - the test is conservative
+        { 3, XMFLOAT3(11.0f, 0.0f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), true },
+        { 3, XMFLOAT3(11.5f, 0.0f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), false },
+        { 3, XMFLOAT3(10.8f, 10.8f, 50.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), true }
+    };
+    const unsigned int indexCounts[] = { 36, 36, 720, 6 };
+    const unsigned int expectedCounts[] = { 5, 0, 4, 2 };
+    const unsigned int batchCount = sizeof(indexCounts) / sizeof(indexCounts[0]);
+    const unsigned int objectCount = sizeof(checkObjects) / sizeof(checkObjects[0]);
+
+    // objects use the instances back to front, so an object's index and
+    // its instance's differ
+    std::vector<GpuCullBatch> checkBatches;
+    std::vector<GpuCullObject> cullObjects;
+    std::vector<InstanceData> instances(objectCount);
+    std::vector<std::vector<unsigned int>> expected(batchCount);
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        const CheckObject& object = checkObjects[i];
+        if (object.batch == checkBatches.size())
+        {
+            GpuCullBatch batch = { indexCounts[object.batch], i };
+            checkBatches.push_back(batch);
+        }
+
+        unsigned int instance = objectCount - 1 - i;
+        memset(&instances[instance], 0, sizeof(InstanceData));
+        instances[instance].world._41 = (float)instance;
+        GpuCullObject cullObject = { object.center, object.batch, object.extents, instance };
+        cullObjects.push_back(cullObject);
+        if (object.visible)
+            expected[object.batch].push_back(instance);
+    }
+
+    bool consistent = true;
+    for (unsigned int b = 0; b < batchCount; b++)
+    {
+        std::sort(expected[b].begin(), expected[b].end());
+        consistent = consistent && expected[b].size() == expectedCounts[b];
+    }
+    if (!report.Expect(consistent, "the check's objects don't add up to its expected counts"))
+        return report.Finish();
+
+    // the reference - the arguments as built, then culled on the CPU
+    std::vector<unsigned int> emulatedArgs;
+    GpuCullEmulation::BuildDrawArgs(checkBatches, emulatedArgs);
+    std::vector<InstanceData> emulatedVisible(objectCount);
+    GpuCullEmulation::Cull(planes, cullObjects.data(), objectCount, instances.data(), emulatedArgs.data(), emulatedVisible.data());
+    report.Print("%u objects in %u batches", objectCount, batchCount);
+    CheckBatches(report, "emulated", checkBatches, expected, emulatedArgs.data(), emulatedVisible.data());
+
+    // the same objects through the other culler
+    if (cull)
+    {
+        std::vector<unsigned int> args;
+        std::vector<InstanceData> visible;
+        if (report.Expect(cull(planes, checkBatches, cullObjects, instances, args, visible), "%s couldn't cull the objects", cullerName) &&
+            report.Expect(args.size() >= batchCount * GPU_CULL_ARGS_PER_DRAW && visible.size() >= objectCount, "%s gave back too little", cullerName))
+            CheckBatches(report, cullerName, checkBatches, expected, args.data(), visible.data());
+    }
+
+    return report.Finish();
+}
+
+// --------------------------------------------------------
+// The emulation on its own:
+//   DX11Checks -gpucull
+// (DX11Starter.exe -gpucull checks the kernel on the GPU)
+// --------------------------------------------------------
+int RunGpuCullCheck(int, char**)
+{
+    return CheckGpuCulling(0, 0);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "GpuCullEmulation.h"
+
+// Culls the check's objects some way other than the emulation - fills in
+// the batches' draw arguments and the visible instances, as a culler's
+// buffers hold them, or returns false if it couldn't
+typedef std::function<bool(const DirectX::XMFLOAT4* planes, const std::vector<GpuCullBatch>& batches,
+    const std::vector<GpuCullObject>& objects, const std::vector<InstanceData>& instances,
+    std::vector<unsigned int>& argsOut, std::vector<InstanceData>& visibleOut)> GpuCullFunction;
+
+// Culls a fixed set of objects, whose results are known, with the
+// emulation and, if cull is given, with it too (named cullerName in
+// the report). Returns the process exit code
+int CheckGpuCulling(const char* cullerName, GpuCullFunction cull);
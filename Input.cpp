@@ -0,0 +1,170 @@
+#include "Input.h"
+#include <cstring>
+#include <fstream>
+
+// log file header
+#define INPUT_LOG_MAGIC     0x31504E49 // "INP1"
+#define INPUT_LOG_VERSION   1
+
+Input::Input()
+{
+    mode = INPUT_MODE_LIVE;
+    memset(&current, 0, sizeof(current));
+    memset(&previous, 0, sizeof(previous));
+    memset(&live, 0, sizeof(live));
+    memset(&previousLive, 0, sizeof(previousLive));
+    frameIndex = 0;
+    replayFinished = false;
+}
+
+void Input::BeginFrame(HWND windowHandle, float& deltaTime)
+{
+    previous = current;
+    previousLive = live;
+    replayFinished = false;
+    Poll(windowHandle, live);
+
+    switch (mode)
+    {
+    case INPUT_MODE_RECORD:
+        current = live;
+        frames.push_back(current);
+        deltaTime = INPUT_FIXED_DELTA_TIME;
+        break;
+    case INPUT_MODE_REPLAY:
+        if (frameIndex < frames.size())
+        {
+            current = frames[frameIndex++];
+            deltaTime = INPUT_FIXED_DELTA_TIME;
+            break;
+        }
+
+        // out of frames, hand control back to the user
+        mode = INPUT_MODE_LIVE;
+        replayFinished = true;
+        current = live;
+        break;
+    default:
+        current = live;
+        break;
+    }
+}
+
+bool Input::KeyDown(int virtualKey) { return TestKey(current, virtualKey); }
+bool Input::KeyPressed(int virtualKey) { return TestKey(current, virtualKey) && !TestKey(previous, virtualKey); }
+bool Input::LiveKeyDown(int virtualKey) { return TestKey(live, virtualKey); }
+bool Input::LiveKeyPressed(int virtualKey) { return TestKey(live, virtualKey) && !TestKey(previousLive, virtualKey); }
+
+POINT Input::GetMousePosition()
+{
+    POINT p = { current.mouseX, current.mouseY };
+    return p;
+}
+
+int Input::GetMouseDeltaX() { return current.mouseX - previous.mouseX; }
+int Input::GetMouseDeltaY() { return current.mouseY - previous.mouseY; }
+
+void Input::StartRecording(const void* startState, size_t stateSize)
+{
+    // the frame before is kept too, so the first replayed
+    // frame sees the same key edges and mouse delta
+    frames.clear();
+    frames.push_back(previous);
+    frames.push_back(current);
+    state.assign((const uint8_t*)startState, (const uint8_t*)startState + stateSize);
+    frameIndex = 0;
+    mode = INPUT_MODE_RECORD;
+}
+
+bool Input::StopRecording(std::string fileName)
+{
+    if (mode != INPUT_MODE_RECORD)
+        return false;
+    mode = INPUT_MODE_LIVE;
+
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    uint32_t header[4] = { INPUT_LOG_MAGIC, INPUT_LOG_VERSION, (uint32_t)frames.size(), (uint32_t)state.size() };
+    float fixedDelta = INPUT_FIXED_DELTA_TIME;
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)&fixedDelta, sizeof(fixedDelta));
+    file.write((const char*)state.data(), state.size());
+    file.write((const char*)frames.data(), frames.size() * sizeof(InputSnapshot));
+    return file.good();
+}
+
+bool Input::StartReplay(std::string fileName)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    uint32_t header[4] = {};
+    float fixedDelta = 0.0f;
+    file.read((char*)header, sizeof(header));
+    file.read((char*)&fixedDelta, sizeof(fixedDelta));
+    if (!file.good() || header[0] != INPUT_LOG_MAGIC || header[1] != INPUT_LOG_VERSION || fixedDelta != INPUT_FIXED_DELTA_TIME || header[2] < 2)
+        return false;
+
+    state.resize(header[3]);
+    frames.resize(header[2]);
+    file.read((char*)state.data(), state.size());
+    file.read((char*)frames.data(), frames.size() * sizeof(InputSnapshot));
+    if (!file.good())
+    {
+        frames.clear();
+        state.clear();
+        return false;
+    }
+
+    // this frame becomes the first recorded one
+    previous = frames[0];
+    current = frames[1];
+    frameIndex = 2;
+    mode = INPUT_MODE_REPLAY;
+    return true;
+}
+
+void Input::StopReplay()
+{
+    if (mode == INPUT_MODE_REPLAY)
+        mode = INPUT_MODE_LIVE;
+}
+
+const std::vector<uint8_t>& Input::GetReplayState() { return state; }
+bool Input::IsReplayFinished() { return replayFinished; }
+
+int Input::GetMode() { return mode; }
+unsigned int Input::GetFrameIndex()
+{
+    if (mode == INPUT_MODE_RECORD) return (unsigned int)frames.size() - 1;
+    if (mode == INPUT_MODE_REPLAY) return frameIndex - 1;
+    return 0;
+}
+
+unsigned int Input::GetFrameCount() { return frames.size() < 2 ? 0 : (unsigned int)frames.size() - 1; }
+
+bool Input::TestKey(const InputSnapshot& snapshot, int virtualKey)
+{
+    if (virtualKey < 0 || virtualKey >= 256)
+        return false;
+    return (snapshot.keys[virtualKey >> 5] >> (virtualKey & 31)) & 1;
+}
+
+void Input::Poll(HWND windowHandle, InputSnapshot& snapshot)
+{
+    memset(snapshot.keys, 0, sizeof(snapshot.keys));
+    for (int key = 1; key < 256; key++)
+    {
+        if (GetAsyncKeyState(key) & 0x8000)
+            snapshot.keys[key >> 5] |= 1u << (key & 31);
+    }
+
+    POINT mousePos = {};
+    GetCursorPos(&mousePos);
+    ScreenToClient(windowHandle, &mousePos);
+    snapshot.mouseX = mousePos.x;
+    snapshot.mouseY = mousePos.y;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define INPUT_MODE_LIVE         0
+#define INPUT_MODE_RECORD       1
+#define INPUT_MODE_REPLAY       2
+
+// step used while recording/replaying so every run simulates the same frames
+#define INPUT_FIXED_DELTA_TIME  (1.0f / 60.0f)
+
+// everything the game reads from the keyboard and mouse in one frame
+struct InputSnapshot
+{
+    uint32_t keys[8];   // one bit per virtual key code
+    int32_t mouseX;     // client space cursor position
+    int32_t mouseY;
+};
+
+// Single place the game gets its input from
+// - Live mode polls the OS once per frame
+// - Record mode does the same but also appends every snapshot to a log,
+//   and switches to a fixed time step so the log can be played back exactly
+// - Replay mode ignores the OS and feeds the log back frame by frame
+// - Hotkeys that control recording/replay themselves should use the Live*
+//   queries, which always read the real keyboard
+// - Recording/replay start on the frame they are requested, right after
+//   BeginFrame(), so the caller should switch that frame to the fixed step
+// - The caller can store its own state blob at the start of a recording
+//   (camera, lights...) and restore it when the replay starts
+class Input
+{
+public:
+    Input();
+
+    // call once at the start of Update(), may replace deltaTime
+    void BeginFrame(HWND windowHandle, float& deltaTime);
+
+    // queries against the current (possibly replayed) snapshot
+    bool KeyDown(int virtualKey);
+    bool KeyPressed(int virtualKey);
+    POINT GetMousePosition();
+    int GetMouseDeltaX();
+    int GetMouseDeltaY();
+
+    // queries against the real keyboard, regardless of mode
+    bool LiveKeyDown(int virtualKey);
+    bool LiveKeyPressed(int virtualKey);
+
+    // recording
+    void StartRecording(const void* state, size_t stateSize);
+    bool StopRecording(std::string fileName);
+
+    // replay - returns false if the log couldn't be read
+    bool StartReplay(std::string fileName);
+    void StopReplay();
+    const std::vector<uint8_t>& GetReplayState();
+
+    // true on the frame the replay ran out (input is live again)
+    bool IsReplayFinished();
+
+    int GetMode();
+    unsigned int GetFrameIndex();
+    unsigned int GetFrameCount();
+
+private:
+    static bool TestKey(const InputSnapshot& snapshot, int virtualKey);
+    void Poll(HWND windowHandle, InputSnapshot& snapshot);
+
+    int mode;
+    InputSnapshot current;
+    InputSnapshot previous;
+    InputSnapshot live;
+    InputSnapshot previousLive;
+
+    // frames being recorded, or the log being replayed
+    std::vector<InputSnapshot> frames;
+    std::vector<uint8_t> state;
+    unsigned int frameIndex;
+    bool replayFinished;
+};
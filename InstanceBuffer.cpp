@@ -0,0 +1,33 @@
+#include "InstanceBuffer.h"
+
+InstanceBuffer::InstanceBuffer()
+    : buffer(D3D11_BIND_VERTEX_BUFFER, sizeof(InstanceData))
+{
+}
+
+void InstanceBuffer::Clear()
+{
+    instances.clear();
+}
+
+unsigned int InstanceBuffer::Add(const InstanceData& instance)
+{
+    instances.push_back(instance);
+    return (unsigned int)instances.size() - 1;
+}
+
+InstanceData& InstanceBuffer::Get(unsigned int index) { return instances[index]; }
+const InstanceData* InstanceBuffer::GetData() { return instances.data(); }
+unsigned int InstanceBuffer::GetCount() { return (unsigned int)instances.size(); }
+
+bool InstanceBuffer::Upload(ID3D11Device* device, RenderDevice* renderDevice)
+{
+    unsigned int count = (unsigned int)instances.size();
+    if (count == 0)
+        return true;
+
+    return buffer.Reserve(device, count) && buffer.Write(renderDevice, instances.data(), count);
+}
+
+ID3D11Buffer* InstanceBuffer::GetBuffer() { return buffer.GetBuffer(); }
+unsigned int InstanceBuffer::GetCapacity() { return buffer.GetCapacity(); }
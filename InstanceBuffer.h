@@ -0,0 +1,33 @@
+#pragma once
+#include <d3d11.h>
+#include <vector>
+#include "BufferStructs.h"
+#include "DynamicBuffer.h"
+#include "RenderDevice.h"
+
+// Dynamic vertex buffer holding one frame's per instance data
+// - The frame's instances are written CPU side with Add(), then
+//   uploaded to a DynamicBuffer, which grows to fit them
+class InstanceBuffer
+{
+public:
+    InstanceBuffer();
+
+    void Clear();
+
+    // returns the index to use as the draw's start instance
+    unsigned int Add(const InstanceData& instance);
+    InstanceData& Get(unsigned int index);
+    const InstanceData* GetData();
+    unsigned int GetCount();
+
+    // returns false if the buffer couldn't be (re)created or mapped
+    bool Upload(ID3D11Device* device, RenderDevice* renderDevice);
+
+    ID3D11Buffer* GetBuffer();
+    unsigned int GetCapacity();
+
+private:
+    std::vector<InstanceData> instances;
+    DynamicBuffer buffer;
+};
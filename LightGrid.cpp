@@ -0,0 +1,478 @@
+#include "LightGrid.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+    // the grid's cell data, indexed by cell
+    struct CellBounds
+    {
+        const float* minX;
+        const float* minY;
+        const float* minZ;
+        const float* maxX;
+        const float* maxY;
+        const float* maxZ;
+        const float* sphereX;
+        const float* sphereY;
+        const float* sphereZ;
+        const float* sphereRadius;
+    };
+
+    // what the row tests need of a light, broadcast once per light
+    struct LightShape
+    {
+        float x, y, z, radius;
+        float dirX, dirY, dirZ;
+        float cosAngle, sinAngle;
+    };
+
+    typedef unsigned int (*TestRowFunction)(const CellBounds& cells, unsigned int rowStart, const LightShape& light);
+
+    // a light touches a cell when the squared distance from its center
+    // to the cell's box is within its squared radius:
+    //     sum(max(min - c, c - max, 0)^2) <= r^2
+    // a spot light's cone also has to reach the cell's bounding sphere -
+    // the sphere is outside when its center is further from the cone's
+    // surface than its radius, past the light's range or behind it
+    unsigned int TestRowSSE(const CellBounds& cells, unsigned int rowStart, const LightShape& light)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 x = _mm_set1_ps(light.x);
+        const __m128 y = _mm_set1_ps(light.y);
+        const __m128 z = _mm_set1_ps(light.z);
+        const __m128 radius = _mm_set1_ps(light.radius);
+        const __m128 radiusSq = _mm_set1_ps(light.radius * light.radius);
+        const bool cone = light.cosAngle > 0.0f;
+
+        unsigned int touched = 0;
+        for (unsigned int i = 0; i < LIGHT_GRID_X; i += 4)
+        {
+            unsigned int c = rowStart + i;
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(cells.minX + c), x), _mm_sub_ps(x, _mm_loadu_ps(cells.maxX + c))), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(cells.minY + c), y), _mm_sub_ps(y, _mm_loadu_ps(cells.maxY + c))), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(cells.minZ + c), z), _mm_sub_ps(z, _mm_loadu_ps(cells.maxZ + c))), zero);
+            __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 inside = _mm_cmple_ps(distanceSq, radiusSq);
+
+            if (cone)
+            {
+                __m128 vx = _mm_sub_ps(_mm_loadu_ps(cells.sphereX + c), x);
+                __m128 vy = _mm_sub_ps(_mm_loadu_ps(cells.sphereY + c), y);
+                __m128 vz = _mm_sub_ps(_mm_loadu_ps(cells.sphereZ + c), z);
+                __m128 sphere = _mm_loadu_ps(cells.sphereRadius + c);
+                __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+                __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_set1_ps(light.dirX)), _mm_mul_ps(vy, _mm_set1_ps(light.dirY))), _mm_mul_ps(vz, _mm_set1_ps(light.dirZ)));
+                __m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(along, along)), zero));
+                __m128 fromSurface = _mm_sub_ps(_mm_mul_ps(across, _mm_set1_ps(light.cosAngle)), _mm_mul_ps(along, _mm_set1_ps(light.sinAngle)));
+                inside = _mm_and_ps(inside, _mm_cmple_ps(fromSurface, sphere));
+                inside = _mm_and_ps(inside, _mm_cmple_ps(along, _mm_add_ps(sphere, radius)));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(along, _mm_sub_ps(zero, sphere)));
+            }
+
+            touched |= (unsigned int)_mm_movemask_ps(inside) << i;
+        }
+        return touched;
+    }
+
+    SIMD_TARGET_AVX
+    unsigned int TestRowAVX(const CellBounds& cells, unsigned int rowStart, const LightShape& light)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 x = _mm256_set1_ps(light.x);
+        const __m256 y = _mm256_set1_ps(light.y);
+        const __m256 z = _mm256_set1_ps(light.z);
+        const __m256 radius = _mm256_set1_ps(light.radius);
+        const __m256 radiusSq = _mm256_set1_ps(light.radius * light.radius);
+        const bool cone = light.cosAngle > 0.0f;
+
+        unsigned int touched = 0;
+        for (unsigned int i = 0; i < LIGHT_GRID_X; i += 8)
+        {
+            unsigned int c = rowStart + i;
+            __m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(cells.minX + c), x), _mm256_sub_ps(x, _mm256_loadu_ps(cells.maxX + c))), zero);
+            __m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(cells.minY + c), y), _mm256_sub_ps(y, _mm256_loadu_ps(cells.maxY + c))), zero);
+            __m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(cells.minZ + c), z), _mm256_sub_ps(z, _mm256_loadu_ps(cells.maxZ + c))), zero);
+            __m256 distanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            __m256 inside = _mm256_cmp_ps(distanceSq, radiusSq, _CMP_LE_OQ);
+
+            if (cone)
+            {
+                __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(cells.sphereX + c), x);
+                __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(cells.sphereY + c), y);
+                __m256 vz = _mm256_sub_ps(_mm256_loadu_ps(cells.sphereZ + c), z);
+                __m256 sphere = _mm256_loadu_ps(cells.sphereRadius + c);
+                __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+                __m256 along = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, _mm256_set1_ps(light.dirX)), _mm256_mul_ps(vy, _mm256_set1_ps(light.dirY))), _mm256_mul_ps(vz, _mm256_set1_ps(light.dirZ)));
+                __m256 across = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(lengthSq, _mm256_mul_ps(along, along)), zero));
+                __m256 fromSurface = _mm256_sub_ps(_mm256_mul_ps(across, _mm256_set1_ps(light.cosAngle)), _mm256_mul_ps(along, _mm256_set1_ps(light.sinAngle)));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(fromSurface, sphere, _CMP_LE_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(along, _mm256_add_ps(sphere, radius), _CMP_LE_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(along, _mm256_sub_ps(zero, sphere), _CMP_GE_OQ));
+            }
+
+            touched |= (unsigned int)_mm256_movemask_ps(inside) << i;
+        }
+        return touched;
+    }
+}
+
+LightGrid::LightGrid(unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+
+    // each thread needs at least one slice of its own
+    this->threadCount = std::min(threadCount, (unsigned int)LIGHT_GRID_Z);
+    bins.resize(this->threadCount);
+    for (Bin& bin : bins)
+        bin.dropped = 0;
+
+    useAVX = CpuFeatures::HasAVX();
+    xScale = yScale = nearZ = farZ = 0.0f;
+    gridNear = 0.0f;
+    sliceScale = sliceBias = 0.0f;
+
+    cells.resize(LIGHT_GRID_CELL_COUNT);
+    directionalCount = 0;
+    entryCount = 0;
+    droppedCount = 0;
+    busiestCellCount = 0;
+    lastBuildTime = 0.0f;
+}
+
+// --------------------------------------------------------
+// Works the frustum back out of a left handed perspective
+// projection, and builds every cell's view space box and
+// bounding sphere for it
+// --------------------------------------------------------
+void LightGrid::SetProjection(const XMFLOAT4X4& projection)
+{
+    // z' = z * _33 + _43, w = z, so z' is 0 at the near plane and z at the far one
+    float newXScale = projection._11;
+    float newYScale = projection._22;
+    float newNear = -projection._43 / projection._33;
+    float newFar = projection._33 * newNear / (projection._33 - 1.0f);
+    if (newXScale == xScale && newYScale == yScale && newNear == nearZ && newFar == farZ)
+        return;
+
+    xScale = newXScale;
+    yScale = newYScale;
+    nearZ = newNear;
+    farZ = newFar;
+
+    // slice k starts at gridNear * (far / gridNear)^(k / LIGHT_GRID_Z)
+    gridNear = std::min(std::max(nearZ, LIGHT_GRID_NEAR_DEPTH), farZ * 0.5f);
+    float logRange = logf(farZ / gridNear);
+    sliceScale = LIGHT_GRID_Z / logRange;
+    sliceBias = LIGHT_GRID_Z * logf(gridNear) / logRange;
+
+    // a point is right of column boundary i when x * xScale / z > ndc
+    for (int i = 0; i <= LIGHT_GRID_X; i++)
+    {
+        float ndc = -1.0f + 2.0f * i / LIGHT_GRID_X;
+        float length = sqrtf(xScale * xScale + ndc * ndc);
+        columnPlanes[i][0] = xScale / length;
+        columnPlanes[i][1] = -ndc / length;
+    }
+
+    // rows go top down, like pixels
+    for (int i = 0; i <= LIGHT_GRID_Y; i++)
+    {
+        float ndc = 1.0f - 2.0f * i / LIGHT_GRID_Y;
+        float length = sqrtf(yScale * yScale + ndc * ndc);
+        rowPlanes[i][0] = yScale / length;
+        rowPlanes[i][1] = -ndc / length;
+    }
+
+    std::vector<float>* arrays[] = { &boxMinX, &boxMinY, &boxMinZ, &boxMaxX, &boxMaxY, &boxMaxZ, &sphereX, &sphereY, &sphereZ, &sphereRadius };
+    for (std::vector<float>* values : arrays)
+        values->resize(LIGHT_GRID_CELL_COUNT);
+
+    for (int slice = 0; slice < LIGHT_GRID_Z; slice++)
+    {
+        // the first slice also holds the pixels in front of gridNear
+        float sliceNear = slice == 0 ? nearZ : gridNear * powf(farZ / gridNear, (float)slice / LIGHT_GRID_Z);
+        float sliceFar = slice == LIGHT_GRID_Z - 1 ? farZ : gridNear * powf(farZ / gridNear, (float)(slice + 1) / LIGHT_GRID_Z);
+
+        for (int row = 0; row < LIGHT_GRID_Y; row++)
+        {
+            float top = 1.0f - 2.0f * row / LIGHT_GRID_Y;
+            float bottom = top - 2.0f / LIGHT_GRID_Y;
+
+            for (int column = 0; column < LIGHT_GRID_X; column++)
+            {
+                float left = -1.0f + 2.0f * column / LIGHT_GRID_X;
+                float right = left + 2.0f / LIGHT_GRID_X;
+
+                // the tile's edges at both ends of the slice
+                int c = (slice * LIGHT_GRID_Y + row) * LIGHT_GRID_X + column;
+                boxMinX[c] = std::min(left * sliceNear, left * sliceFar) / xScale;
+                boxMaxX[c] = std::max(right * sliceNear, right * sliceFar) / xScale;
+                boxMinY[c] = std::min(bottom * sliceNear, bottom * sliceFar) / yScale;
+                boxMaxY[c] = std::max(top * sliceNear, top * sliceFar) / yScale;
+                boxMinZ[c] = sliceNear;
+                boxMaxZ[c] = sliceFar;
+
+                float halfX = (boxMaxX[c] - boxMinX[c]) * 0.5f;
+                float halfY = (boxMaxY[c] - boxMinY[c]) * 0.5f;
+                float halfZ = (boxMaxZ[c] - boxMinZ[c]) * 0.5f;
+                sphereX[c] = boxMinX[c] + halfX;
+                sphereY[c] = boxMinY[c] + halfY;
+                sphereZ[c] = boxMinZ[c] + halfZ;
+                sphereRadius[c] = sqrtf(halfX * halfX + halfY * halfY + halfZ * halfZ);
+            }
+        }
+    }
+}
+
+int LightGrid::SliceOf(float depth)
+{
+    if (depth <= gridNear)
+        return 0;
+    int slice = (int)floorf(logf(depth) * sliceScale - sliceBias);
+    return std::min(std::max(slice, 0), LIGHT_GRID_Z - 1);
+}
+
+// --------------------------------------------------------
+// Moves the lights into view space and works out the cells
+// each may touch, then bins them on the worker threads and
+// joins the threads' lists into one
+// --------------------------------------------------------
+void LightGrid::Build(const XMFLOAT4X4& view, const Light* lights, unsigned int lightCount)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    indices.clear();
+    binLights.clear();
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        const Light& light = lights[i];
+        if (!light.enabled)
+            continue;
+        if (light.type == TYPE_DIRECTIONAL)
+        {
+            indices.push_back(i);
+            continue;
+        }
+        if ((light.type != TYPE_POINT && light.type != TYPE_SPOT) || light.radius <= 0.0f || boxMinX.empty())
+            continue;
+
+        BinLight bin = {};
+        const XMFLOAT3& p = light.position;
+        bin.x = p.x * view._11 + p.y * view._21 + p.z * view._31 + view._41;
+        bin.y = p.x * view._12 + p.y * view._22 + p.z * view._32 + view._42;
+        bin.z = p.x * view._13 + p.y * view._23 + p.z * view._33 + view._43;
+
+        // a hair of slack, so a light that only grazes a cell doesn't
+        // depend on how the shader rounds at the cell's edge
+        bin.radius = light.radius * 1.001f + 0.0001f;
+        if (bin.z + bin.radius < nearZ || bin.z - bin.radius > farZ)
+            continue;
+
+        if (light.type == TYPE_SPOT && light.spotPower > 0.0f)
+        {
+            const XMFLOAT3& d = light.direction;
+            float dx = d.x * view._11 + d.y * view._21 + d.z * view._31;
+            float dy = d.x * view._12 + d.y * view._22 + d.z * view._32;
+            float dz = d.x * view._13 + d.y * view._23 + d.z * view._33;
+            float length = sqrtf(dx * dx + dy * dy + dz * dz);
+            if (length > 0.0f)
+            {
+                // the falloff is pow(cos(angle from the axis), spotPower)
+                bin.dirX = dx / length;
+                bin.dirY = dy / length;
+                bin.dirZ = dz / length;
+                bin.cosAngle = powf(LIGHT_GRID_SPOT_CUTOFF, 1.0f / light.spotPower);
+                bin.sinAngle = sqrtf(std::max(0.0f, 1.0f - bin.cosAngle * bin.cosAngle));
+            }
+        }
+
+        // the tiles between the boundaries the sphere reaches past
+        float columnDistance[LIGHT_GRID_X + 1];
+        for (int c = 0; c <= LIGHT_GRID_X; c++)
+            columnDistance[c] = columnPlanes[c][0] * bin.x + columnPlanes[c][1] * bin.z;
+        for (int c = 0; c < LIGHT_GRID_X; c++)
+        {
+            if (columnDistance[c] > -bin.radius && columnDistance[c + 1] < bin.radius)
+                bin.columns |= 1u << c;
+        }
+
+        float rowDistance[LIGHT_GRID_Y + 1];
+        for (int r = 0; r <= LIGHT_GRID_Y; r++)
+            rowDistance[r] = rowPlanes[r][0] * bin.y + rowPlanes[r][1] * bin.z;
+        for (int r = 0; r < LIGHT_GRID_Y; r++)
+        {
+            if (rowDistance[r] < bin.radius && rowDistance[r + 1] > -bin.radius)
+                bin.rows |= 1u << r;
+        }
+
+        if (bin.columns == 0 || bin.rows == 0)
+            continue;
+
+        bin.firstSlice = SliceOf((bin.z - bin.radius) * 0.999f);
+        bin.lastSlice = SliceOf((bin.z + bin.radius) * 1.001f);
+        bin.index = i;
+        binLights.push_back(bin);
+    }
+    directionalCount = (unsigned int)indices.size();
+
+    if (threadCount > 1)
+    {
+        std::vector<std::thread> workers;
+        for (unsigned int t = 1; t < threadCount; t++)
+            workers.push_back(std::thread(&LightGrid::BinSlices, this, t));
+        BinSlices(0);
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+    else
+    {
+        BinSlices(0);
+    }
+
+    // each thread's runs are relative to its own list, which goes
+    // after the ones before it
+    droppedCount = 0;
+    busiestCellCount = 0;
+    for (unsigned int t = 0; t < threadCount; t++)
+    {
+        unsigned int base = (unsigned int)indices.size();
+        indices.insert(indices.end(), bins[t].indices.begin(), bins[t].indices.end());
+        droppedCount += bins[t].dropped;
+
+        unsigned int cellBegin = t * LIGHT_GRID_Z / threadCount * LIGHT_GRID_X * LIGHT_GRID_Y;
+        unsigned int cellEnd = (t + 1) * LIGHT_GRID_Z / threadCount * LIGHT_GRID_X * LIGHT_GRID_Y;
+        for (unsigned int c = cellBegin; c < cellEnd; c++)
+        {
+            cells[c].offset += base;
+            busiestCellCount = std::max(busiestCellCount, cells[c].count);
+        }
+    }
+    entryCount = (unsigned int)indices.size() - directionalCount;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    lastBuildTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+// --------------------------------------------------------
+// One thread's share - tests every light against its own
+// slices, then sorts the finds into per cell runs. Lights
+// are visited in order, so each run stays sorted
+// --------------------------------------------------------
+void LightGrid::BinSlices(unsigned int thread)
+{
+    Bin& bin = bins[thread];
+    bin.entries.clear();
+    bin.indices.clear();
+    bin.dropped = 0;
+
+    int sliceBegin = (int)(thread * LIGHT_GRID_Z / threadCount);
+    int sliceEnd = (int)((thread + 1) * LIGHT_GRID_Z / threadCount);
+
+    CellBounds bounds = { boxMinX.data(), boxMinY.data(), boxMinZ.data(), boxMaxX.data(), boxMaxY.data(), boxMaxZ.data(),
+        sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data() };
+    TestRowFunction testRow = useAVX ? TestRowAVX : TestRowSSE;
+
+    for (const BinLight& light : binLights)
+    {
+        int firstSlice = std::max(light.firstSlice, sliceBegin);
+        int lastSlice = std::min(light.lastSlice, sliceEnd - 1);
+        if (firstSlice > lastSlice)
+            continue;
+
+        LightShape shape = { light.x, light.y, light.z, light.radius, light.dirX, light.dirY, light.dirZ, light.cosAngle, light.sinAngle };
+        for (int slice = firstSlice; slice <= lastSlice; slice++)
+        {
+            for (int row = 0; row < LIGHT_GRID_Y; row++)
+            {
+                if ((light.rows & (1u << row)) == 0)
+                    continue;
+
+                unsigned int rowStart = (unsigned int)(slice * LIGHT_GRID_Y + row) * LIGHT_GRID_X;
+                unsigned int touched = testRow(bounds, rowStart, shape) & light.columns;
+                for (unsigned int column = 0; touched != 0; column++, touched >>= 1)
+                {
+                    if (touched & 1)
+                        bin.entries.push_back((unsigned long long)(rowStart + column) << 32 | light.index);
+                }
+            }
+        }
+    }
+
+    // count, cap and lay out each cell's run, then fill the runs -
+    // while filling, count is how much of the run is written so far
+    unsigned int cellBegin = (unsigned int)sliceBegin * LIGHT_GRID_X * LIGHT_GRID_Y;
+    unsigned int cellEnd = (unsigned int)sliceEnd * LIGHT_GRID_X * LIGHT_GRID_Y;
+    for (unsigned int c = cellBegin; c < cellEnd; c++)
+        cells[c].count = 0;
+    for (unsigned long long entry : bin.entries)
+        cells[(unsigned int)(entry >> 32)].count++;
+
+    bin.capacity.resize(cellEnd - cellBegin);
+    unsigned int offset = 0;
+    for (unsigned int c = cellBegin; c < cellEnd; c++)
+    {
+        unsigned int count = std::min(cells[c].count, (unsigned int)LIGHT_GRID_MAX_CELL_LIGHTS);
+        bin.dropped += cells[c].count - count;
+        bin.capacity[c - cellBegin] = count;
+        cells[c].offset = offset;
+        cells[c].count = 0;
+        offset += count;
+    }
+
+    bin.indices.resize(offset);
+    for (unsigned long long entry : bin.entries)
+    {
+        LightGridCell& cell = cells[(unsigned int)(entry >> 32)];
+        if (cell.count < bin.capacity[(unsigned int)(entry >> 32) - cellBegin])
+            bin.indices[cell.offset + cell.count++] = (unsigned int)entry;
+    }
+}
+
+void LightGrid::BuildUnculled(const Light* lights, unsigned int lightCount)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    indices.clear();
+    binLights.clear();
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        if (lights[i].enabled && lights[i].type == TYPE_DIRECTIONAL)
+            indices.push_back(i);
+    }
+    directionalCount = (unsigned int)indices.size();
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        if (lights[i].enabled && (lights[i].type == TYPE_POINT || lights[i].type == TYPE_SPOT))
+            indices.push_back(i);
+    }
+
+    std::fill(cells.begin(), cells.end(), LightGridCell());
+    cells[0].offset = directionalCount;
+    cells[0].count = (unsigned int)indices.size() - directionalCount;
+    entryCount = cells[0].count;
+    droppedCount = 0;
+    busiestCellCount = cells[0].count;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    lastBuildTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+const std::vector<LightGridCell>& LightGrid::GetCells() { return cells; }
+const std::vector<unsigned int>& LightGrid::GetIndices() { return indices; }
+unsigned int LightGrid::GetDirectionalCount() { return directionalCount; }
+float LightGrid::GetSliceScale() { return sliceScale; }
+float LightGrid::GetSliceBias() { return sliceBias; }
+void LightGrid::SetUseAVX(bool enabled) { useAVX = enabled && CpuFeatures::HasAVX(); }
+unsigned int LightGrid::GetThreadCount() { return threadCount; }
+unsigned int LightGrid::GetBinnedLightCount() { return (unsigned int)binLights.size(); }
+unsigned int LightGrid::GetEntryCount() { return entryCount; }
+unsigned int LightGrid::GetDroppedCount() { return droppedCount; }
+unsigned int LightGrid::GetBusiestCellCount() { return busiestCellCount; }
+float LightGrid::GetLastBuildTime() { return lastBuildTime; }
@@ -0,0 +1,141 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+// Cells the view frustum is split into - ToonShading.hlsli has the same
+#define LIGHT_GRID_X                16
+#define LIGHT_GRID_Y                9
+#define LIGHT_GRID_Z                24
+#define LIGHT_GRID_CELL_COUNT       (LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z)
+
+// the most lights one cell lists - the rest are dropped (and counted)
+#define LIGHT_GRID_MAX_CELL_LIGHTS  128
+
+// depth slices start here (or at the near plane, if it's further) - the
+// few pixels closer than this all use the first slice
+#define LIGHT_GRID_NEAR_DEPTH       0.25f
+
+// a spot light reaches as far from its axis as its falloff stays above
+// this, which an 8 bit target can't show anyway
+#define LIGHT_GRID_SPOT_CUTOFF      (1.0f / 256.0f)
+
+// one cell's run of the index list
+struct LightGridCell
+{
+    unsigned int offset;
+    unsigned int count;
+};
+
+// Clustered light culling - the view frustum is split into screen tiles
+// and exponentially spaced depth slices, and every point and spot light
+// is listed in the cells its volume touches, so a pixel only loops over
+// the lights of its own cell
+// - A light's candidate cells come from its distance to the tiles'
+//   column and row planes and its depth range; the candidates are then
+//   tested against the cells' view space boxes a row at a time, four
+//   cells per step with SSE or eight with AVX. Spot lights also test
+//   their cone against the cells' bounding spheres
+// - Depth slices are split between worker threads, each writing only
+//   its own slices' lists, so the result never depends on the thread
+//   count or scheduling
+// - Directional lights light every cell, so they come first in the
+//   index list, ahead of every cell's run
+// - Nothing here touches D3D, so it can be built and checked anywhere
+class LightGrid
+{
+public:
+    // threadCount 0 picks one based on the hardware
+    LightGrid(unsigned int threadCount = 0);
+
+    // the camera's projection - rebuilds the cell bounds when it changed
+    void SetProjection(const DirectX::XMFLOAT4X4& projection);
+
+    // bins the enabled lights for a camera - lights are in world space,
+    // and the index list refers to them by their index in lights
+    void Build(const DirectX::XMFLOAT4X4& view, const Light* lights, unsigned int lightCount);
+
+    // lists every enabled point and spot light in cell 0, for drawing
+    // with the cell lookup zeroed, so every pixel loops over them all
+    void BuildUnculled(const Light* lights, unsigned int lightCount);
+
+    // the results, LIGHT_GRID_CELL_COUNT cells ordered slice, row
+    // (top down), column
+    const std::vector<LightGridCell>& GetCells();
+    const std::vector<unsigned int>& GetIndices();
+    unsigned int GetDirectionalCount();
+
+    // the shader's slice lookup: floor(log(viewDepth) * scale - bias)
+    float GetSliceScale();
+    float GetSliceBias();
+
+    // the SIMD width the cells are tested at - on by default when the
+    // CPU has AVX
+    void SetUseAVX(bool enabled);
+    unsigned int GetThreadCount();
+
+    // stats from the last build
+    unsigned int GetBinnedLightCount();     // point/spot lights near the frustum
+    unsigned int GetEntryCount();           // light/cell pairs listed
+    unsigned int GetDroppedCount();         // pairs past a cell's cap
+    unsigned int GetBusiestCellCount();
+    float GetLastBuildTime();
+
+private:
+    // a point or spot light, in view space, with the grid range it
+    // may touch
+    struct BinLight
+    {
+        float x, y, z;
+        float radius;               // with a hair of slack, see Build()
+        float dirX, dirY, dirZ;     // spot direction
+        float cosAngle, sinAngle;   // spot cone - cosAngle <= 0 skips it
+        unsigned int index;
+        int firstSlice, lastSlice;
+        unsigned int columns;       // candidate column/row bits
+        unsigned int rows;
+    };
+
+    // a thread's finds, and its slices' index list
+    struct Bin
+    {
+        std::vector<unsigned long long> entries;    // cell << 32 | light
+        std::vector<unsigned int> indices;
+        std::vector<unsigned int> capacity;         // each cell's run, capped
+        unsigned int dropped;
+    };
+
+    int SliceOf(float depth);
+    void BinSlices(unsigned int thread);
+
+    unsigned int threadCount;
+    bool useAVX;
+
+    // the projection the bounds were built for
+    float xScale, yScale, nearZ, farZ;
+    float gridNear;
+    float sliceScale, sliceBias;
+
+    // normalized column (x, z) and row (y, z) planes through the eye,
+    // positive to the right of / above each tile boundary
+    float columnPlanes[LIGHT_GRID_X + 1][2];
+    float rowPlanes[LIGHT_GRID_Y + 1][2];
+
+    // view space cell boxes and their bounding spheres, one float per
+    // cell in grid order, so each row is one run of LIGHT_GRID_X
+    std::vector<float> boxMinX, boxMinY, boxMinZ;
+    std::vector<float> boxMaxX, boxMaxY, boxMaxZ;
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+
+    std::vector<BinLight> binLights;
+    std::vector<Bin> bins;
+
+    std::vector<LightGridCell> cells;
+    std::vector<unsigned int> indices;
+    unsigned int directionalCount;
+
+    unsigned int entryCount;
+    unsigned int droppedCount;
+    unsigned int busiestCellCount;
+    float lastBuildTime;
+};
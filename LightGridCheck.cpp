@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "Checks.h"
+#include "CheckReport.h"
+#include "CpuFeatures.h"
+#include "LightGrid.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Fills a frustum like the game's with lights, checks that
+// every light is listed in the cell of every point it
+// reaches (finding the cell the way the shader does), that
+// every SIMD width and thread count builds the same grid,
+// and times each of them:
+//   DX11Checks -lightbench [-lights N] [-iterations N]
+// --------------------------------------------------------
+int RunLightBenchmark(int argc, char** argv)
+{
+    unsigned int lightCount = (unsigned int)std::max(1, CheckReport::GetIntOption(argc, argv, "-lights", 4096));
+    unsigned int iterations = (unsigned int)std::max(1, CheckReport::GetIntOption(argc, argv, "-iterations", 100));
+    CheckReport report("lightbench");
+
+    // a 45 degree 16:9 camera, turned and moved off the origin so the
+    // view transform is part of what's checked
+    const float nearPlane = 0.01f;
+    const float farPlane = 100.0f;
+    const float yScale = 1.0f / tanf(0.125f * 3.14159265f);
+    const float xScale = yScale * 9.0f / 16.0f;
+    XMFLOAT4X4 projection = {};
+    projection._11 = xScale;
+    projection._22 = yScale;
+    projection._33 = farPlane / (farPlane - nearPlane);
+    projection._34 = 1.0f;
+    projection._43 = -nearPlane * farPlane / (farPlane - nearPlane);
+
+    const float yaw = 0.4f;
+    const XMFLOAT3 eye(5.0f, 2.0f, -10.0f);
+    const XMFLOAT3 right(cosf(yaw), 0.0f, -sinf(yaw));
+    const XMFLOAT3 forward(sinf(yaw), 0.0f, cosf(yaw));
+    XMFLOAT4X4 view = {};
+    view._11 = right.x;     view._13 = forward.x;
+    view._22 = 1.0f;
+    view._31 = right.z;     view._33 = forward.z;
+    view._41 = -(eye.x * right.x + eye.z * right.z);
+    view._42 = -eye.y;
+    view._43 = -(eye.x * forward.x + eye.z * forward.z);
+    view._44 = 1.0f;
+
+    // lights are placed in view space, where the check happens, and
+    // moved to the world space Build() takes - a couple of directional
+    // ones, a few disabled, and every third a spot
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Light> lights(lightCount + 2);
+    std::vector<XMFLOAT3> viewPositions(lights.size());
+    std::vector<XMFLOAT3> viewDirections(lights.size());
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        Light light = {};
+        light.enabled = i % 10 != 9;
+        if (i < 2)
+        {
+            light.type = TYPE_DIRECTIONAL;
+            light.direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+            lights[i] = light;
+            continue;
+        }
+
+        XMFLOAT3 position(unit(random) * 80.0f - 40.0f, unit(random) * 40.0f - 20.0f, unit(random) * 100.0f - 10.0f);
+        light.type = i % 3 == 0 ? TYPE_SPOT : TYPE_POINT;
+        light.radius = 0.5f + unit(random) * 3.5f;
+        light.position = XMFLOAT3(
+            eye.x + position.x * right.x + position.z * forward.x,
+            eye.y + position.y,
+            eye.z + position.x * right.z + position.z * forward.z);
+        viewPositions[i] = position;
+
+        if (light.type == TYPE_SPOT)
+        {
+            XMFLOAT3 direction(unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f);
+            float length = std::max(0.001f, sqrtf(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z));
+            direction = XMFLOAT3(direction.x / length, direction.y / length, direction.z / length);
+            light.spotPower = 1.0f + unit(random) * 31.0f;
+            light.direction = XMFLOAT3(
+                direction.x * right.x + direction.z * forward.x,
+                direction.y,
+                direction.x * right.z + direction.z * forward.z);
+            viewDirections[i] = direction;
+        }
+        lights[i] = light;
+    }
+    unsigned int totalLights = (unsigned int)lights.size();
+
+    LightGrid reference(1);
+    reference.SetUseAVX(false);
+    reference.SetProjection(projection);
+    reference.Build(view, lights.data(), totalLights);
+    report.Print("%u lights: %u binned, %u light/cell pairs, busiest cell %u, %u dropped past the cap of %d",
+        totalLights, reference.GetBinnedLightCount(), reference.GetEntryCount(), reference.GetBusiestCellCount(),
+        reference.GetDroppedCount(), LIGHT_GRID_MAX_CELL_LIGHTS);
+
+    // random points in the frustum, looked up like the shader does -
+    // cells at the cap may have dropped a light, so they're skipped
+    const unsigned int samples = 20000;
+    unsigned int reached = 0;
+    unsigned int missing = 0;
+    for (unsigned int s = 0; s < samples; s++)
+    {
+        float ndcX = unit(random) * 2.0f - 1.0f;
+        float ndcY = unit(random) * 2.0f - 1.0f;
+        float depth = nearPlane * powf(farPlane / nearPlane, unit(random));
+        XMFLOAT3 point(ndcX * depth / xScale, ndcY * depth / yScale, depth);
+
+        int column = std::min((int)((ndcX * 0.5f + 0.5f) * LIGHT_GRID_X), LIGHT_GRID_X - 1);
+        int row = std::min((int)((0.5f - ndcY * 0.5f) * LIGHT_GRID_Y), LIGHT_GRID_Y - 1);
+        int slice = std::min(std::max((int)floorf(logf(depth) * reference.GetSliceScale() - reference.GetSliceBias()), 0), LIGHT_GRID_Z - 1);
+        const LightGridCell& cell = reference.GetCells()[(slice * LIGHT_GRID_Y + row) * LIGHT_GRID_X + column];
+        if (cell.count >= LIGHT_GRID_MAX_CELL_LIGHTS)
+            continue;
+        const unsigned int* listed = reference.GetIndices().data() + cell.offset;
+
+        for (unsigned int i = 0; i < totalLights; i++)
+        {
+            const Light& light = lights[i];
+            if (!light.enabled || light.type == TYPE_DIRECTIONAL)
+                continue;
+
+            // attenuation reaches zero at the radius
+            float dx = point.x - viewPositions[i].x;
+            float dy = point.y - viewPositions[i].y;
+            float dz = point.z - viewPositions[i].z;
+            float distanceSq = dx * dx + dy * dy + dz * dz;
+            if (distanceSq >= light.radius * light.radius)
+                continue;
+            if (light.type == TYPE_SPOT)
+            {
+                float distance = sqrtf(distanceSq);
+                float cosAngle = distance > 0.0f ? (dx * viewDirections[i].x + dy * viewDirections[i].y + dz * viewDirections[i].z) / distance : 1.0f;
+                if (cosAngle <= 0.0f || powf(cosAngle, light.spotPower) < LIGHT_GRID_SPOT_CUTOFF)
+                    continue;
+            }
+
+            reached++;
+            if (std::find(listed, listed + cell.count, i) == listed + cell.count)
+                missing++;
+        }
+    }
+    report.Print("%u sample points: %u light hits, %u missing from their cell", samples, reached, missing);
+    report.Expect(missing == 0, "%u light hits missing from their cell", missing);
+
+    // every configuration has to build exactly the reference grid - four
+    // threads is what the game uses when the CPU has them
+    struct Configuration { unsigned int threads; bool avx; };
+    Configuration configurations[] = { { 1, false }, { 1, true }, { 4, false }, { 4, true } };
+    for (const Configuration& configuration : configurations)
+    {
+        if (configuration.avx && !CpuFeatures::HasAVX())
+            continue;
+
+        LightGrid grid(configuration.threads);
+        grid.SetUseAVX(configuration.avx);
+        grid.SetProjection(projection);
+        grid.Build(view, lights.data(), totalLights);
+
+        bool same = grid.GetIndices() == reference.GetIndices();
+        for (int c = 0; c < LIGHT_GRID_CELL_COUNT && same; c++)
+        {
+            same = grid.GetCells()[c].offset == reference.GetCells()[c].offset
+                && grid.GetCells()[c].count == reference.GetCells()[c].count;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < iterations; i++)
+            grid.Build(view, lights.data(), totalLights);
+        auto end = std::chrono::high_resolution_clock::now();
+        float ms = std::chrono::duration<float, std::milli>(end - start).count() / iterations;
+
+        report.Print("%u thread%s, %s: %.3f ms per build", grid.GetThreadCount(), grid.GetThreadCount() == 1 ? "" : "s",
+            configuration.avx ? "AVX" : "SSE", ms);
+        report.Expect(same, "%u threads, %s: the grid differs from the reference", grid.GetThreadCount(), configuration.avx ? "AVX" : "SSE");
+    }
+
+    return report.Finish();
+}
@@ -202,12 +202,7 @@ float3 dLightColorPBRToon(float3 normal, float3 worldPos, Light light, float3 ca
 	float luminance = dot(specular, float3(0.2125f, 0.7154f, 0.0721f));
 	float toonLuminance = ApplyToonShadingRamp(luminance, specularRampTexture, clampSampler);
 
-	// calculate energy conservation
-	float3 balancedDiff = DiffuseEnergyConserve(diffuse, specular, metalness);
-
 	float3 toonSpec = specColor * toonLuminance;
-	float3 balancedToonDiff = DiffuseEnergyConserve(toonDiffuse, toonSpec, metalness);
-
 	float3 toonDiffuseLightColor = toonDiffuse * light.DiffuseColor;
 	float3 total = (toonDiffuseLightColor * surfaceColor + toonSpec) * light.Intensity + light.AmbientColor;
 	return total;
@@ -229,13 +224,12 @@ float3 pLightColorPBRToon(float3 normal, float3 worldPos, Light light, float3 ca
 	float luminance = dot(specular, float3(0.2125f, 0.7154f, 0.0721f));
 	float toonLuminance = ApplyToonShadingRamp(luminance, specularRampTexture, clampSampler);
 
-	// calculate energy conservation
-	float3 balancedDiff = DiffuseEnergyConserve(diffuse, specular, metalness);
 	float3 toonSpec = specColor * toonLuminance;
-	float3 balancedToonDiff = DiffuseEnergyConserve(toonDiffuse, toonSpec, metalness);
 
 	float3 toonDiffuseLightColor = toonDiffuse * light.DiffuseColor;
-	float3 total = (toonDiffuseLightColor * surfaceColor + toonSpec) * att * light.Intensity + light.AmbientColor;
+	// the light's ambient reaches past its radius - ShadeSurface() adds
+	// it for every pixel, since a pixel only visits the lights near it
+	float3 total = (toonDiffuseLightColor * surfaceColor + toonSpec) * att * light.Intensity;
 	return total;
 }
 
@@ -255,17 +249,15 @@ float3 sLightColorPBRToon(float3 normal, float3 worldPos, Light light, float3 ca
 	float luminance = dot(specular, float3(0.2125f, 0.7154f, 0.0721f));
 	float toonLuminance = ApplyToonShadingRamp(luminance, specularRampTexture, clampSampler);
 
-	// calculate energy conservation
-	float3 balancedDiff = DiffuseEnergyConserve(diffuse, specular, metalness);
 	float3 toonSpec = specColor * toonLuminance;
-	float3 balancedToonDiff = DiffuseEnergyConserve(toonDiffuse, toonSpec, metalness);
 
 	// do spot light calcultions
 	float angleFromCenter = saturate(dot(-lightDirection, normalize(light.Direction)));
 	float spotAmount = pow(angleFromCenter, light.SpotPower);
 
 	float3 toonDiffuseLightColor = toonDiffuse * light.DiffuseColor;
-	float3 total = (toonDiffuseLightColor * surfaceColor + toonSpec) * att * spotAmount * light.Intensity + light.AmbientColor;
+	// the ambient is added by ShadeSurface(), as for point lights
+	float3 total = (toonDiffuseLightColor * surfaceColor + toonSpec) * att * spotAmount * light.Intensity;
 	return total;
 }
 #endif
\ No newline at end of file
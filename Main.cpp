@@ -1,6 +1,289 @@
 
 #include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "Game.h"
+#include "TraceReplay.h"
+#include "D3D11TraceObjects.h"
+#include "ShaderStructGenerator.h"
+#include "ShaderPack.h"
+#include "ShaderVariants.h"
+#include "CheckReport.h"
+#include "GpuCuller.h"
+#include "GpuCullerCheck.h"
+
+// --------------------------------------------------------
+// The tools below need a D3D11 device, so they stay in the
+// exe rather than DX11Checks. Each reports through a
+// CheckReport into a console of its own, held open until a
+// key is pressed
+// --------------------------------------------------------
+static void OpenToolConsole()
+{
+	AllocConsole();
+	FILE* stream;
+	freopen_s(&stream, "CONOUT$", "w", stdout);
+}
+
+static int CloseToolConsole(int result)
+{
+	system("pause");
+	return result;
+}
+
+static bool CreateToolDevice(Microsoft::WRL::ComPtr<ID3D11Device>& device, Microsoft::WRL::ComPtr<ID3D11DeviceContext>& context)
+{
+	return SUCCEEDED(D3D11CreateDevice(0, D3D_DRIVER_TYPE_HARDWARE, 0, 0, 0, 0, D3D11_SDK_VERSION, device.GetAddressOf(), 0, context.GetAddressOf()));
+}
+
+// the compiled shaders sit next to the exe
+static std::wstring GetShaderPath(const wchar_t* fileName)
+{
+	wchar_t exePath[MAX_PATH] = {};
+	GetModuleFileNameW(0, exePath, MAX_PATH);
+	std::wstring directory = exePath;
+	return directory.substr(0, directory.find_last_of(L"\\/") + 1) + fileName;
+}
+
+// --------------------------------------------------------
+// Offline replay of a frame trace (F8 in game), no window:
+//   DX11Starter.exe -tracereplay frame.trace [-loops N]
+// Replays every frame N times at full speed on a fresh D3D11
+// device (DX11Checks -tracereplay does it on the null one)
+// --------------------------------------------------------
+static int RunTraceReplay(int argc, char** argv)
+{
+	const char* path = CheckReport::GetStringOption(argc, argv, "-tracereplay", 0);
+	int loops = std::max(1, CheckReport::GetIntOption(argc, argv, "-loops", 100));
+
+	OpenToolConsole();
+	CheckReport report("tracereplay");
+
+	FrameTrace trace;
+	if (!report.Expect(path && trace.Load(path) && trace.GetFrameCount() > 0, "couldn't load trace %s", path ? path : "(none)"))
+		return CloseToolConsole(report.Finish());
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	if (!report.Expect(CreateToolDevice(device, context), "couldn't create a D3D11 device"))
+		return CloseToolConsole(report.Finish());
+
+	D3D11TraceObjects objects;
+	unsigned int failed = objects.Create(device.Get(), context.Get(), &trace);
+	if (failed > 0)
+		report.Print("%u of %u objects couldn't be recreated", failed, trace.GetObjectCount());
+
+	TraceReplay replay(&trace);
+	replay.SetObjects(objects.GetHandles());
+	D3D11RenderDevice d3dDevice(context.Get());
+	d3dDevice.EnableConstantRing(device.Get());
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int loop = 0; loop < loops; loop++)
+	{
+		for (unsigned int f = 0; f < trace.GetFrameCount(); f++)
+			replay.ReplayFrame(f, &d3dDevice);
+		context->Flush();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	unsigned int frames = loops * trace.GetFrameCount();
+	float totalMs = std::chrono::duration<float, std::milli>(end - start).count();
+	report.Print("Replayed %u frames of %s on the D3D11 device: %.3f ms total, %.4f ms per frame",
+		frames, path, totalMs, totalMs / frames);
+	return CloseToolConsole(report.Finish());
+}
+
+// --------------------------------------------------------
+// Microbenchmark of SimpleShader's named setters against
+// its handle ones, no window:
+//   DX11Starter.exe -shaderbench [-iterations N]
+// Times the sets the opaque pass makes whenever it binds a
+// toon shader, both ways. Binds go through a state cache,
+// so after the first they're filtered as redundant and what
+// remains is the cost of finding the slot
+// --------------------------------------------------------
+static int RunShaderBenchmark(int argc, char** argv)
+{
+	int iterations = std::max(1, CheckReport::GetIntOption(argc, argv, "-iterations", 1000000));
+
+	OpenToolConsole();
+	CheckReport report("shaderbench");
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	if (!report.Expect(CreateToolDevice(device, context), "couldn't create a D3D11 device"))
+		return CloseToolConsole(report.Finish());
+
+	SimplePixelShader ps(device.Get(), context.Get(), GetShaderPath(L"PixelShader.cso").c_str());
+	if (!report.Expect(ps.IsShaderValid(), "couldn't load PixelShader.cso"))
+		return CloseToolConsole(report.Finish());
+
+	D3D11RenderDevice renderDevice(context.Get());
+	StateCache cache(&renderDevice);
+	ISimpleShader::SetStateCache(&cache);
+
+	ID3D11ShaderResourceView* srv = 0;
+	ID3D11SamplerState* sampler = 0;
+	DirectX::XMFLOAT3 cameraPos(1.0f, 2.0f, 3.0f);
+	const int setsPerIteration = 6;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		ps.SetSamplerState("ClampSampler", sampler);
+		ps.SetSamplerState("shadowSampler", sampler);
+		ps.SetShaderResourceView("RampMap", srv);
+		ps.SetShaderResourceView("specularRampMap", srv);
+		ps.SetShaderResourceView("shadowMap", srv);
+		ps.SetFloat3("cameraPos", cameraPos);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	float namedMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	SamplerSlotHandle clampSampler = ps.GetSamplerHandle("ClampSampler");
+	SamplerSlotHandle shadowSampler = ps.GetSamplerHandle("shadowSampler");
+	SrvSlotHandle rampMap = ps.GetShaderResourceViewHandle("RampMap");
+	SrvSlotHandle specularRampMap = ps.GetShaderResourceViewHandle("specularRampMap");
+	SrvSlotHandle shadowMap = ps.GetShaderResourceViewHandle("shadowMap");
+	ShaderVarHandle cameraPosHandle = ps.GetVariableHandle("cameraPos");
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		ps.SetSamplerState(clampSampler, sampler);
+		ps.SetSamplerState(shadowSampler, sampler);
+		ps.SetShaderResourceView(rampMap, srv);
+		ps.SetShaderResourceView(specularRampMap, srv);
+		ps.SetShaderResourceView(shadowMap, srv);
+		ps.SetFloat3(cameraPosHandle, cameraPos);
+	}
+	end = std::chrono::high_resolution_clock::now();
+	float handleMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	float sets = (float)iterations * setsPerIteration;
+	report.Print("%d x %d sets - by name: %.1f ns per set, by handle: %.1f ns per set (%.1fx)",
+		iterations, setsPerIteration, namedMs * 1000000.0f / sets, handleMs * 1000000.0f / sets,
+		handleMs > 0.0f ? namedMs / handleMs : 0.0f);
+
+	ISimpleShader::SetStateCache(0);
+	return CloseToolConsole(report.Finish());
+}
+
+// --------------------------------------------------------
+// Checks GPU culling's draw arguments and visible instances
+// for a fixed set of objects, no window:
+//   DX11Starter.exe -gpucull
+// The emulation is always checked; with a D3D11 device the
+// kernel's results are read back and checked as well
+// (DX11Checks -gpucull checks the emulation on its own)
+// --------------------------------------------------------
+static int RunGpuCullCheck()
+{
+	OpenToolConsole();
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	if (!CreateToolDevice(device, context))
+	{
+		printf("Couldn't create a D3D11 device, so only the emulation was checked\n");
+		return CloseToolConsole(CheckGpuCulling(0, nullptr));
+	}
+
+	SimpleComputeShader cs(device.Get(), context.Get(), GetShaderPath(L"GpuCullCS.cso").c_str());
+	if (!cs.IsShaderValid())
+		printf("Couldn't load GpuCullCS.cso\n");
+
+	D3D11RenderDevice renderDevice(context.Get());
+	StateCache cache(&renderDevice);
+	ISimpleShader::SetStateCache(&cache);
+
+	// the same objects through a culler - without compute support
+	// Upload() emulates the kernel, so that's what gets compared
+	GpuCuller culler(device.Get(), &cs);
+	int result = CheckGpuCulling(culler.IsGpu() ? "GPU" : "culler (emulated)",
+		[&](const DirectX::XMFLOAT4* planes, const std::vector<GpuCullBatch>& batches, const std::vector<GpuCullObject>& objects,
+			const std::vector<InstanceData>& instances, std::vector<unsigned int>& argsOut, std::vector<InstanceData>& visibleOut)
+		{
+			for (const GpuCullBatch& batch : batches)
+				culler.AddBatch(batch.indexCount, batch.firstInstance);
+			for (const GpuCullObject& object : objects)
+				culler.AddObject(object.center, object.extents, object.batch, object.instance);
+			if (!culler.Upload(&renderDevice, planes, instances.data(), (unsigned int)instances.size()))
+				return false;
+			culler.Dispatch(&cache);
+			return culler.ReadBack(argsOut, visibleOut);
+		});
+
+	ISimpleShader::SetStateCache(0);
+	return CloseToolConsole(result);
+}
+
+// --------------------------------------------------------
+// Post-build step that checks ShaderStructs.h against the
+// compiled shaders, and rewrites it if they've changed:
+//   DX11Starter.exe -genstructs <cso directory> <header>
+// --------------------------------------------------------
+static int RunStructGenerator(int argc, char** argv)
+{
+	// report into the build's console rather than a new one
+	FILE* stream;
+	if (AttachConsole(ATTACH_PARENT_PROCESS))
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+
+	for (int i = 1; i + 2 < argc; i++)
+	{
+		if (strcmp(argv[i], "-genstructs") == 0)
+			return ShaderStructGenerator::Run(argv[i + 1], argv[i + 2]);
+	}
+	printf("usage: -genstructs <cso directory> <header>\n");
+	return 1;
+}
+
+// --------------------------------------------------------
+// Post-build step that packs the compiled shaders, with their
+// reflection, into the file the game loads them from:
+//   DX11Starter.exe -buildpack <cso directory> <pack>
+// --------------------------------------------------------
+static int RunPackBuilder(int argc, char** argv)
+{
+	// report into the build's console rather than a new one
+	FILE* stream;
+	if (AttachConsole(ATTACH_PARENT_PROCESS))
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+
+	for (int i = 1; i + 2 < argc; i++)
+	{
+		if (strcmp(argv[i], "-buildpack") == 0)
+			return ShaderPack::Build(argv[i + 1], argv[i + 2]);
+	}
+	printf("usage: -buildpack <cso directory> <pack>\n");
+	return 1;
+}
+
+// --------------------------------------------------------
+// Post-build step that compiles the opaque pixel shaders'
+// keyword variants into the on-disk cache:
+//   DX11Starter.exe -buildvariants <hlsl directory> <cache directory>
+// --------------------------------------------------------
+static int RunVariantBuilder(int argc, char** argv)
+{
+	// report into the build's console rather than a new one
+	FILE* stream;
+	if (AttachConsole(ATTACH_PARENT_PROCESS))
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+
+	for (int i = 1; i + 2 < argc; i++)
+	{
+		if (strcmp(argv[i], "-buildvariants") == 0)
+			return ShaderVariants::Build(argv[i + 1], argv[i + 2]);
+	}
+	printf("usage: -buildvariants <hlsl directory> <cache directory>\n");
+	return 1;
+}
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -18,6 +301,24 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// replaying a trace, generating structs, packing shaders,
+	// building variants, benchmarking or checking doesn't need the game at all
+	for (int i = 1; i < __argc; i++)
+	{
+		if (strcmp(__argv[i], "-tracereplay") == 0)
+			return RunTraceReplay(__argc, __argv);
+		if (strcmp(__argv[i], "-genstructs") == 0)
+			return RunStructGenerator(__argc, __argv);
+		if (strcmp(__argv[i], "-buildpack") == 0)
+			return RunPackBuilder(__argc, __argv);
+		if (strcmp(__argv[i], "-buildvariants") == 0)
+			return RunVariantBuilder(__argc, __argv);
+		if (strcmp(__argv[i], "-shaderbench") == 0)
+			return RunShaderBenchmark(__argc, __argv);
+		if (strcmp(__argv[i], "-gpucull") == 0)
+			return RunGpuCullCheck();
+	}
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
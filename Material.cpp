@@ -11,6 +11,26 @@ Material::Material(DirectX::XMFLOAT4 cTint, SimplePixelShader* pixel, SimpleVert
     this->srvNormal = p_srvNormal;
     this->srvMetal = p_srvMetal;
     this->srvRough = p_srvRough;
+
+    constants = {};
+    constants.specularIntensity = sIntensity;
+    constantsDirty = true;
+
+    // the views are kept alive by the ComPtrs above
+    srvSet[MATERIAL_SRV_ALBEDO] = srv.Get();
+    srvSet[MATERIAL_SRV_NORMAL] = srvNormal.Get();
+    srvSet[MATERIAL_SRV_ROUGHNESS] = srvRough.Get();
+    srvSet[MATERIAL_SRV_METALNESS] = srvMetal.Get();
+
+    constantSlot = 0;
+    samplerSlot = 0;
+    for (unsigned int i = 0; i < MATERIAL_SRV_COUNT; i++)
+        srvSlots[i] = i;
+    srvSlotsContiguous = true;
+
+    textureArrayGroup = -1;
+    textureArraySlice = 0;
+    toon = true;
 }
 
 // getters
@@ -26,3 +46,84 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Material::GetSRVRoughness() { r
 
 // setters
 void Material::SetColorTint(DirectX::XMFLOAT4 cTint) { colorTint = cTint; }
+
+void Material::SetSpecularIntensity(float sIntensity)
+{
+    specularIntensity = sIntensity;
+    constants.specularIntensity = sIntensity;
+    constantsDirty = true;
+}
+
+bool Material::CreateBindings(ID3D11Device* device)
+{
+    // the slots come from the shader, so the set follows the registers
+    const SimpleConstantBuffer* cb = pShader->GetBufferInfo("MaterialData");
+    if (cb) constantSlot = cb->BindIndex;
+    const SimpleSampler* samplerInfo = pShader->GetSamplerInfo("SamplerOptions");
+    if (samplerInfo) samplerSlot = samplerInfo->BindIndex;
+
+    const char* srvNames[MATERIAL_SRV_COUNT] = { "Albedo", "NormalMap", "RoughnessMap", "MetalnessMap" };
+    for (unsigned int i = 0; i < MATERIAL_SRV_COUNT; i++)
+    {
+        const SimpleSRV* srvInfo = pShader->GetShaderResourceViewInfo(srvNames[i]);
+        if (srvInfo) srvSlots[i] = srvInfo->BindIndex;
+        if (i > 0 && srvSlots[i] != srvSlots[0] + i)
+            srvSlotsContiguous = false;
+    }
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = sizeof(MaterialConstants);
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA initial = {};
+    initial.pSysMem = &constants;
+    if (FAILED(device->CreateBuffer(&desc, &initial, constantBuffer.ReleaseAndGetAddressOf())))
+        return false;
+
+    constantsDirty = false;
+    return true;
+}
+
+void Material::UploadConstants(RenderDevice* device)
+{
+    if (!constantsDirty || !constantBuffer)
+        return;
+
+    device->UpdateBuffer(constantBuffer.Get(), &constants, sizeof(MaterialConstants));
+    constantsDirty = false;
+}
+
+void Material::Bind(StateCache* stateCache)
+{
+    stateCache->SetConstantBuffer(SHADER_STAGE_PIXEL, constantSlot, constantBuffer.Get());
+    stateCache->SetSampler(SHADER_STAGE_PIXEL, samplerSlot, sampler.Get());
+
+    if (srvSlotsContiguous)
+    {
+        stateCache->SetShaderResources(SHADER_STAGE_PIXEL, srvSlots[0], MATERIAL_SRV_COUNT, srvSet);
+        return;
+    }
+    for (unsigned int i = 0; i < MATERIAL_SRV_COUNT; i++)
+        stateCache->SetShaderResource(SHADER_STAGE_PIXEL, srvSlots[i], srvSet[i]);
+}
+
+void Material::SetTextureArraySlot(int group, unsigned int slice)
+{
+    textureArrayGroup = group;
+    textureArraySlice = slice;
+}
+
+int Material::GetTextureArrayGroup() { return textureArrayGroup; }
+unsigned int Material::GetTextureArraySlice() { return textureArraySlice; }
+
+void Material::SetToon(bool toon) { this->toon = toon; }
+bool Material::IsToon() { return toon; }
+
+unsigned int Material::GetShaderVariantBits()
+{
+    unsigned int bits = toon ? SHADER_VARIANT_TOON : 0;
+    if (srvNormal)
+        bits |= SHADER_VARIANT_NORMAL_MAP;
+    return bits;
+}
@@ -2,7 +2,20 @@
 #include <DirectXMath.h>
 #include "DXCore.h"
 #include "SimpleShader.h"
+#include "BufferStructs.h"
+#include "ShaderVariants.h"
 
+// textures in the material's binding set, in register order
+#define MATERIAL_SRV_ALBEDO     0
+#define MATERIAL_SRV_NORMAL     1
+#define MATERIAL_SRV_ROUGHNESS  2
+#define MATERIAL_SRV_METALNESS  3
+#define MATERIAL_SRV_COUNT      4
+
+// A material's constants live in its own constant buffer, written
+// only when they're edited, and its textures and sampler are gathered
+// into a binding set up front - binding a material is one constant
+// buffer, one run of SRVs and one sampler
 class Material
 {
 public:
@@ -26,11 +39,39 @@ public:
 
     // setters
     void SetColorTint(DirectX::XMFLOAT4 cTint);
+    void SetSpecularIntensity(float sIntensity);
+
+    // toon ramps (the default) or plain PBR lighting
+    void SetToon(bool toon);
+    bool IsToon();
+
+    // the shader variant keywords the material needs - the frame's
+    // keywords are added to these when it's drawn
+    unsigned int GetShaderVariantBits();
+
+    // creates the constant buffer and finds the pixel shader's slots
+    // for the binding set - false if the buffer couldn't be created
+    bool CreateBindings(ID3D11Device* device);
+
+    // writes the constants if they were edited since the last upload -
+    // on the immediate context, before anything binding them is recorded
+    void UploadConstants(RenderDevice* device);
+
+    // binds the constant buffer, textures and sampler to the pixel shader
+    void Bind(StateCache* stateCache);
+
+    // where TexturePacker put the material's maps - group -1 if it
+    // wasn't packed and the material's own binding set has to be used
+    void SetTextureArraySlot(int group, unsigned int slice);
+    int GetTextureArrayGroup();
+    unsigned int GetTextureArraySlice();
+
 private:
     DirectX::XMFLOAT4 colorTint;
     //Microsoft::WRL::ComPtr<ID3D11PixelShader> pShader;
     //Microsoft::WRL::ComPtr<ID3D11VertexShader> vShader;
     float specularIntensity;
+    bool toon;
 
     SimpleVertexShader* vShader;
     SimplePixelShader* pShader;
@@ -40,5 +81,18 @@ private:
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvNormal;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvMetal;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvRough;
+
+    // GPU side
+    MaterialConstants constants;
+    bool constantsDirty;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> constantBuffer;
+    ID3D11ShaderResourceView* srvSet[MATERIAL_SRV_COUNT];
+    unsigned int constantSlot;
+    unsigned int samplerSlot;
+    unsigned int srvSlots[MATERIAL_SRV_COUNT];
+    bool srvSlotsContiguous;
+
+    int textureArrayGroup;
+    unsigned int textureArraySlice;
 };
 
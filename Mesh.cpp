@@ -1,10 +1,13 @@
 #include "Mesh.h"
+#include "ObjFile.h"
 
 using namespace DirectX;
 
 Mesh::Mesh(Vertex* vertices, int numVert, unsigned int* indices, int nIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
     CalculateTangents(vertices, numVert, indices, nIndices);
+    CalculateBounds(vertices, numVert);
+    CopyGeometry(vertices, numVert, indices, nIndices);
     CreateVertexBuffers(vertices, numVert, indices, nIndices, device);
 }
 
@@ -90,168 +93,56 @@ void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices,
     }
 }
 
-Mesh::Mesh(const char* fileName, Microsoft::WRL::ComPtr<ID3D11Device> device)
+// Calculates the local space bounding box and bounding sphere of the mesh
+// - The sphere is centered on the box, but the radius comes from the
+//   farthest vertex rather than the box corner, so it stays a bit tighter
+void Mesh::CalculateBounds(Vertex* verts, int numVerts)
 {
-    // File input object
-    std::ifstream obj(fileName);
-
-    // Check for successful open
-    if (!obj.is_open())
+    if (numVerts <= 0)
         return;
 
-    // Variables used while reading the file
-    std::vector<XMFLOAT3> positions;     // Positions from the file
-    std::vector<XMFLOAT3> normals;       // Normals from the file
-    std::vector<XMFLOAT2> uvs;           // UVs from the file
-    std::vector<Vertex> verts;           // Verts we're assembling
-    std::vector<UINT> indices;           // Indices of these verts
-    unsigned int vertCounter = 0;        // Count of vertices/indices
-    char chars[100];                     // String for line reading
-
-    // Still have data left?
-    while (obj.good())
+    XMVECTOR vMin = XMLoadFloat3(&verts[0].Position);
+    XMVECTOR vMax = vMin;
+    for (int i = 1; i < numVerts; i++)
     {
-        // Get the line (100 characters should be more than enough)
-        obj.getline(chars, 100);
-
-        // Check the type of line
-        if (chars[0] == 'v' && chars[1] == 'n')
-        {
-            // Read the 3 numbers directly into an XMFLOAT3
-            XMFLOAT3 norm;
-            sscanf_s(
-                chars,
-                "vn %f %f %f",
-                &norm.x, &norm.y, &norm.z);
-
-            // Add to the list of normals
-            normals.push_back(norm);
-        }
-        else if (chars[0] == 'v' && chars[1] == 't')
-        {
-            // Read the 2 numbers directly into an XMFLOAT2
-            XMFLOAT2 uv;
-            sscanf_s(
-                chars,
-                "vt %f %f",
-                &uv.x, &uv.y);
-
-            // Add to the list of uv's
-            uvs.push_back(uv);
-        }
-        else if (chars[0] == 'v')
-        {
-            // Read the 3 numbers directly into an XMFLOAT3
-            XMFLOAT3 pos;
-            sscanf_s(
-                chars,
-                "v %f %f %f",
-                &pos.x, &pos.y, &pos.z);
-
-            // Add to the positions
-            positions.push_back(pos);
-        }
-        else if (chars[0] == 'f')
-        {
-            // Read the face indices into an array
-            // NOTE: This assumes the given obj file contains
-            //  vertex positions, uv coordinates AND normals.
-            //  If the model is missing any of these, this 
-            //  code will not handle the file correctly!
-            unsigned int i[12];
-            int facesRead = sscanf_s(
-                chars,
-                "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-                &i[0], &i[1], &i[2],
-                &i[3], &i[4], &i[5],
-                &i[6], &i[7], &i[8],
-                &i[9], &i[10], &i[11]);
-
-            // - Create the verts by looking up
-            //    corresponding data from vectors
-            // - OBJ File indices are 1-based, so
-            //    they need to be adusted
-            Vertex v1;
-            v1.Position = positions[i[0] - 1];
-            v1.UV = uvs[i[1] - 1];
-            v1.Normal = normals[i[2] - 1];
-
-            Vertex v2;
-            v2.Position = positions[i[3] - 1];
-            v2.UV = uvs[i[4] - 1];
-            v2.Normal = normals[i[5] - 1];
-
-            Vertex v3;
-            v3.Position = positions[i[6] - 1];
-            v3.UV = uvs[i[7] - 1];
-            v3.Normal = normals[i[8] - 1];
-
-            // The model is most likely in a right-handed space,
-            // especially if it came from Maya.  We want to convert
-            // to a left-handed space for DirectX.  This means we 
-            // need to:
-            //  - Invert the Z position
-            //  - Invert the normal's Z
-            //  - Flip the winding order
-            // We also need to flip the UV coordinate since DirectX
-            // defines (0,0) as the top left of the texture, and many
-            // 3D modeling packages use the bottom left as (0,0)
-
-            // Flip the UV's since they're probably "upside down"
-            v1.UV.y = 1.0f - v1.UV.y;
-            v2.UV.y = 1.0f - v2.UV.y;
-            v3.UV.y = 1.0f - v3.UV.y;
-
-            // Flip Z (LH vs. RH)
-            v1.Position.z *= -1.0f;
-            v2.Position.z *= -1.0f;
-            v3.Position.z *= -1.0f;
-
-            // Flip normal Z
-            v1.Normal.z *= -1.0f;
-            v2.Normal.z *= -1.0f;
-            v3.Normal.z *= -1.0f;
-
-            // Add the verts to the vector (flipping the winding order)
-            verts.push_back(v1);
-            verts.push_back(v3);
-            verts.push_back(v2);
-
-            // Add three more indices
-            indices.push_back(vertCounter); vertCounter += 1;
-            indices.push_back(vertCounter); vertCounter += 1;
-            indices.push_back(vertCounter); vertCounter += 1;
-
-            // Was there a 4th face?
-            if (facesRead == 12)
-            {
-                // Make the last vertex
-                Vertex v4;
-                v4.Position = positions[i[9] - 1];
-                v4.UV = uvs[i[10] - 1];
-                v4.Normal = normals[i[11] - 1];
-
-                // Flip the UV, Z pos and normal
-                v4.UV.y = 1.0f - v4.UV.y;
-                v4.Position.z *= -1.0f;
-                v4.Normal.z *= -1.0f;
-
-                // Add a whole triangle (flipping the winding order)
-                verts.push_back(v1);
-                verts.push_back(v4);
-                verts.push_back(v3);
-
-                // Add three more indices
-                indices.push_back(vertCounter); vertCounter += 1;
-                indices.push_back(vertCounter); vertCounter += 1;
-                indices.push_back(vertCounter); vertCounter += 1;
-            }
-        }
+        XMVECTOR pos = XMLoadFloat3(&verts[i].Position);
+        vMin = XMVectorMin(vMin, pos);
+        vMax = XMVectorMax(vMax, pos);
     }
+    XMStoreFloat3(&aabbMin, vMin);
+    XMStoreFloat3(&aabbMax, vMax);
 
-    // Close the file and create the actual buffers
-    obj.close();
+    XMVECTOR center = XMVectorScale(XMVectorAdd(vMin, vMax), 0.5f);
+    XMVECTOR maxDistSq = XMVectorZero();
+    for (int i = 0; i < numVerts; i++)
+    {
+        XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&verts[i].Position), center);
+        maxDistSq = XMVectorMax(maxDistSq, XMVector3LengthSq(offset));
+    }
+    XMStoreFloat3(&sphereCenter, center);
+    sphereRadius = sqrtf(XMVectorGetX(maxDistSq));
+}
 
+// Keeps the positions and indices around on the CPU after the
+// buffers are created, for things that need to read the geometry
+void Mesh::CopyGeometry(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+    positions.resize(numVerts);
+    for (int i = 0; i < numVerts; i++)
+    {
+        positions[i] = verts[i].Position;
+    }
+
+    this->indices.assign(indices, indices + numIndices);
+}
+
+Mesh::Mesh(const char* fileName, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+    std::vector<Vertex> verts;
+    std::vector<UINT> indices;
+    if (!ObjFile::Read(fileName, verts, indices) || verts.empty())
+        return;
+    unsigned int vertCounter = (unsigned int)verts.size();
 
     // - At this point, "verts" is a vector of Vertex structs, and can be used
     //    directly to create a vertex buffer:  &verts[0] is the address of the first vert
@@ -266,6 +157,8 @@ Mesh::Mesh(const char* fileName, Microsoft::WRL::ComPtr<ID3D11Device> device)
     
     // first get tangegts
     CalculateTangents(&verts[0], vertCounter, &indices[0], vertCounter);
+    CalculateBounds(&verts[0], vertCounter);
+    CopyGeometry(&verts[0], vertCounter, &indices[0], vertCounter);
 
     // send and create vertex buffer
     CreateVertexBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
@@ -292,6 +185,13 @@ int Mesh::GetIndexCount()
     return numIndices;
 }
 
+DirectX::XMFLOAT3 Mesh::GetAABBMin() { return aabbMin; }
+DirectX::XMFLOAT3 Mesh::GetAABBMax() { return aabbMax; }
+DirectX::XMFLOAT3 Mesh::GetSphereCenter() { return sphereCenter; }
+float Mesh::GetSphereRadius() { return sphereRadius; }
+const std::vector<DirectX::XMFLOAT3>& Mesh::GetPositions() { return positions; }
+const std::vector<unsigned int>& Mesh::GetIndices() { return indices; }
+
 void Mesh::CreateVertexBuffers(Vertex* vertices, int numVert, UINT* indices, int nIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
     // Create the VERTEX BUFFER description -----------------------------------
@@ -17,14 +17,34 @@ public:
     Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
     int GetIndexCount();
 
+    // local space bounds, computed once at load
+    DirectX::XMFLOAT3 GetAABBMin();
+    DirectX::XMFLOAT3 GetAABBMax();
+    DirectX::XMFLOAT3 GetSphereCenter();
+    float GetSphereRadius();
+
+    // cpu side copy of the geometry (used by the occlusion culler)
+    const std::vector<DirectX::XMFLOAT3>& GetPositions();
+    const std::vector<unsigned int>& GetIndices();
+
 private: 
     // private vars
     Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer = 0;
     Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer = 0;
     int numIndices = 0;
 
+    DirectX::XMFLOAT3 aabbMin = {};
+    DirectX::XMFLOAT3 aabbMax = {};
+    DirectX::XMFLOAT3 sphereCenter = {};
+    float sphereRadius = 0.0f;
+
+    std::vector<DirectX::XMFLOAT3> positions;
+    std::vector<unsigned int> indices;
+
     // private methods
     void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+    void CalculateBounds(Vertex* verts, int numVerts);
+    void CopyGeometry(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
     void CreateVertexBuffers(Vertex* vertices, int numVert, UINT* indices, int nIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 
 };
@@ -0,0 +1,16 @@
+#pragma once
+#include <vector>
+#include "Vertex.h"
+
+// Reads Wavefront OBJ models
+// - Every face corner becomes its own vertex, so the indices just count
+//   up; quads are split into two triangles
+// - Positions, normals and winding are converted to D3D's left handed
+//   space and the UVs flipped to a top left origin
+// - Tangents aren't in the file and are left for the caller to compute
+// - Nothing here touches D3D, so the culling checks can read the models
+//   without a device
+namespace ObjFile
+{
+    bool Read(const char* fileName, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+}
@@ -0,0 +1,125 @@
+#include "ObjectLightLists.h"
+#include "LightGrid.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+ObjectLightLists::ObjectLightLists()
+{
+    directionalCount = 0;
+    objectCount = 0;
+    cappedCount = 0;
+    longestList = 0;
+}
+
+void ObjectLightLists::Begin(const Light* lights, unsigned int lightCount)
+{
+    indices.clear();
+    listLights.clear();
+    objectCount = 0;
+    cappedCount = 0;
+    longestList = 0;
+
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        const Light& light = lights[i];
+        if (!light.enabled)
+            continue;
+        if (light.type == TYPE_DIRECTIONAL)
+        {
+            indices.push_back(i);
+            continue;
+        }
+        if ((light.type != TYPE_POINT && light.type != TYPE_SPOT) || light.radius <= 0.0f)
+            continue;
+
+        ListLight listLight = {};
+        listLight.position = light.position;
+        listLight.radius = light.radius;
+        listLight.index = i;
+
+        // PBR tints with the ambient color and toon with the diffuse one,
+        // so the brightest channel of either
+        float brightest = std::max(std::max(std::max(light.diffuseColor.x, light.diffuseColor.y), light.diffuseColor.z),
+            std::max(std::max(light.ambientColor.x, light.ambientColor.y), light.ambientColor.z));
+        listLight.strength = light.intensity * brightest;
+
+        // the same reach the light grid gives a spot light
+        const XMFLOAT3& d = light.direction;
+        float length = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+        if (light.type == TYPE_SPOT && light.spotPower > 0.0f && length > 0.0f)
+        {
+            listLight.direction = XMFLOAT3(d.x / length, d.y / length, d.z / length);
+            listLight.cosAngle = powf(LIGHT_GRID_SPOT_CUTOFF, 1.0f / light.spotPower);
+            listLight.sinAngle = sqrtf(std::max(0.0f, 1.0f - listLight.cosAngle * listLight.cosAngle));
+        }
+        listLights.push_back(listLight);
+    }
+    directionalCount = (unsigned int)indices.size();
+}
+
+// --------------------------------------------------------
+// Tests every light against the box, keeps the strongest
+// if there are too many, and appends the run
+// --------------------------------------------------------
+unsigned int ObjectLightLists::Add(XMFLOAT3 center, XMFLOAT3 extents, unsigned int& count)
+{
+    candidates.clear();
+    float boxRadius = sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+    for (const ListLight& light : listLights)
+    {
+        // the light's distance to the box, axis by axis
+        float dx = std::max(0.0f, fabsf(light.position.x - center.x) - extents.x);
+        float dy = std::max(0.0f, fabsf(light.position.y - center.y) - extents.y);
+        float dz = std::max(0.0f, fabsf(light.position.z - center.z) - extents.z);
+        float distanceSq = dx * dx + dy * dy + dz * dz;
+        float radiusSq = light.radius * light.radius;
+        if (distanceSq >= radiusSq)
+            continue;
+
+        // the cone against the box's bounding sphere - outside when the
+        // center is further from the cone's surface than the radius,
+        // past the light's range or behind it
+        if (light.cosAngle > 0.0f)
+        {
+            float vx = center.x - light.position.x;
+            float vy = center.y - light.position.y;
+            float vz = center.z - light.position.z;
+            float along = vx * light.direction.x + vy * light.direction.y + vz * light.direction.z;
+            float across = sqrtf(std::max(0.0f, vx * vx + vy * vy + vz * vz - along * along));
+            if (across * light.cosAngle - along * light.sinAngle > boxRadius || along > boxRadius + light.radius || along < -boxRadius)
+                continue;
+        }
+
+        // rough, it only ranks the lights - the attenuation the shader
+        // would work out at the box's nearest point
+        Candidate candidate = { light.strength * (1.0f - distanceSq / radiusSq), light.index };
+        candidates.push_back(candidate);
+    }
+
+    longestList = std::max(longestList, (unsigned int)candidates.size());
+    if (candidates.size() > OBJECT_LIGHT_LIST_MAX)
+    {
+        // keep the strongest, then put them back in light order
+        std::nth_element(candidates.begin(), candidates.begin() + OBJECT_LIGHT_LIST_MAX, candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.score > b.score || (a.score == b.score && a.index < b.index); });
+        candidates.resize(OBJECT_LIGHT_LIST_MAX);
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.index < b.index; });
+        cappedCount++;
+    }
+
+    unsigned int offset = (unsigned int)indices.size();
+    for (const Candidate& candidate : candidates)
+        indices.push_back(candidate.index);
+    count = (unsigned int)candidates.size();
+    objectCount++;
+    return offset;
+}
+
+const std::vector<unsigned int>& ObjectLightLists::GetIndices() { return indices; }
+unsigned int ObjectLightLists::GetDirectionalCount() { return directionalCount; }
+unsigned int ObjectLightLists::GetObjectCount() { return objectCount; }
+unsigned int ObjectLightLists::GetEntryCount() { return (unsigned int)indices.size() - directionalCount; }
+unsigned int ObjectLightLists::GetCappedCount() { return cappedCount; }
+unsigned int ObjectLightLists::GetLongestList() { return longestList; }
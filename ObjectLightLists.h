@@ -0,0 +1,69 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+// the most lights one object's list holds
+#define OBJECT_LIGHT_LIST_MAX   8
+
+// Per object light lists - the simpler alternative to the light grid
+// (see LightGrid.h): every drawn object gets the point and spot lights
+// that reach its bounds, and its pixels only visit those
+// - A light reaches a box when its sphere touches the box and, for a
+//   spot light, its cone reaches the box's bounding sphere
+// - Past OBJECT_LIGHT_LIST_MAX the lights with the least estimated
+//   contribution, at the box's nearest point, are left out. What's kept
+//   stays in light order
+// - Directional lights reach everything, so they come first in the
+//   index list, ahead of every object's run
+// - Nothing here touches D3D, so it can be built and checked anywhere
+class ObjectLightLists
+{
+public:
+    ObjectLightLists();
+
+    // starts the frame's lists - lights are in world space, and the
+    // index list refers to them by their index in lights
+    void Begin(const Light* lights, unsigned int lightCount);
+
+    // lists the lights reaching a world space box (center/half extents),
+    // returning where its run starts in the index list
+    unsigned int Add(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents, unsigned int& count);
+
+    const std::vector<unsigned int>& GetIndices();
+    unsigned int GetDirectionalCount();
+
+    // stats since Begin()
+    unsigned int GetObjectCount();
+    unsigned int GetEntryCount();       // lights listed, over every object
+    unsigned int GetCappedCount();      // objects that had more lights than fit
+    unsigned int GetLongestList();      // before capping
+
+private:
+    // a point or spot light, ready for testing
+    struct ListLight
+    {
+        DirectX::XMFLOAT3 position;
+        float radius;
+        DirectX::XMFLOAT3 direction;    // spot direction, normalized
+        float cosAngle, sinAngle;       // spot cone - cosAngle <= 0 skips it
+        float strength;                 // intensity times brightest channel
+        unsigned int index;
+    };
+
+    // a light that reaches the current box, and how much it adds
+    struct Candidate
+    {
+        float score;
+        unsigned int index;
+    };
+
+    std::vector<ListLight> listLights;
+    std::vector<Candidate> candidates;
+    std::vector<unsigned int> indices;
+    unsigned int directionalCount;
+
+    unsigned int objectCount;
+    unsigned int cappedCount;
+    unsigned int longestList;
+};
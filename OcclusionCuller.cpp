@@ -0,0 +1,787 @@
+#include "OcclusionCuller.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+using namespace DirectX;
+
+// screen positions are snapped to 1/16th of a pixel
+#define SUBPIXEL_BITS       4
+#define SUBPIXEL_SCALE      (1 << SUBPIXEL_BITS)
+#define SUBPIXEL_HALF       (SUBPIXEL_SCALE / 2)
+
+// triangles are clipped to a guard band this many times the viewport,
+// which bounds the fixed point edge functions - with the buffer capped at
+// OCCLUSION_MAX_PIXELS they stay well inside 32 bits
+#define GUARD_BAND          2.0f
+
+// hierarchical depth tile size in pixels
+#define TILE_WIDTH          8
+#define TILE_HEIGHT         4
+
+// the coarse level's groups, in tiles along each side
+#define TILE_GROUP_SIZE     4
+
+namespace
+{
+    // edge functions and depth plane for one triangle
+    // - inside means all three edge functions are >= 0 (the tie
+    //   breaking bias is already folded into c)
+    struct TriangleSetup
+    {
+        int a[3];
+        int b[3];
+        long long c[3];
+        float zC;
+        float dzdx;
+        float dzdy;
+        float zMin;
+        int minX;
+        int maxX;
+    };
+
+    bool SetupTriangle(const OcclusionCuller::ScreenTriangle& tri, int width, TriangleSetup& s)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            int j = (i + 1) % 3;
+            s.a[i] = tri.y[i] - tri.y[j];
+            s.b[i] = tri.x[j] - tri.x[i];
+            s.c[i] = -((long long)s.a[i] * tri.x[i] + (long long)s.b[i] * tri.y[i]);
+
+            // shared edges are walked in opposite directions by the two
+            // triangles using them, so exactly one of them owns the pixels
+            // that land exactly on the edge
+            bool owned = s.a[i] > 0 || (s.a[i] == 0 && s.b[i] > 0);
+            if (!owned)
+                s.c[i] -= 1;
+        }
+
+        int minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+        int maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+        s.minX = std::max(0, (minX - SUBPIXEL_HALF + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS);
+        s.maxX = std::min(width - 1, (maxX - SUBPIXEL_HALF) >> SUBPIXEL_BITS);
+        if (s.minX > s.maxX)
+            return false;
+
+        // depth plane in pixel units
+        float x0 = tri.x[0] / (float)SUBPIXEL_SCALE, y0 = tri.y[0] / (float)SUBPIXEL_SCALE;
+        float x1 = tri.x[1] / (float)SUBPIXEL_SCALE, y1 = tri.y[1] / (float)SUBPIXEL_SCALE;
+        float x2 = tri.x[2] / (float)SUBPIXEL_SCALE, y2 = tri.y[2] / (float)SUBPIXEL_SCALE;
+        float area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+        if (area <= 0.0f)
+            return false;
+
+        s.dzdx = ((tri.z[1] - tri.z[0]) * (y2 - y0) - (tri.z[2] - tri.z[0]) * (y1 - y0)) / area;
+        s.dzdy = ((tri.z[2] - tri.z[0]) * (x1 - x0) - (tri.z[1] - tri.z[0]) * (x2 - x0)) / area;
+        s.zC = tri.z[0] - s.dzdx * x0 - s.dzdy * y0;
+
+        // interpolation can overshoot slightly past the corners, and an
+        // occluder that reads as closer than it is would hide real geometry
+        s.zMin = std::min(tri.z[0], std::min(tri.z[1], tri.z[2]));
+        return true;
+    }
+
+    void RasterizeScalar(const TriangleSetup& s, float* depth, int width, int rowStart, int rowEnd)
+    {
+        int stepX[3] = { s.a[0] * SUBPIXEL_SCALE, s.a[1] * SUBPIXEL_SCALE, s.a[2] * SUBPIXEL_SCALE };
+        long long px = (long long)s.minX * SUBPIXEL_SCALE + SUBPIXEL_HALF;
+
+        for (int y = rowStart; y < rowEnd; y++)
+        {
+            long long py = (long long)y * SUBPIXEL_SCALE + SUBPIXEL_HALF;
+            int e0 = (int)(s.a[0] * px + s.b[0] * py + s.c[0]);
+            int e1 = (int)(s.a[1] * px + s.b[1] * py + s.c[1]);
+            int e2 = (int)(s.a[2] * px + s.b[2] * py + s.c[2]);
+            float zRow = s.zC + s.dzdy * ((float)y + 0.5f);
+            float* row = depth + (size_t)y * width;
+
+            for (int x = s.minX; x <= s.maxX; x++)
+            {
+                if ((e0 | e1 | e2) >= 0)
+                {
+                    float z = std::max(zRow + s.dzdx * ((float)x + 0.5f), s.zMin);
+                    if (z < row[x])
+                        row[x] = z;
+                }
+                e0 += stepX[0];
+                e1 += stepX[1];
+                e2 += stepX[2];
+            }
+        }
+    }
+
+    // same math as RasterizeScalar, 8 pixels per step
+    // - spans start on an 8 pixel boundary, the extra pixels on either
+    //   side always fail the edge test so no extra masking is needed
+    SIMD_TARGET_AVX2
+    void RasterizeAVX2(const TriangleSetup& s, float* depth, int width, int rowStart, int rowEnd)
+    {
+        int xStart = s.minX & ~7;
+        long long px = (long long)xStart * SUBPIXEL_SCALE + SUBPIXEL_HALF;
+
+        const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i allSet = _mm256_set1_epi32(-1);
+        __m256i laneStep[3];
+        __m256i blockStep[3];
+        for (int i = 0; i < 3; i++)
+        {
+            laneStep[i] = _mm256_mullo_epi32(_mm256_set1_epi32(s.a[i] * SUBPIXEL_SCALE), laneIndex);
+            blockStep[i] = _mm256_set1_epi32(s.a[i] * SUBPIXEL_SCALE * 8);
+        }
+        const __m256 dzdx = _mm256_set1_ps(s.dzdx);
+        const __m256 zMin = _mm256_set1_ps(s.zMin);
+        const __m256 half = _mm256_set1_ps(0.5f);
+
+        for (int y = rowStart; y < rowEnd; y++)
+        {
+            long long py = (long long)y * SUBPIXEL_SCALE + SUBPIXEL_HALF;
+            __m256i e0 = _mm256_add_epi32(_mm256_set1_epi32((int)(s.a[0] * px + s.b[0] * py + s.c[0])), laneStep[0]);
+            __m256i e1 = _mm256_add_epi32(_mm256_set1_epi32((int)(s.a[1] * px + s.b[1] * py + s.c[1])), laneStep[1]);
+            __m256i e2 = _mm256_add_epi32(_mm256_set1_epi32((int)(s.a[2] * px + s.b[2] * py + s.c[2])), laneStep[2]);
+            __m256 zRow = _mm256_set1_ps(s.zC + s.dzdy * ((float)y + 0.5f));
+            float* row = depth + (size_t)y * width;
+
+            for (int x = xStart; x <= s.maxX; x += 8)
+            {
+                __m256i inside = _mm256_cmpgt_epi32(_mm256_or_si256(e0, _mm256_or_si256(e1, e2)), allSet);
+                if (!_mm256_testz_si256(inside, inside))
+                {
+                    __m256 pxf = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), laneIndex)), half);
+                    __m256 z = _mm256_max_ps(_mm256_add_ps(zRow, _mm256_mul_ps(dzdx, pxf)), zMin);
+                    __m256 old = _mm256_loadu_ps(row + x);
+                    __m256 closer = _mm256_min_ps(old, z);
+                    _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, closer, _mm256_castsi256_ps(inside)));
+                }
+                e0 = _mm256_add_epi32(e0, blockStep[0]);
+                e1 = _mm256_add_epi32(e1, blockStep[1]);
+                e2 = _mm256_add_epi32(e2, blockStep[2]);
+            }
+        }
+    }
+
+    // separating axis test between a triangle and an axis aligned cube
+    // (Akenine-Moller) - the cube's 3 axes, the triangle's normal, and
+    // the 9 cross products of the two sets of edges
+    bool TriangleOverlapsCell(XMFLOAT3 center, float half, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+    {
+        float v[3][3] =
+        {
+            { a.x - center.x, a.y - center.y, a.z - center.z },
+            { b.x - center.x, b.y - center.y, b.z - center.z },
+            { c.x - center.x, c.y - center.y, c.z - center.z }
+        };
+        float e[3][3];
+        for (int i = 0; i < 3; i++)
+        {
+            int j = (i + 1) % 3;
+            for (int k = 0; k < 3; k++)
+                e[i][k] = v[j][k] - v[i][k];
+        }
+
+        // projects the triangle and the cube onto an axis, and reports
+        // whether the intervals are apart
+        auto separated = [&](float x, float y, float z)
+        {
+            float p0 = v[0][0] * x + v[0][1] * y + v[0][2] * z;
+            float p1 = v[1][0] * x + v[1][1] * y + v[1][2] * z;
+            float p2 = v[2][0] * x + v[2][1] * y + v[2][2] * z;
+            float radius = half * (fabsf(x) + fabsf(y) + fabsf(z));
+            return std::min(p0, std::min(p1, p2)) > radius || std::max(p0, std::max(p1, p2)) < -radius;
+        };
+
+        if (separated(1.0f, 0.0f, 0.0f) || separated(0.0f, 1.0f, 0.0f) || separated(0.0f, 0.0f, 1.0f))
+            return false;
+
+        float nx = e[0][1] * e[1][2] - e[0][2] * e[1][1];
+        float ny = e[0][2] * e[1][0] - e[0][0] * e[1][2];
+        float nz = e[0][0] * e[1][1] - e[0][1] * e[1][0];
+        if (separated(nx, ny, nz))
+            return false;
+
+        for (int i = 0; i < 3; i++)
+        {
+            // the edge crossed with the x, y and z axes
+            if (separated(0.0f, -e[i][2], e[i][1]) ||
+                separated(e[i][2], 0.0f, -e[i][0]) ||
+                separated(-e[i][1], e[i][0], 0.0f))
+                return false;
+        }
+        return true;
+    }
+
+    // signed distance to the clip planes used before projection:
+    // near (z >= 0) and the four guard band sides
+    float ClipDistance(const XMFLOAT4& v, int plane)
+    {
+        switch (plane)
+        {
+        case 0: return v.z;
+        case 1: return GUARD_BAND * v.w - v.x;
+        case 2: return GUARD_BAND * v.w + v.x;
+        case 3: return GUARD_BAND * v.w - v.y;
+        default: return GUARD_BAND * v.w + v.y;
+        }
+    }
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height, unsigned int threadCount)
+{
+    width = std::max(8, (width + 7) & ~7);
+    height = std::max(4, (height + 3) & ~3);
+    if ((long long)width * height > OCCLUSION_MAX_PIXELS)
+    {
+        // rounded down this time, so it stays under the cap
+        double scale = sqrt((double)OCCLUSION_MAX_PIXELS / ((double)width * height));
+        width = std::max(8, (int)(width * scale) & ~7);
+        height = std::max(4, (int)(height * scale) & ~3);
+        height = std::min(height, (OCCLUSION_MAX_PIXELS / width) & ~3);
+    }
+    this->width = width;
+    this->height = height;
+    this->tilesX = this->width / TILE_WIDTH;
+    this->tilesY = this->height / TILE_HEIGHT;
+    this->groupsX = (tilesX + TILE_GROUP_SIZE - 1) / TILE_GROUP_SIZE;
+    this->groupsY = (tilesY + TILE_GROUP_SIZE - 1) / TILE_GROUP_SIZE;
+
+    if (threadCount == 0)
+        threadCount = std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+    this->threadCount = threadCount;
+
+    // split the rows into one band per thread, on tile boundaries
+    bandHeight = std::max(TILE_HEIGHT, ((this->height / (int)threadCount) + TILE_HEIGHT - 1) & ~(TILE_HEIGHT - 1));
+
+    depth.resize((size_t)this->width * this->height, 1.0f);
+    hiZ.resize((size_t)tilesX * tilesY, 1.0f);
+    hiZCoarse.resize((size_t)groupsX * groupsY, 1.0f);
+    bins.resize(threadCount);
+    useAVX2 = CpuFeatures::HasAVX2();
+
+    XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+    occluderTriangleCount = 0;
+    rasterizedTriangleCount = 0;
+    testedCount = 0;
+    occludedCount = 0;
+    lastRasterTime = 0.0f;
+}
+
+int OcclusionCuller::AddOccluder(const XMFLOAT3* positions, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+{
+    OccluderMesh mesh;
+    mesh.positions.assign(positions, positions + vertexCount);
+    mesh.indices.assign(indices, indices + (indexCount / 3) * 3);
+    occluders.push_back(mesh);
+    return (int)occluders.size() - 1;
+}
+
+// --------------------------------------------------------
+// Voxelizes the mesh, finds the cells its surface walls off
+// from the outside, and merges those into boxes
+// --------------------------------------------------------
+void OcclusionCuller::BuildProxy(const XMFLOAT3* positions, size_t vertexCount, const unsigned int* indices, size_t indexCount, int gridResolution, std::vector<XMFLOAT3>& proxyPositions, std::vector<unsigned int>& proxyIndices)
+{
+    proxyPositions.clear();
+    proxyIndices.clear();
+    if (vertexCount == 0 || gridResolution < 1)
+        return;
+
+    XMFLOAT3 bMin = positions[0];
+    XMFLOAT3 bMax = positions[0];
+    for (size_t i = 1; i < vertexCount; i++)
+    {
+        bMin.x = std::min(bMin.x, positions[i].x); bMax.x = std::max(bMax.x, positions[i].x);
+        bMin.y = std::min(bMin.y, positions[i].y); bMax.y = std::max(bMax.y, positions[i].y);
+        bMin.z = std::min(bMin.z, positions[i].z); bMax.z = std::max(bMax.z, positions[i].z);
+    }
+
+    // cubic cells, gridResolution along the longest side, plus a layer
+    // all around that's known to be outside
+    float cellSize = std::max(bMax.x - bMin.x, std::max(bMax.y - bMin.y, bMax.z - bMin.z)) / gridResolution;
+    if (cellSize <= 0.0f)
+        return;
+    XMFLOAT3 origin(bMin.x - cellSize, bMin.y - cellSize, bMin.z - cellSize);
+    int size[3] =
+    {
+        (int)ceilf((bMax.x - bMin.x) / cellSize) + 2,
+        (int)ceilf((bMax.y - bMin.y) / cellSize) + 2,
+        (int)ceilf((bMax.z - bMin.z) / cellSize) + 2
+    };
+    auto cellIndex = [&size](int x, int y, int z) { return ((size_t)z * size[1] + y) * size[0] + x; };
+
+    enum : unsigned char { CELL_EMPTY, CELL_SURFACE, CELL_OUTSIDE, CELL_TAKEN };
+    std::vector<unsigned char> cells((size_t)size[0] * size[1] * size[2], CELL_EMPTY);
+
+    // mark every cell a triangle touches - the cells are grown a little
+    // for the test, so a triangle lying on a cell face marks both sides
+    float half = cellSize * 0.5f;
+    float grownHalf = half * 1.001f;
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const XMFLOAT3* corners[3] = { &positions[indices[i]], &positions[indices[i + 1]], &positions[indices[i + 2]] };
+        int lo[3], hi[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float o = (&origin.x)[axis];
+            float a = (&corners[0]->x)[axis], b = (&corners[1]->x)[axis], c = (&corners[2]->x)[axis];
+            lo[axis] = std::max(0, (int)floorf((std::min(a, std::min(b, c)) - o) / cellSize) - 1);
+            hi[axis] = std::min(size[axis] - 1, (int)floorf((std::max(a, std::max(b, c)) - o) / cellSize) + 1);
+        }
+
+        for (int z = lo[2]; z <= hi[2]; z++)
+        {
+            for (int y = lo[1]; y <= hi[1]; y++)
+            {
+                for (int x = lo[0]; x <= hi[0]; x++)
+                {
+                    unsigned char& cell = cells[cellIndex(x, y, z)];
+                    if (cell == CELL_SURFACE)
+                        continue;
+                    XMFLOAT3 center(origin.x + (x + 0.5f) * cellSize, origin.y + (y + 0.5f) * cellSize, origin.z + (z + 0.5f) * cellSize);
+                    if (TriangleOverlapsCell(center, grownHalf, *corners[0], *corners[1], *corners[2]))
+                        cell = CELL_SURFACE;
+                }
+            }
+        }
+    }
+
+    // flood the outside in from the padding corner - whatever empty
+    // cells it can't reach are walled in by the surface
+    std::vector<size_t> open;
+    open.push_back(0);
+    cells[0] = CELL_OUTSIDE;
+    while (!open.empty())
+    {
+        size_t index = open.back();
+        open.pop_back();
+        int x = (int)(index % size[0]);
+        int y = (int)((index / size[0]) % size[1]);
+        int z = (int)(index / ((size_t)size[0] * size[1]));
+        int neighbors[6][3] = { { x - 1, y, z }, { x + 1, y, z }, { x, y - 1, z }, { x, y + 1, z }, { x, y, z - 1 }, { x, y, z + 1 } };
+        for (auto& n : neighbors)
+        {
+            if (n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= size[0] || n[1] >= size[1] || n[2] >= size[2])
+                continue;
+            size_t next = cellIndex(n[0], n[1], n[2]);
+            if (cells[next] != CELL_EMPTY)
+                continue;
+            cells[next] = CELL_OUTSIDE;
+            open.push_back(next);
+        }
+    }
+
+    // greedily merge the enclosed cells into boxes - x runs first, then
+    // as many rows of them as are enclosed, then as many slabs of those
+    auto enclosed = [&](int x0, int x1, int y0, int y1, int z0, int z1)
+    {
+        for (int z = z0; z <= z1; z++)
+            for (int y = y0; y <= y1; y++)
+                for (int x = x0; x <= x1; x++)
+                    if (cells[cellIndex(x, y, z)] != CELL_EMPTY)
+                        return false;
+        return true;
+    };
+
+    for (int z = 0; z < size[2]; z++)
+    {
+        for (int y = 0; y < size[1]; y++)
+        {
+            for (int x = 0; x < size[0]; x++)
+            {
+                if (cells[cellIndex(x, y, z)] != CELL_EMPTY)
+                    continue;
+
+                int x1 = x, y1 = y, z1 = z;
+                while (x1 + 1 < size[0] && enclosed(x1 + 1, x1 + 1, y, y, z, z))
+                    x1++;
+                while (y1 + 1 < size[1] && enclosed(x, x1, y1 + 1, y1 + 1, z, z))
+                    y1++;
+                while (z1 + 1 < size[2] && enclosed(x, x1, y, y1, z1 + 1, z1 + 1))
+                    z1++;
+
+                for (int bz = z; bz <= z1; bz++)
+                    for (int by = y; by <= y1; by++)
+                        for (int bx = x; bx <= x1; bx++)
+                            cells[cellIndex(bx, by, bz)] = CELL_TAKEN;
+
+                // 8 corners, bit 0 picks x, bit 1 y and bit 2 z
+                unsigned int base = (unsigned int)proxyPositions.size();
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    proxyPositions.push_back(XMFLOAT3(
+                        origin.x + ((corner & 1) ? x1 + 1 : x) * cellSize,
+                        origin.y + ((corner & 2) ? y1 + 1 : y) * cellSize,
+                        origin.z + ((corner & 4) ? z1 + 1 : z) * cellSize));
+                }
+
+                // occluders are drawn double sided, so the winding doesn't matter
+                static const unsigned int boxIndices[36] =
+                {
+                    0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5,   // -z, +z
+                    0, 4, 5, 0, 5, 1,   2, 3, 7, 2, 7, 6,   // -y, +y
+                    0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3    // -x, +x
+                };
+                for (unsigned int index : boxIndices)
+                    proxyIndices.push_back(base + index);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& viewProj)
+{
+    viewProjection = viewProj;
+    instances.clear();
+    testedCount = 0;
+    occludedCount = 0;
+}
+
+void OcclusionCuller::AddOccluderInstance(int occluderId, const XMFLOAT4X4& world)
+{
+    if (occluderId < 0 || occluderId >= (int)occluders.size())
+        return;
+
+    OccluderInstance instance;
+    instance.occluderId = occluderId;
+    instance.world = world;
+    instances.push_back(instance);
+}
+
+void OcclusionCuller::Rasterize()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    // front end - transform, clip and bin on this thread
+    TransformAndClip();
+
+    // back end - each band of rows belongs to exactly one thread
+    if (threadCount > 1)
+    {
+        std::vector<std::thread> workers;
+        for (unsigned int band = 1; band < threadCount; band++)
+            workers.push_back(std::thread(&OcclusionCuller::RasterizeBand, this, band));
+
+        RasterizeBand(0);
+
+        for (auto& w : workers)
+            w.join();
+    }
+    else
+    {
+        RasterizeBand(0);
+    }
+
+    // groups straddle the bands, so the coarse level waits for all of them
+    for (int gy = 0; gy < groupsY; gy++)
+    {
+        for (int gx = 0; gx < groupsX; gx++)
+        {
+            float farthest = 0.0f;
+            int tyEnd = std::min(tilesY, (gy + 1) * TILE_GROUP_SIZE);
+            int txEnd = std::min(tilesX, (gx + 1) * TILE_GROUP_SIZE);
+            for (int ty = gy * TILE_GROUP_SIZE; ty < tyEnd; ty++)
+            {
+                for (int tx = gx * TILE_GROUP_SIZE; tx < txEnd; tx++)
+                    farthest = std::max(farthest, hiZ[(size_t)ty * tilesX + tx]);
+            }
+            hiZCoarse[(size_t)gy * groupsX + gx] = farthest;
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    lastRasterTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void OcclusionCuller::TransformAndClip()
+{
+    triangles.clear();
+    for (auto& bin : bins)
+        bin.clear();
+
+    occluderTriangleCount = 0;
+
+    // written out rather than left to DirectXMath, whose operation order
+    // differs between versions, so the buffer comes out bit for bit the
+    // same everywhere - the golden check depends on that
+    const XMFLOAT4X4& vp = viewProjection;
+    for (auto& instance : instances)
+    {
+        OccluderMesh& mesh = occluders[instance.occluderId];
+        const XMFLOAT4X4& w = instance.world;
+        XMFLOAT4X4 m;
+        for (int r = 0; r < 4; r++)
+        {
+            for (int c = 0; c < 4; c++)
+                m.m[r][c] = w.m[r][0] * vp.m[0][c] + w.m[r][1] * vp.m[1][c] + w.m[r][2] * vp.m[2][c] + w.m[r][3] * vp.m[3][c];
+        }
+
+        clipVerts.resize(mesh.positions.size());
+        for (size_t i = 0; i < mesh.positions.size(); i++)
+        {
+            const XMFLOAT3& p = mesh.positions[i];
+            clipVerts[i] = XMFLOAT4(
+                p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41,
+                p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42,
+                p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43,
+                p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44);
+        }
+
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            occluderTriangleCount++;
+
+            XMFLOAT4 poly[8];
+            XMFLOAT4 temp[8];
+            int count = 3;
+            poly[0] = clipVerts[mesh.indices[i]];
+            poly[1] = clipVerts[mesh.indices[i + 1]];
+            poly[2] = clipVerts[mesh.indices[i + 2]];
+
+            // Sutherland-Hodgman against each plane, skipping the
+            // work entirely when all corners are on the inside
+            for (int plane = 0; plane < 5 && count >= 3; plane++)
+            {
+                bool allInside = true;
+                bool allOutside = true;
+                for (int v = 0; v < count; v++)
+                {
+                    bool inside = ClipDistance(poly[v], plane) >= 0.0f;
+                    allInside = allInside && inside;
+                    allOutside = allOutside && !inside;
+                }
+                if (allInside)
+                    continue;
+                if (allOutside)
+                {
+                    count = 0;
+                    break;
+                }
+
+                int outCount = 0;
+                for (int v = 0; v < count; v++)
+                {
+                    const XMFLOAT4& a = poly[v];
+                    const XMFLOAT4& b = poly[(v + 1) % count];
+                    float da = ClipDistance(a, plane);
+                    float db = ClipDistance(b, plane);
+
+                    if (da >= 0.0f)
+                        temp[outCount++] = a;
+
+                    if ((da >= 0.0f) != (db >= 0.0f))
+                    {
+                        float t = da / (da - db);
+                        temp[outCount++] = XMFLOAT4(
+                            a.x + (b.x - a.x) * t,
+                            a.y + (b.y - a.y) * t,
+                            a.z + (b.z - a.z) * t,
+                            a.w + (b.w - a.w) * t);
+                    }
+                }
+
+                count = outCount;
+                for (int v = 0; v < count; v++)
+                    poly[v] = temp[v];
+            }
+
+            // fan out whatever is left
+            for (int v = 1; v + 1 < count; v++)
+                EmitTriangle(poly[0], poly[v], poly[v + 1]);
+        }
+    }
+
+    rasterizedTriangleCount = (unsigned int)triangles.size();
+}
+
+void OcclusionCuller::EmitTriangle(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c)
+{
+    const XMFLOAT4* verts[3] = { &a, &b, &c };
+    ScreenTriangle tri;
+    for (int i = 0; i < 3; i++)
+    {
+        float invW = 1.0f / verts[i]->w;
+        float sx = (verts[i]->x * invW * 0.5f + 0.5f) * width;
+        float sy = (0.5f - verts[i]->y * invW * 0.5f) * height;
+        tri.x[i] = (int)floorf(sx * SUBPIXEL_SCALE + 0.5f);
+        tri.y[i] = (int)floorf(sy * SUBPIXEL_SCALE + 0.5f);
+        tri.z[i] = verts[i]->z * invW;
+    }
+
+    // orient every triangle the same way so "inside" is always >= 0
+    // (occluders are drawn double sided, winding isn't trusted)
+    long long area =
+        (long long)(tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) -
+        (long long)(tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+    if (area == 0)
+        return;
+    if (area < 0)
+    {
+        std::swap(tri.x[1], tri.x[2]);
+        std::swap(tri.y[1], tri.y[2]);
+        std::swap(tri.z[1], tri.z[2]);
+    }
+
+    // rows whose pixel centers fall inside the vertical extent
+    int minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+    int maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+    tri.minY = std::max(0, (minY - SUBPIXEL_HALF + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS);
+    tri.maxY = std::min(height - 1, (maxY - SUBPIXEL_HALF) >> SUBPIXEL_BITS);
+    if (tri.minY > tri.maxY)
+        return;
+
+    int minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+    int maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+    if (maxX < 0 || minX >= width * SUBPIXEL_SCALE)
+        return;
+
+    unsigned int index = (unsigned int)triangles.size();
+    triangles.push_back(tri);
+
+    // bin into every band the triangle touches
+    int firstBand = std::min((int)threadCount - 1, tri.minY / bandHeight);
+    int lastBand = std::min((int)threadCount - 1, tri.maxY / bandHeight);
+    for (int band = firstBand; band <= lastBand; band++)
+        bins[band].push_back(index);
+}
+
+void OcclusionCuller::RasterizeBand(unsigned int band)
+{
+    int bandStart = std::min(height, (int)band * bandHeight);
+    int bandEnd = band == threadCount - 1 ? height : std::min(height, bandStart + bandHeight);
+    if (bandStart >= bandEnd)
+        return;
+
+    // triangles are processed in submission order within the band
+    for (unsigned int index : bins[band])
+    {
+        const ScreenTriangle& tri = triangles[index];
+        int rowStart = std::max(bandStart, tri.minY);
+        int rowEnd = std::min(bandEnd, tri.maxY + 1);
+        if (rowStart >= rowEnd)
+            continue;
+
+        TriangleSetup setup;
+        if (!SetupTriangle(tri, width, setup))
+            continue;
+
+        if (useAVX2)
+            RasterizeAVX2(setup, depth.data(), width, rowStart, rowEnd);
+        else
+            RasterizeScalar(setup, depth.data(), width, rowStart, rowEnd);
+    }
+
+    // reduce this band's rows to the farthest depth per tile
+    for (int ty = bandStart / TILE_HEIGHT; ty < bandEnd / TILE_HEIGHT; ty++)
+    {
+        for (int tx = 0; tx < tilesX; tx++)
+        {
+            float farthest = 0.0f;
+            for (int y = 0; y < TILE_HEIGHT; y++)
+            {
+                const float* row = depth.data() + (size_t)(ty * TILE_HEIGHT + y) * width + tx * TILE_WIDTH;
+                for (int x = 0; x < TILE_WIDTH; x++)
+                    farthest = std::max(farthest, row[x]);
+            }
+            hiZ[(size_t)ty * tilesX + tx] = farthest;
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible(XMFLOAT3 center, XMFLOAT3 extents)
+{
+    testedCount++;
+
+    // project the 8 corners, tracking the screen rect and nearest depth
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float nearestZ = FLT_MAX;
+    XMMATRIX viewProj = XMLoadFloat4x4(&viewProjection);
+    for (int i = 0; i < 8; i++)
+    {
+        XMVECTOR corner = XMVectorSet(
+            center.x + ((i & 1) ? extents.x : -extents.x),
+            center.y + ((i & 2) ? extents.y : -extents.y),
+            center.z + ((i & 4) ? extents.z : -extents.z),
+            1.0f);
+        XMFLOAT4 clip;
+        XMStoreFloat4(&clip, XMVector4Transform(corner, viewProj));
+
+        // anything reaching past the near plane is treated as visible
+        if (clip.z <= 0.0f || clip.w <= 0.0f)
+            return true;
+
+        float invW = 1.0f / clip.w;
+        float sx = (clip.x * invW * 0.5f + 0.5f) * width;
+        float sy = (0.5f - clip.y * invW * 0.5f) * height;
+        minX = std::min(minX, sx); maxX = std::max(maxX, sx);
+        minY = std::min(minY, sy); maxY = std::max(maxY, sy);
+        nearestZ = std::min(nearestZ, clip.z * invW);
+    }
+
+    // off screen boxes are the frustum culler's job
+    if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height)
+        return true;
+
+    int tx0 = std::max(0, (int)floorf(minX) / TILE_WIDTH);
+    int ty0 = std::max(0, (int)floorf(minY) / TILE_HEIGHT);
+    int tx1 = std::min(tilesX - 1, (int)floorf(maxX) / TILE_WIDTH);
+    int ty1 = std::min(tilesY - 1, (int)floorf(maxY) / TILE_HEIGHT);
+
+    // visible as soon as any covered tile has something behind the box -
+    // a group whose farthest depth is in front of it hides all its tiles,
+    // so only the groups that don't get their tiles read
+    for (int gy = ty0 / TILE_GROUP_SIZE; gy <= ty1 / TILE_GROUP_SIZE; gy++)
+    {
+        for (int gx = tx0 / TILE_GROUP_SIZE; gx <= tx1 / TILE_GROUP_SIZE; gx++)
+        {
+            if (hiZCoarse[(size_t)gy * groupsX + gx] < nearestZ)
+                continue;
+
+            int tyEnd = std::min(ty1, (gy + 1) * TILE_GROUP_SIZE - 1);
+            int txEnd = std::min(tx1, (gx + 1) * TILE_GROUP_SIZE - 1);
+            for (int ty = std::max(ty0, gy * TILE_GROUP_SIZE); ty <= tyEnd; ty++)
+            {
+                for (int tx = std::max(tx0, gx * TILE_GROUP_SIZE); tx <= txEnd; tx++)
+                {
+                    if (hiZ[(size_t)ty * tilesX + tx] >= nearestZ)
+                        return true;
+                }
+            }
+        }
+    }
+
+    occludedCount++;
+    return false;
+}
+
+void OcclusionCuller::SetUseAVX2(bool enabled) { useAVX2 = enabled && CpuFeatures::HasAVX2(); }
+
+int OcclusionCuller::GetWidth() { return width; }
+int OcclusionCuller::GetHeight() { return height; }
+const std::vector<float>& OcclusionCuller::GetDepthBuffer() { return depth; }
+
+// writes the depth buffer as a grayscale PFM (raw little endian floats,
+// bottom row first) so it can be diffed bit for bit or opened in an viewer
+bool OcclusionCuller::SaveDepthBuffer(const char* fileName)
+{
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file << "Pf\n" << width << " " << height << "\n-1.0\n";
+    for (int y = height - 1; y >= 0; y--)
+    {
+        file.write((const char*)(depth.data() + (size_t)y * width), sizeof(float) * width);
+    }
+    return file.good();
+}
+
+unsigned int OcclusionCuller::GetOccluderTriangleCount() { return occluderTriangleCount; }
+unsigned int OcclusionCuller::GetRasterizedTriangleCount() { return rasterizedTriangleCount; }
+unsigned int OcclusionCuller::GetTestedCount() { return testedCount; }
+unsigned int OcclusionCuller::GetOccludedCount() { return occludedCount; }
+float OcclusionCuller::GetLastRasterTime() { return lastRasterTime; }
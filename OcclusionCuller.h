@@ -0,0 +1,127 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+// the most pixels the depth buffer can have - edge functions are stepped
+// in 32 bits, and across the guard band they reach up to 768 times the
+// pixel count, so this leaves some headroom below where they'd overflow
+#define OCCLUSION_MAX_PIXELS    (1024 * 1024)
+
+// CPU occlusion culling against a small software depth buffer
+// - Occluder triangles are transformed, clipped and rasterized into a
+//   low resolution depth buffer (nearest depth wins)
+// - The buffer is reduced to a two level hierarchy storing the FARTHEST
+//   depth of each 8x4 pixel tile, then of each 4x4 group of tiles, so a
+//   box can be rejected conservatively with a handful of group reads,
+//   going down to the tiles only where a group doesn't hide it
+// - Rasterization uses fixed point edge functions, AVX2 when available and
+//   an identical scalar path otherwise, and is split into horizontal bands
+//   that worker threads own exclusively, so the result never depends on
+//   the thread count or scheduling
+// - Nothing here touches D3D, so it can be built and checked anywhere
+class OcclusionCuller
+{
+public:
+    // width is rounded up to a multiple of 8 and height to a multiple of 4,
+    // and a size past OCCLUSION_MAX_PIXELS is scaled down to fit, keeping
+    // its aspect ratio - GetWidth()/GetHeight() give the size used
+    // threadCount 0 picks one based on the hardware
+    OcclusionCuller(int width = 256, int height = 144, unsigned int threadCount = 0);
+
+    // occluder geometry - returns an id to use with AddOccluderInstance()
+    int AddOccluder(const DirectX::XMFLOAT3* positions, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+
+    // builds a low poly stand-in for a dense mesh out of boxes that lie
+    // entirely inside it, so the stand-in never covers a pixel the mesh
+    // doesn't, or sits any closer than the mesh there
+    // - the mesh is voxelized with gridResolution cells along its longest
+    //   side; the cells the outside can't reach past the surface cells
+    //   are the inside, which is merged into as few boxes as it can be
+    // - holes in the surface let the outside in, and parts thinner than
+    //   a couple of cells have no inside, so those just don't occlude
+    static void BuildProxy(const DirectX::XMFLOAT3* positions, size_t vertexCount, const unsigned int* indices, size_t indexCount, int gridResolution, std::vector<DirectX::XMFLOAT3>& proxyPositions, std::vector<unsigned int>& proxyIndices);
+
+    // per frame usage:
+    //   BeginFrame(), AddOccluderInstance() for each occluder,
+    //   Rasterize(), then IsVisible() for each candidate
+    void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection);
+    void AddOccluderInstance(int occluderId, const DirectX::XMFLOAT4X4& world);
+    void Rasterize();
+
+    // tests a world space box (center/half extents) against the depth buffer
+    bool IsVisible(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents);
+
+    // the rasterizer's path - on by default when the CPU has AVX2, and
+    // the scalar one gives the same buffer bit for bit
+    void SetUseAVX2(bool enabled);
+
+    // debugging / verification
+    int GetWidth();
+    int GetHeight();
+    const std::vector<float>& GetDepthBuffer();
+    bool SaveDepthBuffer(const char* fileName);
+
+    // stats
+    unsigned int GetOccluderTriangleCount();
+    unsigned int GetRasterizedTriangleCount();
+    unsigned int GetTestedCount();
+    unsigned int GetOccludedCount();
+    float GetLastRasterTime();
+
+    // triangle after projection, in fixed point screen space
+    struct ScreenTriangle
+    {
+        int x[3];
+        int y[3];
+        float z[3];
+        int minY;
+        int maxY;
+    };
+
+private:
+    struct OccluderMesh
+    {
+        std::vector<DirectX::XMFLOAT3> positions;
+        std::vector<unsigned int> indices;
+    };
+
+    struct OccluderInstance
+    {
+        int occluderId;
+        DirectX::XMFLOAT4X4 world;
+    };
+
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+    int groupsX;
+    int groupsY;
+    int bandHeight;
+    unsigned int threadCount;
+    bool useAVX2;
+
+    DirectX::XMFLOAT4X4 viewProjection;
+    std::vector<OccluderMesh> occluders;
+    std::vector<OccluderInstance> instances;
+
+    // scratch space reused every frame
+    std::vector<DirectX::XMFLOAT4> clipVerts;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<std::vector<unsigned int>> bins;
+
+    std::vector<float> depth;
+    std::vector<float> hiZ;
+    std::vector<float> hiZCoarse;
+
+    unsigned int occluderTriangleCount;
+    unsigned int rasterizedTriangleCount;
+    unsigned int testedCount;
+    unsigned int occludedCount;
+    float lastRasterTime;
+
+    void TransformAndClip();
+    void EmitTriangle(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c);
+    void RasterizeBand(unsigned int band);
+};
+
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Checks.h"
+#include "CheckReport.h"
+#include "CpuFeatures.h"
+#include "ObjFile.h"
+#include "OcclusionCuller.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // reads a PFM written by SaveDepthBuffer() back into row order
+    bool ReadDepthBuffer(const char* fileName, int width, int height, std::vector<float>& depth)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        std::string magic;
+        int fileWidth = 0, fileHeight = 0;
+        float scale = 0.0f;
+        file >> magic >> fileWidth >> fileHeight >> scale;
+        file.get();
+        if (!file.good() || magic != "Pf" || fileWidth != width || fileHeight != height || scale >= 0.0f)
+            return false;
+
+        depth.resize((size_t)width * height);
+        for (int y = height - 1; y >= 0; y--)
+            file.read((char*)(depth.data() + (size_t)y * width), sizeof(float) * width);
+        return file.good();
+    }
+
+    // a world matrix with a scale, an optional half turn about y and a
+    // translation, written out so no trig is involved
+    XMFLOAT4X4 PlacementMatrix(XMFLOAT3 scale, bool halfTurn, XMFLOAT3 position)
+    {
+        XMFLOAT4X4 world = {};
+        world._11 = halfTurn ? -scale.x : scale.x;
+        world._22 = scale.y;
+        world._33 = halfTurn ? -scale.z : scale.z;
+        world._41 = position.x;
+        world._42 = position.y;
+        world._43 = position.z;
+        world._44 = 1.0f;
+        return world;
+    }
+}
+
+// --------------------------------------------------------
+// Rasterizes the room's occluders from fixed cameras with
+// the scalar path on one thread, compares that bit for bit
+// with the golden PFMs, then checks every thread count on
+// both paths gives the same buffer:
+//   DX11Checks -occlusioncheck [-threads N] [-update]
+//              [-models dir] [-goldens dir]
+// -update rewrites the goldens instead of comparing with
+// them. The directories default to the repo's Assets
+// --------------------------------------------------------
+int RunOcclusionCheck(int argc, char** argv)
+{
+    unsigned int maxThreads = (unsigned int)std::max(1, CheckReport::GetIntOption(argc, argv, "-threads", 8));
+    bool update = CheckReport::HasOption(argc, argv, "-update");
+    std::string modelDirectory = CheckReport::GetStringOption(argc, argv, "-models", "Assets/Models");
+    std::string goldenDirectory = CheckReport::GetStringOption(argc, argv, "-goldens", "Assets/Occlusion");
+    CheckReport report("occlusioncheck");
+
+    // the walls and the sofa and tv proxies, placed like Game does - the
+    // tv's half turn is exact here, so it's a hair off the game's
+    const char* modelNames[] = { "cube.obj", "sofa.obj", "tv.obj" };
+    std::vector<XMFLOAT3> positions[3];
+    std::vector<unsigned int> indices[3];
+    for (int m = 0; m < 3; m++)
+    {
+        std::vector<Vertex> verts;
+        std::string path = modelDirectory + "/" + modelNames[m];
+        if (!report.Expect(ObjFile::Read(path.c_str(), verts, indices[m]) && !verts.empty(), "couldn't read %s", path.c_str()))
+            return report.Finish();
+        for (const Vertex& vert : verts)
+            positions[m].push_back(vert.Position);
+    }
+
+    std::vector<XMFLOAT3> proxyPositions[2];
+    std::vector<unsigned int> proxyIndices[2];
+    for (int m = 0; m < 2; m++)
+    {
+        OcclusionCuller::BuildProxy(positions[m + 1].data(), positions[m + 1].size(), indices[m + 1].data(), indices[m + 1].size(),
+            24, proxyPositions[m], proxyIndices[m]);
+    }
+
+    struct Placement { int occluder; XMFLOAT3 scale; bool halfTurn; XMFLOAT3 position; };
+    Placement placements[] =
+    {
+        { 0, XMFLOAT3(15.0f, 10.0f, 1.0f), false, XMFLOAT3(0.0f, -0.5f, -8.0f) },
+        { 0, XMFLOAT3(15.0f, 10.0f, 1.0f), false, XMFLOAT3(0.0f, -0.5f, 8.0f) },
+        { 0, XMFLOAT3(1.0f, 10.0f, 17.0f), false, XMFLOAT3(-8.0f, -0.5f, 0.0f) },
+        { 0, XMFLOAT3(1.0f, 10.0f, 17.0f), false, XMFLOAT3(8.0f, -0.5f, 0.0f) },
+        { 1, XMFLOAT3(0.03f, 0.03f, 0.03f), false, XMFLOAT3(0.0f, -4.5f, 4.5f) },
+        { 2, XMFLOAT3(5.0f, 5.0f, 5.0f), true, XMFLOAT3(0.0f, -2.85f, -4.5f) }
+    };
+    std::vector<XMFLOAT4X4> worlds;
+    for (const Placement& placement : placements)
+        worlds.push_back(PlacementMatrix(placement.scale, placement.halfTurn, placement.position));
+
+    // the game's starting view at the tv, a corner looking across the
+    // room, and one low beside the sofa - walls run behind all three, so
+    // they all clip against the near plane. directions are axis aligned
+    // or diagonal and the projection's scales are exact, so building
+    // them needs no trig either
+    struct View { XMFLOAT3 eye; XMFLOAT3 forward; };
+    const float diagonal = 1.0f / sqrtf(2.0f);
+    View views[] =
+    {
+        { XMFLOAT3(0.0f, -2.0f, 4.5f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+        { XMFLOAT3(-6.5f, -1.0f, -6.5f), XMFLOAT3(diagonal, 0.0f, diagonal) },
+        { XMFLOAT3(5.0f, -3.9f, 4.5f), XMFLOAT3(-1.0f, 0.0f, 0.0f) }
+    };
+    const float nearPlane = 0.01f;
+    const float farPlane = 100.0f;
+    const float yScale = 2.0f;
+    const float xScale = yScale * 9.0f / 16.0f;
+
+    for (int v = 0; v < 3; v++)
+    {
+        // right = up x forward, up stays +y since nothing looks up or down
+        XMFLOAT3 f = views[v].forward;
+        XMFLOAT3 e = views[v].eye;
+        XMFLOAT4X4 viewProj = {};
+        viewProj._11 = f.z * xScale;
+        viewProj._31 = -f.x * xScale;
+        viewProj._41 = -(e.x * f.z - e.z * f.x) * xScale;
+        viewProj._22 = yScale;
+        viewProj._42 = -e.y * yScale;
+        float zScale = farPlane / (farPlane - nearPlane);
+        float depth = -(e.x * f.x + e.z * f.z);
+        viewProj._13 = f.x * zScale;
+        viewProj._33 = f.z * zScale;
+        viewProj._43 = depth * zScale - nearPlane * zScale;
+        viewProj._14 = f.x;
+        viewProj._34 = f.z;
+        viewProj._44 = depth;
+
+        auto render = [&](OcclusionCuller& culler)
+        {
+            int ids[3];
+            ids[0] = culler.AddOccluder(positions[0].data(), positions[0].size(), indices[0].data(), indices[0].size());
+            for (int m = 0; m < 2; m++)
+                ids[m + 1] = culler.AddOccluder(proxyPositions[m].data(), proxyPositions[m].size(), proxyIndices[m].data(), proxyIndices[m].size());
+
+            culler.BeginFrame(viewProj);
+            for (int i = 0; i < 6; i++)
+                culler.AddOccluderInstance(ids[placements[i].occluder], worlds[i]);
+            culler.Rasterize();
+        };
+
+        OcclusionCuller reference(256, 144, 1);
+        reference.SetUseAVX2(false);
+        render(reference);
+        const std::vector<float>& expected = reference.GetDepthBuffer();
+        unsigned int covered = 0;
+        for (float z : expected)
+            covered += z < 1.0f ? 1 : 0;
+        report.Print("view %d: %u of %u pixels covered, %u triangles rasterized", v, covered, (unsigned int)expected.size(),
+            reference.GetRasterizedTriangleCount());
+
+        std::string golden = goldenDirectory + "/room_view" + std::to_string(v) + ".pfm";
+        if (update)
+        {
+            if (report.Expect(reference.SaveDepthBuffer(golden.c_str()), "couldn't write %s", golden.c_str()))
+                report.Print("  golden written");
+        }
+        else
+        {
+            std::vector<float> stored;
+            if (report.Expect(ReadDepthBuffer(golden.c_str(), reference.GetWidth(), reference.GetHeight(), stored), "no golden to compare with at %s", golden.c_str()))
+            {
+                unsigned int differing = 0;
+                for (size_t i = 0; i < stored.size(); i++)
+                    differing += memcmp(&stored[i], &expected[i], sizeof(float)) != 0 ? 1 : 0;
+                if (report.Expect(differing == 0, "%u pixels differ from the golden", differing))
+                    report.Print("  matches the golden");
+            }
+        }
+
+        // every thread count and path has to give exactly the same buffer
+        for (int avx2 = 0; avx2 <= 1; avx2++)
+        {
+            if (avx2 && !CpuFeatures::HasAVX2())
+            {
+                report.Print("  AVX2: not supported by this CPU, skipped");
+                continue;
+            }
+
+            std::string mismatched;
+            for (unsigned int threads = 1; threads <= maxThreads; threads++)
+            {
+                OcclusionCuller culler(256, 144, threads);
+                culler.SetUseAVX2(avx2 != 0);
+                render(culler);
+                if (memcmp(culler.GetDepthBuffer().data(), expected.data(), sizeof(float) * expected.size()) != 0)
+                    mismatched += " " + std::to_string(threads);
+            }
+            if (report.Expect(mismatched.empty(), "%s differs from the reference at%s threads", avx2 ? "AVX2" : "scalar", mismatched.c_str()))
+                report.Print("  %s, 1-%u threads: identical", avx2 ? "AVX2" : "scalar", maxThreads);
+        }
+    }
+
+    return report.Finish();
+}
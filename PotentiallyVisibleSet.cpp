@@ -0,0 +1,531 @@
+#include "PotentiallyVisibleSet.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace DirectX;
+
+// file header for saved sets
+#define PVS_FILE_MAGIC      0x31535650 // "PVS1"
+
+// lookup table resolution used when cells were authored by hand
+#define PVS_LOOKUP_RES      32
+
+namespace
+{
+    bool Contains(const XMFLOAT3& bMin, const XMFLOAT3& bMax, const XMFLOAT3& p)
+    {
+        return p.x >= bMin.x && p.x <= bMax.x &&
+            p.y >= bMin.y && p.y <= bMax.y &&
+            p.z >= bMin.z && p.z <= bMax.z;
+    }
+
+    bool Overlaps(const XMFLOAT3& aMin, const XMFLOAT3& aMax, const XMFLOAT3& bMin, const XMFLOAT3& bMax)
+    {
+        return aMin.x <= bMax.x && aMax.x >= bMin.x &&
+            aMin.y <= bMax.y && aMax.y >= bMin.y &&
+            aMin.z <= bMax.z && aMax.z >= bMin.z;
+    }
+
+    // slab test of the segment from + t * dir, t in [tMin, tMax]
+    // returns the entry t, or a negative number on a miss
+    float SegmentEntry(const XMFLOAT3& from, const XMFLOAT3& dir, float tMin, float tMax, const XMFLOAT3& bMin, const XMFLOAT3& bMax)
+    {
+        const float o[3] = { from.x, from.y, from.z };
+        const float d[3] = { dir.x, dir.y, dir.z };
+        const float lo[3] = { bMin.x, bMin.y, bMin.z };
+        const float hi[3] = { bMax.x, bMax.y, bMax.z };
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (d[axis] == 0.0f)
+            {
+                if (o[axis] < lo[axis] || o[axis] > hi[axis])
+                    return -1.0f;
+                continue;
+            }
+
+            float inv = 1.0f / d[axis];
+            float t0 = (lo[axis] - o[axis]) * inv;
+            float t1 = (hi[axis] - o[axis]) * inv;
+            if (t0 > t1)
+                std::swap(t0, t1);
+
+            tMin = std::max(tMin, t0);
+            tMax = std::min(tMax, t1);
+            if (tMin > tMax)
+                return -1.0f;
+        }
+
+        return tMin;
+    }
+
+    void Hash(uint64_t& hash, const void* data, size_t size)
+    {
+        // FNV-1a
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+}
+
+PotentiallyVisibleSet::PotentiallyVisibleSet()
+{
+    lookupBounds = {};
+    lookupRes[0] = lookupRes[1] = lookupRes[2] = 0;
+    cellWords = 0;
+    entityWords = 0;
+    built = false;
+    rngState = 1;
+    signature = 0;
+}
+
+int PotentiallyVisibleSet::AddCell(XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+    Box cell = { boundsMin, boundsMax };
+    cells.push_back(cell);
+    built = false;
+    return (int)cells.size() - 1;
+}
+
+void PotentiallyVisibleSet::GenerateGridCells(XMFLOAT3 boundsMin, XMFLOAT3 boundsMax, int cellsX, int cellsY, int cellsZ)
+{
+    cells.clear();
+    portals.clear();
+
+    XMFLOAT3 size(
+        (boundsMax.x - boundsMin.x) / cellsX,
+        (boundsMax.y - boundsMin.y) / cellsY,
+        (boundsMax.z - boundsMin.z) / cellsZ);
+
+    // x fastest, matching the lookup table layout
+    for (int z = 0; z < cellsZ; z++)
+    {
+        for (int y = 0; y < cellsY; y++)
+        {
+            for (int x = 0; x < cellsX; x++)
+            {
+                XMFLOAT3 cMin(boundsMin.x + size.x * x, boundsMin.y + size.y * y, boundsMin.z + size.z * z);
+                XMFLOAT3 cMax(cMin.x + size.x, cMin.y + size.y, cMin.z + size.z);
+                AddCell(cMin, cMax);
+            }
+        }
+    }
+
+    // a grid maps exactly onto a lookup table of the same size
+    lookupRes[0] = cellsX;
+    lookupRes[1] = cellsY;
+    lookupRes[2] = cellsZ;
+}
+
+void PotentiallyVisibleSet::AddPortal(int cellA, int cellB, XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+    Portal portal = { cellA, cellB, { boundsMin, boundsMax } };
+    portals.push_back(portal);
+    built = false;
+}
+
+// finds every pair of cells that share a face, and turns the face into a
+// portal unless the occluders cover all of it (checked on a small grid of
+// points across the face)
+void PotentiallyVisibleSet::DerivePortals()
+{
+    const int faceSamples = 4;
+
+    for (size_t a = 0; a < cells.size(); a++)
+    {
+        for (size_t b = a + 1; b < cells.size(); b++)
+        {
+            const Box& ca = cells[a];
+            const Box& cb = cells[b];
+
+            // shared face = the overlap, which must be flat on exactly one axis
+            XMFLOAT3 fMin(std::max(ca.min.x, cb.min.x), std::max(ca.min.y, cb.min.y), std::max(ca.min.z, cb.min.z));
+            XMFLOAT3 fMax(std::min(ca.max.x, cb.max.x), std::min(ca.max.y, cb.max.y), std::min(ca.max.z, cb.max.z));
+            float extent[3] = { fMax.x - fMin.x, fMax.y - fMin.y, fMax.z - fMin.z };
+            int flatAxes = 0;
+            bool separated = false;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (extent[axis] < 0.0f) separated = true;
+                else if (extent[axis] == 0.0f) flatAxes++;
+            }
+            if (separated || flatAxes != 1)
+                continue;
+
+            bool open = false;
+            for (int i = 0; i < faceSamples && !open; i++)
+            {
+                for (int j = 0; j < faceSamples && !open; j++)
+                {
+                    float u = (i + 0.5f) / faceSamples;
+                    float v = (j + 0.5f) / faceSamples;
+
+                    // spread u/v over the two non-flat axes
+                    XMFLOAT3 p = fMin;
+                    if (extent[0] == 0.0f) { p.y += extent[1] * u; p.z += extent[2] * v; }
+                    else if (extent[1] == 0.0f) { p.x += extent[0] * u; p.z += extent[2] * v; }
+                    else { p.x += extent[0] * u; p.y += extent[1] * v; }
+
+                    bool covered = false;
+                    for (const Box& o : occluders)
+                    {
+                        if (Contains(o.min, o.max, p)) { covered = true; break; }
+                    }
+                    open = !covered;
+                }
+            }
+
+            if (open)
+                AddPortal((int)a, (int)b, fMin, fMax);
+        }
+    }
+}
+
+void PotentiallyVisibleSet::AddOccluder(XMFLOAT3 center, XMFLOAT3 extents)
+{
+    Box box = { XMFLOAT3(center.x - extents.x, center.y - extents.y, center.z - extents.z), XMFLOAT3(center.x + extents.x, center.y + extents.y, center.z + extents.z) };
+    occluders.push_back(box);
+    built = false;
+}
+
+void PotentiallyVisibleSet::AddEntity(XMFLOAT3 center, XMFLOAT3 extents)
+{
+    Box box = { XMFLOAT3(center.x - extents.x, center.y - extents.y, center.z - extents.z), XMFLOAT3(center.x + extents.x, center.y + extents.y, center.z + extents.z) };
+    entities.push_back(box);
+    built = false;
+}
+
+void PotentiallyVisibleSet::Build(int samplesPerTest, uint32_t seed)
+{
+    rngState = seed ? seed : 1;
+    BuildLookup();
+
+    size_t cellCount = cells.size();
+    size_t entityCount = entities.size();
+    cellWords = (cellCount + 63) / 64;
+    entityWords = (entityCount + 63) / 64;
+    cellVisibility.assign(cellCount * cellWords, 0);
+    entityVisibility.assign(cellCount * entityWords, 0);
+
+    auto setBit = [](std::vector<uint64_t>& bits, size_t row, size_t words, size_t index)
+    {
+        bits[row * words + index / 64] |= 1ull << (index % 64);
+    };
+
+    // cell to cell - symmetric, so only half the pairs are cast
+    for (size_t a = 0; a < cellCount; a++)
+    {
+        setBit(cellVisibility, a, cellWords, a);
+
+        for (size_t b = a + 1; b < cellCount; b++)
+        {
+            bool visible = HasPortal((int)a, (int)b);
+            for (int s = 0; s < samplesPerTest && !visible; s++)
+            {
+                XMFLOAT3 from, to;
+                if (!SamplePoint(cells[a], from) || !SamplePoint(cells[b], to))
+                    continue;
+                visible = !SegmentBlocked(from, to);
+            }
+
+            if (visible)
+            {
+                setBit(cellVisibility, a, cellWords, b);
+                setBit(cellVisibility, b, cellWords, a);
+            }
+        }
+    }
+
+    // which cells each entity touches, used to skip hopeless rays
+    std::vector<std::vector<int>> entityCells(entityCount);
+    for (size_t e = 0; e < entityCount; e++)
+    {
+        for (size_t c = 0; c < cellCount; c++)
+        {
+            if (Overlaps(entities[e].min, entities[e].max, cells[c].min, cells[c].max))
+                entityCells[e].push_back((int)c);
+        }
+    }
+
+    // cell to entity
+    for (size_t a = 0; a < cellCount; a++)
+    {
+        for (size_t e = 0; e < entityCount; e++)
+        {
+            const Box& target = entities[e];
+
+            // touching the cell, or not touching any cell (nothing to go on)
+            bool visible = Overlaps(target.min, target.max, cells[a].min, cells[a].max) || entityCells[e].empty();
+
+            // an entity can only be seen if some cell it sits in can be seen
+            bool reachable = visible;
+            for (int c : entityCells[e])
+            {
+                if (reachable) break;
+                reachable = IsCellVisible((int)a, c);
+            }
+
+            for (int s = 0; s < samplesPerTest && reachable && !visible; s++)
+            {
+                XMFLOAT3 from, to;
+                if (!SamplePoint(cells[a], from))
+                    continue;
+                to = XMFLOAT3(
+                    target.min.x + (target.max.x - target.min.x) * Random(),
+                    target.min.y + (target.max.y - target.min.y) * Random(),
+                    target.min.z + (target.max.z - target.min.z) * Random());
+
+                // stop the ray where it enters the entity's own box, so walls
+                // (which are both entities and occluders) don't hide themselves
+                XMFLOAT3 dir(to.x - from.x, to.y - from.y, to.z - from.z);
+                float entry = SegmentEntry(from, dir, 0.0f, 1.0f, target.min, target.max);
+                if (entry < 0.0f)
+                    continue;
+                entry = std::max(0.0f, entry - 0.001f);
+                XMFLOAT3 hit(from.x + dir.x * entry, from.y + dir.y * entry, from.z + dir.z * entry);
+
+                visible = !SegmentBlocked(from, hit);
+            }
+
+            if (visible)
+                setBit(entityVisibility, a, entityWords, e);
+        }
+    }
+
+    signature = ComputeSignature();
+    built = true;
+}
+
+bool PotentiallyVisibleSet::Save(const char* fileName)
+{
+    if (!built)
+        return false;
+
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    uint32_t header[3] = { PVS_FILE_MAGIC, (uint32_t)cells.size(), (uint32_t)entities.size() };
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)&signature, sizeof(signature));
+    file.write((const char*)cellVisibility.data(), cellVisibility.size() * sizeof(uint64_t));
+    file.write((const char*)entityVisibility.data(), entityVisibility.size() * sizeof(uint64_t));
+    return file.good();
+}
+
+bool PotentiallyVisibleSet::Load(const char* fileName)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    uint32_t header[3] = {};
+    uint64_t fileSignature = 0;
+    file.read((char*)header, sizeof(header));
+    file.read((char*)&fileSignature, sizeof(fileSignature));
+    if (!file.good() || header[0] != PVS_FILE_MAGIC || header[1] != cells.size() || header[2] != entities.size())
+        return false;
+
+    // built from some other version of the scene
+    if (fileSignature != ComputeSignature())
+        return false;
+
+    cellWords = (cells.size() + 63) / 64;
+    entityWords = (entities.size() + 63) / 64;
+    cellVisibility.resize(cells.size() * cellWords);
+    entityVisibility.resize(cells.size() * entityWords);
+    file.read((char*)cellVisibility.data(), cellVisibility.size() * sizeof(uint64_t));
+    file.read((char*)entityVisibility.data(), entityVisibility.size() * sizeof(uint64_t));
+    if (!file.good())
+        return false;
+
+    BuildLookup();
+    signature = fileSignature;
+    built = true;
+    return true;
+}
+
+bool PotentiallyVisibleSet::IsBuilt() { return built; }
+
+int PotentiallyVisibleSet::GetCell(XMFLOAT3 position)
+{
+    if (!built || !Contains(lookupBounds.min, lookupBounds.max, position))
+        return -1;
+
+    int v[3];
+    const float p[3] = { position.x, position.y, position.z };
+    const float lo[3] = { lookupBounds.min.x, lookupBounds.min.y, lookupBounds.min.z };
+    const float hi[3] = { lookupBounds.max.x, lookupBounds.max.y, lookupBounds.max.z };
+    for (int axis = 0; axis < 3; axis++)
+    {
+        v[axis] = (int)((p[axis] - lo[axis]) / (hi[axis] - lo[axis]) * lookupRes[axis]);
+        v[axis] = std::min(lookupRes[axis] - 1, std::max(0, v[axis]));
+    }
+
+    return lookup[((size_t)v[2] * lookupRes[1] + v[1]) * lookupRes[0] + v[0]];
+}
+
+bool PotentiallyVisibleSet::IsCellVisible(int fromCell, int toCell)
+{
+    if (fromCell < 0 || toCell < 0 || fromCell >= (int)cells.size() || toCell >= (int)cells.size() || cellVisibility.empty())
+        return true;
+
+    return (cellVisibility[fromCell * cellWords + toCell / 64] >> (toCell % 64)) & 1;
+}
+
+bool PotentiallyVisibleSet::IsEntityVisible(int fromCell, unsigned int entity)
+{
+    if (fromCell < 0 || fromCell >= (int)cells.size() || entity >= entities.size() || entityVisibility.empty())
+        return true;
+
+    return (entityVisibility[fromCell * entityWords + entity / 64] >> (entity % 64)) & 1;
+}
+
+const uint64_t* PotentiallyVisibleSet::GetVisibleEntities(int fromCell)
+{
+    if (!built || fromCell < 0 || fromCell >= (int)cells.size() || entityWords == 0)
+        return nullptr;
+
+    return &entityVisibility[fromCell * entityWords];
+}
+
+unsigned int PotentiallyVisibleSet::GetVisibleEntityCount(int fromCell)
+{
+    const uint64_t* bits = GetVisibleEntities(fromCell);
+    if (!bits)
+        return (unsigned int)entities.size();
+
+    unsigned int count = 0;
+    for (size_t w = 0; w < entityWords; w++)
+    {
+        uint64_t word = bits[w];
+        while (word)
+        {
+            word &= word - 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+int PotentiallyVisibleSet::GetCellCount() { return (int)cells.size(); }
+unsigned int PotentiallyVisibleSet::GetEntityCount() { return (unsigned int)entities.size(); }
+int PotentiallyVisibleSet::GetPortalCount() { return (int)portals.size(); }
+
+// xorshift32 - small, fast and the same on every platform
+float PotentiallyVisibleSet::Random()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return (rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+// random point in a box that isn't buried inside an occluder
+bool PotentiallyVisibleSet::SamplePoint(const Box& box, XMFLOAT3& point)
+{
+    for (int attempt = 0; attempt < 8; attempt++)
+    {
+        point = XMFLOAT3(
+            box.min.x + (box.max.x - box.min.x) * Random(),
+            box.min.y + (box.max.y - box.min.y) * Random(),
+            box.min.z + (box.max.z - box.min.z) * Random());
+
+        bool inside = false;
+        for (const Box& o : occluders)
+        {
+            if (Contains(o.min, o.max, point)) { inside = true; break; }
+        }
+        if (!inside)
+            return true;
+    }
+
+    return false;
+}
+
+bool PotentiallyVisibleSet::SegmentBlocked(XMFLOAT3 from, XMFLOAT3 to)
+{
+    XMFLOAT3 dir(to.x - from.x, to.y - from.y, to.z - from.z);
+    for (const Box& o : occluders)
+    {
+        if (SegmentEntry(from, dir, 0.0f, 1.0f, o.min, o.max) >= 0.0f)
+            return true;
+    }
+    return false;
+}
+
+bool PotentiallyVisibleSet::HasPortal(int cellA, int cellB)
+{
+    for (const Portal& p : portals)
+    {
+        if ((p.cellA == cellA && p.cellB == cellB) || (p.cellA == cellB && p.cellB == cellA))
+            return true;
+    }
+    return false;
+}
+
+// voxelizes the union of the cells so GetCell() is one table read
+void PotentiallyVisibleSet::BuildLookup()
+{
+    lookup.clear();
+    if (cells.empty())
+        return;
+
+    lookupBounds = cells[0];
+    for (const Box& c : cells)
+    {
+        lookupBounds.min = XMFLOAT3(std::min(lookupBounds.min.x, c.min.x), std::min(lookupBounds.min.y, c.min.y), std::min(lookupBounds.min.z, c.min.z));
+        lookupBounds.max = XMFLOAT3(std::max(lookupBounds.max.x, c.max.x), std::max(lookupBounds.max.y, c.max.y), std::max(lookupBounds.max.z, c.max.z));
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (lookupRes[axis] <= 0)
+            lookupRes[axis] = PVS_LOOKUP_RES;
+    }
+
+    XMFLOAT3 voxel(
+        (lookupBounds.max.x - lookupBounds.min.x) / lookupRes[0],
+        (lookupBounds.max.y - lookupBounds.min.y) / lookupRes[1],
+        (lookupBounds.max.z - lookupBounds.min.z) / lookupRes[2]);
+
+    lookup.resize((size_t)lookupRes[0] * lookupRes[1] * lookupRes[2], -1);
+    for (int z = 0; z < lookupRes[2]; z++)
+    {
+        for (int y = 0; y < lookupRes[1]; y++)
+        {
+            for (int x = 0; x < lookupRes[0]; x++)
+            {
+                XMFLOAT3 center(
+                    lookupBounds.min.x + voxel.x * (x + 0.5f),
+                    lookupBounds.min.y + voxel.y * (y + 0.5f),
+                    lookupBounds.min.z + voxel.z * (z + 0.5f));
+
+                for (size_t c = 0; c < cells.size(); c++)
+                {
+                    if (Contains(cells[c].min, cells[c].max, center))
+                    {
+                        lookup[((size_t)z * lookupRes[1] + y) * lookupRes[0] + x] = (int)c;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+uint64_t PotentiallyVisibleSet::ComputeSignature()
+{
+    uint64_t hash = 14695981039346656037ull;
+    uint32_t version = 1;
+    Hash(hash, &version, sizeof(version));
+    if (!cells.empty()) Hash(hash, cells.data(), cells.size() * sizeof(Box));
+    if (!portals.empty()) Hash(hash, portals.data(), portals.size() * sizeof(Portal));
+    if (!occluders.empty()) Hash(hash, occluders.data(), occluders.size() * sizeof(Box));
+    if (!entities.empty()) Hash(hash, entities.data(), entities.size() * sizeof(Box));
+    return hash;
+}
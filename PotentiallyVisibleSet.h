@@ -0,0 +1,93 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+// Precomputed cell based visibility for indoor scenes
+// - The scene is split into box shaped cells (authored, or a uniform grid)
+// - Portals connect neighbouring cells, either authored or derived by
+//   checking which shared faces are not completely covered by walls
+// - Build() casts sampled rays between cells and from cells to entities
+//   against the occluder boxes, storing the results as bitsets
+// - At runtime GetCell() is a single lookup into a voxel table, and the
+//   cell's entity bitset can be handed straight to the frustum culler
+// - Results can be saved and reloaded, keyed by a hash of the inputs,
+//   so the build only happens when the scene actually changes
+class PotentiallyVisibleSet
+{
+public:
+    PotentiallyVisibleSet();
+
+    // scene description (call before Build() / Load())
+    int AddCell(DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+    void GenerateGridCells(DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, int cellsX, int cellsY, int cellsZ);
+    void AddPortal(int cellA, int cellB, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+    void DerivePortals();
+    void AddOccluder(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents);
+    void AddEntity(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents);
+
+    // offline step - samplesPerTest rays are cast for each cell/cell
+    // and cell/entity pair before giving up and calling it hidden
+    void Build(int samplesPerTest = 64, uint32_t seed = 12345);
+
+    // persistence - Load() fails if the file was built from a different scene
+    bool Save(const char* fileName);
+    bool Load(const char* fileName);
+    bool IsBuilt();
+
+    // runtime queries
+    int GetCell(DirectX::XMFLOAT3 position);
+    bool IsCellVisible(int fromCell, int toCell);
+    bool IsEntityVisible(int fromCell, unsigned int entity);
+    const uint64_t* GetVisibleEntities(int fromCell);
+    unsigned int GetVisibleEntityCount(int fromCell);
+
+    // info
+    int GetCellCount();
+    unsigned int GetEntityCount();
+    int GetPortalCount();
+
+private:
+    struct Box
+    {
+        DirectX::XMFLOAT3 min;
+        DirectX::XMFLOAT3 max;
+    };
+
+    struct Portal
+    {
+        int cellA;
+        int cellB;
+        Box bounds;
+    };
+
+    // inputs
+    std::vector<Box> cells;
+    std::vector<Portal> portals;
+    std::vector<Box> occluders;
+    std::vector<Box> entities;
+
+    // voxel table used for O(1) cell lookups
+    Box lookupBounds;
+    int lookupRes[3];
+    std::vector<int> lookup;
+
+    // outputs, one row of words per cell
+    size_t cellWords;
+    size_t entityWords;
+    std::vector<uint64_t> cellVisibility;
+    std::vector<uint64_t> entityVisibility;
+    bool built;
+
+    // building helpers
+    uint32_t rngState;
+    float Random();
+    bool SamplePoint(const Box& box, DirectX::XMFLOAT3& point);
+    bool SegmentBlocked(DirectX::XMFLOAT3 from, DirectX::XMFLOAT3 to);
+    bool HasPortal(int cellA, int cellB);
+    void BuildLookup();
+    uint64_t ComputeSignature();
+
+    uint64_t signature;
+};
+
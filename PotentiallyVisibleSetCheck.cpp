@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <string>
+#include "Checks.h"
+#include "CheckReport.h"
+#include "PotentiallyVisibleSet.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Builds a scene of four cells, a wall with a doorway and a
+// solid one, with several seeds and compares the cell and
+// entity bitsets with the known answers:
+//   DX11Checks -pvscheck
+// --------------------------------------------------------
+int RunPvsCheck(int, char**)
+{
+    CheckReport report("pvscheck");
+
+    // four 4x4x4 cells in a row along x. the wall at x = 8 is a unit
+    // thick, with a doorway for z between 1.2 and 2.8 - wide enough that
+    // the face samples find a portal and rays through it are common. the
+    // wall at x = 12 is solid, so cell 3 sees nothing else
+    auto buildScene = [](PotentiallyVisibleSet& pvs)
+    {
+        pvs.GenerateGridCells(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(16.0f, 4.0f, 4.0f), 4, 1, 1);
+        pvs.AddOccluder(XMFLOAT3(8.0f, 2.0f, 0.1f), XMFLOAT3(0.5f, 3.0f, 1.1f));
+        pvs.AddOccluder(XMFLOAT3(8.0f, 2.0f, 3.9f), XMFLOAT3(0.5f, 3.0f, 1.1f));
+        pvs.AddOccluder(XMFLOAT3(12.0f, 2.0f, 2.0f), XMFLOAT3(0.1f, 2.0f, 2.0f));
+
+        // 0: in cell 0, 1: in cell 2 in line with the doorway, 2: in cell
+        // 3, 3: the solid wall itself, 4: in cell 2 tucked in behind the
+        // doorway's wall - no ray from cell 0 or 1 can get through the
+        // thick doorway at an angle steep enough to reach it
+        pvs.AddEntity(XMFLOAT3(1.5f, 1.5f, 1.5f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+        pvs.AddEntity(XMFLOAT3(10.5f, 2.0f, 2.0f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+        pvs.AddEntity(XMFLOAT3(14.0f, 2.0f, 2.0f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+        pvs.AddEntity(XMFLOAT3(12.0f, 2.0f, 2.0f), XMFLOAT3(0.1f, 2.0f, 2.0f));
+        pvs.AddEntity(XMFLOAT3(8.65f, 2.0f, 0.15f), XMFLOAT3(0.05f, 0.05f, 0.05f));
+        pvs.DerivePortals();
+    };
+
+    // bit n of a row is cell / entity n
+    const uint64_t expectedCells[4] = { 0x7, 0x7, 0x7, 0x8 };
+    const uint64_t expectedEntities[4] = { 0xB, 0xB, 0x1B, 0xC };
+    const XMFLOAT3 lookupPoints[] = { XMFLOAT3(2.0f, 2.0f, 2.0f), XMFLOAT3(6.0f, 1.0f, 3.0f), XMFLOAT3(9.0f, 3.0f, 1.0f), XMFLOAT3(15.0f, 0.5f, 0.5f), XMFLOAT3(20.0f, 2.0f, 2.0f) };
+    const int expectedLookups[] = { 0, 1, 2, 3, -1 };
+    const uint32_t seeds[] = { 12345, 1, 777, 0xDEADBEEF };
+
+    const int expectedPortals = 2;
+    auto formatRow = [](int cell, uint64_t cellRow, uint64_t entityRow)
+    {
+        char row[64];
+        snprintf(row, sizeof(row), " %d: %llx/%llx", cell, (unsigned long long)cellRow, (unsigned long long)entityRow);
+        return std::string(row);
+    };
+
+    // a cell's rows, read back through the runtime queries
+    auto readRows = [](PotentiallyVisibleSet& pvs, int cell, uint64_t& cellRow, uint64_t& entityRow)
+    {
+        cellRow = 0;
+        for (int c = 0; c < pvs.GetCellCount(); c++)
+            cellRow |= (uint64_t)pvs.IsCellVisible(cell, c) << c;
+        entityRow = 0;
+        for (unsigned int e = 0; e < pvs.GetEntityCount(); e++)
+            entityRow |= (uint64_t)pvs.IsEntityVisible(cell, e) << e;
+    };
+
+    std::string expectedRows;
+    for (int c = 0; c < 4; c++)
+        expectedRows += formatRow(c, expectedCells[c], expectedEntities[c]);
+    report.Print("expected: %d portals, cells/entities%s", expectedPortals, expectedRows.c_str());
+
+    for (uint32_t seed : seeds)
+    {
+        PotentiallyVisibleSet pvs;
+        buildScene(pvs);
+        pvs.Build(64, seed);
+
+        // the same seed has to give the same bits again
+        PotentiallyVisibleSet again;
+        buildScene(again);
+        again.Build(64, seed);
+
+        bool correct = pvs.GetPortalCount() == expectedPortals;
+        bool repeatable = true;
+        std::string rows;
+        for (int c = 0; c < 4; c++)
+        {
+            uint64_t cellRow, entityRow, againCellRow, againEntityRow;
+            readRows(pvs, c, cellRow, entityRow);
+            readRows(again, c, againCellRow, againEntityRow);
+            correct = correct && cellRow == expectedCells[c] && entityRow == expectedEntities[c];
+            repeatable = repeatable && cellRow == againCellRow && entityRow == againEntityRow;
+            rows += formatRow(c, cellRow, entityRow);
+        }
+        for (int i = 0; i < 5; i++)
+            correct = correct && pvs.GetCell(lookupPoints[i]) == expectedLookups[i];
+
+        report.Print("seed %u: %d portals, cells/entities%s", seed, pvs.GetPortalCount(), rows.c_str());
+        report.Expect(correct, "seed %u: wrong portals, bitsets or cell lookups", seed);
+        report.Expect(repeatable, "seed %u: a second build gave different bits", seed);
+    }
+
+    return report.Finish();
+}
@@ -0,0 +1,412 @@
+#include "RecordingRenderDevice.h"
+#include <cstring>
+
+// D3D11 slot counts, kept here so this file doesn't need the D3D headers
+#define RECORDING_CONSTANT_BUFFER_SLOTS 14
+#define RECORDING_SRV_SLOTS             128
+#define RECORDING_SAMPLER_SLOTS         16
+#define RECORDING_VERTEX_BUFFER_SLOTS   32
+#define RECORDING_RENDER_TARGET_SLOTS   8
+
+RecordingRenderDevice::RecordingRenderDevice(RenderDevice* forwardTo)
+{
+    this->forwardTo = forwardTo;
+    Reset();
+}
+
+void RecordingRenderDevice::Reset()
+{
+    commands.clear();
+    data.clear();
+    memset(commandCounts, 0, sizeof(commandCounts));
+    errorCount = 0;
+    errorMessages.clear();
+
+    vertexShaderBound = false;
+    indexBufferBound = false;
+    targetsBound = false;
+}
+
+const std::vector<RenderCommand>& RecordingRenderDevice::GetCommands() { return commands; }
+const std::vector<unsigned char>& RecordingRenderDevice::GetData() { return data; }
+unsigned int RecordingRenderDevice::GetErrorCount() { return errorCount; }
+const std::vector<std::string>& RecordingRenderDevice::GetErrorMessages() { return errorMessages; }
+
+unsigned int RecordingRenderDevice::GetCommandCount(int type)
+{
+    return type >= 0 && type < RENDER_CMD_COUNT ? commandCounts[type] : 0;
+}
+
+unsigned int RecordingRenderDevice::GetDrawCount()
+{
+    return commandCounts[RENDER_CMD_DRAW] +
+        commandCounts[RENDER_CMD_DRAW_INDEXED] +
+        commandCounts[RENDER_CMD_DRAW_INDEXED_INSTANCED] +
+        commandCounts[RENDER_CMD_DRAW_INDEXED_INSTANCED_INDIRECT];
+}
+
+void* RecordingRenderDevice::GetNativeContext()
+{
+    return forwardTo ? forwardTo->GetNativeContext() : 0;
+}
+
+RenderCommand& RecordingRenderDevice::Record(int type, const void* object, const void* bytes, unsigned int dataSize)
+{
+    RenderCommand command = {};
+    command.type = type;
+    command.object = object;
+    command.dataOffset = (unsigned int)data.size();
+    command.dataSize = bytes ? dataSize : 0;
+    if (bytes && dataSize > 0)
+        data.insert(data.end(), (const unsigned char*)bytes, (const unsigned char*)bytes + dataSize);
+
+    commandCounts[type]++;
+    commands.push_back(command);
+    return commands.back();
+}
+
+void RecordingRenderDevice::Error(const char* call, const char* message)
+{
+    errorCount++;
+    if (errorMessages.size() < RENDER_DEVICE_MAX_ERROR_MESSAGES)
+        errorMessages.push_back(std::string(call) + " (call " + std::to_string(commands.size()) + "): " + message);
+}
+
+bool RecordingRenderDevice::CheckStage(const char* call, int stage)
+{
+    if (stage >= 0 && stage < SHADER_STAGE_COUNT)
+        return true;
+    Error(call, "invalid shader stage");
+    return false;
+}
+
+bool RecordingRenderDevice::CheckSlot(const char* call, unsigned int slot, unsigned int slotCount)
+{
+    if (slot < slotCount)
+        return true;
+    Error(call, "slot out of range");
+    return false;
+}
+
+void RecordingRenderDevice::CheckDraw(const char* call, bool indexed)
+{
+    if (!vertexShaderBound)
+        Error(call, "no vertex shader bound");
+    if (indexed && !indexBufferBound)
+        Error(call, "no index buffer bound");
+    if (!targetsBound)
+        Error(call, "no render target or depth buffer bound");
+}
+
+// --------------------------------------------------------
+// Shader stages
+// --------------------------------------------------------
+void RecordingRenderDevice::SetShader(int stage, ID3D11DeviceChild* shader)
+{
+    CheckStage("SetShader", stage);
+    if (stage == SHADER_STAGE_VERTEX)
+        vertexShaderBound = shader != 0;
+
+    RenderCommand& command = Record(RENDER_CMD_SET_SHADER, shader);
+    command.args[0] = (unsigned int)stage;
+
+    if (forwardTo) forwardTo->SetShader(stage, shader);
+}
+
+void RecordingRenderDevice::SetConstantBuffer(int stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+    CheckStage("SetConstantBuffer", stage);
+    CheckSlot("SetConstantBuffer", slot, RECORDING_CONSTANT_BUFFER_SLOTS);
+
+    RenderCommand& command = Record(RENDER_CMD_SET_CONSTANT_BUFFER, buffer);
+    command.args[0] = (unsigned int)stage;
+    command.args[1] = slot;
+
+    if (forwardTo) forwardTo->SetConstantBuffer(stage, slot, buffer);
+}
+
+void RecordingRenderDevice::SetShaderResources(int stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs)
+{
+    CheckStage("SetShaderResources", stage);
+    if (count == 0 || !srvs)
+        Error("SetShaderResources", "no views given");
+    else
+        CheckSlot("SetShaderResources", startSlot + count - 1, RECORDING_SRV_SLOTS);
+
+    // the views themselves go in the data block
+    RenderCommand& command = Record(RENDER_CMD_SET_SHADER_RESOURCES, 0, srvs, srvs ? count * sizeof(void*) : 0);
+    command.args[0] = (unsigned int)stage;
+    command.args[1] = startSlot;
+    command.args[2] = count;
+
+    if (forwardTo) forwardTo->SetShaderResources(stage, startSlot, count, srvs);
+}
+
+void RecordingRenderDevice::SetSampler(int stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+    CheckStage("SetSampler", stage);
+    CheckSlot("SetSampler", slot, RECORDING_SAMPLER_SLOTS);
+
+    RenderCommand& command = Record(RENDER_CMD_SET_SAMPLER, sampler);
+    command.args[0] = (unsigned int)stage;
+    command.args[1] = slot;
+
+    if (forwardTo) forwardTo->SetSampler(stage, slot, sampler);
+}
+
+// --------------------------------------------------------
+// Buffer contents - the bytes are kept, so a capture has
+// every constant buffer value the frame used
+// --------------------------------------------------------
+void RecordingRenderDevice::UpdateBuffer(ID3D11Buffer* buffer, const void* bytes, unsigned int size)
+{
+    if (!buffer)
+        Error("UpdateBuffer", "null buffer");
+    if (!bytes || size == 0)
+        Error("UpdateBuffer", "no data");
+
+    RenderCommand& command = Record(RENDER_CMD_UPDATE_BUFFER, buffer, bytes, size);
+    command.args[0] = size;
+
+    if (forwardTo) forwardTo->UpdateBuffer(buffer, bytes, size);
+}
+
+void RecordingRenderDevice::UpdateBufferRange(ID3D11Buffer* buffer, const void* bytes, unsigned int offset, unsigned int size)
+{
+    if (!buffer)
+        Error("UpdateBufferRange", "null buffer");
+    if (!bytes || size == 0)
+        Error("UpdateBufferRange", "no data");
+
+    RenderCommand& command = Record(RENDER_CMD_UPDATE_BUFFER_RANGE, buffer, bytes, size);
+    command.args[0] = size;
+    command.args[1] = offset;
+
+    if (forwardTo) forwardTo->UpdateBufferRange(buffer, bytes, offset, size);
+}
+
+bool RecordingRenderDevice::WriteDynamicBuffer(ID3D11Buffer* buffer, const void* bytes, unsigned int size)
+{
+    if (!buffer)
+        Error("WriteDynamicBuffer", "null buffer");
+    if (!bytes || size == 0)
+        Error("WriteDynamicBuffer", "no data");
+
+    RenderCommand& command = Record(RENDER_CMD_WRITE_DYNAMIC_BUFFER, buffer, bytes, size);
+    command.args[0] = size;
+
+    if (forwardTo) return forwardTo->WriteDynamicBuffer(buffer, bytes, size);
+    return buffer != 0;
+}
+
+// --------------------------------------------------------
+// Constant ring - an allocation is recorded with its bytes
+// and where the ring put them, so binding the range later
+// can be matched back to the data
+// --------------------------------------------------------
+bool RecordingRenderDevice::AllocateConstants(const void* bytes, unsigned int size, ConstantAllocation& allocation)
+{
+    if (!forwardTo || !forwardTo->AllocateConstants(bytes, size, allocation))
+        return false;
+
+    RenderCommand& command = Record(RENDER_CMD_ALLOCATE_CONSTANTS, allocation.buffer, bytes, size);
+    command.args[0] = allocation.firstConstant;
+    command.args[1] = allocation.numConstants;
+    return true;
+}
+
+void RecordingRenderDevice::SetConstantBufferRange(int stage, unsigned int slot, const ConstantAllocation& allocation)
+{
+    CheckStage("SetConstantBufferRange", stage);
+    CheckSlot("SetConstantBufferRange", slot, RECORDING_CONSTANT_BUFFER_SLOTS);
+    if (allocation.firstConstant % 16 != 0 || allocation.numConstants % 16 != 0 || allocation.numConstants == 0)
+        Error("SetConstantBufferRange", "range not a multiple of 16 constants");
+
+    RenderCommand& command = Record(RENDER_CMD_SET_CONSTANT_BUFFER_RANGE, allocation.buffer);
+    command.args[0] = (unsigned int)stage;
+    command.args[1] = slot;
+    command.args[2] = allocation.firstConstant;
+    command.args[3] = allocation.numConstants;
+
+    if (forwardTo) forwardTo->SetConstantBufferRange(stage, slot, allocation);
+}
+
+unsigned int RecordingRenderDevice::GetConstantGeneration()
+{
+    return forwardTo ? forwardTo->GetConstantGeneration() : 0;
+}
+
+// --------------------------------------------------------
+// Input assembler
+// --------------------------------------------------------
+void RecordingRenderDevice::SetInputLayout(ID3D11InputLayout* layout)
+{
+    Record(RENDER_CMD_SET_INPUT_LAYOUT, layout);
+    if (forwardTo) forwardTo->SetInputLayout(layout);
+}
+
+void RecordingRenderDevice::SetPrimitiveTopology(unsigned int topology)
+{
+    RenderCommand& command = Record(RENDER_CMD_SET_TOPOLOGY, 0);
+    command.args[0] = topology;
+
+    if (forwardTo) forwardTo->SetPrimitiveTopology(topology);
+}
+
+void RecordingRenderDevice::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+    CheckSlot("SetVertexBuffer", slot, RECORDING_VERTEX_BUFFER_SLOTS);
+
+    RenderCommand& command = Record(RENDER_CMD_SET_VERTEX_BUFFER, buffer);
+    command.args[0] = slot;
+    command.args[1] = stride;
+    command.args[2] = offset;
+
+    if (forwardTo) forwardTo->SetVertexBuffer(slot, buffer, stride, offset);
+}
+
+void RecordingRenderDevice::SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset)
+{
+    indexBufferBound = buffer != 0;
+
+    RenderCommand& command = Record(RENDER_CMD_SET_INDEX_BUFFER, buffer);
+    command.args[0] = format;
+    command.args[1] = offset;
+
+    if (forwardTo) forwardTo->SetIndexBuffer(buffer, format, offset);
+}
+
+// --------------------------------------------------------
+// Fixed function states
+// --------------------------------------------------------
+void RecordingRenderDevice::SetRasterizerState(ID3D11RasterizerState* state)
+{
+    Record(RENDER_CMD_SET_RASTERIZER_STATE, state);
+    if (forwardTo) forwardTo->SetRasterizerState(state);
+}
+
+void RecordingRenderDevice::SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+    RenderCommand& command = Record(RENDER_CMD_SET_DEPTH_STENCIL_STATE, state);
+    command.args[0] = stencilRef;
+
+    if (forwardTo) forwardTo->SetDepthStencilState(state, stencilRef);
+}
+
+void RecordingRenderDevice::SetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask)
+{
+    RenderCommand& command = Record(RENDER_CMD_SET_BLEND_STATE, state, blendFactor, blendFactor ? 4 * sizeof(float) : 0);
+    command.args[0] = sampleMask;
+
+    if (forwardTo) forwardTo->SetBlendState(state, blendFactor, sampleMask);
+}
+
+// --------------------------------------------------------
+// Output merger
+// --------------------------------------------------------
+void RecordingRenderDevice::SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+    if (count > RECORDING_RENDER_TARGET_SLOTS)
+        Error("SetRenderTargets", "too many render targets");
+    if (count > 0 && !rtvs)
+        Error("SetRenderTargets", "no views given");
+
+    // a null first target with no depth buffer is an unbind
+    targetsBound = dsv != 0 || (count > 0 && rtvs && rtvs[0] != 0);
+
+    RenderCommand& command = Record(RENDER_CMD_SET_RENDER_TARGETS, dsv, rtvs, rtvs ? count * sizeof(void*) : 0);
+    command.args[0] = count;
+
+    if (forwardTo) forwardTo->SetRenderTargets(count, rtvs, dsv);
+}
+
+void RecordingRenderDevice::SetViewport(float x, float y, float width, float height, float minDepth, float maxDepth)
+{
+    if (width <= 0.0f || height <= 0.0f)
+        Error("SetViewport", "empty viewport");
+
+    float viewport[6] = { x, y, width, height, minDepth, maxDepth };
+    Record(RENDER_CMD_SET_VIEWPORT, 0, viewport, sizeof(viewport));
+
+    if (forwardTo) forwardTo->SetViewport(x, y, width, height, minDepth, maxDepth);
+}
+
+void RecordingRenderDevice::ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4])
+{
+    if (!rtv)
+        Error("ClearRenderTarget", "null view");
+
+    Record(RENDER_CMD_CLEAR_RENDER_TARGET, rtv, color, 4 * sizeof(float));
+
+    if (forwardTo) forwardTo->ClearRenderTarget(rtv, color);
+}
+
+void RecordingRenderDevice::ClearDepthStencil(ID3D11DepthStencilView* dsv, unsigned int flags, float depth, unsigned char stencil)
+{
+    if (!dsv)
+        Error("ClearDepthStencil", "null view");
+
+    RenderCommand& command = Record(RENDER_CMD_CLEAR_DEPTH_STENCIL, dsv, &depth, sizeof(float));
+    command.args[0] = flags;
+    command.args[1] = stencil;
+
+    if (forwardTo) forwardTo->ClearDepthStencil(dsv, flags, depth, stencil);
+}
+
+// --------------------------------------------------------
+// Draws
+// --------------------------------------------------------
+void RecordingRenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+    CheckDraw("Draw", false);
+
+    RenderCommand& command = Record(RENDER_CMD_DRAW, 0);
+    command.args[0] = vertexCount;
+    command.args[1] = startVertex;
+
+    if (forwardTo) forwardTo->Draw(vertexCount, startVertex);
+}
+
+void RecordingRenderDevice::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+    CheckDraw("DrawIndexed", true);
+
+    RenderCommand& command = Record(RENDER_CMD_DRAW_INDEXED, 0);
+    command.args[0] = indexCount;
+    command.args[1] = startIndex;
+    command.args[2] = (unsigned int)baseVertex;
+
+    if (forwardTo) forwardTo->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void RecordingRenderDevice::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+    CheckDraw("DrawIndexedInstanced", true);
+    if (instanceCount == 0)
+        Error("DrawIndexedInstanced", "no instances");
+
+    RenderCommand& command = Record(RENDER_CMD_DRAW_INDEXED_INSTANCED, 0);
+    command.args[0] = indexCount;
+    command.args[1] = instanceCount;
+    command.args[2] = startIndex;
+    command.args[3] = (unsigned int)baseVertex;
+    command.args[4] = startInstance;
+
+    if (forwardTo) forwardTo->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+// the arguments live in GPU memory, so only the buffer and offset are
+// recorded - a replay draws whatever the buffer holds by then
+void RecordingRenderDevice::DrawIndexedInstancedIndirect(ID3D11Buffer* args, unsigned int byteOffset)
+{
+    CheckDraw("DrawIndexedInstancedIndirect", true);
+    if (!args)
+        Error("DrawIndexedInstancedIndirect", "null argument buffer");
+    if (byteOffset % 4 != 0)
+        Error("DrawIndexedInstancedIndirect", "unaligned argument offset");
+
+    RenderCommand& command = Record(RENDER_CMD_DRAW_INDEXED_INSTANCED_INDIRECT, args);
+    command.args[0] = byteOffset;
+
+    if (forwardTo) forwardTo->DrawIndexedInstancedIndirect(args, byteOffset);
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "RenderDevice.h"
+
+// recorded call types
+#define RENDER_CMD_SET_SHADER               0
+#define RENDER_CMD_SET_CONSTANT_BUFFER      1
+#define RENDER_CMD_SET_SHADER_RESOURCES     2
+#define RENDER_CMD_SET_SAMPLER              3
+#define RENDER_CMD_UPDATE_BUFFER            4
+#define RENDER_CMD_WRITE_DYNAMIC_BUFFER     5
+#define RENDER_CMD_SET_INPUT_LAYOUT         6
+#define RENDER_CMD_SET_TOPOLOGY             7
+#define RENDER_CMD_SET_VERTEX_BUFFER        8
+#define RENDER_CMD_SET_INDEX_BUFFER         9
+#define RENDER_CMD_SET_RASTERIZER_STATE     10
+#define RENDER_CMD_SET_DEPTH_STENCIL_STATE  11
+#define RENDER_CMD_SET_BLEND_STATE          12
+#define RENDER_CMD_SET_RENDER_TARGETS       13
+#define RENDER_CMD_SET_VIEWPORT             14
+#define RENDER_CMD_CLEAR_RENDER_TARGET      15
+#define RENDER_CMD_CLEAR_DEPTH_STENCIL      16
+#define RENDER_CMD_DRAW                     17
+#define RENDER_CMD_DRAW_INDEXED             18
+#define RENDER_CMD_DRAW_INDEXED_INSTANCED   19
+#define RENDER_CMD_ALLOCATE_CONSTANTS       20
+#define RENDER_CMD_SET_CONSTANT_BUFFER_RANGE 21
+#define RENDER_CMD_DRAW_INDEXED_INSTANCED_INDIRECT 22
+#define RENDER_CMD_UPDATE_BUFFER_RANGE      23
+#define RENDER_CMD_COUNT                    24
+
+// only the first few validation messages are kept
+#define RENDER_DEVICE_MAX_ERROR_MESSAGES    32
+
+// One recorded call
+// - object is the main handle the call takes (shader, buffer, state, view)
+// - args hold the integer arguments in the order the call takes them
+// - anything variable length (buffer contents, handle lists, viewports,
+//   clear colors) is stored in the device's data block
+struct RenderCommand
+{
+    int type;
+    const void* object;
+    unsigned int args[5];
+    unsigned int dataOffset;
+    unsigned int dataSize;
+};
+
+// RenderDevice that records every call it gets and checks it against
+// the state it has seen so far
+// - With a device to forward to, calls are passed on after recording,
+//   so a real frame can be captured as it's drawn
+// - Without one it's a null backend - nothing is drawn, which lets the
+//   submission code (state cache, render queue batching) run headless
+// - Validation catches out of range stages and slots, draws without a
+//   vertex shader, index buffer or target, empty uploads and clears of
+//   null views; it doesn't know about resource formats or sizes
+class RecordingRenderDevice : public RenderDevice
+{
+public:
+    RecordingRenderDevice(RenderDevice* forwardTo = 0);
+
+    // drops the recorded calls, errors and tracked state
+    void Reset();
+
+    const std::vector<RenderCommand>& GetCommands();
+    const std::vector<unsigned char>& GetData();
+    unsigned int GetCommandCount(int type);
+    unsigned int GetDrawCount();
+    unsigned int GetErrorCount();
+    const std::vector<std::string>& GetErrorMessages();
+
+    void* GetNativeContext();
+
+    void SetShader(int stage, ID3D11DeviceChild* shader);
+    void SetConstantBuffer(int stage, unsigned int slot, ID3D11Buffer* buffer);
+    void SetShaderResources(int stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs);
+    void SetSampler(int stage, unsigned int slot, ID3D11SamplerState* sampler);
+
+    void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+    void UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int offset, unsigned int size);
+    bool WriteDynamicBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+
+    // the ring is the forwarded device's - the null backend has none
+    bool AllocateConstants(const void* data, unsigned int size, ConstantAllocation& allocation);
+    void SetConstantBufferRange(int stage, unsigned int slot, const ConstantAllocation& allocation);
+    unsigned int GetConstantGeneration();
+
+    void SetInputLayout(ID3D11InputLayout* layout);
+    void SetPrimitiveTopology(unsigned int topology);
+    void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+    void SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset);
+
+    void SetRasterizerState(ID3D11RasterizerState* state);
+    void SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+    void SetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask);
+
+    void SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv);
+    void SetViewport(float x, float y, float width, float height, float minDepth, float maxDepth);
+    void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]);
+    void ClearDepthStencil(ID3D11DepthStencilView* dsv, unsigned int flags, float depth, unsigned char stencil);
+
+    void Draw(unsigned int vertexCount, unsigned int startVertex);
+    void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+    void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+    void DrawIndexedInstancedIndirect(ID3D11Buffer* args, unsigned int byteOffset);
+
+private:
+    RenderCommand& Record(int type, const void* object, const void* data = 0, unsigned int dataSize = 0);
+    void Error(const char* call, const char* message);
+    bool CheckStage(const char* call, int stage);
+    bool CheckSlot(const char* call, unsigned int slot, unsigned int slotCount);
+    void CheckDraw(const char* call, bool indexed);
+
+    RenderDevice* forwardTo;
+
+    std::vector<RenderCommand> commands;
+    std::vector<unsigned char> data;
+    unsigned int commandCounts[RENDER_CMD_COUNT];
+    unsigned int errorCount;
+    std::vector<std::string> errorMessages;
+
+    // what validation needs to know about the current state
+    bool vertexShaderBound;
+    bool indexBufferBound;
+    bool targetsBound;
+};
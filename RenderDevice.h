@@ -0,0 +1,96 @@
+#pragma once
+
+// shader stages
+#define SHADER_STAGE_VERTEX     0
+#define SHADER_STAGE_PIXEL      1
+#define SHADER_STAGE_GEOMETRY   2
+#define SHADER_STAGE_HULL       3
+#define SHADER_STAGE_DOMAIN     4
+#define SHADER_STAGE_COMPUTE    5
+#define SHADER_STAGE_COUNT      6
+
+// Resources are only ever passed around as handles here, so the
+// interface (and any backend that doesn't touch D3D) builds without
+// the D3D11 headers - for the D3D11 backend they're the real objects
+struct ID3D11DeviceChild;
+struct ID3D11Buffer;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11InputLayout;
+struct ID3D11RasterizerState;
+struct ID3D11DepthStencilState;
+struct ID3D11BlendState;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+
+// A block of constants written to a backend's constant ring, bound as a
+// range of the ring's buffer. It stays valid until the backend's constant
+// generation changes, after which the constants have to be written again
+struct ConstantAllocation
+{
+    ID3D11Buffer* buffer;
+    unsigned int firstConstant;
+    unsigned int numConstants;
+    unsigned int generation;
+};
+
+// Everything the renderer submits during a frame, one level below
+// StateCache (which filters what reaches it)
+// - stage is one of the SHADER_STAGE_* values above
+// - topology, index format and clear flags use the D3D11 values,
+//   so the D3D11 backend can forward them as they are
+// - Creating resources is still done on the ID3D11Device directly
+class RenderDevice
+{
+public:
+    virtual ~RenderDevice() {}
+
+    // the backend's own context (an ID3D11DeviceContext), if it has one
+    virtual void* GetNativeContext() = 0;
+
+    // shader stages
+    virtual void SetShader(int stage, ID3D11DeviceChild* shader) = 0;
+    virtual void SetConstantBuffer(int stage, unsigned int slot, ID3D11Buffer* buffer) = 0;
+    virtual void SetShaderResources(int stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs) = 0;
+    virtual void SetSampler(int stage, unsigned int slot, ID3D11SamplerState* sampler) = 0;
+
+    // buffer contents - UpdateBuffer replaces a default usage buffer,
+    // UpdateBufferRange part of one (constant buffers only with D3D11.1
+    // partial updates, in whole constants), WriteDynamicBuffer maps a
+    // dynamic one with DISCARD
+    virtual void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) = 0;
+    virtual void UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int offset, unsigned int size) = 0;
+    virtual bool WriteDynamicBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) = 0;
+
+    // constant ring - AllocateConstants returns false when the backend has
+    // none, and constants go to each shader's own buffer with UpdateBuffer
+    virtual bool AllocateConstants(const void* data, unsigned int size, ConstantAllocation& allocation) = 0;
+    virtual void SetConstantBufferRange(int stage, unsigned int slot, const ConstantAllocation& allocation) = 0;
+    virtual unsigned int GetConstantGeneration() = 0;
+
+    // input assembler
+    virtual void SetInputLayout(ID3D11InputLayout* layout) = 0;
+    virtual void SetPrimitiveTopology(unsigned int topology) = 0;
+    virtual void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset) = 0;
+    virtual void SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset) = 0;
+
+    // fixed function states
+    virtual void SetRasterizerState(ID3D11RasterizerState* state) = 0;
+    virtual void SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef) = 0;
+    virtual void SetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask) = 0;
+
+    // output merger
+    virtual void SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) = 0;
+    virtual void SetViewport(float x, float y, float width, float height, float minDepth, float maxDepth) = 0;
+    virtual void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) = 0;
+    virtual void ClearDepthStencil(ID3D11DepthStencilView* dsv, unsigned int flags, float depth, unsigned char stencil) = 0;
+
+    // draws
+    virtual void Draw(unsigned int vertexCount, unsigned int startVertex) = 0;
+    virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+    virtual void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) = 0;
+
+    // the draw's arguments (index count, instance count, start index, base
+    // vertex, start instance) are read from the buffer at byteOffset
+    virtual void DrawIndexedInstancedIndirect(ID3D11Buffer* args, unsigned int byteOffset) = 0;
+};
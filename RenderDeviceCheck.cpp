@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+#include "Checks.h"
+#include "CheckReport.h"
+#include "FrameTrace.h"
+#include "RecordingRenderDevice.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "TraceReplay.h"
+
+// the D3D11 values the checks bind, without the D3D11 headers
+#define CHECK_TOPOLOGY_TRIANGLELIST 4
+#define CHECK_FORMAT_R32_UINT       42
+
+namespace
+{
+    // the null device never looks behind a handle, so any distinct
+    // non null address will do - the Nth byte of a placeholder block
+    unsigned char placeholders[4096];
+
+    template<typename T> T* Placeholder(unsigned int id)
+    {
+        return reinterpret_cast<T*>(placeholders + id);
+    }
+}
+
+// --------------------------------------------------------
+// Drives a state cache into the null device with binds it
+// must filter, ones it must let through, and a frame the
+// device must reject:
+//   DX11Checks -statecache
+// --------------------------------------------------------
+int RunStateCacheCheck(int, char**)
+{
+    CheckReport report("statecache");
+    RecordingRenderDevice nullDevice;
+    StateCache cache(&nullDevice);
+
+    ID3D11DeviceChild* vs = Placeholder<ID3D11DeviceChild>(1);
+    ID3D11DeviceChild* ps = Placeholder<ID3D11DeviceChild>(2);
+    ID3D11Buffer* constants = Placeholder<ID3D11Buffer>(3);
+    ID3D11Buffer* vertices = Placeholder<ID3D11Buffer>(4);
+    ID3D11Buffer* indices = Placeholder<ID3D11Buffer>(5);
+    ID3D11RenderTargetView* rtv = Placeholder<ID3D11RenderTargetView>(6);
+    ID3D11DepthStencilView* dsv = Placeholder<ID3D11DepthStencilView>(7);
+    ID3D11BlendState* blend = Placeholder<ID3D11BlendState>(8);
+    ID3D11ShaderResourceView* views[3] =
+    {
+        Placeholder<ID3D11ShaderResourceView>(9),
+        Placeholder<ID3D11ShaderResourceView>(10),
+        Placeholder<ID3D11ShaderResourceView>(11),
+    };
+
+    // the same shader twice
+    cache.SetShader(SHADER_STAGE_VERTEX, vs);
+    cache.SetShader(SHADER_STAGE_VERTEX, vs);
+    report.Expect(cache.GetIssuedCount(STATE_CALL_SHADER) == 1 && cache.GetFilteredCount(STATE_CALL_SHADER) == 1,
+        "a repeated shader bind wasn't filtered");
+
+    // a constant buffer as a whole, then a range of it - each
+    // repeat is dropped, the change from whole to range isn't
+    ConstantAllocation allocation = { constants, 16, 16, 0 };
+    cache.SetConstantBuffer(SHADER_STAGE_PIXEL, 0, constants);
+    cache.SetConstantBuffer(SHADER_STAGE_PIXEL, 0, constants);
+    cache.SetConstantBufferRange(SHADER_STAGE_PIXEL, 0, allocation);
+    cache.SetConstantBufferRange(SHADER_STAGE_PIXEL, 0, allocation);
+    report.Expect(cache.GetIssuedCount(STATE_CALL_CONSTANT_BUFFER) == 2 && cache.GetFilteredCount(STATE_CALL_CONSTANT_BUFFER) == 2,
+        "constant buffer binds: %u issued, %u filtered, expected 2 and 2",
+        cache.GetIssuedCount(STATE_CALL_CONSTANT_BUFFER), cache.GetFilteredCount(STATE_CALL_CONSTANT_BUFFER));
+
+    // three views, then the same three with the middle one changed -
+    // only that slot should reach the device
+    cache.SetShaderResources(SHADER_STAGE_PIXEL, 0, 3, views);
+    ID3D11ShaderResourceView* changed[3] = { views[0], views[2], views[2] };
+    cache.SetShaderResources(SHADER_STAGE_PIXEL, 0, 3, changed);
+    const RenderCommand& last = nullDevice.GetCommands().back();
+    report.Expect(last.type == RENDER_CMD_SET_SHADER_RESOURCES && last.args[1] == 1 && last.args[2] == 1,
+        "changing one of three views didn't bind just that slot");
+
+    // binding targets forgets the views, so the same ones go through again
+    cache.SetRenderTargets(1, &rtv, dsv);
+    unsigned int viewBinds = nullDevice.GetCommandCount(RENDER_CMD_SET_SHADER_RESOURCES);
+    cache.SetShaderResources(SHADER_STAGE_PIXEL, 0, 3, changed);
+    report.Expect(nullDevice.GetCommandCount(RENDER_CMD_SET_SHADER_RESOURCES) == viewBinds + 1,
+        "views bound before SetRenderTargets were still filtered");
+
+    // a null blend factor is all ones
+    const float ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    cache.SetBlendState(blend, 0, 0xffffffff);
+    cache.SetBlendState(blend, ones, 0xffffffff);
+    report.Expect(nullDevice.GetCommandCount(RENDER_CMD_SET_BLEND_STATE) == 1,
+        "a null blend factor and an explicit one of all ones didn't match");
+
+    // after Invalidate() everything goes through once more
+    cache.Invalidate();
+    cache.SetShader(SHADER_STAGE_VERTEX, vs);
+    report.Expect(nullDevice.GetCommandCount(RENDER_CMD_SET_SHADER) == 2,
+        "a bind after Invalidate() was filtered");
+
+    // so far everything was valid; a draw with no index buffer isn't
+    report.Expect(nullDevice.GetErrorCount() == 0, "%u validation errors before the bad draw", nullDevice.GetErrorCount());
+    cache.GetDevice()->DrawIndexed(36, 0, 0);
+    report.Expect(nullDevice.GetErrorCount() == 1, "an indexed draw without an index buffer wasn't caught");
+
+    // and a complete one is fine
+    nullDevice.Reset();
+    cache.Invalidate();
+    cache.SetRenderTargets(1, &rtv, dsv);
+    cache.SetShader(SHADER_STAGE_VERTEX, vs);
+    cache.SetShader(SHADER_STAGE_PIXEL, ps);
+    cache.SetPrimitiveTopology(CHECK_TOPOLOGY_TRIANGLELIST);
+    cache.SetVertexBuffer(0, vertices, 32, 0);
+    cache.SetIndexBuffer(indices, CHECK_FORMAT_R32_UINT, 0);
+    cache.GetDevice()->DrawIndexed(36, 0, 0);
+    report.Expect(nullDevice.GetErrorCount() == 0 && nullDevice.GetDrawCount() == 1,
+        "a complete draw: %u validation errors, %u draws", nullDevice.GetErrorCount(), nullDevice.GetDrawCount());
+
+    for (const std::string& message : nullDevice.GetErrorMessages())
+        report.Print("  %s", message.c_str());
+    return report.Finish();
+}
+
+// --------------------------------------------------------
+// Times sorting a frame's render queue and submitting it,
+// binds filtered by a state cache, to the null device:
+//   DX11Checks -submitbench [-items N] [-frames N]
+// Every frame has to validate, and draw one instanced batch
+// per shader, material and mesh combination in it
+// --------------------------------------------------------
+int RunSubmitBenchmark(int argc, char** argv)
+{
+    const unsigned int shaderCount = 4;
+    const unsigned int materialCount = 64;
+    const unsigned int meshCount = 32;
+    unsigned int itemCount = (unsigned int)std::max(1, CheckReport::GetIntOption(argc, argv, "-items", 10000));
+    unsigned int frames = (unsigned int)std::max(1, CheckReport::GetIntOption(argc, argv, "-frames", 100));
+
+    CheckReport report("submitbench");
+    RecordingRenderDevice nullDevice;
+    StateCache cache(&nullDevice);
+    RenderQueue queue;
+
+    // the same scene every run
+    std::mt19937 random(34);
+    std::vector<uint64_t> keys(itemCount);
+    std::set<uint64_t> combinations;
+    for (unsigned int i = 0; i < itemCount; i++)
+    {
+        unsigned int shader = random() % shaderCount;
+        unsigned int material = random() % materialCount;
+        unsigned int mesh = random() % meshCount;
+        keys[i] = RenderQueue::MakeKey(RENDER_PASS_OPAQUE, shader, material, mesh, (random() % 1000) / 1000.0f);
+        combinations.insert(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, shader, material, mesh, 0.0f));
+    }
+
+    ID3D11RenderTargetView* rtv = Placeholder<ID3D11RenderTargetView>(1);
+    ID3D11DepthStencilView* dsv = Placeholder<ID3D11DepthStencilView>(2);
+    ID3D11SamplerState* sampler = Placeholder<ID3D11SamplerState>(3);
+    unsigned int errors = 0;
+    unsigned int wrongFrames = 0;
+    float sortMs = 0.0f;
+    float submitMs = 0.0f;
+
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        queue.Clear();
+        for (unsigned int i = 0; i < itemCount; i++)
+            queue.Add(keys[i], i);
+        queue.Sort();
+        auto sorted = std::chrono::high_resolution_clock::now();
+
+        // a new frame starts from nothing bound, as far as either knows
+        nullDevice.Reset();
+        cache.Invalidate();
+        cache.SetRenderTargets(1, &rtv, dsv);
+        cache.SetPrimitiveTopology(CHECK_TOPOLOGY_TRIANGLELIST);
+
+        const std::vector<RenderItem>& items = queue.GetItems();
+        size_t end = queue.GetPassEnd(RENDER_PASS_OPAQUE);
+        unsigned int instances = 0;
+        for (size_t q = queue.GetPassBegin(RENDER_PASS_OPAQUE); q < end;)
+        {
+            uint64_t key = items[q].key;
+            unsigned int shader = RenderQueue::GetShader(key);
+            unsigned int material = RenderQueue::GetMaterial(key);
+            unsigned int mesh = RenderQueue::GetMesh(key);
+
+            // shaders, materials and meshes get placeholder blocks of their own
+            cache.SetShader(SHADER_STAGE_VERTEX, Placeholder<ID3D11DeviceChild>(16 + shader));
+            cache.SetShader(SHADER_STAGE_PIXEL, Placeholder<ID3D11DeviceChild>(32 + shader));
+            cache.SetShaderResource(SHADER_STAGE_PIXEL, 0, Placeholder<ID3D11ShaderResourceView>(64 + material));
+            cache.SetSampler(SHADER_STAGE_PIXEL, 0, sampler);
+            cache.SetVertexBuffer(0, Placeholder<ID3D11Buffer>(256 + mesh), 32, 0);
+            cache.SetIndexBuffer(Placeholder<ID3D11Buffer>(512 + mesh), CHECK_FORMAT_R32_UINT, 0);
+
+            size_t batchEnd = queue.GetBatchEnd(q, end);
+            cache.GetDevice()->DrawIndexedInstanced(36, (unsigned int)(batchEnd - q), 0, 0, (unsigned int)q);
+            instances += (unsigned int)(batchEnd - q);
+            q = batchEnd;
+        }
+        auto submitted = std::chrono::high_resolution_clock::now();
+
+        sortMs += std::chrono::duration<float, std::milli>(sorted - start).count();
+        submitMs += std::chrono::duration<float, std::milli>(submitted - sorted).count();
+        errors += nullDevice.GetErrorCount();
+        if (nullDevice.GetDrawCount() != combinations.size() || instances != itemCount)
+            wrongFrames++;
+    }
+
+    report.Print("%u items, %u state combinations: sort %.3f ms, submit %.3f ms per frame, %u of %u binds filtered",
+        itemCount, (unsigned int)combinations.size(), sortMs / frames, submitMs / frames,
+        cache.GetTotalFilteredCount(), cache.GetTotalFilteredCount() + cache.GetTotalIssuedCount());
+    report.Expect(errors == 0, "%u validation errors", errors);
+    report.Expect(wrongFrames == 0, "%u of %u frames didn't draw one batch per combination", wrongFrames, frames);
+    for (const std::string& message : nullDevice.GetErrorMessages())
+        report.Print("  %s", message.c_str());
+    return report.Finish();
+}
+
+// --------------------------------------------------------
+// Replays a frame trace (F8 in game) on the null device:
+//   DX11Checks -tracereplay frame.trace [-loops N]
+// The first pass validates every frame, then all of them
+// are replayed N times at full speed
+// --------------------------------------------------------
+int RunTraceReplay(int argc, char** argv)
+{
+    const char* path = CheckReport::GetStringOption(argc, argv, "-tracereplay", 0);
+    int loops = std::max(1, CheckReport::GetIntOption(argc, argv, "-loops", 100));
+
+    CheckReport report("tracereplay");
+    FrameTrace trace;
+    if (!report.Expect(path && trace.Load(path) && trace.GetFrameCount() > 0, "couldn't load trace %s", path ? path : "(none)"))
+        return report.Finish();
+
+    TraceReplay replay(&trace);
+    replay.UsePlaceholderObjects();
+    RecordingRenderDevice nullDevice;
+
+    unsigned int errors = 0;
+    for (unsigned int f = 0; f < trace.GetFrameCount(); f++)
+    {
+        nullDevice.Reset();
+        replay.ReplayFrame(f, &nullDevice);
+        errors += nullDevice.GetErrorCount();
+        for (const std::string& message : nullDevice.GetErrorMessages())
+            report.Print("  frame %u: %s", f, message.c_str());
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int loop = 0; loop < loops; loop++)
+    {
+        for (unsigned int f = 0; f < trace.GetFrameCount(); f++)
+        {
+            nullDevice.Reset();
+            replay.ReplayFrame(f, &nullDevice);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    unsigned int frames = loops * trace.GetFrameCount();
+    float totalMs = std::chrono::duration<float, std::milli>(end - start).count();
+    report.Print("Replayed %u frames of %s on the null device: %.3f ms total, %.4f ms per frame",
+        frames, path, totalMs, totalMs / frames);
+    report.Expect(errors == 0, "%u validation errors", errors);
+    return report.Finish();
+}
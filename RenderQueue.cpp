@@ -0,0 +1,149 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// bit positions of each key field
+#define KEY_PASS_SHIFT      60
+#define KEY_SHADER_SHIFT    52
+#define KEY_MATERIAL_SHIFT  40
+#define KEY_MESH_SHIFT      28
+#define KEY_DEPTH_SHIFT     4
+
+#define KEY_PASS_MASK       0xFull
+#define KEY_SHADER_MASK     0xFFull
+#define KEY_MATERIAL_MASK   0xFFFull
+#define KEY_MESH_MASK       0xFFFull
+#define KEY_DEPTH_MASK      0xFFFFFFull
+
+RenderQueue::RenderQueue()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint64_t RenderQueue::MakeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth01)
+{
+    depth01 = std::min(1.0f, std::max(0.0f, depth01));
+    uint64_t depth = (uint64_t)(depth01 * (float)KEY_DEPTH_MASK);
+
+    return ((pass & KEY_PASS_MASK) << KEY_PASS_SHIFT) |
+        ((shader & KEY_SHADER_MASK) << KEY_SHADER_SHIFT) |
+        ((material & KEY_MATERIAL_MASK) << KEY_MATERIAL_SHIFT) |
+        ((mesh & KEY_MESH_MASK) << KEY_MESH_SHIFT) |
+        ((depth & KEY_DEPTH_MASK) << KEY_DEPTH_SHIFT);
+}
+
+unsigned int RenderQueue::GetPass(uint64_t key) { return (unsigned int)((key >> KEY_PASS_SHIFT) & KEY_PASS_MASK); }
+unsigned int RenderQueue::GetShader(uint64_t key) { return (unsigned int)((key >> KEY_SHADER_SHIFT) & KEY_SHADER_MASK); }
+unsigned int RenderQueue::GetMaterial(uint64_t key) { return (unsigned int)((key >> KEY_MATERIAL_SHIFT) & KEY_MATERIAL_MASK); }
+unsigned int RenderQueue::GetMesh(uint64_t key) { return (unsigned int)((key >> KEY_MESH_SHIFT) & KEY_MESH_MASK); }
+
+void RenderQueue::Clear()
+{
+    items.clear();
+
+    float sortTime = stats.sortTime;
+    memset(&stats, 0, sizeof(stats));
+    stats.sortTime = sortTime;
+}
+
+void RenderQueue::Add(uint64_t key, unsigned int entity)
+{
+    RenderItem item = { key, entity };
+    items.push_back(item);
+}
+
+// LSD radix sort, 8 bits per pass
+// - all 8 histograms are built in a single read of the keys
+// - a pass where every key has the same digit would just copy the
+//   list, so it's skipped (most of the key is constant in a small scene)
+void RenderQueue::Sort()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    size_t count = items.size();
+    scratch.resize(count);
+
+    unsigned int histograms[8][256] = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t key = items[i].key;
+        for (int digit = 0; digit < 8; digit++)
+        {
+            histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+        }
+    }
+
+    RenderItem* src = items.data();
+    RenderItem* dst = scratch.data();
+    for (int digit = 0; digit < 8 && count > 1; digit++)
+    {
+        unsigned int* histogram = histograms[digit];
+        if (histogram[(src[0].key >> (digit * 8)) & 0xFF] == count)
+            continue;
+
+        // exclusive prefix sum gives each bucket's starting offset
+        unsigned int offsets[256];
+        unsigned int sum = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            offsets[b] = sum;
+            sum += histogram[b];
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            unsigned int bucket = (unsigned int)((src[i].key >> (digit * 8)) & 0xFF);
+            dst[offsets[bucket]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
+
+    // an odd number of passes leaves the result in the scratch list
+    if (src != items.data())
+        items.swap(scratch);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.sortTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+const std::vector<RenderItem>& RenderQueue::GetItems() { return items; }
+
+size_t RenderQueue::GetPassBegin(unsigned int pass)
+{
+    uint64_t first = (uint64_t)(pass & KEY_PASS_MASK) << KEY_PASS_SHIFT;
+    return std::lower_bound(items.begin(), items.end(), first,
+        [](const RenderItem& item, uint64_t key) { return item.key < key; }) - items.begin();
+}
+
+size_t RenderQueue::GetPassEnd(unsigned int pass)
+{
+    if (pass >= KEY_PASS_MASK)
+        return items.size();
+    return GetPassBegin(pass + 1);
+}
+
+size_t RenderQueue::GetBatchEnd(size_t begin, size_t end)
+{
+    // everything above the depth is draw state
+    uint64_t state = items[begin].key >> KEY_MESH_SHIFT;
+    size_t i = begin + 1;
+    while (i < end && (items[i].key >> KEY_MESH_SHIFT) == state)
+        i++;
+    return i;
+}
+
+RenderQueueStats& RenderQueue::GetStats() { return stats; }
+
+void RenderQueue::MergeStats(const RenderQueueStats& other)
+{
+    stats.draws += other.draws;
+    stats.instances += other.instances;
+    stats.shaderBinds += other.shaderBinds;
+    stats.materialBinds += other.materialBinds;
+    stats.meshBinds += other.meshBinds;
+    stats.shaderSkips += other.shaderSkips;
+    stats.materialSkips += other.materialSkips;
+    stats.meshSkips += other.meshSkips;
+}
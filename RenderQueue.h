@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// render passes, in the order they are submitted
+#define RENDER_PASS_SHADOW      0
+#define RENDER_PASS_OPAQUE      1
+
+// One draw waiting to be submitted
+struct RenderItem
+{
+    uint64_t key;
+    unsigned int entity;
+};
+
+// per frame counters - a "skip" is a bind that the sorted
+// order made unnecessary, compared to binding for every queued item
+// - draws are instanced, one per run of items sharing all draw state
+struct RenderQueueStats
+{
+    unsigned int draws;
+    unsigned int instances;
+    unsigned int shaderBinds;
+    unsigned int materialBinds;
+    unsigned int meshBinds;
+    unsigned int shaderSkips;
+    unsigned int materialSkips;
+    unsigned int meshSkips;
+    float sortTime;
+};
+
+// Collects the frame's draws as 64 bit sort keys, then radix sorts them
+// so draws sharing state end up next to each other
+// - Key layout, most significant first:
+//     pass (4) | shader (8) | material (12) | mesh (12) | depth (24) | unused (4)
+// - Depth is quantized view depth, so within a state group the draws
+//   go front to back and early depth rejection does more work
+class RenderQueue
+{
+public:
+    RenderQueue();
+
+    static uint64_t MakeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth01);
+    static unsigned int GetPass(uint64_t key);
+    static unsigned int GetShader(uint64_t key);
+    static unsigned int GetMaterial(uint64_t key);
+    static unsigned int GetMesh(uint64_t key);
+
+    void Clear();
+    void Add(uint64_t key, unsigned int entity);
+    void Sort();
+
+    // items are only in order after Sort()
+    const std::vector<RenderItem>& GetItems();
+
+    // first index of the pass, and one past its last
+    size_t GetPassBegin(unsigned int pass);
+    size_t GetPassEnd(unsigned int pass);
+
+    // one past the last item (before end) that can be drawn instanced with
+    // items[begin] - the run sharing its pass, shader, material and mesh
+    size_t GetBatchEnd(size_t begin, size_t end);
+
+    // the submitting code fills in the bind counters, either directly
+    // or by merging in counters kept per thread
+    RenderQueueStats& GetStats();
+    void MergeStats(const RenderQueueStats& other);
+
+private:
+    std::vector<RenderItem> items;
+    std::vector<RenderItem> scratch;
+    RenderQueueStats stats;
+};
@@ -3,6 +3,13 @@
  
 #include "PBRIncludes.hlsli"
 
+// Constant buffer slots, by how often their contents change
+// - b0 FrameData    - once a frame (lights, shadow matrices)
+// - b1 PassData     - once per pass (camera or light view)
+// - b2 MaterialData - owned by the material, bound with its textures
+// - per object data (world, normal matrix, tint) is in the instance
+//   stream, so there's no per draw constant buffer at all
+
 // Struct representing a single vertex worth of data
 // - This should match the vertex definition in our C++ code
 // - By "match", I mean the size, order and number of members
@@ -21,6 +28,27 @@ struct VertexShaderInput
 	float3 tangent		: TANGENT;		// XYZ vector
 };
 
+// Vertex data plus the per instance data of an instanced draw
+// - Anything ending in _PER_INSTANCE is read from input slot 1 once per
+//   instance (see SimpleVertexShader's input layout creation)
+// - The instance part must match InstanceData in BufferStructs.h
+struct InstancedVertexShaderInput
+{
+	float3 position		: POSITION;
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float3 tangent		: TANGENT;
+	float4 world0		: WORLD_PER_INSTANCE0;	// world matrix rows
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
+	float4 normal0		: NORMALMATRIX_PER_INSTANCE0;	// inverse transpose world rows
+	float4 normal1		: NORMALMATRIX_PER_INSTANCE1;
+	float4 normal2		: NORMALMATRIX_PER_INSTANCE2;
+	float4 colorTint	: TINT_PER_INSTANCE;
+	float4 material		: MATERIAL_PER_INSTANCE;	// texture array slice, specular intensity, light list offset, count
+};
+
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
@@ -79,5 +107,6 @@ struct VertexToPixelNormalShadowMap
 	float3 worldPos		: POSITION;
 	float3 tangent		: TANGENT;
 	float4 posForShadows: SHADOWS;
+	nointerpolation float4 material : MATERIAL;	// texture array slice, specular intensity, light list offset, count
 };
 #endif
\ No newline at end of file
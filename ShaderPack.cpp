@@ -0,0 +1,392 @@
+#include "ShaderPack.h"
+#include "SimpleShader.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+ShaderPack::ShaderPack()
+{
+    file = INVALID_HANDLE_VALUE;
+    mapping = 0;
+    view = 0;
+    size = 0;
+    header = 0;
+}
+
+ShaderPack::~ShaderPack()
+{
+    Close();
+}
+
+// --------------------------------------------------------
+// Maps a pack read only - the OS pages in what's used, so
+// opening it doesn't read the bytecode yet
+// --------------------------------------------------------
+bool ShaderPack::Open(const std::wstring& path)
+{
+    Close();
+
+    file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(ShaderPackHeader) || fileSize.QuadPart > UINT_MAX)
+    {
+        Close();
+        return false;
+    }
+    size = (unsigned int)fileSize.QuadPart;
+
+    mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (mapping)
+        view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        Close();
+        return false;
+    }
+
+    header = (const ShaderPackHeader*)view;
+    if (!Validate())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void ShaderPack::Close()
+{
+    if (view) UnmapViewOfFile(view);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+    mapping = 0;
+    view = 0;
+    size = 0;
+    header = 0;
+}
+
+bool ShaderPack::IsOpen() const { return header != 0; }
+
+bool ShaderPack::InFile(unsigned int offset, unsigned int count, unsigned int stride) const
+{
+    return offset % 4 == 0 && (uint64_t)offset + (uint64_t)count * stride <= size;
+}
+
+// --------------------------------------------------------
+// Checks every table, and every range a record points at,
+// is inside the file - a stale or truncated pack is rejected
+// here rather than read past the end of the mapping
+// --------------------------------------------------------
+bool ShaderPack::Validate() const
+{
+    if (header->magic != SHADER_PACK_MAGIC || header->version != SHADER_PACK_VERSION)
+        return false;
+
+    if (!InFile(header->shadersOffset, header->shaderCount, sizeof(ShaderPackShader)) ||
+        !InFile(header->buffersOffset, header->bufferCount, sizeof(ShaderPackBuffer)) ||
+        !InFile(header->variablesOffset, header->variableCount, sizeof(ShaderPackVariable)) ||
+        !InFile(header->resourcesOffset, header->resourceCount, sizeof(ShaderPackResource)) ||
+        !InFile(header->inputElementsOffset, header->inputElementCount, sizeof(ShaderPackInputElement)))
+        return false;
+
+    // names are read straight from the table, so it has to end in a terminator
+    if (header->stringsSize == 0 || (uint64_t)header->stringsOffset + header->stringsSize > size ||
+        view[header->stringsOffset + header->stringsSize - 1] != 0)
+        return false;
+
+    for (unsigned int i = 0; i < header->shaderCount; i++)
+    {
+        const ShaderPackShader& shader = GetShader(i);
+        if ((uint64_t)shader.bytecodeOffset + shader.bytecodeSize > size ||
+            (uint64_t)shader.firstBuffer + shader.bufferCount > header->bufferCount ||
+            (uint64_t)shader.firstResource + shader.resourceCount > header->resourceCount ||
+            (uint64_t)shader.firstInputElement + shader.inputElementCount > header->inputElementCount)
+            return false;
+    }
+
+    const ShaderPackBuffer* buffers = GetBuffers();
+    for (unsigned int i = 0; i < header->bufferCount; i++)
+    {
+        if ((uint64_t)buffers[i].firstVariable + buffers[i].variableCount > header->variableCount)
+            return false;
+    }
+    return true;
+}
+
+int ShaderPack::FindShader(const char* name) const
+{
+    for (unsigned int i = 0; header && i < header->shaderCount; i++)
+    {
+        if (strcmp(GetString(GetShader(i).name), name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+unsigned int ShaderPack::GetShaderCount() const { return header ? header->shaderCount : 0; }
+
+const ShaderPackShader& ShaderPack::GetShader(unsigned int index) const
+{
+    return ((const ShaderPackShader*)(view + header->shadersOffset))[index];
+}
+
+const void* ShaderPack::GetBytecode(const ShaderPackShader& shader) const
+{
+    return view + shader.bytecodeOffset;
+}
+
+const ShaderPackBuffer* ShaderPack::GetBuffers() const { return (const ShaderPackBuffer*)(view + header->buffersOffset); }
+const ShaderPackVariable* ShaderPack::GetVariables() const { return (const ShaderPackVariable*)(view + header->variablesOffset); }
+const ShaderPackResource* ShaderPack::GetResources() const { return (const ShaderPackResource*)(view + header->resourcesOffset); }
+const ShaderPackInputElement* ShaderPack::GetInputElements() const { return (const ShaderPackInputElement*)(view + header->inputElementsOffset); }
+
+const char* ShaderPack::GetString(unsigned int offset) const
+{
+    return offset < header->stringsSize ? (const char*)view + header->stringsOffset + offset : "";
+}
+
+// --------------------------------------------------------
+// Collects shaders' bytecode and reflection into the pack's
+// tables, then lays them out as a file
+// --------------------------------------------------------
+class ShaderPackBuilder
+{
+public:
+    bool AddShader(const std::string& name, const void* bytecode, size_t size);
+    std::vector<unsigned char> Write();
+
+    unsigned int GetShaderCount() { return (unsigned int)shaders.size(); }
+    const std::string& GetErrors() { return errors; }
+
+private:
+    unsigned int AddString(const char* text);
+
+    std::vector<ShaderPackShader> shaders;
+    std::vector<std::vector<unsigned char>> bytecodes;
+    std::vector<ShaderPackBuffer> buffers;
+    std::vector<ShaderPackVariable> variables;
+    std::vector<ShaderPackResource> resources;
+    std::vector<ShaderPackInputElement> inputElements;
+    std::string strings;
+    std::unordered_map<std::string, unsigned int> stringOffsets;
+    std::string errors;
+};
+
+unsigned int ShaderPackBuilder::AddString(const char* text)
+{
+    auto found = stringOffsets.find(text);
+    if (found != stringOffsets.end())
+        return found->second;
+
+    unsigned int offset = (unsigned int)strings.size();
+    strings.append(text);
+    strings.push_back('\0');
+    stringOffsets[text] = offset;
+    return offset;
+}
+
+// --------------------------------------------------------
+// Reflects a shader the same way SimpleShader does when it
+// loads a .cso - what it finds here is all it gets from a pack
+// --------------------------------------------------------
+bool ShaderPackBuilder::AddShader(const std::string& name, const void* bytecode, size_t size)
+{
+    ID3D11ShaderReflection* refl = 0;
+    if (FAILED(D3DReflect(bytecode, size, IID_ID3D11ShaderReflection, (void**)&refl)))
+    {
+        errors += "-buildpack: couldn't reflect " + name + "\n";
+        return false;
+    }
+
+    D3D11_SHADER_DESC shaderDesc;
+    refl->GetDesc(&shaderDesc);
+
+    ShaderPackShader shader = {};
+    shader.name = AddString(name.c_str());
+    shader.bytecodeSize = (unsigned int)size;
+
+    // constant buffers, and their variables
+    shader.firstBuffer = (unsigned int)buffers.size();
+    shader.bufferCount = shaderDesc.ConstantBuffers;
+    for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
+    {
+        ID3D11ShaderReflectionConstantBuffer* cb = refl->GetConstantBufferByIndex(b);
+        D3D11_SHADER_BUFFER_DESC bufferDesc;
+        cb->GetDesc(&bufferDesc);
+        D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+        refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+        ShaderPackBuffer buffer = {};
+        buffer.name = AddString(bufferDesc.Name);
+        buffer.type = (unsigned int)bufferDesc.Type;
+        buffer.size = bufferDesc.Size;
+        buffer.bindIndex = bindDesc.BindPoint;
+        buffer.firstVariable = (unsigned int)variables.size();
+        buffer.variableCount = bufferDesc.Variables;
+        for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+        {
+            D3D11_SHADER_VARIABLE_DESC varDesc;
+            cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+
+            ShaderPackVariable variable = { AddString(varDesc.Name), varDesc.StartOffset, varDesc.Size };
+            variables.push_back(variable);
+        }
+        buffers.push_back(buffer);
+    }
+
+    // everything else that's bound - the buffers are above
+    shader.firstResource = (unsigned int)resources.size();
+    for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
+    {
+        D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
+        refl->GetResourceBindingDesc(r, &resourceDesc);
+        if (resourceDesc.Type == D3D_SIT_CBUFFER || resourceDesc.Type == D3D_SIT_TBUFFER)
+            continue;
+
+        ShaderPackResource resource = { AddString(resourceDesc.Name), (unsigned int)resourceDesc.Type, resourceDesc.BindPoint };
+        resources.push_back(resource);
+    }
+    shader.resourceCount = (unsigned int)resources.size() - shader.firstResource;
+
+    // the input layout a vertex shader would make for itself
+    shader.firstInputElement = (unsigned int)inputElements.size();
+    if (D3D11_SHVER_GET_TYPE(shaderDesc.Version) == D3D11_SHVER_VERTEX_SHADER)
+    {
+        for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+        {
+            D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+            refl->GetInputParameterDesc(i, &paramDesc);
+
+            ShaderPackInputElement element = {};
+            element.semanticName = AddString(paramDesc.SemanticName);
+            element.semanticIndex = paramDesc.SemanticIndex;
+            element.format = (unsigned int)SimpleVertexShader::GetInputFormat(paramDesc);
+            element.perInstance = SimpleVertexShader::IsPerInstanceSemantic(paramDesc.SemanticName) ? 1 : 0;
+            inputElements.push_back(element);
+        }
+    }
+    shader.inputElementCount = (unsigned int)inputElements.size() - shader.firstInputElement;
+
+    refl->GetThreadGroupSize(&shader.threadGroupSize[0], &shader.threadGroupSize[1], &shader.threadGroupSize[2]);
+    refl->Release();
+
+    shaders.push_back(shader);
+    bytecodes.push_back(std::vector<unsigned char>((const unsigned char*)bytecode, (const unsigned char*)bytecode + size));
+    return true;
+}
+
+// --------------------------------------------------------
+// The header, the tables, the strings, then each shader's
+// bytecode on a 16 byte boundary
+// --------------------------------------------------------
+std::vector<unsigned char> ShaderPackBuilder::Write()
+{
+    ShaderPackHeader header = {};
+    header.magic = SHADER_PACK_MAGIC;
+    header.version = SHADER_PACK_VERSION;
+
+    unsigned int offset = sizeof(ShaderPackHeader);
+    header.shadersOffset = offset;
+    header.shaderCount = (unsigned int)shaders.size();
+    offset += header.shaderCount * sizeof(ShaderPackShader);
+    header.buffersOffset = offset;
+    header.bufferCount = (unsigned int)buffers.size();
+    offset += header.bufferCount * sizeof(ShaderPackBuffer);
+    header.variablesOffset = offset;
+    header.variableCount = (unsigned int)variables.size();
+    offset += header.variableCount * sizeof(ShaderPackVariable);
+    header.resourcesOffset = offset;
+    header.resourceCount = (unsigned int)resources.size();
+    offset += header.resourceCount * sizeof(ShaderPackResource);
+    header.inputElementsOffset = offset;
+    header.inputElementCount = (unsigned int)inputElements.size();
+    offset += header.inputElementCount * sizeof(ShaderPackInputElement);
+    header.stringsOffset = offset;
+    header.stringsSize = (unsigned int)strings.size();
+    offset += header.stringsSize;
+
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        offset = (offset + 15) / 16 * 16;
+        shaders[i].bytecodeOffset = offset;
+        offset += shaders[i].bytecodeSize;
+    }
+
+    std::vector<unsigned char> file(offset, 0);
+    memcpy(&file[0], &header, sizeof(header));
+    if (!shaders.empty()) memcpy(&file[header.shadersOffset], shaders.data(), shaders.size() * sizeof(ShaderPackShader));
+    if (!buffers.empty()) memcpy(&file[header.buffersOffset], buffers.data(), buffers.size() * sizeof(ShaderPackBuffer));
+    if (!variables.empty()) memcpy(&file[header.variablesOffset], variables.data(), variables.size() * sizeof(ShaderPackVariable));
+    if (!resources.empty()) memcpy(&file[header.resourcesOffset], resources.data(), resources.size() * sizeof(ShaderPackResource));
+    if (!inputElements.empty()) memcpy(&file[header.inputElementsOffset], inputElements.data(), inputElements.size() * sizeof(ShaderPackInputElement));
+    if (!strings.empty()) memcpy(&file[header.stringsOffset], strings.data(), strings.size());
+    for (size_t i = 0; i < shaders.size(); i++)
+        memcpy(&file[shaders[i].bytecodeOffset], bytecodes[i].data(), bytecodes[i].size());
+    return file;
+}
+
+int ShaderPack::Build(const char* csoDirectory, const char* packPath)
+{
+    wchar_t directory[MAX_PATH] = {};
+    MultiByteToWideChar(CP_ACP, 0, csoDirectory, -1, directory, MAX_PATH);
+
+    // trailing separators come from $(OutDir)
+    std::wstring trimmed = directory;
+    while (!trimmed.empty() && (trimmed.back() == L'\\' || trimmed.back() == L'/'))
+        trimmed.pop_back();
+
+    std::vector<std::wstring> files;
+    WIN32_FIND_DATAW found;
+    HANDLE find = FindFirstFileW((trimmed + L"\\*.cso").c_str(), &found);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            files.push_back(found.cFileName);
+        } while (FindNextFileW(find, &found));
+        FindClose(find);
+    }
+
+    // sorted, so the same shaders always make the same pack
+    std::sort(files.begin(), files.end());
+
+    ShaderPackBuilder builder;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        ID3DBlob* blob = 0;
+        if (FAILED(D3DReadFileToBlob((trimmed + L"\\" + files[i]).c_str(), &blob)))
+            continue;
+
+        std::wstring stem = files[i].substr(0, files[i].size() - 4);
+        char name[MAX_PATH] = {};
+        WideCharToMultiByte(CP_ACP, 0, stem.c_str(), -1, name, MAX_PATH, 0, 0);
+        builder.AddShader(name, blob->GetBufferPointer(), blob->GetBufferSize());
+        blob->Release();
+    }
+    printf("%s", builder.GetErrors().c_str());
+    if (builder.GetShaderCount() == 0)
+    {
+        printf("-buildpack: no compiled shaders in %s\n", csoDirectory);
+        return 1;
+    }
+
+    std::vector<unsigned char> pack = builder.Write();
+    FILE* file = 0;
+    if (fopen_s(&file, packPath, "wb") != 0 || !file)
+    {
+        printf("-buildpack: couldn't write %s\n", packPath);
+        return 1;
+    }
+    fwrite(pack.data(), 1, pack.size(), file);
+    fclose(file);
+
+    printf("-buildpack: %u shaders (%u KB) packed into %s\n", builder.GetShaderCount(), (unsigned int)(pack.size() / 1024), packPath);
+    return 0;
+}
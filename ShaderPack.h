@@ -0,0 +1,126 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+
+#define SHADER_PACK_MAGIC       0x4B415053  // "SPAK"
+#define SHADER_PACK_VERSION     1
+
+// Records in a pack - every table is an array of one of these,
+// offsets are from the start of the file, and names are offsets
+// into its string table
+struct ShaderPackHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int shadersOffset;
+    unsigned int shaderCount;
+    unsigned int buffersOffset;
+    unsigned int bufferCount;
+    unsigned int variablesOffset;
+    unsigned int variableCount;
+    unsigned int resourcesOffset;
+    unsigned int resourceCount;
+    unsigned int inputElementsOffset;
+    unsigned int inputElementCount;
+    unsigned int stringsOffset;
+    unsigned int stringsSize;
+};
+
+// - name is the .cso's, without the extension
+// - first* index the pack's tables, so a shader's records are
+//   next to each other
+struct ShaderPackShader
+{
+    unsigned int name;
+    unsigned int bytecodeOffset;
+    unsigned int bytecodeSize;
+    unsigned int firstBuffer;
+    unsigned int bufferCount;
+    unsigned int firstResource;
+    unsigned int resourceCount;
+    unsigned int firstInputElement;
+    unsigned int inputElementCount;
+    unsigned int threadGroupSize[3];    // compute shaders only
+};
+
+// a constant buffer - type is a D3D_CBUFFER_TYPE
+struct ShaderPackBuffer
+{
+    unsigned int name;
+    unsigned int type;
+    unsigned int size;
+    unsigned int bindIndex;
+    unsigned int firstVariable;
+    unsigned int variableCount;
+};
+
+struct ShaderPackVariable
+{
+    unsigned int name;
+    unsigned int offset;
+    unsigned int size;
+};
+
+// a bound resource other than a constant buffer - type is a
+// D3D_SHADER_INPUT_TYPE
+struct ShaderPackResource
+{
+    unsigned int name;
+    unsigned int type;
+    unsigned int bindIndex;
+};
+
+// a vertex shader input, as the layout SimpleVertexShader would
+// make from reflection - format is a DXGI_FORMAT
+struct ShaderPackInputElement
+{
+    unsigned int semanticName;
+    unsigned int semanticIndex;
+    unsigned int format;
+    unsigned int perInstance;
+};
+
+// Every compiled shader in one file, with what SimpleShader would
+// otherwise get from reflecting each of them at startup
+// - Built after every build (DX11Starter.exe -buildpack <cso dir> <pack>)
+// - Open() maps the file and checks every table is inside it, so the
+//   records can be read straight from the mapping - nothing's copied
+//   until a shader is created from it
+// - The mapping is read only, so shaders can be created from one
+//   pack on several threads at once
+class ShaderPack
+{
+public:
+    ShaderPack();
+    ~ShaderPack();
+
+    // false if it's missing or isn't a pack this build can read
+    bool Open(const std::wstring& path);
+    void Close();
+    bool IsOpen() const;
+
+    // -1 if the pack doesn't have it
+    int FindShader(const char* name) const;
+    unsigned int GetShaderCount() const;
+    const ShaderPackShader& GetShader(unsigned int index) const;
+    const void* GetBytecode(const ShaderPackShader& shader) const;
+
+    const ShaderPackBuffer* GetBuffers() const;
+    const ShaderPackVariable* GetVariables() const;
+    const ShaderPackResource* GetResources() const;
+    const ShaderPackInputElement* GetInputElements() const;
+    const char* GetString(unsigned int offset) const;
+
+    // the -buildpack build step - returns the process exit code
+    static int Build(const char* csoDirectory, const char* packPath);
+
+private:
+    bool Validate() const;
+    bool InFile(unsigned int offset, unsigned int count, unsigned int stride) const;
+
+    HANDLE file;
+    HANDLE mapping;
+    const unsigned char* view;
+    unsigned int size;
+    const ShaderPackHeader* header;
+};
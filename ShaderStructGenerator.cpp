@@ -0,0 +1,382 @@
+#include "ShaderStructGenerator.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// hand written C++ structs the shaders share, and where they live
+static const char* sharedStructHeaders[][2] = {
+    { "Light", "Lights.h" },
+};
+
+const std::string& ShaderStructGenerator::GetErrors() { return errors; }
+
+// --------------------------------------------------------
+// Reflects every cbuffer of a shader - variables that can't
+// be expressed as C++ types with the same layout are kept
+// as raw bytes, so the struct still has the right size
+// --------------------------------------------------------
+bool ShaderStructGenerator::AddShader(const std::string& name, const void* bytecode, size_t size)
+{
+    ID3D11ShaderReflection* refl = 0;
+    if (FAILED(D3DReflect(bytecode, size, IID_ID3D11ShaderReflection, (void**)&refl)))
+    {
+        errors += name + ": couldn't reflect the shader\n";
+        return false;
+    }
+
+    D3D11_SHADER_DESC shaderDesc;
+    refl->GetDesc(&shaderDesc);
+    for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
+    {
+        ID3D11ShaderReflectionConstantBuffer* cb = refl->GetConstantBufferByIndex(b);
+        D3D11_SHADER_BUFFER_DESC bufferDesc;
+        cb->GetDesc(&bufferDesc);
+        if (bufferDesc.Type != D3D11_CT_CBUFFER)
+            continue;
+
+        D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+        refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+        Buffer buffer;
+        buffer.shader = name;
+        buffer.name = bufferDesc.Name;
+        buffer.bindIndex = bindDesc.BindPoint;
+        buffer.size = bufferDesc.Size;
+        buffer.sameAs = -1;
+
+        for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+        {
+            ID3D11ShaderReflectionVariable* var = cb->GetVariableByIndex(v);
+            D3D11_SHADER_VARIABLE_DESC varDesc;
+            var->GetDesc(&varDesc);
+
+            // a variable can't spill into the next one, which may be
+            // packed into the tail of its last register
+            unsigned int end = bufferDesc.Size;
+            if (v + 1 < bufferDesc.Variables)
+            {
+                D3D11_SHADER_VARIABLE_DESC nextDesc;
+                cb->GetVariableByIndex(v + 1)->GetDesc(&nextDesc);
+                end = nextDesc.StartOffset;
+            }
+
+            Field field;
+            if (!ReflectField(var->GetType(), varDesc, end - varDesc.StartOffset, field))
+                errors += name + ": " + buffer.name + "." + field.name + " has no matching C++ type, kept as bytes\n";
+            buffer.fields.push_back(field);
+        }
+
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            if (buffers[i].sameAs < 0 && buffers[i].name == buffer.name && SameLayout(buffers[i], buffer))
+            {
+                buffer.sameAs = (int)i;
+                break;
+            }
+        }
+        buffers.push_back(buffer);
+    }
+
+    refl->Release();
+    return true;
+}
+
+// --------------------------------------------------------
+// Picks the C++ type for one cbuffer variable - returns
+// false if it has to be raw bytes
+// --------------------------------------------------------
+bool ShaderStructGenerator::ReflectField(ID3D11ShaderReflectionType* type, const D3D11_SHADER_VARIABLE_DESC& varDesc, unsigned int space, Field& field)
+{
+    D3D11_SHADER_TYPE_DESC typeDesc;
+    type->GetDesc(&typeDesc);
+
+    field.name = varDesc.Name;
+    field.offset = varDesc.StartOffset;
+    field.size = varDesc.Size;
+    field.elements = typeDesc.Elements;
+
+    unsigned int elementSize = 0;
+    if (typeDesc.Class == D3D_SVC_STRUCT && typeDesc.Name)
+    {
+        ReflectStruct(type, typeDesc.Name);
+        for (size_t i = 0; i < sharedStructs.size(); i++)
+        {
+            if (sharedStructs[i].name == typeDesc.Name)
+                elementSize = sharedStructs[i].stride;
+        }
+        field.type = typeDesc.Name;
+        field.structName = typeDesc.Name;
+    }
+    else if (typeDesc.Class == D3D_SVC_SCALAR || typeDesc.Class == D3D_SVC_VECTOR)
+    {
+        // hlsl bools are 4 bytes, like ints
+        const char* scalar = 0;
+        const char* vector = 0;
+        switch (typeDesc.Type)
+        {
+        case D3D_SVT_FLOAT: scalar = "float"; vector = "DirectX::XMFLOAT"; break;
+        case D3D_SVT_INT:
+        case D3D_SVT_BOOL: scalar = "int"; vector = "DirectX::XMINT"; break;
+        case D3D_SVT_UINT: scalar = "unsigned int"; vector = "DirectX::XMUINT"; break;
+        default: break;
+        }
+        if (scalar)
+        {
+            field.type = typeDesc.Columns == 1 ? scalar : vector + std::to_string(typeDesc.Columns);
+            elementSize = typeDesc.Columns * 4;
+        }
+    }
+    else if ((typeDesc.Class == D3D_SVC_MATRIX_ROWS || typeDesc.Class == D3D_SVC_MATRIX_COLUMNS) &&
+        typeDesc.Type == D3D_SVT_FLOAT && typeDesc.Rows == 4 && typeDesc.Columns == 4)
+    {
+        field.type = "DirectX::XMFLOAT4X4";
+        elementSize = 64;
+    }
+
+    // array elements each start a register, so only whole register
+    // elements line up with a C++ array
+    unsigned int count = field.elements > 0 ? field.elements : 1;
+    if (field.type.empty() || elementSize == 0 || (count > 1 && elementSize % 16 != 0) || elementSize * count > space)
+    {
+        field.type.clear();
+        field.structName.clear();
+        return false;
+    }
+    field.size = elementSize * count;
+    return true;
+}
+
+// --------------------------------------------------------
+// Records the layout of an HLSL struct, to assert against
+// the C++ struct of the same name
+// --------------------------------------------------------
+void ShaderStructGenerator::ReflectStruct(ID3D11ShaderReflectionType* type, const char* name)
+{
+    for (size_t i = 0; i < sharedStructs.size(); i++)
+    {
+        if (sharedStructs[i].name == name)
+            return;
+    }
+
+    D3D11_SHADER_TYPE_DESC typeDesc;
+    type->GetDesc(&typeDesc);
+
+    SharedStruct shared;
+    shared.name = name;
+    unsigned int end = 0;
+    for (unsigned int m = 0; m < typeDesc.Members; m++)
+    {
+        D3D11_SHADER_TYPE_DESC memberDesc;
+        type->GetMemberTypeByIndex(m)->GetDesc(&memberDesc);
+
+        unsigned int memberSize = memberDesc.Columns * 4;
+        if (memberDesc.Class == D3D_SVC_MATRIX_ROWS)
+            memberSize = memberDesc.Rows * 16;
+        else if (memberDesc.Class == D3D_SVC_MATRIX_COLUMNS)
+            memberSize = memberDesc.Columns * 16;
+        if (memberDesc.Elements > 1)
+            memberSize += (memberDesc.Elements - 1) * 16;
+        end = std::max(end, memberDesc.Offset + memberSize);
+
+        shared.members.push_back(std::make_pair(CppMemberName(type->GetMemberTypeName(m)), memberDesc.Offset));
+    }
+
+    // structs in arrays are padded out to whole registers
+    shared.stride = (end + 15) / 16 * 16;
+    sharedStructs.push_back(shared);
+}
+
+bool ShaderStructGenerator::SameLayout(const Buffer& a, const Buffer& b)
+{
+    if (a.size != b.size || a.bindIndex != b.bindIndex || a.fields.size() != b.fields.size())
+        return false;
+    for (size_t i = 0; i < a.fields.size(); i++)
+    {
+        const Field& fa = a.fields[i];
+        const Field& fb = b.fields[i];
+        if (fa.name != fb.name || fa.type != fb.type || fa.offset != fb.offset || fa.size != fb.size || fa.elements != fb.elements)
+            return false;
+    }
+    return true;
+}
+
+// HLSL members are PascalCase, the C++ ones camelCase
+std::string ShaderStructGenerator::CppMemberName(const char* hlslName)
+{
+    std::string name = hlslName ? hlslName : "";
+    if (!name.empty() && name[0] >= 'A' && name[0] <= 'Z')
+        name[0] = name[0] - 'A' + 'a';
+    return name;
+}
+
+// --------------------------------------------------------
+// Writes the header - the output only depends on the
+// shaders, so an unchanged build writes the same bytes
+// --------------------------------------------------------
+std::string ShaderStructGenerator::Generate()
+{
+    std::string out;
+    out += "#pragma once\n";
+    out += "// Generated from the compiled shaders by ShaderStructGenerator after every\n";
+    out += "// build - don't edit, change the HLSL and build again\n";
+    out += "#include <cstddef>\n";
+    out += "#include <DirectXMath.h>\n";
+
+    for (size_t s = 0; s < sharedStructs.size(); s++)
+    {
+        bool found = false;
+        for (size_t h = 0; h < sizeof(sharedStructHeaders) / sizeof(sharedStructHeaders[0]); h++)
+        {
+            if (sharedStructs[s].name == sharedStructHeaders[h][0])
+            {
+                out += std::string("#include \"") + sharedStructHeaders[h][1] + "\"\n";
+                found = true;
+            }
+        }
+        if (!found)
+            out += "// " + sharedStructs[s].name + " has no known header - declare it before including this one\n";
+    }
+
+    // the hand written structs have to match the HLSL ones exactly
+    for (size_t s = 0; s < sharedStructs.size(); s++)
+    {
+        const SharedStruct& shared = sharedStructs[s];
+        std::string message = "\"" + shared.name + " doesn't match the HLSL struct\"";
+        out += "\n// struct " + shared.name + "\n";
+        out += "static_assert(sizeof(" + shared.name + ") == " + std::to_string(shared.stride) + ", " + message + ");\n";
+        for (size_t m = 0; m < shared.members.size(); m++)
+            out += "static_assert(offsetof(" + shared.name + ", " + shared.members[m].first + ") == " + std::to_string(shared.members[m].second) + ", " + message + ");\n";
+    }
+
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        const Buffer& buffer = buffers[b];
+        std::string structName = buffer.shader + buffer.name;
+        if (buffer.sameAs >= 0)
+        {
+            const Buffer& same = buffers[buffer.sameAs];
+            out += "\n// " + buffer.shader + " cbuffer " + buffer.name + " - the same layout as " + same.shader + "'s\n";
+            out += "typedef " + same.shader + same.name + " " + structName + ";\n";
+            continue;
+        }
+
+        out += "\n// " + buffer.shader + " cbuffer " + buffer.name + " : register(b" + std::to_string(buffer.bindIndex) + ")\n";
+        out += "struct " + structName + "\n{\n";
+        out += "    static const unsigned int Register = " + std::to_string(buffer.bindIndex) + ";\n";
+        out += "    static const unsigned int Size = " + std::to_string(buffer.size) + ";\n\n";
+
+        unsigned int offset = 0;
+        unsigned int paddingCount = 0;
+        for (size_t f = 0; f < buffer.fields.size(); f++)
+        {
+            const Field& field = buffer.fields[f];
+            if (field.offset > offset)
+                out += "    unsigned char padding" + std::to_string(paddingCount++) + "[" + std::to_string(field.offset - offset) + "];\n";
+
+            if (field.type.empty())
+                out += "    unsigned char " + field.name + "[" + std::to_string(field.size) + "];\n";
+            else if (field.elements > 0)
+                out += "    " + field.type + " " + field.name + "[" + std::to_string(field.elements) + "];\n";
+            else
+                out += "    " + field.type + " " + field.name + ";\n";
+            offset = field.offset + field.size;
+        }
+        if (buffer.size > offset)
+            out += "    unsigned char padding" + std::to_string(paddingCount++) + "[" + std::to_string(buffer.size - offset) + "];\n";
+        out += "};\n";
+
+        std::string message = "\"" + structName + " doesn't match " + buffer.shader + "\"";
+        out += "static_assert(sizeof(" + structName + ") == " + structName + "::Size, " + message + ");\n";
+        for (size_t f = 0; f < buffer.fields.size(); f++)
+            out += "static_assert(offsetof(" + structName + ", " + buffer.fields[f].name + ") == " + std::to_string(buffer.fields[f].offset) + ", " + message + ");\n";
+    }
+
+    return out;
+}
+
+unsigned int ShaderStructGenerator::AddDirectory(const std::wstring& directory)
+{
+    std::vector<std::wstring> files;
+    WIN32_FIND_DATAW found;
+    HANDLE find = FindFirstFileW((directory + L"\\*.cso").c_str(), &found);
+    if (find == INVALID_HANDLE_VALUE)
+        return 0;
+    do
+    {
+        files.push_back(found.cFileName);
+    } while (FindNextFileW(find, &found));
+    FindClose(find);
+
+    // sorted, so the header doesn't depend on the file system's order
+    std::sort(files.begin(), files.end());
+
+    unsigned int added = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        ID3DBlob* blob = 0;
+        if (FAILED(D3DReadFileToBlob((directory + L"\\" + files[i]).c_str(), &blob)))
+            continue;
+
+        std::wstring stem = files[i].substr(0, files[i].size() - 4);
+        char name[MAX_PATH] = {};
+        WideCharToMultiByte(CP_ACP, 0, stem.c_str(), -1, name, MAX_PATH, 0, 0);
+        if (AddShader(name, blob->GetBufferPointer(), blob->GetBufferSize()))
+            added++;
+        blob->Release();
+    }
+    return added;
+}
+
+int ShaderStructGenerator::Run(const char* csoDirectory, const char* headerPath)
+{
+    wchar_t directory[MAX_PATH] = {};
+    MultiByteToWideChar(CP_ACP, 0, csoDirectory, -1, directory, MAX_PATH);
+
+    // trailing separators come from $(OutDir)
+    std::wstring trimmed = directory;
+    while (!trimmed.empty() && (trimmed.back() == L'\\' || trimmed.back() == L'/'))
+        trimmed.pop_back();
+
+    ShaderStructGenerator generator;
+    unsigned int shaderCount = generator.AddDirectory(trimmed);
+    printf("%s", generator.GetErrors().c_str());
+    if (shaderCount == 0)
+    {
+        printf("-genstructs: no compiled shaders in %s\n", csoDirectory);
+        return 1;
+    }
+    std::string header = generator.Generate();
+
+    // line endings may have been changed by a checkout, so they
+    // don't count as a difference
+    std::string existing;
+    FILE* file = 0;
+    if (fopen_s(&file, headerPath, "rb") == 0 && file)
+    {
+        char chunk[4096];
+        size_t read;
+        while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            existing.append(chunk, read);
+        fclose(file);
+    }
+    existing.erase(std::remove(existing.begin(), existing.end(), '\r'), existing.end());
+    if (existing == header)
+    {
+        printf("-genstructs: %s is up to date (%u shaders)\n", headerPath, shaderCount);
+        return 0;
+    }
+
+    if (fopen_s(&file, headerPath, "wb") != 0 || !file)
+    {
+        printf("-genstructs: couldn't write %s\n", headerPath);
+        return 1;
+    }
+    fwrite(header.data(), 1, header.size(), file);
+    fclose(file);
+
+    // failing the build makes sure the code is compiled against the
+    // new layouts before anything runs
+    printf("-genstructs: %s was out of date and has been regenerated - build again\n", headerPath);
+    return 1;
+}
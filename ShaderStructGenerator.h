@@ -0,0 +1,74 @@
+#pragma once
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <string>
+#include <vector>
+
+// Writes ShaderStructs.h - a C++ struct for every constant buffer of the
+// compiled shaders, laid out from their reflection
+// - Runs after every build (DX11Starter.exe -genstructs <cso dir> <header>)
+//   and fails the build when the header it would write differs from the
+//   one on disk, so a changed cbuffer is picked up by the next build
+// - Every field gets a static_assert on its offset, and every struct on
+//   its size, so hand edits to either side can't drift silently
+// - HLSL structs inside cbuffers map to the hand written C++ struct of
+//   the same name (Light -> Lights.h), with its members' names starting
+//   lowercase - the generated header asserts their offsets too, which
+//   is where HLSL/C++ drift in shared types turns into a compile error
+// - Buffers with the same name and layout in several shaders share one
+//   struct, and the other shaders get a typedef to it
+class ShaderStructGenerator
+{
+public:
+    // reflects one compiled shader - its structs are prefixed with name
+    bool AddShader(const std::string& name, const void* bytecode, size_t size);
+
+    // reflects every .cso in a directory, in name order - returns how many
+    unsigned int AddDirectory(const std::wstring& directory);
+
+    // the header for everything added so far
+    std::string Generate();
+
+    // what couldn't be reflected, one line each
+    const std::string& GetErrors();
+
+    // the -genstructs build step - returns the process exit code
+    static int Run(const char* csoDirectory, const char* headerPath);
+
+private:
+    struct Field
+    {
+        std::string name;
+        std::string type;           // empty if it's emitted as raw bytes
+        std::string structName;     // a hand written C++ struct, if any
+        unsigned int offset;
+        unsigned int size;
+        unsigned int elements;
+    };
+
+    struct Buffer
+    {
+        std::string shader;
+        std::string name;
+        unsigned int bindIndex;
+        unsigned int size;
+        std::vector<Field> fields;
+        int sameAs;                 // an earlier buffer with the same layout, or -1
+    };
+
+    struct SharedStruct
+    {
+        std::string name;
+        unsigned int stride;
+        std::vector<std::pair<std::string, unsigned int>> members;
+    };
+
+    bool ReflectField(ID3D11ShaderReflectionType* type, const D3D11_SHADER_VARIABLE_DESC& varDesc, unsigned int space, Field& field);
+    void ReflectStruct(ID3D11ShaderReflectionType* type, const char* name);
+    static bool SameLayout(const Buffer& a, const Buffer& b);
+    static std::string CppMemberName(const char* hlslName);
+
+    std::vector<Buffer> buffers;
+    std::vector<SharedStruct> sharedStructs;
+    std::string errors;
+};
@@ -0,0 +1,140 @@
+#pragma once
+// Generated from the compiled shaders by ShaderStructGenerator after every
+// build - don't edit, change the HLSL and build again
+#include <cstddef>
+#include <DirectXMath.h>
+#include "Lights.h"
+
+// struct Light
+static_assert(sizeof(Light) == 80, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, type) == 0, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, direction) == 4, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, radius) == 16, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, position) == 20, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, intensity) == 32, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, diffuseColor) == 36, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, spotPower) == 48, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, ambientColor) == 52, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, enabled) == 64, "Light doesn't match the HLSL struct");
+static_assert(offsetof(Light, padding) == 68, "Light doesn't match the HLSL struct");
+
+// GpuCullCS cbuffer CullData : register(b0)
+struct GpuCullCSCullData
+{
+    static const unsigned int Register = 0;
+    static const unsigned int Size = 112;
+
+    DirectX::XMFLOAT4 planes[6];
+    unsigned int objectCount;
+    unsigned char padding0[12];
+};
+static_assert(sizeof(GpuCullCSCullData) == GpuCullCSCullData::Size, "GpuCullCSCullData doesn't match GpuCullCS");
+static_assert(offsetof(GpuCullCSCullData, planes) == 0, "GpuCullCSCullData doesn't match GpuCullCS");
+static_assert(offsetof(GpuCullCSCullData, objectCount) == 96, "GpuCullCSCullData doesn't match GpuCullCS");
+
+// PixelShader cbuffer FrameData : register(b0)
+struct PixelShaderFrameData
+{
+    static const unsigned int Register = 0;
+    static const unsigned int Size = 10288;
+
+    Light lights[128];
+    int lightCount;
+    int renderShadows;
+    int directionalCount;
+    float clusterSliceScale;
+    DirectX::XMFLOAT3 localAmbient;
+    float clusterSliceBias;
+    DirectX::XMFLOAT2 clusterTileScale;
+    int objectLightLists;
+    unsigned char padding0[4];
+};
+static_assert(sizeof(PixelShaderFrameData) == PixelShaderFrameData::Size, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, lights) == 0, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, lightCount) == 10240, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, renderShadows) == 10244, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, directionalCount) == 10248, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, clusterSliceScale) == 10252, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, localAmbient) == 10256, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, clusterSliceBias) == 10268, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, clusterTileScale) == 10272, "PixelShaderFrameData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderFrameData, objectLightLists) == 10280, "PixelShaderFrameData doesn't match PixelShader");
+
+// PixelShader cbuffer PassData : register(b1)
+struct PixelShaderPassData
+{
+    static const unsigned int Register = 1;
+    static const unsigned int Size = 16;
+
+    DirectX::XMFLOAT3 cameraPos;
+    unsigned char padding0[4];
+};
+static_assert(sizeof(PixelShaderPassData) == PixelShaderPassData::Size, "PixelShaderPassData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderPassData, cameraPos) == 0, "PixelShaderPassData doesn't match PixelShader");
+
+// PixelShader cbuffer MaterialData : register(b2)
+struct PixelShaderMaterialData
+{
+    static const unsigned int Register = 2;
+    static const unsigned int Size = 16;
+
+    float specularIntensity;
+    unsigned char padding0[12];
+};
+static_assert(sizeof(PixelShaderMaterialData) == PixelShaderMaterialData::Size, "PixelShaderMaterialData doesn't match PixelShader");
+static_assert(offsetof(PixelShaderMaterialData, specularIntensity) == 0, "PixelShaderMaterialData doesn't match PixelShader");
+
+// PostProcessPS cbuffer ExternalData : register(b0)
+struct PostProcessPSExternalData
+{
+    static const unsigned int Register = 0;
+    static const unsigned int Size = 16;
+
+    float pixelWidth;
+    float pixelHeight;
+    float depthAdjust;
+    float normalAdjust;
+};
+static_assert(sizeof(PostProcessPSExternalData) == PostProcessPSExternalData::Size, "PostProcessPSExternalData doesn't match PostProcessPS");
+static_assert(offsetof(PostProcessPSExternalData, pixelWidth) == 0, "PostProcessPSExternalData doesn't match PostProcessPS");
+static_assert(offsetof(PostProcessPSExternalData, pixelHeight) == 4, "PostProcessPSExternalData doesn't match PostProcessPS");
+static_assert(offsetof(PostProcessPSExternalData, depthAdjust) == 8, "PostProcessPSExternalData doesn't match PostProcessPS");
+static_assert(offsetof(PostProcessPSExternalData, normalAdjust) == 12, "PostProcessPSExternalData doesn't match PostProcessPS");
+
+// ShadowMapVS cbuffer PassData : register(b1)
+struct ShadowMapVSPassData
+{
+    static const unsigned int Register = 1;
+    static const unsigned int Size = 128;
+
+    DirectX::XMFLOAT4X4 view;
+    DirectX::XMFLOAT4X4 projection;
+};
+static_assert(sizeof(ShadowMapVSPassData) == ShadowMapVSPassData::Size, "ShadowMapVSPassData doesn't match ShadowMapVS");
+static_assert(offsetof(ShadowMapVSPassData, view) == 0, "ShadowMapVSPassData doesn't match ShadowMapVS");
+static_assert(offsetof(ShadowMapVSPassData, projection) == 64, "ShadowMapVSPassData doesn't match ShadowMapVS");
+
+// SkyVS cbuffer PassData - the same layout as ShadowMapVS's
+typedef ShadowMapVSPassData SkyVSPassData;
+
+// TextureArrayPS cbuffer FrameData - the same layout as PixelShader's
+typedef PixelShaderFrameData TextureArrayPSFrameData;
+
+// TextureArrayPS cbuffer PassData - the same layout as PixelShader's
+typedef PixelShaderPassData TextureArrayPSPassData;
+
+// VertexShader cbuffer FrameData : register(b0)
+struct VertexShaderFrameData
+{
+    static const unsigned int Register = 0;
+    static const unsigned int Size = 128;
+
+    DirectX::XMFLOAT4X4 shadowView;
+    DirectX::XMFLOAT4X4 shadowProjection;
+};
+static_assert(sizeof(VertexShaderFrameData) == VertexShaderFrameData::Size, "VertexShaderFrameData doesn't match VertexShader");
+static_assert(offsetof(VertexShaderFrameData, shadowView) == 0, "VertexShaderFrameData doesn't match VertexShader");
+static_assert(offsetof(VertexShaderFrameData, shadowProjection) == 64, "VertexShaderFrameData doesn't match VertexShader");
+
+// VertexShader cbuffer PassData - the same layout as ShadowMapVS's
+typedef ShadowMapVSPassData VertexShaderPassData;
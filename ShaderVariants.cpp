@@ -0,0 +1,312 @@
+#include "ShaderVariants.h"
+#include <Windows.h>
+#include <d3dcompiler.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    // the shaders built with variants - all of them include ToonShading.hlsli
+    const char* variantShaders[] = { "PixelShader", "TextureArrayPS" };
+    const unsigned int variantShaderCount = sizeof(variantShaders) / sizeof(variantShaders[0]);
+
+    // in mask bit order
+    const char* keywordNames[SHADER_VARIANT_KEYWORD_COUNT] = {
+        "SHADOWS_ON", "LIGHTS_DIRECTIONAL", "LIGHTS_POINT", "LIGHTS_SPOT", "NORMAL_MAP", "TOON" };
+
+    // matches the build's own shader settings for the configuration
+    const char* variantTarget = "ps_5_0";
+#if defined(DEBUG) || defined(_DEBUG)
+    const UINT variantFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION | D3DCOMPILE_ENABLE_STRICTNESS;
+#else
+    const UINT variantFlags = D3DCOMPILE_OPTIMIZATION_LEVEL3 | D3DCOMPILE_ENABLE_STRICTNESS;
+#endif
+
+    struct VariantJob
+    {
+        unsigned int shader;
+        unsigned int mask;
+        std::string file;       // its name in the cache, once it's there
+        bool compiled;          // false if the cache already had it
+        std::string errors;
+    };
+
+    void Hash(uint64_t& hash, const void* data, size_t size)
+    {
+        // FNV-1a
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    std::wstring Widen(const std::string& text)
+    {
+        wchar_t wide[MAX_PATH] = {};
+        MultiByteToWideChar(CP_ACP, 0, text.c_str(), -1, wide, MAX_PATH);
+        return wide;
+    }
+
+    std::string TrimSeparators(const char* path)
+    {
+        // trailing separators come from $(ProjectDir) and $(OutDir)
+        std::string trimmed = path;
+        while (!trimmed.empty() && (trimmed.back() == '\\' || trimmed.back() == '/'))
+            trimmed.pop_back();
+        return trimmed;
+    }
+
+    // --------------------------------------------------------
+    // Preprocesses one variant, names it by the hash of what the
+    // compiler would see, and compiles it unless the cache
+    // already has that file
+    // --------------------------------------------------------
+    void BuildVariant(VariantJob& job, const std::string& sourceDirectory, const std::string& cacheDirectory)
+    {
+        std::string sourcePath = sourceDirectory + "\\" + variantShaders[job.shader] + ".hlsl";
+        ID3DBlob* source = 0;
+        if (FAILED(D3DReadFileToBlob(Widen(sourcePath).c_str(), &source)))
+        {
+            job.errors = "couldn't read " + sourcePath + "\n";
+            return;
+        }
+
+        D3D_SHADER_MACRO defines[SHADER_VARIANT_KEYWORD_COUNT + 2] = {};
+        unsigned int defineCount = 0;
+        defines[defineCount++] = { "SHADER_VARIANT", "1" };
+        for (unsigned int k = 0; k < SHADER_VARIANT_KEYWORD_COUNT; k++)
+        {
+            if (job.mask & (1u << k))
+                defines[defineCount++] = { keywordNames[k], "1" };
+        }
+
+        ID3DBlob* preprocessed = 0;
+        ID3DBlob* errors = 0;
+        HRESULT hr = D3DPreprocess(source->GetBufferPointer(), source->GetBufferSize(), sourcePath.c_str(),
+            defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, &preprocessed, &errors);
+        source->Release();
+        if (errors)
+        {
+            job.errors = (const char*)errors->GetBufferPointer();
+            errors->Release();
+        }
+        if (FAILED(hr))
+            return;
+
+        uint64_t hash = 14695981039346656037ull;
+        unsigned int compilerVersion = D3D_COMPILER_VERSION;
+        Hash(hash, preprocessed->GetBufferPointer(), preprocessed->GetBufferSize());
+        Hash(hash, variantTarget, strlen(variantTarget));
+        Hash(hash, &variantFlags, sizeof(variantFlags));
+        Hash(hash, &compilerVersion, sizeof(compilerVersion));
+
+        char file[MAX_PATH];
+        sprintf_s(file, "%s_%016llx.cso", variantShaders[job.shader], (unsigned long long)hash);
+        std::wstring path = Widen(cacheDirectory + "\\" + file);
+        if (GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES)
+        {
+            preprocessed->Release();
+            job.file = file;
+            return;
+        }
+
+        // the preprocessed text is what was hashed, so that's what's compiled
+        ID3DBlob* code = 0;
+        hr = D3DCompile(preprocessed->GetBufferPointer(), preprocessed->GetBufferSize(), sourcePath.c_str(),
+            0, 0, "main", variantTarget, variantFlags, 0, &code, &errors);
+        preprocessed->Release();
+        if (errors)
+        {
+            job.errors += (const char*)errors->GetBufferPointer();
+            errors->Release();
+        }
+        if (FAILED(hr))
+            return;
+
+        hr = D3DWriteBlobToFile(code, path.c_str(), TRUE);
+        code->Release();
+        if (FAILED(hr))
+        {
+            job.errors += std::string("couldn't write ") + file + "\n";
+            return;
+        }
+        job.file = file;
+        job.compiled = true;
+    }
+}
+
+ShaderVariants::ShaderVariants(ID3D11Device* device, ID3D11DeviceContext* context, SimplePixelShader* baseShader)
+    : device(device), context(context), baseShader(baseShader)
+{
+    for (unsigned int i = 0; i < SHADER_VARIANT_COUNT; i++)
+        variants[i] = 0;
+}
+
+ShaderVariants::~ShaderVariants()
+{
+    for (SimplePixelShader* variant : created)
+        delete variant;
+}
+
+bool ShaderVariants::Open(const std::wstring& cacheDirectory, const std::wstring& name)
+{
+    FILE* list = 0;
+    if (_wfopen_s(&list, (cacheDirectory + L"\\" + name + L".variants").c_str(), L"r") != 0 || !list)
+        return false;
+
+    // one "<mask> <file>" line per variant
+    unsigned int mask;
+    char file[MAX_PATH];
+    unsigned int count = 0;
+    while (fscanf_s(list, "%u %259s", &mask, file, (unsigned int)sizeof(file)) == 2)
+    {
+        if (mask >= SHADER_VARIANT_COUNT)
+            continue;
+        files[mask] = cacheDirectory + L"\\" + Widen(file);
+        count++;
+    }
+    fclose(list);
+    return count > 0;
+}
+
+// --------------------------------------------------------
+// Creates the variants for every combination of the frame
+// keywords with one material's - a variant that fails to
+// load is left to the base shader
+// --------------------------------------------------------
+unsigned int ShaderVariants::Prewarm(unsigned int materialBits)
+{
+    unsigned int count = 0;
+    materialBits &= (SHADER_VARIANT_COUNT - 1) & ~SHADER_VARIANT_FRAME_BITS;
+    for (unsigned int frameBits = 0; frameBits <= SHADER_VARIANT_FRAME_BITS; frameBits++)
+    {
+        unsigned int mask = frameBits | materialBits;
+        if (variants[mask] || files[mask].empty())
+            continue;
+
+        SimplePixelShader* variant = new SimplePixelShader(device, context, files[mask].c_str());
+        if (!variant->IsShaderValid())
+        {
+            delete variant;
+            continue;
+        }
+        variants[mask] = variant;
+        created.push_back(variant);
+        count++;
+    }
+    return count;
+}
+
+SimplePixelShader* ShaderVariants::GetBaseShader() const { return baseShader; }
+const std::vector<SimplePixelShader*>& ShaderVariants::GetCreated() const { return created; }
+
+unsigned int ShaderVariants::GetFrameBits(bool shadows, const Light* lights, unsigned int lightCount)
+{
+    unsigned int bits = shadows ? SHADER_VARIANT_SHADOWS : 0;
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        if (lights[i].enabled && lights[i].type >= TYPE_DIRECTIONAL && lights[i].type <= TYPE_SPOT)
+            bits |= SHADER_VARIANT_LIGHTS_DIRECTIONAL << lights[i].type;
+    }
+    return bits;
+}
+
+// --------------------------------------------------------
+// Builds every variant of every variant shader into the
+// cache on a few threads, writes each shader's list, and
+// deletes cached files no list mentions any more
+// --------------------------------------------------------
+int ShaderVariants::Build(const char* sourceDirectory, const char* cacheDirectory)
+{
+    std::string sources = TrimSeparators(sourceDirectory);
+    std::string cache = TrimSeparators(cacheDirectory);
+    CreateDirectoryW(Widen(cache).c_str(), 0);
+
+    std::vector<VariantJob> jobs;
+    for (unsigned int s = 0; s < variantShaderCount; s++)
+    {
+        for (unsigned int mask = 0; mask < SHADER_VARIANT_COUNT; mask++)
+        {
+            VariantJob job = {};
+            job.shader = s;
+            job.mask = mask;
+            jobs.push_back(job);
+        }
+    }
+
+    // the compiler is thread safe, and each job only touches its own file
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < jobs.size(); i = next++)
+            BuildVariant(jobs[i], sources, cache);
+    };
+    unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < threadCount; t++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    unsigned int compiled = 0;
+    unsigned int failed = 0;
+    for (const VariantJob& job : jobs)
+    {
+        if (!job.errors.empty())
+            printf("%s", job.errors.c_str());
+        if (job.file.empty())
+            failed++;
+        else if (job.compiled)
+            compiled++;
+    }
+    if (failed > 0)
+    {
+        printf("-buildvariants: %u of %u variants failed to build\n", failed, (unsigned int)jobs.size());
+        return 1;
+    }
+
+    for (unsigned int s = 0; s < variantShaderCount; s++)
+    {
+        std::string listPath = cache + "\\" + variantShaders[s] + ".variants";
+        FILE* list = 0;
+        if (fopen_s(&list, listPath.c_str(), "w") != 0 || !list)
+        {
+            printf("-buildvariants: couldn't write %s\n", listPath.c_str());
+            return 1;
+        }
+        for (const VariantJob& job : jobs)
+        {
+            if (job.shader == s)
+                fprintf(list, "%u %s\n", job.mask, job.file.c_str());
+        }
+        fclose(list);
+    }
+
+    // variants of sources that have since changed
+    unsigned int removed = 0;
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA((cache + "\\*.cso").c_str(), &found);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            bool listed = false;
+            for (size_t i = 0; i < jobs.size() && !listed; i++)
+                listed = jobs[i].file == found.cFileName;
+            if (!listed && DeleteFileA((cache + "\\" + found.cFileName).c_str()))
+                removed++;
+        } while (FindNextFileA(find, &found));
+        FindClose(find);
+    }
+
+    printf("-buildvariants: %u variants in %s (%u compiled, %u cached, %u stale removed)\n",
+        (unsigned int)jobs.size(), cacheDirectory, compiled, (unsigned int)jobs.size() - compiled, removed);
+    return 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <d3d11.h>
+#include <string>
+#include <vector>
+#include "Lights.h"
+#include "SimpleShader.h"
+
+// Feature keywords of the opaque pixel shaders (see ToonShading.hlsli) -
+// a variant's mask is the keywords it was compiled with
+#define SHADER_VARIANT_SHADOWS              0x01
+#define SHADER_VARIANT_LIGHTS_DIRECTIONAL   0x02    // TYPE_DIRECTIONAL
+#define SHADER_VARIANT_LIGHTS_POINT         0x04    // TYPE_POINT
+#define SHADER_VARIANT_LIGHTS_SPOT          0x08    // TYPE_SPOT
+#define SHADER_VARIANT_NORMAL_MAP           0x10
+#define SHADER_VARIANT_TOON                 0x20
+#define SHADER_VARIANT_KEYWORD_COUNT        6
+#define SHADER_VARIANT_COUNT                (1 << SHADER_VARIANT_KEYWORD_COUNT)
+
+// the keywords that follow the frame rather than the material
+#define SHADER_VARIANT_FRAME_BITS           0x0F
+
+// Specialized builds of one pixel shader, one for every combination of
+// feature keywords, so a draw only pays for the features it uses
+// - -buildvariants compiles them all after a build into a cache
+//   directory, each file named by a hash of its preprocessed source,
+//   defines and compiler settings - an unchanged variant is never
+//   compiled again, and an edited include can't leave a stale one in use
+// - <name>.variants in the cache lists the file of each mask
+// - Prewarm() creates every variant a material can be drawn with, so
+//   Get() is one array lookup and safe on the recording threads
+// - a mask that wasn't prewarmed, or a missing cache, gets the base
+//   shader, which has every feature and branches on them at runtime
+class ShaderVariants
+{
+public:
+    ShaderVariants(ID3D11Device* device, ID3D11DeviceContext* context, SimplePixelShader* baseShader);
+    ~ShaderVariants();
+
+    // reads the cache's list for name - false if it has none
+    bool Open(const std::wstring& cacheDirectory, const std::wstring& name);
+
+    // creates the variant of every frame state for one material's
+    // keywords - returns how many were created
+    unsigned int Prewarm(unsigned int materialBits);
+
+    SimplePixelShader* Get(unsigned int mask) const
+    {
+        SimplePixelShader* variant = variants[mask & (SHADER_VARIANT_COUNT - 1)];
+        return variant ? variant : baseShader;
+    }
+    SimplePixelShader* GetBaseShader() const;
+
+    // every variant created so far, in creation order
+    const std::vector<SimplePixelShader*>& GetCreated() const;
+
+    // the frame keywords for the shadow setting and the enabled lights
+    static unsigned int GetFrameBits(bool shadows, const Light* lights, unsigned int lightCount);
+
+    // the -buildvariants build step - returns the process exit code
+    static int Build(const char* sourceDirectory, const char* cacheDirectory);
+
+private:
+    ID3D11Device* device;
+    ID3D11DeviceContext* context;
+    SimplePixelShader* baseShader;
+
+    std::wstring files[SHADER_VARIANT_COUNT];
+    SimplePixelShader* variants[SHADER_VARIANT_COUNT];
+    std::vector<SimplePixelShader*> created;
+};
@@ -1,19 +1,22 @@
 // Vertex Shader to be used when rendering TO the shadow map
 
-cbuffer ExternalData : register(b0)
+// the light's view and projection, world comes in per instance
+cbuffer PassData : register(b1)
 {
-	matrix world;
 	matrix view;
 	matrix projection;
 }
 
-// Struct representing a single vertex worth of data
+// Struct representing a single vertex worth of data, plus the
+// instance's world matrix rows from input slot 1 (the rest of
+// InstanceData follows them but isn't needed here)
 struct VertexShaderInput
 {
 	float3 position		: POSITION;     // XYZ position
-	float2 uv			: TEXCOORD;
-	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
+	float4 world0		: WORLD_PER_INSTANCE0;
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
 };
 
 // Struct representing the data we're sending down the pipeline
@@ -30,9 +33,14 @@ VertexToPixel main(VertexShaderInput input)
 	// Set up output struct
 	VertexToPixel output;
 
-	// Modifying the position using the provided transformation (world) matrix
-	matrix wvp = mul(projection, mul(view, world));
-	output.position = mul(wvp, float4(input.position, 1.0f));
+	// Modifying the position using the instance's transformation (world) matrix
+	float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+	float4 worldPos = mul(float4(input.position, 1.0f), world);
+	// precise, since the depth pre-pass draws with this shader and the main
+	// pass (VertexShader.hlsl) has to land on exactly the same depths
+	matrix vp = mul(projection, view);
+	precise float4 position = mul(vp, worldPos);
+	output.position = position;
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
@@ -18,8 +18,19 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	this->constantBuffers = 0;
 	this->shaderBlob = 0;
 	this->shaderValid = false;
+	this->partialUpdates = false;
+	this->pack = 0;
+	this->packedShader = 0;
+	for (unsigned int i = 0; i < D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT; i++)
+		this->bufferIndexByRegister[i] = -1;
+	ResetUploadStats();
 }
 
+thread_local StateCache* ISimpleShader::stateCache = 0;
+StateObjectCache* ISimpleShader::stateObjects = 0;
+thread_local ID3D11DeviceContext* ISimpleShader::threadContext = 0;
+thread_local unsigned int ISimpleShader::threadSlot = 0;
+
 // --------------------------------------------------------
 // Destructor
 // --------------------------------------------------------
@@ -30,6 +41,261 @@ ISimpleShader::~ISimpleShader()
 		shaderBlob->Release();
 }
 
+// --------------------------------------------------------
+// Sets the context (and local data slot) the calling thread
+// records into, for every shader
+//
+// context - A deferred context, or null for each shader's own
+// slot - Which copy of the local data to use, 1 or more
+//        for anything but a shader's own context
+// --------------------------------------------------------
+void ISimpleShader::SetThreadContext(ID3D11DeviceContext* context, unsigned int slot)
+{
+	threadContext = context;
+	threadSlot = context && slot < SIMPLE_SHADER_CONTEXT_SLOTS ? slot : 0;
+}
+
+// --------------------------------------------------------
+// Gets the context the calling thread is recording into
+// --------------------------------------------------------
+ID3D11DeviceContext* ISimpleShader::GetActiveContext()
+{
+	return threadContext ? threadContext : deviceContext;
+}
+
+// --------------------------------------------------------
+// Gets the calling thread's copy of a buffer's local data,
+// so threads recording with the same shader don't overwrite
+// each other's variables
+// --------------------------------------------------------
+unsigned char* ISimpleShader::GetLocalData(unsigned int bufferIndex)
+{
+	SimpleConstantBuffer& cb = constantBuffers[bufferIndex];
+	return cb.LocalDataBuffer + cb.Size * threadSlot;
+}
+
+// --------------------------------------------------------
+// Gets the thread's state cache, as long as it sits in front
+// of the same context this shader binds to
+// --------------------------------------------------------
+StateCache* ISimpleShader::GetContextStateCache()
+{
+	if (stateCache && stateCache->GetDevice()->GetNativeContext() == GetActiveContext())
+		return stateCache;
+	return 0;
+}
+
+// --------------------------------------------------------
+// Copies data into the calling thread's local data - only
+// the bytes that differ from what's there become dirty, so
+// rewriting the same values leaves the buffer clean
+// --------------------------------------------------------
+void ISimpleShader::WriteLocalData(unsigned int bufferIndex, unsigned int offset, const void* data, unsigned int size)
+{
+	unsigned char* localData = GetLocalData(bufferIndex) + offset;
+	const unsigned char* bytes = (const unsigned char*)data;
+	if (size == 0 || memcmp(localData, bytes, size) == 0)
+		return;
+
+	// trim the unchanged bytes off both ends
+	unsigned int begin = 0;
+	while (localData[begin] == bytes[begin]) begin++;
+	unsigned int end = size;
+	while (localData[end - 1] == bytes[end - 1]) end--;
+	memcpy(localData + begin, bytes + begin, end - begin);
+
+	SimpleDirtyRange& dirty = constantBuffers[bufferIndex].DirtyRanges[threadSlot];
+	if (dirty.Begin == dirty.End)
+	{
+		dirty.Begin = offset + begin;
+		dirty.End = offset + end;
+		return;
+	}
+	if (offset + begin < dirty.Begin) dirty.Begin = offset + begin;
+	if (offset + end > dirty.End) dirty.End = offset + end;
+}
+
+// --------------------------------------------------------
+// Copies one constant buffer's local data to the GPU, if
+// anything changed since this slot last uploaded it
+//
+// With a constant ring every upload is a new allocation,
+// which is bound right away if this shader is in use - a
+// clean buffer keeps its allocation while it's still valid
+// --------------------------------------------------------
+void ISimpleShader::UploadBufferData(unsigned int bufferIndex)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[bufferIndex];
+	SimpleDirtyRange& dirty = cb->DirtyRanges[threadSlot];
+	SimpleUploadStats& stats = uploadStats[threadSlot];
+
+	StateCache* cache = GetContextStateCache();
+	if (!cache)
+	{
+		UpdateOwnBuffer(bufferIndex, 0);
+		return;
+	}
+
+	RenderDevice* renderDevice = cache->GetDevice();
+	ConstantAllocation& allocation = cb->Allocations[threadSlot];
+	if (dirty.Begin == dirty.End && allocation.buffer && allocation.generation == renderDevice->GetConstantGeneration())
+	{
+		stats.CleanSkips++;
+		return;
+	}
+
+	if (renderDevice->AllocateConstants(GetLocalData(bufferIndex), cb->Size, allocation))
+	{
+		dirty.Begin = dirty.End = 0;
+		stats.Uploads++;
+		stats.RingAllocations++;
+		stats.Bytes += cb->Size;
+		if (cb->Type == D3D11_CT_CBUFFER && cache->IsShaderBound(GetStage(), GetStageShader()))
+			cache->SetConstantBufferRange(GetStage(), cb->BindIndex, allocation);
+		return;
+	}
+
+	UpdateOwnBuffer(bufferIndex, renderDevice);
+}
+
+// --------------------------------------------------------
+// Writes a constant buffer's local data to the shader's own
+// buffer, through the render device if there is one
+// - On the shader's own context (slot 0) only the dirty range
+//   has to go, or nothing if it's clean, as long as no other
+//   slot wrote the buffer in between. Recording threads' lists
+//   run later, around the shader's own writes, so they always
+//   write all of it
+// - Small buffers are dynamic and rewritten with Map/DISCARD,
+//   bigger ones get UpdateSubresource - of just the dirty
+//   constants when the device allows it and they're at most
+//   half the buffer
+// --------------------------------------------------------
+void ISimpleShader::UpdateOwnBuffer(unsigned int bufferIndex, RenderDevice* renderDevice)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[bufferIndex];
+	SimpleDirtyRange& dirty = cb->DirtyRanges[threadSlot];
+	SimpleUploadStats& stats = uploadStats[threadSlot];
+	unsigned char* localData = GetLocalData(bufferIndex);
+	ID3D11DeviceContext* context = GetActiveContext();
+
+	unsigned int begin = 0;
+	unsigned int end = cb->Size;
+	if (threadSlot == 0 && cb->LastWriterSlot == 0)
+	{
+		if (dirty.Begin == dirty.End)
+		{
+			stats.CleanSkips++;
+			return;
+		}
+
+		// partial updates are in whole constants
+		begin = dirty.Begin / 16 * 16;
+		end = (dirty.End + 15) / 16 * 16;
+		if (end > cb->Size) end = cb->Size;
+	}
+
+	if (cb->Dynamic)
+	{
+		if (renderDevice)
+		{
+			if (!renderDevice->WriteDynamicBuffer(cb->ConstantBuffer, localData, cb->Size))
+				return;
+		}
+		else
+		{
+			D3D11_MAPPED_SUBRESOURCE mapped = {};
+			if (FAILED(context->Map(cb->ConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+				return;
+			memcpy(mapped.pData, localData, cb->Size);
+			context->Unmap(cb->ConstantBuffer, 0);
+		}
+		stats.DiscardMaps++;
+		stats.Bytes += cb->Size;
+	}
+	else if (partialUpdates && (end - begin) * 2 <= cb->Size)
+	{
+		if (renderDevice)
+			renderDevice->UpdateBufferRange(cb->ConstantBuffer, localData + begin, begin, end - begin);
+		else
+		{
+			D3D11_BOX box = { begin, 0, 0, end, 1, 1 };
+			context->UpdateSubresource(cb->ConstantBuffer, 0, &box, localData + begin, 0, 0);
+		}
+		stats.PartialUpdates++;
+		stats.Bytes += end - begin;
+	}
+	else
+	{
+		if (renderDevice)
+			renderDevice->UpdateBuffer(cb->ConstantBuffer, localData, cb->Size);
+		else
+			context->UpdateSubresource(cb->ConstantBuffer, 0, 0, localData, 0, 0);
+		stats.FullUpdates++;
+		stats.Bytes += cb->Size;
+	}
+
+	dirty.Begin = dirty.End = 0;
+	cb->LastWriterSlot = (int)threadSlot;
+	stats.Uploads++;
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer through the cache - its latest
+// ring allocation if it's still valid, a new one if not, or
+// the shader's own buffer when the device has no ring
+// --------------------------------------------------------
+void ISimpleShader::BindBufferData(unsigned int bufferIndex, StateCache* cache)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[bufferIndex];
+	RenderDevice* renderDevice = cache->GetDevice();
+
+	ConstantAllocation& allocation = cb->Allocations[threadSlot];
+	if (allocation.buffer && allocation.generation == renderDevice->GetConstantGeneration())
+	{
+		cache->SetConstantBufferRange(GetStage(), cb->BindIndex, allocation);
+		return;
+	}
+
+	if (renderDevice->AllocateConstants(GetLocalData(bufferIndex), cb->Size, allocation))
+	{
+		SimpleUploadStats& stats = uploadStats[threadSlot];
+		cb->DirtyRanges[threadSlot].Begin = cb->DirtyRanges[threadSlot].End = 0;
+		stats.Uploads++;
+		stats.RingAllocations++;
+		stats.Bytes += cb->Size;
+		cache->SetConstantBufferRange(GetStage(), cb->BindIndex, allocation);
+		return;
+	}
+
+	cache->SetConstantBuffer(GetStage(), cb->BindIndex, cb->ConstantBuffer);
+}
+
+// --------------------------------------------------------
+// Upload stats, summed over the context slots
+// --------------------------------------------------------
+SimpleUploadStats ISimpleShader::GetUploadStats()
+{
+	SimpleUploadStats total = {};
+	for (unsigned int i = 0; i < SIMPLE_SHADER_CONTEXT_SLOTS; i++)
+	{
+		const SimpleUploadStats& stats = uploadStats[i];
+		total.Uploads += stats.Uploads;
+		total.CleanSkips += stats.CleanSkips;
+		total.Bytes += stats.Bytes;
+		total.RingAllocations += stats.RingAllocations;
+		total.DiscardMaps += stats.DiscardMaps;
+		total.PartialUpdates += stats.PartialUpdates;
+		total.FullUpdates += stats.FullUpdates;
+	}
+	return total;
+}
+
+void ISimpleShader::ResetUploadStats()
+{
+	memset(uploadStats, 0, sizeof(uploadStats));
+}
+
 // --------------------------------------------------------
 // Cleans up the variable table and buffers - Some things will
 // be handled by derived classes
@@ -41,6 +307,8 @@ void ISimpleShader::CleanUp()
 	{
 		constantBuffers[i].ConstantBuffer->Release();
 		delete[] constantBuffers[i].LocalDataBuffer;
+		delete[] constantBuffers[i].Allocations;
+		delete[] constantBuffers[i].DirtyRanges;
 	}
 
 	if (constantBuffers)
@@ -49,11 +317,12 @@ void ISimpleShader::CleanUp()
 		constantBufferCount = 0;
 	}
 
-	for (unsigned int i = 0; i < shaderResourceViews.size(); i++)
-		delete shaderResourceViews[i];
-	
-	for (unsigned int i = 0; i < samplerStates.size(); i++)
-		delete samplerStates[i];
+	variables.clear();
+	shaderResourceViews.clear();
+	samplerStates.clear();
+
+	for (unsigned int i = 0; i < D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT; i++)
+		bufferIndexByRegister[i] = -1;
 
 	// Clean up tables
 	varTable.clear();
@@ -79,6 +348,31 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	return LoadShaderBlob();
+}
+
+// --------------------------------------------------------
+// Same as LoadShaderFile(), for compiled shader code that's
+// already in memory
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBytecode(const void* bytecode, size_t size)
+{
+	HRESULT hr = D3DCreateBlob(size, &shaderBlob);
+	if (hr != S_OK)
+	{
+		return false;
+	}
+	memcpy(shaderBlob->GetBufferPointer(), bytecode, size);
+
+	return LoadShaderBlob();
+}
+
+// --------------------------------------------------------
+// Creates the shader from the loaded blob and builds the
+// variable table using shader reflection
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBlob()
+{
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -101,8 +395,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	refl->GetDesc(&shaderDesc);
 
 	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+	CreateBufferTable(shaderDesc.ConstantBuffers);
 	
 	// Handle bound resources (like shaders and samplers)
 	unsigned int resourceCount = shaderDesc.BoundResources;
@@ -111,34 +404,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		// Get this resource's description
 		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
 		refl->GetResourceBindingDesc(r, &resourceDesc);
-
-		// Check the type
-		switch (resourceDesc.Type)
-		{
-		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
-			break;
-
-		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
-			break;
-		}
+		AddResource(resourceDesc.Name, resourceDesc.Type, resourceDesc.BindPoint);
 	}
 
 	// Loop through all constant buffers
@@ -151,34 +417,12 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		// Get the description of this buffer
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
-
-		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
 		
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
-		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
-
-		// Create this constant buffer
-		D3D11_BUFFER_DESC newBuffDesc;
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = bufferDesc.Size;
-		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
-		newBuffDesc.MiscFlags = 0;
-		newBuffDesc.StructureByteStride = 0;
-		device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
-
-		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		InitConstantBuffer(b, bufferDesc.Name, bufferDesc.Type, bufferDesc.Size, bindDesc.BindPoint);
 
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
@@ -190,19 +434,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			// Get the description of the variable and its type
 			D3D11_SHADER_VARIABLE_DESC varDesc;
 			var->GetDesc(&varDesc);
-
-			// Create the variable struct
-			SimpleShaderVariable varStruct;
-			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
-
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
-			constantBuffers[b].Variables.push_back(varStruct);
+			AddVariable(b, varDesc.Name, varDesc.StartOffset, varDesc.Size);
 		}
 	}
 
@@ -211,6 +443,178 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	return true;
 }
 
+// --------------------------------------------------------
+// Creates the shader from a shader pack - the same tables
+// LoadShaderBlob() builds, read from the pack's instead of
+// from reflection
+//
+// pack - An open pack, which can be shared by threads loading
+//        other shaders at the same time
+// name - The shader's name in the pack (its .cso's, without
+//        the extension)
+//
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderPacked(const ShaderPack* pack, const char* name)
+{
+	int index = pack->FindShader(name);
+	if (index < 0)
+		return false;
+	const ShaderPackShader& packed = pack->GetShader(index);
+
+	// The blob is kept like any other shader's, for whatever
+	// wants the bytecode later (like frame captures)
+	HRESULT hr = D3DCreateBlob(packed.bytecodeSize, &shaderBlob);
+	if (hr != S_OK)
+	{
+		return false;
+	}
+	memcpy(shaderBlob->GetBufferPointer(), pack->GetBytecode(packed), packed.bytecodeSize);
+
+	// CreateShader() looks at these to skip its own reflection
+	this->pack = pack;
+	this->packedShader = &packed;
+	shaderValid = CreateShader(shaderBlob);
+	if (shaderValid)
+	{
+		CreateBufferTable(packed.bufferCount);
+
+		const ShaderPackResource* resources = pack->GetResources() + packed.firstResource;
+		for (unsigned int r = 0; r < packed.resourceCount; r++)
+			AddResource(pack->GetString(resources[r].name), (D3D_SHADER_INPUT_TYPE)resources[r].type, resources[r].bindIndex);
+
+		const ShaderPackBuffer* buffers = pack->GetBuffers() + packed.firstBuffer;
+		for (unsigned int b = 0; b < packed.bufferCount; b++)
+		{
+			InitConstantBuffer(b, pack->GetString(buffers[b].name), (D3D_CBUFFER_TYPE)buffers[b].type, buffers[b].size, buffers[b].bindIndex);
+
+			const ShaderPackVariable* vars = pack->GetVariables() + buffers[b].firstVariable;
+			for (unsigned int v = 0; v < buffers[b].variableCount; v++)
+				AddVariable(b, pack->GetString(vars[v].name), vars[v].offset, vars[v].size);
+		}
+	}
+	this->pack = 0;
+	this->packedShader = 0;
+	return shaderValid;
+}
+
+// --------------------------------------------------------
+// Allocates the constant buffer array, before the buffers
+// are filled in by InitConstantBuffer()
+// --------------------------------------------------------
+void ISimpleShader::CreateBufferTable(unsigned int bufferCount)
+{
+	constantBufferCount = bufferCount;
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+
+	// Bigger buffers only update their dirty range, if the
+	// device can do that to a constant buffer
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	partialUpdates = SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferPartialUpdate;
+}
+
+// --------------------------------------------------------
+// Adds a bound resource to the SRV or sampler table - other
+// types (constant buffers, UAVs) are handled elsewhere
+// --------------------------------------------------------
+void ISimpleShader::AddResource(const char* name, D3D_SHADER_INPUT_TYPE type, unsigned int bindIndex)
+{
+	// Check the type
+	switch (type)
+	{
+	case D3D_SIT_TEXTURE: // A texture resource
+	case D3D_SIT_STRUCTURED:
+	case D3D_SIT_BYTEADDRESS:
+	{
+		// Create the SRV wrapper
+		SimpleSRV srv;
+		srv.BindIndex = bindIndex;								// Shader bind point
+		srv.Index = (unsigned int)shaderResourceViews.size();	// Raw index
+
+		textureTable.insert(std::pair<std::string, unsigned int>(name, srv.Index));
+		shaderResourceViews.push_back(srv);
+	}
+		break;
+
+	case D3D_SIT_SAMPLER: // A sampler resource
+	{
+		// Create the sampler wrapper
+		SimpleSampler samp;
+		samp.BindIndex = bindIndex;							// Shader bind point
+		samp.Index = (unsigned int)samplerStates.size();	// Raw index
+
+		samplerTable.insert(std::pair<std::string, unsigned int>(name, samp.Index));
+		samplerStates.push_back(samp);
+	}
+		break;
+	}
+}
+
+// --------------------------------------------------------
+// Sets up one constant buffer - its D3D buffer, and the
+// local data for every context slot
+// --------------------------------------------------------
+void ISimpleShader::InitConstantBuffer(unsigned int index, const char* name, D3D_CBUFFER_TYPE type, unsigned int size, unsigned int bindIndex)
+{
+	SimpleConstantBuffer& buffer = constantBuffers[index];
+
+	// Save the type, which we reference when setting these buffers
+	buffer.Type = type;
+
+	// Set up the buffer and put its pointer in the table
+	buffer.BindIndex = bindIndex;
+	buffer.Name = name;
+	cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(name, &buffer));
+	if (bindIndex < D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT)
+		bufferIndexByRegister[bindIndex] = index;
+
+	// Create this constant buffer - dynamic if it's always
+	// going to be written whole
+	buffer.Dynamic = !partialUpdates || size < SIMPLE_SHADER_PARTIAL_UPDATE_MIN_SIZE;
+	D3D11_BUFFER_DESC newBuffDesc;
+	newBuffDesc.Usage = buffer.Dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	newBuffDesc.ByteWidth = size;
+	newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	newBuffDesc.CPUAccessFlags = buffer.Dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	newBuffDesc.MiscFlags = 0;
+	newBuffDesc.StructureByteStride = 0;
+	device->CreateBuffer(&newBuffDesc, 0, &buffer.ConstantBuffer);
+
+	// Set up the data buffer for this constant buffer - one
+	// copy per context slot, back to back
+	buffer.Size = size;
+	buffer.LocalDataBuffer = new unsigned char[size * SIMPLE_SHADER_CONTEXT_SLOTS];
+	ZeroMemory(buffer.LocalDataBuffer, size * SIMPLE_SHADER_CONTEXT_SLOTS);
+	buffer.Allocations = new ConstantAllocation[SIMPLE_SHADER_CONTEXT_SLOTS]();
+
+	// Nothing's been uploaded yet, so every slot starts dirty
+	buffer.DirtyRanges = new SimpleDirtyRange[SIMPLE_SHADER_CONTEXT_SLOTS];
+	for (unsigned int i = 0; i < SIMPLE_SHADER_CONTEXT_SLOTS; i++)
+	{
+		buffer.DirtyRanges[i].Begin = 0;
+		buffer.DirtyRanges[i].End = size;
+	}
+	buffer.LastWriterSlot = -1;
+}
+
+// --------------------------------------------------------
+// Adds a variable to the table and to its constant buffer
+// --------------------------------------------------------
+void ISimpleShader::AddVariable(unsigned int bufferIndex, const char* name, unsigned int offset, unsigned int size)
+{
+	// Create the variable struct
+	SimpleShaderVariable varStruct;
+	varStruct.ConstantBufferIndex = bufferIndex;
+	varStruct.ByteOffset = offset;
+	varStruct.Size = size;
+
+	// Add this variable to the table and the constant buffer
+	varTable.insert(std::pair<std::string, unsigned int>(name, (unsigned int)variables.size()));
+	variables.push_back(varStruct);
+	constantBuffers[bufferIndex].Variables.push_back(varStruct);
+}
+
 // --------------------------------------------------------
 // Helper for looking up a variable by name and also
 // verifying that it is the requested size
@@ -221,15 +625,15 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
+	std::unordered_map<std::string, unsigned int>::iterator result =
 		varTable.find(name);
 
 	// Did we find the key?
 	if (result == varTable.end())
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	// Grab the variable the result points at
+	SimpleShaderVariable* var = &variables[result->second];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -273,6 +677,9 @@ void ISimpleShader::SetShader()
 // Copies the relevant data to the all of this 
 // shader's constant buffers.  To just copy one
 // buffer, use CopyBufferData()
+//
+// Buffers whose local data hasn't changed since they were
+// last copied are skipped
 // --------------------------------------------------------
 void ISimpleShader::CopyAllBufferData()
 {
@@ -282,10 +689,8 @@ void ISimpleShader::CopyAllBufferData()
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		// Copy the local data buffer, if it's dirty
+		UploadBufferData(i);
 	}
 }
 
@@ -314,9 +719,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBufferData(index);
 }
 
 // --------------------------------------------------------
@@ -336,9 +739,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBufferData((unsigned int)(cb - constantBuffers));
 }
 
 
@@ -364,15 +765,40 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	WriteLocalData(var->ConstantBufferIndex, var->ByteOffset, data, size);
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a whole constant buffer and uploads it
+//
+// bindIndex - The register the buffer is bound to
+// data - The buffer's entire contents
+// size - The size of the data, which must be the buffer's size
+//
+// Returns true if the buffer was written, false if there's no
+// buffer at that register or it's a different size
+// --------------------------------------------------------
+bool ISimpleShader::WriteBufferData(unsigned int bindIndex, const void* data, unsigned int size)
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return false;
+
+	if (bindIndex >= D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT)
+		return false;
+	int index = bufferIndexByRegister[bindIndex];
+	if (index < 0 || constantBuffers[index].Size != size)
+		return false;
+
+	// Into the local data, then the usual upload - which
+	// skips the buffer if nothing in it changed
+	WriteLocalData(index, 0, data, size);
+	UploadBufferData(index);
+	return true;
+}
+
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
@@ -461,6 +887,134 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 	return FindVariable(name, -1);
 }
 
+// --------------------------------------------------------
+// Resolves a variable's name into a handle for the Set*
+// overloads - an invalid handle if there's no such variable
+// --------------------------------------------------------
+ShaderVarHandle ISimpleShader::GetVariableHandle(const std::string& name)
+{
+	ShaderVarHandle handle;
+	std::unordered_map<std::string, unsigned int>::iterator result = varTable.find(name);
+	if (result != varTable.end())
+		handle.Index = (int)result->second;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Resolves an SRV's name into a handle (or an invalid one)
+// --------------------------------------------------------
+SrvSlotHandle ISimpleShader::GetShaderResourceViewHandle(const std::string& name)
+{
+	SrvSlotHandle handle;
+	std::unordered_map<std::string, unsigned int>::iterator result = textureTable.find(name);
+	if (result != textureTable.end())
+		handle.Index = (int)result->second;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Resolves a sampler's name into a handle (or an invalid one)
+// --------------------------------------------------------
+SamplerSlotHandle ISimpleShader::GetSamplerHandle(const std::string& name)
+{
+	SamplerSlotHandle handle;
+	std::unordered_map<std::string, unsigned int>::iterator result = samplerTable.find(name);
+	if (result != samplerTable.end())
+		handle.Index = (int)result->second;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable through a handle with arbitrary data
+//
+// handle - From GetVariableHandle() on this shader
+// data - The data to set in the buffer
+// size - The size of the data (this must be less than or equal to the variable's size)
+//
+// Returns true if data is copied, false if the handle is invalid
+// --------------------------------------------------------
+bool ISimpleShader::SetData(ShaderVarHandle handle, const void* data, unsigned int size)
+{
+	if (handle.Index < 0 || handle.Index >= (int)variables.size())
+		return false;
+
+	const SimpleShaderVariable& var = variables[handle.Index];
+	if (size > var.Size)
+		return false;
+
+	WriteLocalData(var.ConstantBufferIndex, var.ByteOffset, data, size);
+	return true;
+}
+
+bool ISimpleShader::SetInt(ShaderVarHandle handle, int data) { return SetData(handle, &data, sizeof(int)); }
+bool ISimpleShader::SetFloat(ShaderVarHandle handle, float data) { return SetData(handle, &data, sizeof(float)); }
+bool ISimpleShader::SetFloat2(ShaderVarHandle handle, const DirectX::XMFLOAT2& data) { return SetData(handle, &data, sizeof(float) * 2); }
+bool ISimpleShader::SetFloat3(ShaderVarHandle handle, const DirectX::XMFLOAT3& data) { return SetData(handle, &data, sizeof(float) * 3); }
+bool ISimpleShader::SetFloat4(ShaderVarHandle handle, const DirectX::XMFLOAT4& data) { return SetData(handle, &data, sizeof(float) * 4); }
+bool ISimpleShader::SetMatrix4x4(ShaderVarHandle handle, const DirectX::XMFLOAT4X4& data) { return SetData(handle, &data, sizeof(float) * 16); }
+
+// --------------------------------------------------------
+// Sets a shader resource view in this shader's stage
+//
+// name - The name of the texture resource in the shader
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if a texture of the given name was found, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
+{
+	return SetShaderResourceView(GetShaderResourceViewHandle(name), srv);
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view through a handle - returns
+// false if the handle is invalid
+// --------------------------------------------------------
+bool ISimpleShader::SetShaderResourceView(SrvSlotHandle handle, ID3D11ShaderResourceView* srv)
+{
+	if (handle.Index < 0 || handle.Index >= (int)shaderResourceViews.size())
+		return false;
+
+	unsigned int bindIndex = shaderResourceViews[handle.Index].BindIndex;
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+		cache->SetShaderResource(GetStage(), bindIndex, srv);
+	else
+		BindShaderResourceView(bindIndex, srv);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in this shader's stage
+//
+// name - The name of the sampler state in the shader
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if a sampler of the given name was found, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
+{
+	return SetSamplerState(GetSamplerHandle(name), samplerState);
+}
+
+// --------------------------------------------------------
+// Sets a sampler state through a handle - returns false if
+// the handle is invalid
+// --------------------------------------------------------
+bool ISimpleShader::SetSamplerState(SamplerSlotHandle handle, ID3D11SamplerState* samplerState)
+{
+	if (handle.Index < 0 || handle.Index >= (int)samplerStates.size())
+		return false;
+
+	unsigned int bindIndex = samplerStates[handle.Index].BindIndex;
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+		cache->SetSampler(GetStage(), bindIndex, samplerState);
+	else
+		BindSamplerState(bindIndex, samplerState);
+	return true;
+}
+
 // --------------------------------------------------------
 // Gets info about an SRV in the shader (or null)
 //
@@ -469,7 +1023,7 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleSRV*>::iterator result =
+	std::unordered_map<std::string, unsigned int>::iterator result =
 		textureTable.find(name);
 
 	// Did we find the key?
@@ -477,7 +1031,7 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
 		return 0;
 
 	// Success
-	return result->second;
+	return &shaderResourceViews[result->second];
 }
 
 
@@ -492,7 +1046,7 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 	if (index >= shaderResourceViews.size()) return 0;
 
 	// Grab the bind index
-	return shaderResourceViews[index];
+	return &shaderResourceViews[index];
 }
 
 
@@ -504,7 +1058,7 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleSampler*>::iterator result =
+	std::unordered_map<std::string, unsigned int>::iterator result =
 		samplerTable.find(name);
 
 	// Did we find the key?
@@ -512,7 +1066,7 @@ const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
 		return 0;
 
 	// Success
-	return result->second;
+	return &samplerStates[result->second];
 }
 
 // --------------------------------------------------------
@@ -526,7 +1080,7 @@ const SimpleSampler* ISimpleShader::GetSamplerInfo(unsigned int index)
 	if (index >= samplerStates.size()) return 0;
 
 	// Grab the bind index
-	return samplerStates[index];
+	return &samplerStates[index];
 }
 
 
@@ -582,19 +1136,47 @@ const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(unsigned int index)
 ///////////////////////////////////////////////////////////////////////////////
 
 // --------------------------------------------------------
-// Constructor just calls the base
+// Constructor just calls the base
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
+	: ISimpleShader(device, context) 
+{ 
+	// Ensure we set to zero to successfully trigger
+	// the Input Layout creation during LoadShaderFile()
+	this->inputLayout = 0;
+	this->shader = 0;
+	this->perInstanceCompatible = false;
+
+	// Load the actual compiled shader file
+	this->LoadShaderFile(shaderFile);
+}
+
+// --------------------------------------------------------
+// Constructor overload which takes compiled shader code
+// that's already in memory
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, const void* bytecode, size_t bytecodeSize)
+	: ISimpleShader(device, context)
+{
+	this->inputLayout = 0;
+	this->shader = 0;
+	this->perInstanceCompatible = false;
+
+	this->LoadShaderBytecode(bytecode, bytecodeSize);
+}
+
+// --------------------------------------------------------
+// Constructor overload which creates the shader from a
+// shader pack, with the input layout the pack describes
 // --------------------------------------------------------
-SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
-	: ISimpleShader(device, context) 
-{ 
-	// Ensure we set to zero to successfully trigger
-	// the Input Layout creation during LoadShaderFile()
+SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, const ShaderPack* pack, const char* name)
+	: ISimpleShader(device, context)
+{
 	this->inputLayout = 0;
 	this->shader = 0;
 	this->perInstanceCompatible = false;
 
-	// Load the actual compiled shader file
-	this->LoadShaderFile(shaderFile);
+	this->LoadShaderPacked(pack, name);
 }
 
 // --------------------------------------------------------
@@ -668,96 +1250,158 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 	// shader code to re-reflect and create an input layout that 
 	// matches what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
-
-	// Reflect shader info
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	if (packedShader)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
-		// Check the semantic name for "_PER_INSTANCE"
-		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
-		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
-		bool isPerInstance = 
-			lenDiff >= 0 &&
-			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
-
-		// Fill out input element desc
-		D3D11_INPUT_ELEMENT_DESC elementDesc;
-		elementDesc.SemanticName = paramDesc.SemanticName;
-		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
-		elementDesc.InputSlot = 0;
-		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-		elementDesc.InstanceDataStepRate = 0;
-
-		// Replace anything affected by "per instance" data
-		if (isPerInstance)
+		// A shader pack has the elements worked out already
+		const ShaderPackInputElement* elements = pack->GetInputElements() + packedShader->firstInputElement;
+		for (unsigned int i = 0; i < packedShader->inputElementCount; i++)
 		{
-			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
-			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
-			elementDesc.InstanceDataStepRate = 1;
-
-			perInstanceCompatible = true;
+			inputLayoutDesc.push_back(MakeInputElement(
+				pack->GetString(elements[i].semanticName),
+				elements[i].semanticIndex,
+				(DXGI_FORMAT)elements[i].format,
+				elements[i].perInstance != 0));
+			perInstanceCompatible = perInstanceCompatible || elements[i].perInstance != 0;
 		}
+	}
 
-		// Determine DXGI format
-		if (paramDesc.Mask == 1)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 3)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 7)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 15)
+	// Reflect shader info
+	ID3D11ShaderReflection* refl = 0;
+	if (!packedShader)
+	{
+		D3DReflect(
+			shaderBlob->GetBufferPointer(),
+			shaderBlob->GetBufferSize(),
+			IID_ID3D11ShaderReflection,
+			(void**)&refl);
+
+		// Get shader info
+		D3D11_SHADER_DESC shaderDesc;
+		refl->GetDesc(&shaderDesc);
+
+		// Read input layout description from shader info
+		for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+			D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+			refl->GetInputParameterDesc(i, &paramDesc);
+
+			// Check the semantic name for "_PER_INSTANCE"
+			bool isPerInstance = IsPerInstanceSemantic(paramDesc.SemanticName);
+			perInstanceCompatible = perInstanceCompatible || isPerInstance;
+
+			// Save element desc - the semantic name points into the
+			// reflection, which is kept until the layout's created
+			inputLayoutDesc.push_back(MakeInputElement(
+				paramDesc.SemanticName,
+				paramDesc.SemanticIndex,
+				GetInputFormat(paramDesc),
+				isPerInstance));
 		}
-
-		// Save element desc
-		inputLayoutDesc.push_back(elementDesc);
 	}
 
-	// Try to create Input Layout
-	HRESULT hr = device->CreateInputLayout(
-		&inputLayoutDesc[0], 
-		(unsigned int)inputLayoutDesc.size(), 
-		shaderBlob->GetBufferPointer(), 
-		shaderBlob->GetBufferSize(),
-		&inputLayout);
+	// Try to create Input Layout - through the cache when there is one,
+	// so shaders with the same inputs share it (with a reference each)
+	if (!inputLayoutDesc.empty() && stateObjects)
+	{
+		inputLayout = stateObjects->GetInputLayout(
+			&inputLayoutDesc[0],
+			(unsigned int)inputLayoutDesc.size(),
+			shaderBlob->GetBufferPointer(),
+			shaderBlob->GetBufferSize());
+		if (inputLayout)
+			inputLayout->AddRef();
+	}
+	else if (!inputLayoutDesc.empty())
+	{
+		device->CreateInputLayout(
+			&inputLayoutDesc[0], 
+			(unsigned int)inputLayoutDesc.size(), 
+			shaderBlob->GetBufferPointer(), 
+			shaderBlob->GetBufferSize(),
+			&inputLayout);
+	}
 
 	// All done, clean up
-	refl->Release();
+	if (refl)
+		refl->Release();
 	return true;
 }
 
+// --------------------------------------------------------
+// Whether an input's semantic ends in "_PER_INSTANCE", which
+// makes it per instance data from input slot 1
+// --------------------------------------------------------
+bool SimpleVertexShader::IsPerInstanceSemantic(const char* semanticName)
+{
+	std::string perInstanceStr = "_PER_INSTANCE";
+	std::string sem = semanticName;
+	int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
+	return
+		lenDiff >= 0 &&
+		sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+}
+
+// --------------------------------------------------------
+// The DXGI format matching an input's component count and
+// type, or DXGI_FORMAT_UNKNOWN if there isn't one
+// --------------------------------------------------------
+DXGI_FORMAT SimpleVertexShader::GetInputFormat(const D3D11_SIGNATURE_PARAMETER_DESC& paramDesc)
+{
+	// Determine DXGI format
+	if (paramDesc.Mask == 1)
+	{
+		if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) return DXGI_FORMAT_R32_UINT;
+		else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) return DXGI_FORMAT_R32_SINT;
+		else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) return DXGI_FORMAT_R32_FLOAT;
+	}
+	else if (paramDesc.Mask <= 3)
+	{
+		if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) return DXGI_FORMAT_R32G32_UINT;
+		else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) return DXGI_FORMAT_R32G32_SINT;
+		else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) return DXGI_FORMAT_R32G32_FLOAT;
+	}
+	else if (paramDesc.Mask <= 7)
+	{
+		if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) return DXGI_FORMAT_R32G32B32_UINT;
+		else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) return DXGI_FORMAT_R32G32B32_SINT;
+		else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) return DXGI_FORMAT_R32G32B32_FLOAT;
+	}
+	else if (paramDesc.Mask <= 15)
+	{
+		if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) return DXGI_FORMAT_R32G32B32A32_UINT;
+		else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) return DXGI_FORMAT_R32G32B32A32_SINT;
+		else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+// --------------------------------------------------------
+// Fills out an input element desc - per vertex data comes
+// from input slot 0, per instance data from slot 1
+// --------------------------------------------------------
+D3D11_INPUT_ELEMENT_DESC SimpleVertexShader::MakeInputElement(const char* semanticName, unsigned int semanticIndex, DXGI_FORMAT format, bool perInstance)
+{
+	// Fill out input element desc
+	D3D11_INPUT_ELEMENT_DESC elementDesc;
+	elementDesc.SemanticName = semanticName;
+	elementDesc.SemanticIndex = semanticIndex;
+	elementDesc.Format = format;
+	elementDesc.InputSlot = 0;
+	elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+	elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	elementDesc.InstanceDataStepRate = 0;
+
+	// Replace anything affected by "per instance" data
+	if (perInstance)
+	{
+		elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
+		elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		elementDesc.InstanceDataStepRate = 1;
+	}
+	return elementDesc;
+}
+
 // --------------------------------------------------------
 // Sets the vertex shader, input layout and constant buffers
 // for future DirectX drawing
@@ -767,9 +1411,18 @@ void SimpleVertexShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
-	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout);
-	deviceContext->VSSetShader(shader, 0, 0);
+	// Set the shader and input layout, through the state cache if there is one
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+	{
+		cache->SetInputLayout(inputLayout);
+		cache->SetShader(SHADER_STAGE_VERTEX, shader);
+	}
+	else
+	{
+		GetActiveContext()->IASetInputLayout(inputLayout);
+		GetActiveContext()->VSSetShader(shader, 0, 0);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -779,55 +1432,32 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			BindBufferData(i, cache);
+		else
+			GetActiveContext()->VSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
-// Sets a shader resource view in the vertex shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
+// Binds a shader resource view in the vertex shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+void SimpleVertexShader::BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
+	GetActiveContext()->VSSetShaderResources(bindIndex, 1, &srv);
 }
 
 // --------------------------------------------------------
-// Sets a sampler state in the vertex shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
+// Binds a sampler state in the vertex shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+void SimpleVertexShader::BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
+	GetActiveContext()->VSSetSamplers(bindIndex, 1, &samplerState);
 }
 
 
@@ -847,6 +1477,18 @@ SimplePixelShader::SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext*
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload which creates the shader from a
+// shader pack
+// --------------------------------------------------------
+SimplePixelShader::SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context, const ShaderPack* pack, const char* name)
+	: ISimpleShader(device, context)
+{
+	this->shader = 0;
+
+	this->LoadShaderPacked(pack, name);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -897,8 +1539,12 @@ void SimplePixelShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 	
-	// Set the shader
-	deviceContext->PSSetShader(shader, 0, 0);
+	// Set the shader, through the state cache if there is one
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+		cache->SetShader(SHADER_STAGE_PIXEL, shader);
+	else
+		GetActiveContext()->PSSetShader(shader, 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -908,55 +1554,32 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			BindBufferData(i, cache);
+		else
+			GetActiveContext()->PSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
-// Sets a shader resource view in the pixel shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
+// Binds a shader resource view in the pixel shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+void SimplePixelShader::BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
+	GetActiveContext()->PSSetShaderResources(bindIndex, 1, &srv);
 }
 
 // --------------------------------------------------------
-// Sets a sampler state in the pixel shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
+// Binds a sampler state in the pixel shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+void SimplePixelShader::BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
+	GetActiveContext()->PSSetSamplers(bindIndex, 1, &samplerState);
 }
 
 
@@ -1028,8 +1651,12 @@ void SimpleDomainShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
-	// Set the shader
-	deviceContext->DSSetShader(shader, 0, 0);
+	// Set the shader, through the state cache if there is one
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+		cache->SetShader(SHADER_STAGE_DOMAIN, shader);
+	else
+		GetActiveContext()->DSSetShader(shader, 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1039,55 +1666,32 @@ void SimpleDomainShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			BindBufferData(i, cache);
+		else
+			GetActiveContext()->DSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
-// Sets a shader resource view in the domain shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
+// Binds a shader resource view in the domain shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+void SimpleDomainShader::BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
+	GetActiveContext()->DSSetShaderResources(bindIndex, 1, &srv);
 }
 
 // --------------------------------------------------------
-// Sets a sampler state in the domain shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
+// Binds a sampler state in the domain shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+void SimpleDomainShader::BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
+	GetActiveContext()->DSSetSamplers(bindIndex, 1, &samplerState);
 }
 
 
@@ -1158,8 +1762,12 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
-	// Set the shader
-	deviceContext->HSSetShader(shader, 0, 0);
+	// Set the shader, through the state cache if there is one
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+		cache->SetShader(SHADER_STAGE_HULL, shader);
+	else
+		GetActiveContext()->HSSetShader(shader, 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1169,55 +1777,32 @@ void SimpleHullShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			BindBufferData(i, cache);
+		else
+			GetActiveContext()->HSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
-// Sets a shader resource view in the hull shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
+// Binds a shader resource view in the hull shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+void SimpleHullShader::BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
+	GetActiveContext()->HSSetShaderResources(bindIndex, 1, &srv);
 }
 
 // --------------------------------------------------------
-// Sets a sampler state in the hull shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
+// Binds a sampler state in the hull shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+void SimpleHullShader::BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
+	GetActiveContext()->HSSetSamplers(bindIndex, 1, &samplerState);
 }
 
 
@@ -1411,8 +1996,12 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
-	// Set the shader
-	deviceContext->GSSetShader(shader, 0, 0);
+	// Set the shader, through the state cache if there is one
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+		cache->SetShader(SHADER_STAGE_GEOMETRY, shader);
+	else
+		GetActiveContext()->GSSetShader(shader, 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1422,55 +2011,32 @@ void SimpleGeometryShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			BindBufferData(i, cache);
+		else
+			GetActiveContext()->GSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
 // --------------------------------------------------------
-// Sets a shader resource view in the Geometry shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
+// Binds a shader resource view in the geometry shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+void SimpleGeometryShader::BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
+	GetActiveContext()->GSSetShaderResources(bindIndex, 1, &srv);
 }
 
 // --------------------------------------------------------
-// Sets a sampler state in the Geometry shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
+// Binds a sampler state in the geometry shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+void SimpleGeometryShader::BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
+	GetActiveContext()->GSSetSamplers(bindIndex, 1, &samplerState);
 }
 
 // --------------------------------------------------------
@@ -1512,6 +2078,22 @@ SimpleComputeShader::SimpleComputeShader(ID3D11Device* device, ID3D11DeviceConte
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload which creates the shader from a
+// shader pack, with its thread group size and UAVs
+// --------------------------------------------------------
+SimpleComputeShader::SimpleComputeShader(ID3D11Device* device, ID3D11DeviceContext* context, const ShaderPack* pack, const char* name)
+	: ISimpleShader(device, context)
+{
+	this->threadsTotal = 0;
+	this->threadsX = 0;
+	this->threadsY = 0;
+	this->threadsZ = 0;
+	this->shader = 0;
+
+	this->LoadShaderPacked(pack, name);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -1555,6 +2137,23 @@ bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
 	if (result != S_OK)
 		return false;
 
+	// A shader pack has the thread info and resources already
+	if (packedShader)
+	{
+		threadsX = packedShader->threadGroupSize[0];
+		threadsY = packedShader->threadGroupSize[1];
+		threadsZ = packedShader->threadGroupSize[2];
+		threadsTotal = threadsX * threadsY * threadsZ;
+
+		const ShaderPackResource* resources = pack->GetResources() + packedShader->firstResource;
+		for (unsigned int r = 0; r < packedShader->resourceCount; r++)
+		{
+			if (IsUnorderedAccessType((D3D_SHADER_INPUT_TYPE)resources[r].type))
+				uavTable.insert(std::pair<std::string, unsigned int>(pack->GetString(resources[r].name), resources[r].bindIndex));
+		}
+		return true;
+	}
+
 	// Set up shader reflection to get information about UAV's
 	ID3D11ShaderReflection* refl;
 	D3DReflect(
@@ -1582,16 +2181,8 @@ bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
 		refl->GetResourceBindingDesc(r, &resourceDesc);
 
 		// Check the type, looking for any kind of UAV
-		switch (resourceDesc.Type)
-		{
-		case D3D_SIT_UAV_APPEND_STRUCTURED:
-		case D3D_SIT_UAV_CONSUME_STRUCTURED:
-		case D3D_SIT_UAV_RWBYTEADDRESS:
-		case D3D_SIT_UAV_RWSTRUCTURED:
-		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
-		case D3D_SIT_UAV_RWTYPED:
+		if (IsUnorderedAccessType(resourceDesc.Type))
 			uavTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
-		}
 	}
 
 	// All set
@@ -1599,6 +2190,24 @@ bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
 	return true;
 }
 
+// --------------------------------------------------------
+// Whether a bound resource is any kind of UAV
+// --------------------------------------------------------
+bool SimpleComputeShader::IsUnorderedAccessType(D3D_SHADER_INPUT_TYPE type)
+{
+	switch (type)
+	{
+	case D3D_SIT_UAV_APPEND_STRUCTURED:
+	case D3D_SIT_UAV_CONSUME_STRUCTURED:
+	case D3D_SIT_UAV_RWBYTEADDRESS:
+	case D3D_SIT_UAV_RWSTRUCTURED:
+	case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
+	case D3D_SIT_UAV_RWTYPED:
+		return true;
+	}
+	return false;
+}
+
 // --------------------------------------------------------
 // Sets the Compute shader and constant buffers for
 // future DirectX drawing
@@ -1608,8 +2217,12 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
-	// Set the shader
-	deviceContext->CSSetShader(shader, 0, 0);
+	// Set the shader, through the state cache if there is one
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+		cache->SetShader(SHADER_STAGE_COMPUTE, shader);
+	else
+		GetActiveContext()->CSSetShader(shader, 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1619,10 +2232,13 @@ void SimpleComputeShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			BindBufferData(i, cache);
+		else
+			GetActiveContext()->CSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
@@ -1648,7 +2264,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 // --------------------------------------------------------
 void SimpleComputeShader::DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
 {
-	deviceContext->Dispatch(groupsX, groupsY, groupsZ);
+	GetActiveContext()->Dispatch(groupsX, groupsY, groupsZ);
 }
 
 // --------------------------------------------------------
@@ -1673,54 +2289,28 @@ void SimpleComputeShader::DispatchByGroups(unsigned int groupsX, unsigned int gr
 // --------------------------------------------------------
 void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ)
 {
-	deviceContext->Dispatch(
+	GetActiveContext()->Dispatch(
 		max((unsigned int)ceil((float)threadsX / this->threadsX), 1),
 		max((unsigned int)ceil((float)threadsY / this->threadsY), 1),
 		max((unsigned int)ceil((float)threadsZ / this->threadsZ), 1));
 }
 
 // --------------------------------------------------------
-// Sets a shader resource view in the Compute shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
+// Binds a shader resource view in the compute shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+void SimpleComputeShader::BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
+	GetActiveContext()->CSSetShaderResources(bindIndex, 1, &srv);
 }
 
 // --------------------------------------------------------
-// Sets a sampler state in the Compute shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
+// Binds a sampler state in the compute shader stage,
+// straight through the context
 // --------------------------------------------------------
-bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+void SimpleComputeShader::BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
+	GetActiveContext()->CSSetSamplers(bindIndex, 1, &samplerState);
 }
 
 // --------------------------------------------------------
@@ -1740,7 +2330,12 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11Unorder
 		return false;
 
 	// Set the shader resource view
-	deviceContext->CSSetUnorderedAccessViews(bindIndex, 1, &uav, &appendConsumeOffset);
+	GetActiveContext()->CSSetUnorderedAccessViews(bindIndex, 1, &uav, &appendConsumeOffset);
+
+	// A UAV bind unbinds any SRV of the same resource without the cache knowing
+	StateCache* cache = GetContextStateCache();
+	if (cache)
+		cache->InvalidateShaderResources();
 
 	// Success
 	return true;
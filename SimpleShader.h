@@ -6,10 +6,30 @@
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include <string>
 
+#include "StateCache.h"
+#include "StateObjectCache.h"
+#include "ShaderPack.h"
+
+// --------------------------------------------------------
+// How many contexts can record with the same shader at
+// once - each one gets its own copy of the local constant
+// buffer data. Slot 0 belongs to the shader's own context
+// --------------------------------------------------------
+#define SIMPLE_SHADER_CONTEXT_SLOTS 8
+
+// --------------------------------------------------------
+// Constant buffers smaller than this are dynamic and always
+// rewritten whole with Map/DISCARD - bigger ones are default
+// usage, and only their dirty range is updated when the
+// device has D3D11.1 partial constant buffer updates
+// --------------------------------------------------------
+#define SIMPLE_SHADER_PARTIAL_UPDATE_MIN_SIZE 256
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -21,6 +41,16 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// --------------------------------------------------------
+// The bytes of a local data buffer that changed since it
+// was last uploaded, [Begin, End) - clean when they're equal
+// --------------------------------------------------------
+struct SimpleDirtyRange
+{
+	unsigned int Begin;
+	unsigned int End;
+};
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -33,10 +63,29 @@ struct SimpleConstantBuffer
 	unsigned int Size;
 	unsigned int BindIndex;
 	ID3D11Buffer* ConstantBuffer = 0;
+	bool Dynamic = false;				// written with Map/DISCARD, not UpdateSubresource
 	unsigned char* LocalDataBuffer = 0;
+	ConstantAllocation* Allocations = 0; // latest ring allocation, per context slot
+	SimpleDirtyRange* DirtyRanges = 0;	// per context slot
+	std::atomic<int> LastWriterSlot;	// the slot that last wrote ConstantBuffer, or -1
 	std::vector<SimpleShaderVariable> Variables;
 };
 
+// --------------------------------------------------------
+// What a shader's constant buffer uploads did since its
+// stats were last reset
+// --------------------------------------------------------
+struct SimpleUploadStats
+{
+	unsigned int Uploads;			// buffers that were written
+	unsigned int CleanSkips;		// buffers that weren't, as nothing changed
+	unsigned int Bytes;				// bytes written for the GPU
+	unsigned int RingAllocations;	// uploads to the constant ring
+	unsigned int DiscardMaps;		// own buffer uploads with Map/DISCARD
+	unsigned int PartialUpdates;	// ... with UpdateSubresource of a range
+	unsigned int FullUpdates;		// ... with UpdateSubresource of it all
+};
+
 // --------------------------------------------------------
 // Contains info about a single SRV in a shader
 // --------------------------------------------------------
@@ -55,6 +104,16 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// --------------------------------------------------------
+// Names resolved once into indices, so sets in a hot loop
+// skip the string, hash and map probe of the named ones.
+// A handle only works with the shader it came from - the
+// default (-1) makes sets fail like an unknown name would
+// --------------------------------------------------------
+struct ShaderVarHandle { int Index = -1; };
+struct SrvSlotHandle { int Index = -1; };
+struct SamplerSlotHandle { int Index = -1; };
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
@@ -76,6 +135,16 @@ public:
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
 
+	// Sets and uploads a whole constant buffer from its struct in
+	// ShaderStructs.h - found by register, so there are no lookups by
+	// name, and the struct is checked against the shader at compile time
+	template<typename T> bool WriteBufferData(const T& data)
+	{
+		static_assert(sizeof(T) == T::Size, "WriteBufferData needs a struct from ShaderStructs.h");
+		return WriteBufferData(T::Register, &data, sizeof(T));
+	}
+	bool WriteBufferData(unsigned int bindIndex, const void* data, unsigned int size);
+
 	bool SetInt(std::string name, int data);
 	bool SetFloat(std::string name, float data);
 	bool SetFloat2(std::string name, const float data[2]);
@@ -87,20 +156,36 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
-	// Setting shader resources
-	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
-	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
+	// Resolving names into handles, once, for the overloads below
+	ShaderVarHandle GetVariableHandle(const std::string& name);
+	SrvSlotHandle GetShaderResourceViewHandle(const std::string& name);
+	SamplerSlotHandle GetSamplerHandle(const std::string& name);
+
+	// Sets shader data through a handle
+	bool SetData(ShaderVarHandle handle, const void* data, unsigned int size);
+	bool SetInt(ShaderVarHandle handle, int data);
+	bool SetFloat(ShaderVarHandle handle, float data);
+	bool SetFloat2(ShaderVarHandle handle, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(ShaderVarHandle handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(ShaderVarHandle handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(ShaderVarHandle handle, const DirectX::XMFLOAT4X4& data);
+
+	// Setting shader resources, by name or handle
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetShaderResourceView(SrvSlotHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
+	bool SetSamplerState(SamplerSlotHandle handle, ID3D11SamplerState* samplerState);
 
 	// Getting data about variables and resources
 	const SimpleShaderVariable* GetVariableInfo(std::string name);
 	
 	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
-	size_t GetShaderResourceViewCount() { return textureTable.size(); }
+	size_t GetShaderResourceViewCount() { return shaderResourceViews.size(); }
 	
 	const SimpleSampler* GetSamplerInfo(std::string name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
-	size_t GetSamplerCount() { return samplerTable.size(); }
+	size_t GetSamplerCount() { return samplerStates.size(); }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
@@ -111,6 +196,26 @@ public:
 	// Misc getters
 	ID3DBlob* GetShaderBlob() { return shaderBlob; }
 
+	// Upload stats, summed over every context slot - reset them
+	// once a frame (with no recording going on) for per frame ones
+	SimpleUploadStats GetUploadStats();
+	void ResetUploadStats();
+
+	// Optional cache every shader binds through, shared by all shaders
+	// but set per thread. Only used when it wraps the context the
+	// shader is currently binding to
+	static void SetStateCache(StateCache* cache) { stateCache = cache; }
+	static StateCache* GetStateCache() { return stateCache; }
+
+	// Optional cache vertex shaders get their input layouts from, so
+	// shaders with the same inputs share one. Shared by all threads
+	static void SetStateObjectCache(StateObjectCache* cache) { stateObjects = cache; }
+
+	// Redirects the calling thread's binds, copies and local data to
+	// another context (a deferred one) and its own data slot.
+	// Pass null to go back to each shader's own context and slot 0
+	static void SetThreadContext(ID3D11DeviceContext* context, unsigned int slot);
+
 protected:
 	
 	bool shaderValid;
@@ -121,17 +226,75 @@ protected:
 	// Resource counts
 	unsigned int constantBufferCount;
 	
-	// Maps for variables and buffers
+	// Flat arrays for variables and resources, which handles
+	// index, and maps from names into them
 	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
-	std::vector<SimpleSRV*>		shaderResourceViews;
-	std::vector<SimpleSampler*>	samplerStates;
+	std::vector<SimpleShaderVariable>	variables;
+	std::vector<SimpleSRV>		shaderResourceViews;
+	std::vector<SimpleSampler>	samplerStates;
 	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
-	std::unordered_map<std::string, SimpleSRV*> textureTable;
-	std::unordered_map<std::string, SimpleSampler*> samplerTable;
+	std::unordered_map<std::string, unsigned int> varTable;
+	std::unordered_map<std::string, unsigned int> textureTable;
+	std::unordered_map<std::string, unsigned int> samplerTable;
+
+	// Buffer index for each register, -1 if nothing is bound there
+	int bufferIndexByRegister[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+
+	// Whether the device can update part of a constant buffer
+	bool partialUpdates;
+
+	// Per context slot, so recording threads don't share counters
+	SimpleUploadStats uploadStats[SIMPLE_SHADER_CONTEXT_SLOTS];
+
+	static thread_local StateCache* stateCache;
+	static StateObjectCache* stateObjects;
+	static thread_local ID3D11DeviceContext* threadContext;
+	static thread_local unsigned int threadSlot;
+
+	// The context the calling thread is recording into
+	ID3D11DeviceContext* GetActiveContext();
 
-	// Initialization method
+	// The calling thread's copy of a constant buffer's local data
+	unsigned char* GetLocalData(unsigned int bufferIndex);
+
+	// The thread's cache if it wraps the active context, otherwise null
+	StateCache* GetContextStateCache();
+
+	// Copies data into the calling thread's local data, growing
+	// the buffer's dirty range by the bytes that actually changed
+	void WriteLocalData(unsigned int bufferIndex, unsigned int offset, const void* data, unsigned int size);
+
+	// Uploads a constant buffer's local data if it's dirty, through
+	// the cache's render device when there is one
+	void UploadBufferData(unsigned int bufferIndex);
+	void UpdateOwnBuffer(unsigned int bufferIndex, RenderDevice* renderDevice);
+	void BindBufferData(unsigned int bufferIndex, StateCache* cache);
+
+	// The stage this shader runs in, and its D3D object
+	virtual int GetStage() = 0;
+	virtual ID3D11DeviceChild* GetStageShader() = 0;
+
+	// Binds straight through the active context, when there's
+	// no state cache for it
+	virtual void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv) = 0;
+	virtual void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState) = 0;
+
+	// Initialization methods
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadShaderBytecode(const void* bytecode, size_t size);
+	bool LoadShaderBlob();
+	bool LoadShaderPacked(const ShaderPack* pack, const char* name);
+
+	// Filling in the tables, from reflection or a shader pack
+	void CreateBufferTable(unsigned int bufferCount);
+	void AddResource(const char* name, D3D_SHADER_INPUT_TYPE type, unsigned int bindIndex);
+	void InitConstantBuffer(unsigned int index, const char* name, D3D_CBUFFER_TYPE type, unsigned int size, unsigned int bindIndex);
+	void AddVariable(unsigned int bufferIndex, const char* name, unsigned int offset, unsigned int size);
+
+	// Set while the shader is created from a pack, so CreateShader()
+	// can read what it would otherwise reflect
+	const ShaderPack* pack;
+	const ShaderPackShader* packedShader;
 
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(ID3DBlob* shaderBlob) = 0;
@@ -151,16 +314,26 @@ class SimpleVertexShader : public ISimpleShader
 {
 public:
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
+	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, const void* bytecode, size_t bytecodeSize);
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile, ID3D11InputLayout* inputLayout, bool perInstanceCompatible);
+	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, const ShaderPack* pack, const char* name);
 	~SimpleVertexShader();
 	ID3D11VertexShader* GetDirectXShader() { return shader; }
 	ID3D11InputLayout* GetInputLayout() { return inputLayout; }
 	bool GetPerInstanceCompatible() { return perInstanceCompatible; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	// How an input in the shader's signature becomes an input
+	// element - shared with the shader pack builder
+	static bool IsPerInstanceSemantic(const char* semanticName);
+	static DXGI_FORMAT GetInputFormat(const D3D11_SIGNATURE_PARAMETER_DESC& paramDesc);
+	static D3D11_INPUT_ELEMENT_DESC MakeInputElement(const char* semanticName, unsigned int semanticIndex, DXGI_FORMAT format, bool perInstance);
+
 
 protected:
+	int GetStage() { return SHADER_STAGE_VERTEX; }
+	void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv);
+	void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState);
+	ID3D11DeviceChild* GetStageShader() { return shader; }
 	bool perInstanceCompatible;
 	ID3D11InputLayout* inputLayout;
 	ID3D11VertexShader* shader;
@@ -177,13 +350,16 @@ class SimplePixelShader : public ISimpleShader
 {
 public:
 	SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
+	SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context, const ShaderPack* pack, const char* name);
 	~SimplePixelShader();
 	ID3D11PixelShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
 
 protected:
+	int GetStage() { return SHADER_STAGE_PIXEL; }
+	void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv);
+	void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState);
+	ID3D11DeviceChild* GetStageShader() { return shader; }
 	ID3D11PixelShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
@@ -200,10 +376,12 @@ public:
 	~SimpleDomainShader();
 	ID3D11DomainShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
 
 protected:
+	int GetStage() { return SHADER_STAGE_DOMAIN; }
+	void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv);
+	void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState);
+	ID3D11DeviceChild* GetStageShader() { return shader; }
 	ID3D11DomainShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
@@ -220,10 +398,12 @@ public:
 	~SimpleHullShader();
 	ID3D11HullShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
 
 protected:
+	int GetStage() { return SHADER_STAGE_HULL; }
+	void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv);
+	void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState);
+	ID3D11DeviceChild* GetStageShader() { return shader; }
 	ID3D11HullShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
@@ -240,14 +420,16 @@ public:
 	~SimpleGeometryShader();
 	ID3D11GeometryShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount);
 
 	static void UnbindStreamOutStage(ID3D11DeviceContext* deviceContext);
 
 protected:
+	int GetStage() { return SHADER_STAGE_GEOMETRY; }
+	void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv);
+	void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState);
+	ID3D11DeviceChild* GetStageShader() { return shader; }
 	// Shader itself
 	ID3D11GeometryShader* shader;
 
@@ -273,19 +455,22 @@ class SimpleComputeShader : public ISimpleShader
 {
 public:
 	SimpleComputeShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
+	SimpleComputeShader(ID3D11Device* device, ID3D11DeviceContext* context, const ShaderPack* pack, const char* name);
 	~SimpleComputeShader();
 	ID3D11ComputeShader* GetDirectXShader() { return shader; }
 
 	void DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
 	void DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ);
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
 	bool SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
 
 protected:
+	int GetStage() { return SHADER_STAGE_COMPUTE; }
+	void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv);
+	void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState);
+	ID3D11DeviceChild* GetStageShader() { return shader; }
 	ID3D11ComputeShader* shader;
 	std::unordered_map<std::string, unsigned int> uavTable;
 
@@ -294,6 +479,7 @@ protected:
 	unsigned int threadsZ;
 	unsigned int threadsTotal;
 
+	static bool IsUnorderedAccessType(D3D_SHADER_INPUT_TYPE type);
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
 	void CleanUp();
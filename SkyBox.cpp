@@ -1,77 +1,81 @@
 #include "SkyBox.h"
+#include "ShaderStructs.h"
 
 using namespace DirectX;
 
-SkyBox::SkyBox(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, std::wstring filePath, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS)
+SkyBox::SkyBox(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, StateObjectCache* stateObjects, std::wstring filePath, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS)
 {
     // create the SRV from the dds texture file
     CreateDDSTextureFromFile(device.Get(), filePath.c_str(), nullptr, skySRV.GetAddressOf());
 
     // set the common constructor values
-    SetGeneralParamaters(p_skyMesh, p_skySS, device, p_skyVS, p_skyPS);
+    SetGeneralParamaters(p_skyMesh, p_skySS, stateObjects, p_skyVS, p_skyPS);
 }
 
-SkyBox::SkyBox(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS, std::wstring filePath_right, std::wstring filePath_left, std::wstring filePath_up, std::wstring filePath_down, std::wstring filePath_front, std::wstring filePath_back)
+SkyBox::SkyBox(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, StateObjectCache* stateObjects, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS, std::wstring filePath_right, std::wstring filePath_left, std::wstring filePath_up, std::wstring filePath_down, std::wstring filePath_front, std::wstring filePath_back)
 {
     // create a cube map and get the SRV
     skySRV = CreateCubemap(device, context, filePath_right.c_str(), filePath_left.c_str(), filePath_up.c_str(), filePath_down.c_str(), filePath_front.c_str(), filePath_back.c_str());
 
     // set the common constructor values
-    SetGeneralParamaters(p_skyMesh, p_skySS, device, p_skyVS, p_skyPS);
+    SetGeneralParamaters(p_skyMesh, p_skySS, stateObjects, p_skyVS, p_skyPS);
 }
 
-void SkyBox::SetGeneralParamaters(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS)
+void SkyBox::SetGeneralParamaters(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, StateObjectCache* stateObjects, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS)
 {
     skyMesh = p_skyMesh;
     skySS = p_skySS;
 
-    // generate rasterizer state description and pass it through device to create it
+    // generate rasterizer state description and get the shared state for it
     D3D11_RASTERIZER_DESC rd = {};
     rd.FillMode = D3D11_FILL_SOLID;
     rd.CullMode = D3D11_CULL_FRONT;
-    device->CreateRasterizerState(&rd, skyRS.GetAddressOf());
+    skyRS = stateObjects->GetRasterizerState(rd);
 
-    // generate depth-stencil description and pass through device to create it.
+    // generate depth-stencil description and get the shared state for it
     D3D11_DEPTH_STENCIL_DESC dsd = {};
     dsd.DepthEnable = true;
     dsd.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-    device->CreateDepthStencilState(&dsd, skyDS.GetAddressOf());
+    skyDS = stateObjects->GetDepthStencilState(dsd);
 
     skyVS = p_skyVS;
     skyPS = p_skyPS;
+    skySamplerHandle = skyPS->GetSamplerHandle("samplerOptions");
+    skyTextureHandle = skyPS->GetShaderResourceViewHandle("skyTexture");
 }
 
-void SkyBox::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* camera)
+void SkyBox::Draw(StateCache* stateCache, Camera* camera)
 {
     // Change the render states
-    context->RSSetState(skyRS.Get());
-    context->OMSetDepthStencilState(skyDS.Get(), 0);
+    stateCache->SetRasterizerState(skyRS.Get());
+    stateCache->SetDepthStencilState(skyDS.Get(), 0);
 
     // Prepare the sky-specific shaders, pass SamplerState and SRV, pass view and projection matrices
     skyVS->SetShader();
     skyPS->SetShader();
 
-    skyPS->SetSamplerState("samplerOptions", skySS.Get());
-    skyPS->SetShaderResourceView("skyTexture", skySRV.Get());
+    skyPS->SetSamplerState(skySamplerHandle, skySS.Get());
+    skyPS->SetShaderResourceView(skyTextureHandle, skySRV.Get());
 
-    skyVS->SetMatrix4x4("view", camera->GetViewMatrix());
-    skyVS->SetMatrix4x4("projection", camera->GetProjectionMatrix());
-    skyVS->CopyAllBufferData();
+    SkyVSPassData passData = {};
+    passData.view = camera->GetViewMatrix();
+    passData.projection = camera->GetProjectionMatrix();
+    skyVS->WriteBufferData(passData);
 
     // Draw the Mesh
     UINT stride = sizeof(Vertex);
     UINT offset = 0;
-    context->IASetVertexBuffers(0, 1, skyMesh->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-    context->IASetIndexBuffer(skyMesh->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
-    context->DrawIndexed(
+    stateCache->SetVertexBuffer(0, skyMesh->GetVertexBuffer().Get(), stride, offset);
+    stateCache->SetIndexBuffer(skyMesh->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+    stateCache->GetDevice()->DrawIndexed(
         skyMesh->GetIndexCount(),
         0,
         0
     );
 
     // Reset the render states
-    context->RSSetState(nullptr);
-    context->OMSetDepthStencilState(nullptr, 0);
+    stateCache->SetRasterizerState(nullptr);
+    stateCache->SetDepthStencilState(nullptr, 0);
 }
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SkyBox::CreateCubemap(
@@ -2,6 +2,8 @@
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <assert.h> 
 #include "SimpleShader.h"
+#include "StateCache.h"
+#include "StateObjectCache.h"
 #include "Mesh.h"
 #include "DXCore.h"
 #include "DDSTextureLoader.h"
@@ -12,11 +14,12 @@ class SkyBox
 {
 public:
     // constructor
-    SkyBox(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, std::wstring filePath, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS);
-    SkyBox(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS, std::wstring filePath_right, std::wstring filePath_left, std::wstring filePath_up, std::wstring filePath_down, std::wstring filePath_front, std::wstring filePath_back);
+    // its rasterizer and depth states come from stateObjects
+    SkyBox(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, StateObjectCache* stateObjects, std::wstring filePath, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS);
+    SkyBox(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, StateObjectCache* stateObjects, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS, std::wstring filePath_right, std::wstring filePath_left, std::wstring filePath_up, std::wstring filePath_down, std::wstring filePath_front, std::wstring filePath_back);
     
     // methods
-    void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* camera);
+    void Draw(StateCache* stateCache, Camera* camera);
 
 private:
     // vars
@@ -29,9 +32,11 @@ private:
 
     SimpleVertexShader* skyVS;
     SimplePixelShader* skyPS;
+    SamplerSlotHandle skySamplerHandle;
+    SrvSlotHandle skyTextureHandle;
 
     //methods
-    void SetGeneralParamaters(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, Microsoft::WRL::ComPtr<ID3D11Device> device, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS);
+    void SetGeneralParamaters(Mesh* p_skyMesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> p_skySS, StateObjectCache* stateObjects, SimpleVertexShader* p_skyVS, SimplePixelShader* p_skyPS);
     Microsoft::WRL::ComPtr< ID3D11ShaderResourceView> CreateCubemap(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const wchar_t* right, const wchar_t* left, const wchar_t* up, const wchar_t* down, const wchar_t* front, const wchar_t* back);
 };
 
@@ -1,6 +1,6 @@
 #include "ShaderIncludes.hlsli"
 
-cbuffer ExternalData : register (b0)
+cbuffer PassData : register (b1)
 {
 	matrix view;
 	matrix projection;
@@ -0,0 +1,288 @@
+#include "StateCache.h"
+#include <climits>
+#include <cstring>
+
+// never a real object, so the first call after an Invalidate() always goes through
+#define UNKNOWN_STATE ((const void*)~(size_t)0)
+
+// the tracked range of a constant buffer bound as a whole
+#define WHOLE_BUFFER_RANGE UINT_MAX
+
+StateCache::StateCache(RenderDevice* device)
+{
+    this->device = device;
+    ResetStats();
+    Invalidate();
+}
+
+RenderDevice* StateCache::GetDevice() { return device; }
+
+void StateCache::Invalidate()
+{
+    for (int stage = 0; stage < SHADER_STAGE_COUNT; stage++)
+    {
+        shaders[stage] = UNKNOWN_STATE;
+        for (const void*& cb : constantBuffers[stage]) cb = UNKNOWN_STATE;
+        for (unsigned int& first : constantFirst[stage]) first = WHOLE_BUFFER_RANGE;
+        for (unsigned int& count : constantCount[stage]) count = WHOLE_BUFFER_RANGE;
+        for (const void*& sampler : samplers[stage]) sampler = UNKNOWN_STATE;
+    }
+    InvalidateShaderResources();
+
+    inputLayout = UNKNOWN_STATE;
+    topology = -1;
+    for (int slot = 0; slot < STATE_VERTEX_BUFFER_SLOTS; slot++)
+    {
+        vertexBuffers[slot] = UNKNOWN_STATE;
+        vertexStrides[slot] = 0;
+        vertexOffsets[slot] = 0;
+    }
+    indexBuffer = UNKNOWN_STATE;
+    indexFormat = 0;  // DXGI_FORMAT_UNKNOWN
+    indexOffset = 0;
+
+    rasterizerState = UNKNOWN_STATE;
+    depthStencilState = UNKNOWN_STATE;
+    stencilRef = 0;
+    blendState = UNKNOWN_STATE;
+    memset(blendFactor, 0, sizeof(blendFactor));
+    sampleMask = 0;
+}
+
+void StateCache::InvalidateShaderResources()
+{
+    for (int stage = 0; stage < SHADER_STAGE_COUNT; stage++)
+    {
+        for (const void*& srv : srvs[stage]) srv = UNKNOWN_STATE;
+    }
+}
+
+bool StateCache::Filter(int callType, const void*& tracked, const void* value)
+{
+    if (tracked == value)
+    {
+        filtered[callType]++;
+        return true;
+    }
+
+    tracked = value;
+    issued[callType]++;
+    return false;
+}
+
+void StateCache::SetShader(int stage, ID3D11DeviceChild* shader)
+{
+    if (Filter(STATE_CALL_SHADER, shaders[stage], shader))
+        return;
+
+    device->SetShader(stage, shader);
+}
+
+bool StateCache::IsShaderBound(int stage, ID3D11DeviceChild* shader)
+{
+    return shaders[stage] == shader;
+}
+
+void StateCache::SetConstantBuffer(int stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+    // binding the buffer that's there, but as a whole, still goes through
+    if (constantFirst[stage][slot] != WHOLE_BUFFER_RANGE)
+        constantBuffers[stage][slot] = UNKNOWN_STATE;
+    constantFirst[stage][slot] = WHOLE_BUFFER_RANGE;
+    constantCount[stage][slot] = WHOLE_BUFFER_RANGE;
+
+    if (Filter(STATE_CALL_CONSTANT_BUFFER, constantBuffers[stage][slot], buffer))
+        return;
+
+    device->SetConstantBuffer(stage, slot, buffer);
+}
+
+void StateCache::SetConstantBufferRange(int stage, unsigned int slot, const ConstantAllocation& allocation)
+{
+    if (constantFirst[stage][slot] != allocation.firstConstant || constantCount[stage][slot] != allocation.numConstants)
+        constantBuffers[stage][slot] = UNKNOWN_STATE;
+    constantFirst[stage][slot] = allocation.firstConstant;
+    constantCount[stage][slot] = allocation.numConstants;
+
+    if (Filter(STATE_CALL_CONSTANT_BUFFER, constantBuffers[stage][slot], allocation.buffer))
+        return;
+
+    device->SetConstantBufferRange(stage, slot, allocation);
+}
+
+// binds the smallest run of slots that actually changed
+void StateCache::SetShaderResources(int stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* views)
+{
+    unsigned int first = count;
+    unsigned int last = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const void*& tracked = srvs[stage][startSlot + i];
+        if (tracked == views[i])
+        {
+            filtered[STATE_CALL_SRV]++;
+            continue;
+        }
+
+        tracked = views[i];
+        if (first == count) first = i;
+        last = i;
+    }
+
+    if (first == count)
+        return;
+    issued[STATE_CALL_SRV]++;
+
+    device->SetShaderResources(stage, startSlot + first, last - first + 1, views + first);
+}
+
+void StateCache::SetShaderResource(int stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+    SetShaderResources(stage, slot, 1, &srv);
+}
+
+void StateCache::UnbindShaderResource(ID3D11ShaderResourceView* srv)
+{
+    if (!srv)
+        return;
+
+    ID3D11ShaderResourceView* none = 0;
+    for (int stage = 0; stage < SHADER_STAGE_COUNT; stage++)
+    {
+        for (unsigned int slot = 0; slot < STATE_SRV_SLOTS; slot++)
+        {
+            if (srvs[stage][slot] == srv)
+                SetShaderResources(stage, slot, 1, &none);
+        }
+    }
+}
+
+void StateCache::SetSampler(int stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+    if (Filter(STATE_CALL_SAMPLER, samplers[stage][slot], sampler))
+        return;
+
+    device->SetSampler(stage, slot, sampler);
+}
+
+void StateCache::SetInputLayout(ID3D11InputLayout* layout)
+{
+    if (Filter(STATE_CALL_INPUT_ASSEMBLER, inputLayout, layout))
+        return;
+    device->SetInputLayout(layout);
+}
+
+void StateCache::SetPrimitiveTopology(unsigned int newTopology)
+{
+    if (topology == (int)newTopology)
+    {
+        filtered[STATE_CALL_INPUT_ASSEMBLER]++;
+        return;
+    }
+
+    topology = (int)newTopology;
+    issued[STATE_CALL_INPUT_ASSEMBLER]++;
+    device->SetPrimitiveTopology(newTopology);
+}
+
+void StateCache::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+    if (vertexBuffers[slot] == buffer && vertexStrides[slot] == stride && vertexOffsets[slot] == offset)
+    {
+        filtered[STATE_CALL_INPUT_ASSEMBLER]++;
+        return;
+    }
+
+    vertexBuffers[slot] = buffer;
+    vertexStrides[slot] = stride;
+    vertexOffsets[slot] = offset;
+    issued[STATE_CALL_INPUT_ASSEMBLER]++;
+    device->SetVertexBuffer(slot, buffer, stride, offset);
+}
+
+void StateCache::SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset)
+{
+    if (indexBuffer == buffer && indexFormat == format && indexOffset == offset)
+    {
+        filtered[STATE_CALL_INPUT_ASSEMBLER]++;
+        return;
+    }
+
+    indexBuffer = buffer;
+    indexFormat = format;
+    indexOffset = offset;
+    issued[STATE_CALL_INPUT_ASSEMBLER]++;
+    device->SetIndexBuffer(buffer, format, offset);
+}
+
+void StateCache::SetRasterizerState(ID3D11RasterizerState* state)
+{
+    if (Filter(STATE_CALL_RENDER_STATE, rasterizerState, state))
+        return;
+    device->SetRasterizerState(state);
+}
+
+void StateCache::SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int ref)
+{
+    if (depthStencilState == state && stencilRef == ref)
+    {
+        filtered[STATE_CALL_RENDER_STATE]++;
+        return;
+    }
+
+    depthStencilState = state;
+    stencilRef = ref;
+    issued[STATE_CALL_RENDER_STATE]++;
+    device->SetDepthStencilState(state, ref);
+}
+
+void StateCache::SetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int mask)
+{
+    // a null factor means all ones to D3D
+    float newFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    if (factor)
+        memcpy(newFactor, factor, sizeof(newFactor));
+
+    if (blendState == state && sampleMask == mask && memcmp(blendFactor, newFactor, sizeof(newFactor)) == 0)
+    {
+        filtered[STATE_CALL_RENDER_STATE]++;
+        return;
+    }
+
+    blendState = state;
+    sampleMask = mask;
+    memcpy(blendFactor, newFactor, sizeof(newFactor));
+    issued[STATE_CALL_RENDER_STATE]++;
+    device->SetBlendState(state, newFactor, mask);
+}
+
+void StateCache::SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+    device->SetRenderTargets(count, rtvs, dsv);
+
+    // D3D unbinds any SRV whose resource just became an output
+    InvalidateShaderResources();
+}
+
+unsigned int StateCache::GetIssuedCount(int callType) { return issued[callType]; }
+unsigned int StateCache::GetFilteredCount(int callType) { return filtered[callType]; }
+
+unsigned int StateCache::GetTotalIssuedCount()
+{
+    unsigned int total = 0;
+    for (unsigned int count : issued) total += count;
+    return total;
+}
+
+unsigned int StateCache::GetTotalFilteredCount()
+{
+    unsigned int total = 0;
+    for (unsigned int count : filtered) total += count;
+    return total;
+}
+
+void StateCache::ResetStats()
+{
+    memset(issued, 0, sizeof(issued));
+    memset(filtered, 0, sizeof(filtered));
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "RenderDevice.h"
+
+// groups of calls the stats are kept for
+#define STATE_CALL_SHADER           0
+#define STATE_CALL_CONSTANT_BUFFER  1
+#define STATE_CALL_SRV              2
+#define STATE_CALL_SAMPLER          3
+#define STATE_CALL_INPUT_ASSEMBLER  4
+#define STATE_CALL_RENDER_STATE     5
+#define STATE_CALL_COUNT            6
+
+// slots tracked per stage and for the input assembler - the D3D11
+// limits, spelled out so the cache builds without the D3D11 headers
+#define STATE_CONSTANT_BUFFER_SLOTS 14
+#define STATE_SRV_SLOTS             128
+#define STATE_SAMPLER_SLOTS         16
+#define STATE_VERTEX_BUFFER_SLOTS   32
+
+// Sits between the renderer and a RenderDevice and drops
+// calls that would bind what is already bound
+// - Tracks shaders, constant buffers, SRVs and samplers per stage,
+//   the IA buffers/layout/topology and the RS/DS/blend states
+// - Anything that changes the context behind the cache's back
+//   (SpriteBatch, for one) must be followed by Invalidate()
+// - Binding render targets can silently unbind SRVs of the same
+//   resource, so SetRenderTargets() forgets the tracked SRVs
+// - Topologies and index formats are the D3D11 values, as with
+//   RenderDevice
+class StateCache
+{
+public:
+    StateCache(RenderDevice* device);
+
+    // the device everything that gets through is sent to - anything
+    // the cache doesn't track (draws, clears, uploads) goes there directly
+    RenderDevice* GetDevice();
+
+    // forget everything, the next call of every kind goes through
+    void Invalidate();
+    void InvalidateShaderResources();
+
+    // shader stages
+    void SetShader(int stage, ID3D11DeviceChild* shader);
+    bool IsShaderBound(int stage, ID3D11DeviceChild* shader);
+    void SetConstantBuffer(int stage, unsigned int slot, ID3D11Buffer* buffer);
+    void SetConstantBufferRange(int stage, unsigned int slot, const ConstantAllocation& allocation);
+    void SetShaderResources(int stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs);
+    void SetShaderResource(int stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+
+    // nulls every slot the view is known to be bound to, in any stage -
+    // slots the cache has forgotten (after SetRenderTargets) are left alone
+    void UnbindShaderResource(ID3D11ShaderResourceView* srv);
+    void SetSampler(int stage, unsigned int slot, ID3D11SamplerState* sampler);
+
+    // input assembler
+    void SetInputLayout(ID3D11InputLayout* layout);
+    void SetPrimitiveTopology(unsigned int topology);
+    void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+    void SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset);
+
+    // fixed function states
+    void SetRasterizerState(ID3D11RasterizerState* state);
+    void SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+    void SetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask);
+
+    // output merger - never filtered
+    void SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv);
+
+    // stats since the last ResetStats()
+    unsigned int GetIssuedCount(int callType);
+    unsigned int GetFilteredCount(int callType);
+    unsigned int GetTotalIssuedCount();
+    unsigned int GetTotalFilteredCount();
+    void ResetStats();
+
+private:
+    // returns true (and counts it) if the call can be dropped
+    bool Filter(int callType, const void*& tracked, const void* value);
+
+    RenderDevice* device;
+
+    const void* shaders[SHADER_STAGE_COUNT];
+    const void* constantBuffers[SHADER_STAGE_COUNT][STATE_CONSTANT_BUFFER_SLOTS];
+    unsigned int constantFirst[SHADER_STAGE_COUNT][STATE_CONSTANT_BUFFER_SLOTS];
+    unsigned int constantCount[SHADER_STAGE_COUNT][STATE_CONSTANT_BUFFER_SLOTS];
+    const void* srvs[SHADER_STAGE_COUNT][STATE_SRV_SLOTS];
+    const void* samplers[SHADER_STAGE_COUNT][STATE_SAMPLER_SLOTS];
+
+    const void* inputLayout;
+    int topology;
+    const void* vertexBuffers[STATE_VERTEX_BUFFER_SLOTS];
+    unsigned int vertexStrides[STATE_VERTEX_BUFFER_SLOTS];
+    unsigned int vertexOffsets[STATE_VERTEX_BUFFER_SLOTS];
+    const void* indexBuffer;
+    unsigned int indexFormat;
+    unsigned int indexOffset;
+
+    const void* rasterizerState;
+    const void* depthStencilState;
+    unsigned int stencilRef;
+    const void* blendState;
+    float blendFactor[4];
+    unsigned int sampleMask;
+
+    unsigned int issued[STATE_CALL_COUNT];
+    unsigned int filtered[STATE_CALL_COUNT];
+};
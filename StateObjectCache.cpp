@@ -0,0 +1,147 @@
+#include "StateObjectCache.h"
+#include <cstdio>
+#include <cstring>
+
+StateObjectCache::StateObjectCache(ID3D11Device* device)
+{
+    this->device = device;
+    frozen = false;
+    sharedCount = 0;
+    lateCount = 0;
+}
+
+// --------------------------------------------------------
+// Descriptions are zero initialized plain structs, so their
+// bytes are the key as they are
+// --------------------------------------------------------
+std::string StateObjectCache::MakeKey(Kind kind, const void* desc, size_t size)
+{
+    std::string key(1, (char)kind);
+    key.append((const char*)desc, size);
+    return key;
+}
+
+ID3D11DeviceChild* StateObjectCache::Find(const std::string& key)
+{
+    auto found = objects.find(key);
+    if (found == objects.end())
+        return 0;
+    sharedCount++;
+    return found->second.Get();
+}
+
+void StateObjectCache::Store(const std::string& key, ID3D11DeviceChild* object)
+{
+    if (!object)
+        return;
+    objects[key].Attach(object);
+
+    if (frozen)
+    {
+        if (lateCount == 0)
+            printf("StateObjectCache: a state object was created after loading - prewarm it at load instead\n");
+        lateCount++;
+    }
+}
+
+ID3D11RasterizerState* StateObjectCache::GetRasterizerState(const D3D11_RASTERIZER_DESC& desc)
+{
+    std::string key = MakeKey(KIND_RASTERIZER, &desc, sizeof(desc));
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ID3D11DeviceChild* found = Find(key))
+        return (ID3D11RasterizerState*)found;
+
+    ID3D11RasterizerState* state = 0;
+    device->CreateRasterizerState(&desc, &state);
+    Store(key, state);
+    return state;
+}
+
+ID3D11DepthStencilState* StateObjectCache::GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+    std::string key = MakeKey(KIND_DEPTH_STENCIL, &desc, sizeof(desc));
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ID3D11DeviceChild* found = Find(key))
+        return (ID3D11DepthStencilState*)found;
+
+    ID3D11DepthStencilState* state = 0;
+    device->CreateDepthStencilState(&desc, &state);
+    Store(key, state);
+    return state;
+}
+
+ID3D11BlendState* StateObjectCache::GetBlendState(const D3D11_BLEND_DESC& desc)
+{
+    std::string key = MakeKey(KIND_BLEND, &desc, sizeof(desc));
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ID3D11DeviceChild* found = Find(key))
+        return (ID3D11BlendState*)found;
+
+    ID3D11BlendState* state = 0;
+    device->CreateBlendState(&desc, &state);
+    Store(key, state);
+    return state;
+}
+
+ID3D11SamplerState* StateObjectCache::GetSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+    std::string key = MakeKey(KIND_SAMPLER, &desc, sizeof(desc));
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ID3D11DeviceChild* found = Find(key))
+        return (ID3D11SamplerState*)found;
+
+    ID3D11SamplerState* state = 0;
+    device->CreateSamplerState(&desc, &state);
+    Store(key, state);
+    return state;
+}
+
+// --------------------------------------------------------
+// The elements' semantic names are pointers, so the key
+// holds the names themselves followed by the rest of each
+// element
+// --------------------------------------------------------
+ID3D11InputLayout* StateObjectCache::GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, const void* bytecode, size_t bytecodeSize)
+{
+    std::string key(1, (char)KIND_INPUT_LAYOUT);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        D3D11_INPUT_ELEMENT_DESC element = elements[i];
+        key.append(element.SemanticName, strlen(element.SemanticName) + 1);
+        element.SemanticName = 0;
+        key.append((const char*)&element, sizeof(element));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ID3D11DeviceChild* found = Find(key))
+        return (ID3D11InputLayout*)found;
+
+    ID3D11InputLayout* layout = 0;
+    device->CreateInputLayout(elements, count, bytecode, bytecodeSize, &layout);
+    Store(key, layout);
+    return layout;
+}
+
+void StateObjectCache::Freeze()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    frozen = true;
+}
+
+unsigned int StateObjectCache::GetObjectCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (unsigned int)objects.size();
+}
+
+unsigned int StateObjectCache::GetSharedCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sharedCount;
+}
+
+unsigned int StateObjectCache::GetLateCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lateCount;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Owns the immutable state objects (rasterizer, depth stencil, blend,
+// sampler) and input layouts, keyed by their descriptions, so every
+// identical description shares one object
+// - Get*() returns the shared object, creating it on the first request -
+//   the cache keeps it alive, callers that hold on to it AddRef it
+// - Everything is asked for while loading; Freeze() marks the end of
+//   that, and anything created afterwards is counted and reported,
+//   since it means a D3D object was made mid frame
+// - Input layouts are keyed by their elements, semantic names included -
+//   the same elements can only come from the same input signature, so
+//   vertex shaders with matching inputs share a layout
+// - Safe to call from the threads shaders are loaded on
+class StateObjectCache
+{
+public:
+    StateObjectCache(ID3D11Device* device);
+
+    ID3D11RasterizerState* GetRasterizerState(const D3D11_RASTERIZER_DESC& desc);
+    ID3D11DepthStencilState* GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc);
+    ID3D11BlendState* GetBlendState(const D3D11_BLEND_DESC& desc);
+    ID3D11SamplerState* GetSamplerState(const D3D11_SAMPLER_DESC& desc);
+
+    // bytecode is only used when the layout has to be created
+    ID3D11InputLayout* GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, unsigned int count, const void* bytecode, size_t bytecodeSize);
+
+    void Freeze();
+
+    // objects the cache holds, requests it answered with an existing
+    // one, and objects created after Freeze()
+    unsigned int GetObjectCount();
+    unsigned int GetSharedCount();
+    unsigned int GetLateCount();
+
+private:
+    // the kind is the key's first byte, so equal descriptions of
+    // different kinds can't collide
+    enum Kind : char { KIND_RASTERIZER, KIND_DEPTH_STENCIL, KIND_BLEND, KIND_SAMPLER, KIND_INPUT_LAYOUT };
+    static std::string MakeKey(Kind kind, const void* desc, size_t size);
+
+    // both with the mutex held - Store() takes over the
+    // creation's reference
+    ID3D11DeviceChild* Find(const std::string& key);
+    void Store(const std::string& key, ID3D11DeviceChild* object);
+
+    ID3D11Device* device;
+    std::mutex mutex;
+    std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11DeviceChild>> objects;
+    bool frozen;
+    unsigned int sharedCount;
+    unsigned int lateCount;
+};
@@ -0,0 +1,26 @@
+#include "ToonShading.hlsli"
+
+// The opaque pixel shader for materials packed into texture arrays -
+// every material in an array group shares these bindings, and picks its
+// slice (and specular intensity) from the instance data, so one
+// instanced draw can cover several materials
+Texture2DArray Albedo		: register(t0);
+Texture2DArray NormalMap	: register(t1);
+Texture2DArray RoughnessMap	: register(t2);
+Texture2DArray MetalnessMap	: register(t3);
+SamplerState SamplerOptions	: register(s0);
+
+PSOutput main(VertexToPixelNormalShadowMap input)
+{
+	float3 uv = float3(input.uv, input.material.x);
+	float4 surfaceColor = Albedo.Sample(SamplerOptions, uv);
+#ifdef NORMAL_MAP
+	float3 unpackedNormal = NormalMap.Sample(SamplerOptions, uv).rgb * 2 - 1;
+#else
+	float3 unpackedNormal = float3(0, 0, 1);
+#endif
+	float metalness = MetalnessMap.Sample(SamplerOptions, uv).r;
+	float roughness = RoughnessMap.Sample(SamplerOptions, uv).r;
+
+	return ShadeSurface(input, surfaceColor, unpackedNormal, metalness, roughness, input.material.y);
+}
@@ -0,0 +1,183 @@
+#include "TexturePacker.h"
+#include <climits>
+#include <cstring>
+
+TexturePacker::TexturePacker(ID3D11Device* device, ID3D11DeviceContext* context, SimplePixelShader* shader)
+{
+    this->device = device;
+    this->context = context;
+    arrayBytes = 0;
+
+    // the maps are in binding set order from the albedo on
+    const SimpleSRV* albedo = shader->GetShaderResourceViewInfo("Albedo");
+    const SimpleSampler* sampler = shader->GetSamplerInfo("SamplerOptions");
+    firstSlot = albedo ? albedo->BindIndex : 0;
+    samplerSlot = sampler ? sampler->BindIndex : 0;
+}
+
+unsigned int TexturePacker::GetGroupCount() { return (unsigned int)groups.size(); }
+const TextureArrayGroup& TexturePacker::GetGroup(unsigned int group) { return groups[group]; }
+uint64_t TexturePacker::GetArrayBytes() { return arrayBytes; }
+
+// --------------------------------------------------------
+// Finds the resolution class of a material's maps, and the
+// mip of each one that has exactly that size
+// --------------------------------------------------------
+bool TexturePacker::MakeCandidate(Material* material, Candidate& candidate)
+{
+    ID3D11ShaderResourceView* views[MATERIAL_SRV_COUNT] = {
+        material->GetSRV().Get(), material->GetSRVNormal().Get(),
+        material->GetSRVRoughness().Get(), material->GetSRVMetalness().Get() };
+
+    candidate.material = material;
+    candidate.size = TEXTURE_ARRAY_MAX_SIZE;
+
+    D3D11_TEXTURE2D_DESC descs[MATERIAL_SRV_COUNT];
+    for (unsigned int i = 0; i < MATERIAL_SRV_COUNT; i++)
+    {
+        if (!views[i])
+            return false;
+
+        Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+        views[i]->GetResource(resource.GetAddressOf());
+        D3D11_RESOURCE_DIMENSION dimension;
+        resource->GetType(&dimension);
+        if (dimension != D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+            return false;
+
+        // the material's views keep the textures alive
+        candidate.textures[i] = (ID3D11Texture2D*)resource.Get();
+        candidate.textures[i]->GetDesc(&descs[i]);
+        if (descs[i].ArraySize != 1 || descs[i].SampleDesc.Count != 1)
+            return false;
+        candidate.formats[i] = descs[i].Format;
+
+        unsigned int smallest = descs[i].Width < descs[i].Height ? descs[i].Width : descs[i].Height;
+        while (candidate.size > smallest)
+            candidate.size /= 2;
+    }
+
+    candidate.mipLevels = UINT_MAX;
+    for (unsigned int i = 0; i < MATERIAL_SRV_COUNT; i++)
+    {
+        unsigned int mip = 0;
+        while (mip < descs[i].MipLevels && (descs[i].Width >> mip) > candidate.size)
+            mip++;
+        if (mip == descs[i].MipLevels || (descs[i].Width >> mip) != candidate.size || (descs[i].Height >> mip) != candidate.size)
+            return false;
+
+        candidate.mips[i] = mip;
+        if (descs[i].MipLevels - mip < candidate.mipLevels)
+            candidate.mipLevels = descs[i].MipLevels - mip;
+    }
+    return candidate.size > 0;
+}
+
+unsigned int TexturePacker::Pack(const std::vector<Material*>& materials)
+{
+    std::vector<std::vector<Candidate>> pending;
+    for (Material* material : materials)
+    {
+        material->SetTextureArraySlot(-1, 0);
+
+        Candidate candidate;
+        if (!MakeCandidate(material, candidate))
+            continue;
+
+        // same class, formats and sampler - anything else needs its own group
+        size_t g = 0;
+        for (; g < pending.size(); g++)
+        {
+            const Candidate& first = pending[g][0];
+            if (first.size == candidate.size &&
+                memcmp(first.formats, candidate.formats, sizeof(candidate.formats)) == 0 &&
+                first.material->GetSampler() == material->GetSampler())
+                break;
+        }
+        if (g == pending.size())
+            pending.push_back(std::vector<Candidate>());
+        pending[g].push_back(candidate);
+    }
+
+    unsigned int packed = 0;
+    for (const std::vector<Candidate>& members : pending)
+    {
+        if (members.size() > D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION || !CreateGroup(members))
+            continue;
+
+        unsigned int group = (unsigned int)groups.size() - 1;
+        for (unsigned int slice = 0; slice < members.size(); slice++)
+            members[slice].material->SetTextureArraySlot((int)group, slice);
+        packed += (unsigned int)members.size();
+    }
+    return packed;
+}
+
+bool TexturePacker::CreateGroup(const std::vector<Candidate>& members)
+{
+    TextureArrayGroup group;
+    group.size = members[0].size;
+    group.mipLevels = members[0].mipLevels;
+    for (const Candidate& member : members)
+    {
+        if (member.mipLevels < group.mipLevels)
+            group.mipLevels = member.mipLevels;
+        group.materials.push_back(member.material);
+    }
+    group.sampler = members[0].material->GetSampler().Get();
+
+    for (unsigned int i = 0; i < MATERIAL_SRV_COUNT; i++)
+    {
+        group.formats[i] = members[0].formats[i];
+
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = group.size;
+        desc.Height = group.size;
+        desc.MipLevels = group.mipLevels;
+        desc.ArraySize = (UINT)members.size();
+        desc.Format = group.formats[i];
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> array;
+        if (FAILED(device->CreateTexture2D(&desc, 0, array.GetAddressOf())))
+            return false;
+
+        // slice by slice, mip by mip, starting from the class sized mip
+        for (UINT slice = 0; slice < desc.ArraySize; slice++)
+        {
+            const Candidate& member = members[slice];
+            D3D11_TEXTURE2D_DESC sourceDesc;
+            member.textures[i]->GetDesc(&sourceDesc);
+            for (UINT mip = 0; mip < desc.MipLevels; mip++)
+            {
+                context->CopySubresourceRegion(
+                    array.Get(), D3D11CalcSubresource(mip, slice, desc.MipLevels), 0, 0, 0,
+                    member.textures[i], D3D11CalcSubresource(member.mips[i] + mip, 0, sourceDesc.MipLevels), 0);
+            }
+        }
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = desc.Format;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+        srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+        if (FAILED(device->CreateShaderResourceView(array.Get(), &srvDesc, group.srvs[i].GetAddressOf())))
+            return false;
+        group.srvSet[i] = group.srvs[i].Get();
+
+        // a mip chain is about a third on top of the top level
+        uint64_t sliceBytes = (uint64_t)group.size * group.size * (group.formats[i] == DXGI_FORMAT_R8_UNORM ? 1 : 4);
+        arrayBytes += sliceBytes * desc.ArraySize * 4 / 3;
+    }
+
+    groups.push_back(group);
+    return true;
+}
+
+void TexturePacker::Bind(StateCache* stateCache, unsigned int group)
+{
+    stateCache->SetShaderResources(SHADER_STAGE_PIXEL, firstSlot, MATERIAL_SRV_COUNT, groups[group].srvSet);
+    stateCache->SetSampler(SHADER_STAGE_PIXEL, samplerSlot, groups[group].sampler);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include "Material.h"
+#include "StateCache.h"
+
+// largest array slice - anything bigger is packed from a smaller mip
+#define TEXTURE_ARRAY_MAX_SIZE      2048
+
+// One set of texture arrays - slice i of every array belongs to the
+// same material, and the arrays line up with the material's binding set
+struct TextureArrayGroup
+{
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvs[MATERIAL_SRV_COUNT];
+    ID3D11ShaderResourceView* srvSet[MATERIAL_SRV_COUNT];
+    ID3D11SamplerState* sampler;
+    DXGI_FORMAT formats[MATERIAL_SRV_COUNT];
+    unsigned int size;
+    unsigned int mipLevels;
+    std::vector<Material*> materials;
+};
+
+// Packs material textures into Texture2DArrays, so materials that share
+// shaders can be drawn in one instanced batch (TextureArrayPS.hlsl)
+// - Materials are grouped by resolution class - the largest power of two
+//   square their textures all have a mip of - and by the formats of their
+//   four maps; each group becomes one array per map
+// - Resizing is done by copying from the mip that matches the class, so
+//   a texture without such a mip (not a power of two, not square) keeps
+//   its material out of the arrays
+// - Materials in a group also have to share a sampler, which the group
+//   binds for all of them
+class TexturePacker
+{
+public:
+    // the shader's registers decide where the arrays are bound
+    TexturePacker(ID3D11Device* device, ID3D11DeviceContext* context, SimplePixelShader* shader);
+
+    // assigns every packable material a group and slice - returns how
+    // many materials were packed
+    unsigned int Pack(const std::vector<Material*>& materials);
+
+    unsigned int GetGroupCount();
+    const TextureArrayGroup& GetGroup(unsigned int group);
+
+    // binds a group's arrays and sampler in place of a material's set
+    void Bind(StateCache* stateCache, unsigned int group);
+
+    // approximate memory used by the arrays
+    uint64_t GetArrayBytes();
+
+private:
+    struct Candidate
+    {
+        Material* material;
+        unsigned int size;
+        unsigned int mips[MATERIAL_SRV_COUNT];       // the mip packed from
+        unsigned int mipLevels;                      // mips below it, on every map
+        ID3D11Texture2D* textures[MATERIAL_SRV_COUNT];
+        DXGI_FORMAT formats[MATERIAL_SRV_COUNT];
+    };
+    bool MakeCandidate(Material* material, Candidate& candidate);
+    bool CreateGroup(const std::vector<Candidate>& members);
+
+    ID3D11Device* device;
+    ID3D11DeviceContext* context;
+    unsigned int firstSlot;
+    unsigned int samplerSlot;
+    std::vector<TextureArrayGroup> groups;
+    uint64_t arrayBytes;
+};
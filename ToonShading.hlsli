@@ -0,0 +1,216 @@
+#ifndef __GGP_TOON_SHADING__
+#define __GGP_TOON_SHADING__
+
+#include "Lighting.hlsli"
+#include "ShaderIncludes.hlsli"
+
+#define MAX_LIGHTS 128
+
+// the light grid's cells - see LightGrid.h
+#define LIGHT_GRID_X 16
+#define LIGHT_GRID_Y 9
+#define LIGHT_GRID_Z 24
+
+// The lighting shared by the opaque pixel shaders - they differ only
+// in where the material's textures come from (see PixelShader.hlsl
+// and TextureArrayPS.hlsl), and hand the samples to ShadeSurface()
+
+// Feature keywords - a variant (see ShaderVariants.h) is compiled with
+// SHADER_VARIANT and only the keywords it's drawn with, so everything
+// else is compiled out:
+// - SHADOWS_ON         samples the shadow map
+// - LIGHTS_DIRECTIONAL, LIGHTS_POINT, LIGHTS_SPOT
+//                      the light types the enabled lights have
+// - NORMAL_MAP         the material has a normal map
+// - TOON               toon ramps rather than plain PBR
+// Without SHADER_VARIANT (the .cso the build makes) it has everything,
+// and branches on renderShadows instead
+//
+// Point and spot lights are culled on the CPU into a grid of cells over
+// the view frustum (see LightGrid.h) - a pixel finds its cell from its
+// screen position and view depth, and only loops over that cell's lights.
+// With objectLightLists set, each instance brings its own list instead
+// (see ObjectLightLists.h), as an offset and count in input.material.zw
+#ifndef SHADER_VARIANT
+#define SHADOWS_DYNAMIC
+#define LIGHTS_DIRECTIONAL
+#define LIGHTS_POINT
+#define LIGHTS_SPOT
+#define NORMAL_MAP
+#define TOON
+#endif
+
+// constants are split by how often they change (see ShaderIncludes.hlsli)
+cbuffer FrameData : register (b0)
+{
+	Light lights[MAX_LIGHTS];
+	int lightCount;
+	int renderShadows;
+	int directionalCount;
+	float clusterSliceScale;
+	float3 localAmbient;
+	float clusterSliceBias;
+	float2 clusterTileScale;
+	int objectLightLists;
+}
+
+cbuffer PassData : register (b1)
+{
+	float3 cameraPos;
+}
+
+Texture2D RampMap		: register(t4);
+Texture2D shadowMap		: register(t5);
+Texture2D specularRampMap		: register(t6);
+SamplerState ClampSampler	: register(s1);
+SamplerComparisonState shadowSampler	: register(s2);
+
+// each cell's (offset, count) run of LightIndices, which starts with
+// the directional lights - per object lists use LightIndices alone
+Buffer<uint2> LightGrid		: register(t7);
+Buffer<uint> LightIndices	: register(t8);
+
+struct PSOutput 
+{
+	float4 color		: SV_TARGET0;
+	float4 normals		: SV_TARGET1;
+	float4 depth		: SV_TARGET2;
+};
+
+#ifdef TOON
+#define LIGHT_COLOR(kind) kind##LightColorPBRToon(normal, worldPos, light, cameraPos, metalness, roughness, surfaceColor, specularColor, RampMap, specularRampMap, ClampSampler)
+#else
+#define LIGHT_COLOR(kind) kind##LightColorPBR(normal, worldPos, light, cameraPos, metalness, roughness, surfaceColor, specularColor)
+#endif
+
+// --------------------------------------------------------
+// One directional light's contribution
+// --------------------------------------------------------
+float3 DirectionalLightColor(Light light, float3 normal, float3 worldPos, float metalness, float roughness, float3 surfaceColor, float3 specularColor)
+{
+	return LIGHT_COLOR(d);
+}
+
+// --------------------------------------------------------
+// One point or spot light's contribution - a variant with
+// only one of the two doesn't need to look at the type
+// --------------------------------------------------------
+float3 LocalLightColor(Light light, float3 normal, float3 worldPos, float metalness, float roughness, float3 surfaceColor, float3 specularColor)
+{
+#if defined(LIGHTS_POINT) && !defined(LIGHTS_SPOT)
+	return LIGHT_COLOR(p);
+#elif defined(LIGHTS_SPOT) && !defined(LIGHTS_POINT)
+	return LIGHT_COLOR(s);
+#else
+	if (light.Type == TYPE_SPOT)
+		return LIGHT_COLOR(s);
+	return LIGHT_COLOR(p);
+#endif
+}
+
+// --------------------------------------------------------
+// The light grid cell a pixel is in
+// --------------------------------------------------------
+uint2 LightGridCell(float4 screenPosition)
+{
+	// w is the view depth - with clustering off the scales are zero,
+	// and everything is in cell 0
+	int slice = (int)floor(log(screenPosition.w) * clusterSliceScale - clusterSliceBias);
+	uint2 tile = min((uint2)(screenPosition.xy * clusterTileScale), uint2(LIGHT_GRID_X - 1, LIGHT_GRID_Y - 1));
+	uint z = (uint)clamp(slice, 0, LIGHT_GRID_Z - 1);
+	return LightGrid[(z * LIGHT_GRID_Y + tile.y) * LIGHT_GRID_X + tile.x];
+}
+
+// --------------------------------------------------------
+// How much of the shadow casting light reaches the pixel
+// --------------------------------------------------------
+float ShadowAmount(float4 posForShadows)
+{
+	// Convert from homogeneous screen coords to UV coords
+	// remembering to flip the y value
+	float2 shadowUV = posForShadows.xy / posForShadows.w * 0.5f + 0.5f;
+	shadowUV.y = 1.0f - shadowUV.y;
+
+	// Calculate this pixel's depth from the light
+	float depthFromLight = posForShadows.z / posForShadows.w;
+
+	// Use a comparison sampler to compare the results of a 2x2 group of neighboring pixels
+	// and return the ratio of how many "passed" the comparison
+	return shadowMap.SampleCmpLevelZero(shadowSampler, shadowUV, depthFromLight);
+}
+
+// --------------------------------------------------------
+// Lights and shadows one pixel of a surface
+// 
+// - surfaceColor is the albedo sample, still in gamma space
+// - unpackedNormal is the tangent space normal, in [-1, 1] -
+//   ignored without NORMAL_MAP
+// --------------------------------------------------------
+PSOutput ShadeSurface(VertexToPixelNormalShadowMap input, float4 surfaceColor, float3 unpackedNormal, float metalness, float roughness, float specularIntensity)
+{
+	// normalize the normal and tangent
+	float3 normal = normalize(input.normal);
+#ifdef NORMAL_MAP
+	float3 tangent = normalize(input.tangent);
+	tangent = normalize(tangent - normal * dot(tangent, normal)); // Gram-Schmidt orthoganlization
+
+	float3 biTangent = cross(tangent, normal);
+	float3x3 TBN = float3x3(tangent, biTangent, normal);
+
+	// normalize the normal after applying TBN matrix
+	normal = mul(unpackedNormal, TBN);
+	normal = normalize(normal);
+#endif
+	 
+	// gamma correct the surface color
+	surfaceColor.rgb = pow(surfaceColor.rgb, 2.2);
+
+	// get the specular color
+	// Specular color determination -----------------
+	// Assume albedo texture is actually holding specular color where metalness == 1
+	//
+	// Note the use of lerp here - metal is generally 0 or 1, but might be in between
+	// because of linear texture sampling, so we want lerp the specular color to match 
+	float3 specularColor = lerp(F0_NON_METAL.rrr, surfaceColor.rgb, metalness) * specularIntensity;
+
+	float3 totalColor = float3(0, 0, 0);
+#ifdef LIGHTS_DIRECTIONAL
+	// directional lights reach every cell, so they're listed first
+	for (int i = 0; i < directionalCount; i++)
+		totalColor += DirectionalLightColor(lights[LightIndices[i]], normal, input.worldPos, metalness, roughness, surfaceColor.rgb, specularColor);
+#endif
+
+#if defined(LIGHTS_POINT) || defined(LIGHTS_SPOT)
+	// the enabled point and spot lights that reach the pixel's cell,
+	// or the object's own run of them
+	uint2 run = objectLightLists != 0 ? (uint2)input.material.zw : LightGridCell(input.position);
+	for (uint j = 0; j < run.y; j++)
+		totalColor += LocalLightColor(lights[LightIndices[run.x + j]], normal, input.worldPos, metalness, roughness, surfaceColor.rgb, specularColor);
+
+#ifdef TOON
+	// toon point and spot lights add their ambient everywhere, not
+	// just in their cells, so it's summed for the frame instead
+	totalColor += localAmbient;
+#endif
+#endif
+
+	// Shadow Mapping
+#if defined(SHADOWS_DYNAMIC)
+	if (renderShadows != 0)
+		totalColor *= ShadowAmount(input.posForShadows);
+#elif defined(SHADOWS_ON)
+	totalColor *= ShadowAmount(input.posForShadows);
+#endif
+
+	// generate output
+	PSOutput output;
+	
+	output.color = float4(pow(totalColor, 1.0f / 2.2f), 1.0f);
+	output.normals = float4(input.normal, 0);
+	output.depth = 0.5f;
+
+	// calculate and return final color
+	return output;
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "TraceReplay.h"
+#include "RecordingRenderDevice.h"
+
+TraceReplay::TraceReplay(FrameTrace* trace)
+{
+    this->trace = trace;
+}
+
+void TraceReplay::SetObjects(const std::vector<void*>& handles)
+{
+    this->handles = handles;
+}
+
+void TraceReplay::UsePlaceholderObjects()
+{
+    // the address of each byte is as good a handle as any
+    unsigned int count = trace->GetObjectCount();
+    placeholders.assign(count + 1, 0);
+    handles.assign(count + 1, 0);
+    for (unsigned int id = 1; id <= count; id++)
+        handles[id] = &placeholders[id];
+}
+
+void* TraceReplay::GetHandle(unsigned int id)
+{
+    return id < handles.size() ? handles[id] : 0;
+}
+
+void TraceReplay::ReplayFrame(unsigned int frameIndex, RenderDevice* device)
+{
+    TraceFrame& frame = trace->GetFrame(frameIndex);
+
+    for (const TraceCommand& command : frame.commands)
+    {
+        unsigned int size = 0;
+        const unsigned char* data = trace->GetCommandData(frame, command, size);
+        const unsigned int* args = command.args;
+        void* object = GetHandle(command.object);
+
+        // handle lists come back as ids
+        if (command.type == RENDER_CMD_SET_SHADER_RESOURCES || command.type == RENDER_CMD_SET_RENDER_TARGETS)
+        {
+            const unsigned int* ids = (const unsigned int*)data;
+            handleList.resize(size / sizeof(unsigned int));
+            for (size_t i = 0; i < handleList.size(); i++)
+                handleList[i] = GetHandle(ids[i]);
+        }
+
+        switch (command.type)
+        {
+        case RENDER_CMD_SET_SHADER:
+            device->SetShader((int)args[0], (ID3D11DeviceChild*)object);
+            break;
+        case RENDER_CMD_SET_CONSTANT_BUFFER:
+            device->SetConstantBuffer((int)args[0], args[1], (ID3D11Buffer*)object);
+            break;
+        case RENDER_CMD_SET_SHADER_RESOURCES:
+            device->SetShaderResources((int)args[0], args[1], args[2], (ID3D11ShaderResourceView* const*)handleList.data());
+            break;
+        case RENDER_CMD_SET_SAMPLER:
+            device->SetSampler((int)args[0], args[1], (ID3D11SamplerState*)object);
+            break;
+        case RENDER_CMD_UPDATE_BUFFER:
+            if (data) device->UpdateBuffer((ID3D11Buffer*)object, data, size);
+            break;
+        case RENDER_CMD_UPDATE_BUFFER_RANGE:
+            if (data) device->UpdateBufferRange((ID3D11Buffer*)object, data, args[1], size);
+            break;
+        case RENDER_CMD_WRITE_DYNAMIC_BUFFER:
+            if (data) device->WriteDynamicBuffer((ID3D11Buffer*)object, data, size);
+            break;
+        case RENDER_CMD_SET_INPUT_LAYOUT:
+            device->SetInputLayout((ID3D11InputLayout*)object);
+            break;
+        case RENDER_CMD_SET_TOPOLOGY:
+            device->SetPrimitiveTopology(args[0]);
+            break;
+        case RENDER_CMD_SET_VERTEX_BUFFER:
+            device->SetVertexBuffer(args[0], (ID3D11Buffer*)object, args[1], args[2]);
+            break;
+        case RENDER_CMD_SET_INDEX_BUFFER:
+            device->SetIndexBuffer((ID3D11Buffer*)object, args[0], args[1]);
+            break;
+        case RENDER_CMD_SET_RASTERIZER_STATE:
+            device->SetRasterizerState((ID3D11RasterizerState*)object);
+            break;
+        case RENDER_CMD_SET_DEPTH_STENCIL_STATE:
+            device->SetDepthStencilState((ID3D11DepthStencilState*)object, args[0]);
+            break;
+        case RENDER_CMD_SET_BLEND_STATE:
+            device->SetBlendState((ID3D11BlendState*)object, (const float*)data, args[0]);
+            break;
+        case RENDER_CMD_SET_RENDER_TARGETS:
+            device->SetRenderTargets(args[0], (ID3D11RenderTargetView* const*)handleList.data(), (ID3D11DepthStencilView*)object);
+            break;
+        case RENDER_CMD_SET_VIEWPORT:
+        {
+            const float* viewport = (const float*)data;
+            if (viewport) device->SetViewport(viewport[0], viewport[1], viewport[2], viewport[3], viewport[4], viewport[5]);
+            break;
+        }
+        case RENDER_CMD_CLEAR_RENDER_TARGET:
+            if (data) device->ClearRenderTarget((ID3D11RenderTargetView*)object, (const float*)data);
+            break;
+        case RENDER_CMD_CLEAR_DEPTH_STENCIL:
+            if (data) device->ClearDepthStencil((ID3D11DepthStencilView*)object, args[0], *(const float*)data, (unsigned char)args[1]);
+            break;
+        case RENDER_CMD_DRAW:
+            device->Draw(args[0], args[1]);
+            break;
+        case RENDER_CMD_DRAW_INDEXED:
+            device->DrawIndexed(args[0], args[1], (int)args[2]);
+            break;
+        case RENDER_CMD_DRAW_INDEXED_INSTANCED:
+            device->DrawIndexedInstanced(args[0], args[1], args[2], (int)args[3], args[4]);
+            break;
+        case RENDER_CMD_DRAW_INDEXED_INSTANCED_INDIRECT:
+            device->DrawIndexedInstancedIndirect((ID3D11Buffer*)object, args[0]);
+            break;
+        case RENDER_CMD_ALLOCATE_CONSTANTS:
+        {
+            // a device without a ring gets the captured range of the
+            // ring's own buffer instead
+            ConstantAllocation allocation = { (ID3D11Buffer*)object, args[0], args[1], 0 };
+            if (data && !device->AllocateConstants(data, size, allocation))
+                allocation = { (ID3D11Buffer*)object, args[0], args[1], 0 };
+            constantRanges[(uint64_t)command.object << 32 | args[0]] = allocation;
+            break;
+        }
+        case RENDER_CMD_SET_CONSTANT_BUFFER_RANGE:
+        {
+            auto found = constantRanges.find((uint64_t)command.object << 32 | args[2]);
+            if (found != constantRanges.end())
+                device->SetConstantBufferRange((int)args[0], args[1], found->second);
+            break;
+        }
+        }
+    }
+}
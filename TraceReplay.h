@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include "FrameTrace.h"
+#include "RenderDevice.h"
+
+// Plays the frames of a FrameTrace back on any RenderDevice
+// - The trace's object ids are turned into handles through a table
+//   the backend provides (D3D11TraceObjects for a real device); a
+//   backend that never looks at them can use placeholders instead
+// - Calls are issued exactly as recorded, with no state filtering,
+//   so the cost measured is the submission itself
+// - Constant ring allocations are made again on the replay device, and
+//   the ranges bound afterwards are pointed at where they landed there
+class TraceReplay
+{
+public:
+    TraceReplay(FrameTrace* trace);
+
+    // handles[id] for every object in the trace, handles[0] being null
+    void SetObjects(const std::vector<void*>& handles);
+
+    // a distinct non null handle per object, for the null backend
+    void UsePlaceholderObjects();
+
+    void ReplayFrame(unsigned int frameIndex, RenderDevice* device);
+
+private:
+    void* GetHandle(unsigned int id);
+
+    FrameTrace* trace;
+    std::vector<void*> handles;
+    std::vector<unsigned char> placeholders;
+    std::vector<void*> handleList;
+
+    // captured (ring id << 32 | first constant) -> replayed allocation
+    std::unordered_map<uint64_t, ConstantAllocation> constantRanges;
+};
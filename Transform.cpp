@@ -11,6 +11,10 @@ Transform::Transform()
     XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
 
     isDirty = false;
+    isBasisDirty = false;
+    isChanged = true;
+    changeList = 0;
+    changeId = 0;
 }
 
 // getters
@@ -19,7 +23,7 @@ XMFLOAT3 Transform::GetPitchYawRoll() { return this->pitchYawRoll; }
 XMFLOAT3 Transform::GetScale() { return this->scale; }
 XMFLOAT4X4 Transform::GetWorldMatrix() 
 {
-    if (isDirty)
+    if (isBasisDirty)
     {
         // recalc world matrix...
         XMMATRIX translationMatrix = XMMatrixTranslation(position.x, position.y, position.z);
@@ -30,6 +34,15 @@ XMFLOAT4X4 Transform::GetWorldMatrix()
 
         XMStoreFloat4x4(&worldMatrix, world);
 
+        isBasisDirty = false;
+        isDirty = false;
+    }
+    else if (isDirty)
+    {
+        // only moved - the translation is the last row as it is
+        worldMatrix._41 = position.x;
+        worldMatrix._42 = position.y;
+        worldMatrix._43 = position.z;
         isDirty = false;
     }
 
@@ -47,30 +60,51 @@ DirectX::XMFLOAT4X4 Transform::GetInverseTransposeWorldMatrix()
     return invTransposeWorldMatrix;
 }
 
+bool Transform::IsChanged() { return isChanged; }
+void Transform::ClearChanged() { isChanged = false; }
+
+void Transform::SetChangeList(std::vector<unsigned int>* list, unsigned int id)
+{
+    changeList = list;
+    changeId = id;
+}
+
+void Transform::MarkChanged(bool basisChanged)
+{
+    isDirty = true;
+    isBasisDirty = isBasisDirty || basisChanged;
+    if (isChanged)
+        return;
+
+    isChanged = true;
+    if (changeList)
+        changeList->push_back(changeId);
+}
+
 // setters
 void Transform::SetPosition(float x, float y, float z) 
 {
     position = XMFLOAT3(x, y, z);
-    isDirty = true;
+    MarkChanged(false);
 }
 
 void Transform::SetPitchYawRoll(float pitch, float yaw, float roll)
 {
     pitchYawRoll = XMFLOAT3(pitch, yaw, roll);
-    isDirty = true;
+    MarkChanged(true);
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
     scale = XMFLOAT3(x, y, z);
-    isDirty = true;
+    MarkChanged(true);
 }
 
 // transformers
 void Transform::MoveAbsolute(float x, float y, float z)
 {
     position = XMFLOAT3(position.x + x, position.y + y, position.z + z);
-    isDirty = true;
+    MarkChanged(false);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
@@ -83,16 +117,17 @@ void Transform::MoveRelative(float x, float y, float z)
     XMVECTOR relDirection = XMVector3Rotate(absDirection, rotation);
     XMVECTOR newPosition = XMLoadFloat3(&position) + relDirection;
     XMStoreFloat3(&position, newPosition);
+    MarkChanged(false);
 }
 
 void Transform::Rotate(float pitch, float yaw, float roll) 
 {
     pitchYawRoll = XMFLOAT3(pitchYawRoll.x + pitch, pitchYawRoll.y + yaw, pitchYawRoll.z + roll);
-    isDirty = true;
+    MarkChanged(true);
 }
 
 void Transform::Scale(float x, float y, float z)
 {
     scale = XMFLOAT3(scale.x * x, scale.y * y, scale.z * z);
-    isDirty = true;
+    MarkChanged(true);
 }
\ No newline at end of file
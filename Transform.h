@@ -1,6 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <vector>
 
 class Transform
 {
@@ -14,6 +15,17 @@ public:
     DirectX::XMFLOAT4X4 GetWorldMatrix();
     DirectX::XMFLOAT4X4 GetInverseTransposeWorldMatrix();
 
+    // set by every change, and left set until cleared - whoever keeps
+    // something derived from the world matrix (the culler's world
+    // bounds) clears it once they've caught up
+    bool IsChanged();
+    void ClearChanged();
+
+    // the first change after ClearChanged() also pushes id onto the
+    // list, so whoever keeps up with the changes can walk just the
+    // transforms that moved instead of asking every one of them
+    void SetChangeList(std::vector<unsigned int>* list, unsigned int id);
+
     // setters
     void SetPosition(float x, float y, float z);
     void SetPitchYawRoll(float pitch, float yaw, float roll);
@@ -31,6 +43,15 @@ private:
     DirectX::XMFLOAT3 scale;
     DirectX::XMFLOAT3 pitchYawRoll;
 
+    // isDirty - the world matrix needs its translation updated,
+    // isBasisDirty - its scale and rotation need rebuilding too
     bool isDirty;
+    bool isBasisDirty;
+    bool isChanged;
+
+    std::vector<unsigned int>* changeList;
+    unsigned int changeId;
+
+    void MarkChanged(bool basisChanged);
 };
 
@@ -0,0 +1,36 @@
+#include "TypedBuffer.h"
+
+TypedBuffer::TypedBuffer(DXGI_FORMAT format, unsigned int elementSize)
+    : buffer(D3D11_BIND_SHADER_RESOURCE, elementSize)
+{
+    this->format = format;
+}
+
+bool TypedBuffer::Upload(ID3D11Device* device, RenderDevice* renderDevice, const void* elements, unsigned int count)
+{
+    // an empty frame still gets a buffer, so the view exists
+    bool recreated = false;
+    if (!buffer.Reserve(device, count, &recreated))
+    {
+        srv.Reset();
+        return false;
+    }
+
+    if (recreated || !srv)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = format;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        srvDesc.Buffer.FirstElement = 0;
+        srvDesc.Buffer.NumElements = buffer.GetCapacity();
+
+        srv.Reset();
+        if (FAILED(device->CreateShaderResourceView(buffer.GetBuffer(), &srvDesc, srv.GetAddressOf())))
+            return false;
+    }
+
+    return buffer.Write(renderDevice, elements, count);
+}
+
+ID3D11ShaderResourceView* TypedBuffer::GetSRV() { return srv.Get(); }
+unsigned int TypedBuffer::GetCapacity() { return buffer.GetCapacity(); }
@@ -0,0 +1,28 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include "DynamicBuffer.h"
+#include "RenderDevice.h"
+
+// Dynamic buffer shaders read as a Buffer<> of one format (uint, uint2,
+// ...), holding one frame's worth of elements
+// - A DynamicBuffer with a typed view on top - Upload() rewrites it
+//   with a single Map/DISCARD, growing it when the frame needs more room
+// - The view always exists after the first Upload(), even for a frame
+//   with nothing in it, so it can be bound unconditionally
+class TypedBuffer
+{
+public:
+    TypedBuffer(DXGI_FORMAT format, unsigned int elementSize);
+
+    // returns false if the buffer couldn't be (re)created or mapped
+    bool Upload(ID3D11Device* device, RenderDevice* renderDevice, const void* elements, unsigned int count);
+
+    ID3D11ShaderResourceView* GetSRV();
+    unsigned int GetCapacity();
+
+private:
+    DXGI_FORMAT format;
+    DynamicBuffer buffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+};
@@ -1,16 +1,19 @@
 #include "ShaderIncludes.hlsli"
 
-cbuffer ExternalData : register (b0)
+// constants are split by how often they change (see ShaderIncludes.hlsli),
+// world, normal matrix and tint come in per instance
+cbuffer FrameData : register (b0)
 {
-	float4 colorTint;
-	matrix world;
-	matrix view;
-	matrix projection;
-	matrix invTransposeWorld;
 	matrix shadowView;
 	matrix shadowProjection;
 }
 
+cbuffer PassData : register (b1)
+{
+	matrix view;
+	matrix projection;
+}
+
 // --------------------------------------------------------
 // The entry point (main method) for our vertex shader
 // 
@@ -18,12 +21,18 @@ cbuffer ExternalData : register (b0)
 // - Output is a single struct of data to pass down the pipeline
 // - Named "main" because that's the default the shader compiler looks for
 // --------------------------------------------------------
-VertexToPixelNormalShadowMap main(VertexShaderInput input)
+VertexToPixelNormalShadowMap main(InstancedVertexShaderInput input)
 {
 	// Set up output struct
 	VertexToPixelNormalShadowMap output;
 	output.uv = input.uv;
 
+	// the instance rows are laid out like the C++ matrices, so the
+	// position goes on the left
+	float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+	float3x3 invTransposeWorld = float3x3(input.normal0.xyz, input.normal1.xyz, input.normal2.xyz);
+	float4 worldPos = mul(float4(input.position, 1.0f), world);
+
 	// Here we're essentially passing the input position directly through to the next
 	// stage (rasterizer), though it needs to be a 4-component vector now.  
 	// - To be considered within the bounds of the screen, the X and Y components 
@@ -32,26 +41,30 @@ VertexToPixelNormalShadowMap main(VertexShaderInput input)
 	// - Each of these components is then automatically divided by the W component, 
 	//   which we're leaving at 1.0 for now (this is more useful when dealing with 
 	//   a perspective projection matrix, which we'll get to in the future).
-	matrix wvp = mul(projection, mul(view, world));
-	output.position = mul(wvp, float4(input.position, 1.0f));
+	// precise, so it matches ShadowMapVS.hlsl bit for bit when that laid
+	// down the depth pre-pass this is tested EQUAL against
+	matrix vp = mul(projection, view);
+	precise float4 position = mul(vp, worldPos);
+	output.position = position;
 
 	// figure out where vertex is in shadow map
-	matrix shadowWVP = mul(shadowProjection, mul(shadowView, world));
-	output.posForShadows = mul(shadowWVP, float4(input.position, 1.0f));
+	matrix shadowVP = mul(shadowProjection, shadowView);
+	output.posForShadows = mul(shadowVP, worldPos);
 
 	// Pass the color through 
 	// - The values will be interpolated per-pixel by the rasterizer
 	// - We don't need to alter it here, but we do need to send it to the pixel shader
-	output.color = colorTint;
+	output.color = input.colorTint;
+	output.material = input.material;
 
 	// use inverse transpose world matrix to account for non-uniform scaling
-	output.normal = normalize(mul((float3x3)invTransposeWorld, input.normal));
+	output.normal = normalize(mul(input.normal, invTransposeWorld));
 
 	// send world position of vertex for point/spot lights
-	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
+	output.worldPos = worldPos.xyz;
 
 	// use inverse transpose world matric to account for non-uniform scaling
-	output.tangent = normalize(mul((float3x3)invTransposeWorld, input.tangent));
+	output.tangent = normalize(mul(input.tangent, invTransposeWorld));
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)